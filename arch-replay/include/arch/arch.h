@@ -0,0 +1,10 @@
+#ifndef __ARCH_H__
+#define __ARCH_H__
+#include <ppsi/assert.h>
+
+/* Architecture-specific defines, included by top-level stuff */
+
+#include <arpa/inet.h> /* ntohs etc */
+#include <stdlib.h>    /* abs */
+
+#endif /* __ARCH_H__ */
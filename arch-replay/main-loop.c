@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * This is the main loop for the replay. Like the simulator, it jumps to
+ * the next event: a timeout of the state machines, or the next record of
+ * the trace. There's no waiting and no randomness, so two runs on the
+ * same trace and configuration give the same output.
+ */
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+#include <common-fun.h>
+#include "ppsi-replay.h"
+
+/* Call pp_state_machine for each instance. To be called periodically,
+ * when no packets are incoming */
+static int run_all_state_machines(struct pp_globals *ppg)
+{
+	int j;
+	int delay_ms = 0, delay_ms_j;
+
+	for (j = 0; j < ppg->nlinks; j++) {
+		struct pp_instance *ppi = INST(ppg, j);
+		delay_ms_j = pp_state_machine(ppi, NULL, 0);
+
+		/* delay_ms is the least delay_ms among all instances */
+		if (j == 0)
+			delay_ms = delay_ms_j;
+		if (delay_ms_j < delay_ms)
+			delay_ms = delay_ms_j;
+	}
+
+	/* BMCA must run at least once per announce interval 9.2.6.8 */
+	if (pp_gtimeout(ppg, PP_TO_BMC)) {
+		bmc_calculate_ebest(ppg); /* Calculate erbest, ebest,... */
+		pp_gtimeout_reset(ppg, PP_TO_BMC);
+		delay_ms=0;
+	} else {
+		/* check if the BMC timeout is the next to run */
+		int delay_bmca = pp_gnext_delay_1(ppg,PP_TO_BMC);
+		if (delay_bmca < delay_ms)
+			delay_ms = delay_bmca;
+	}
+	return delay_ms;
+}
+
+/* Recorded time against running time, in ms and with integers only */
+static void replay_report(struct replay_arch_data *d, struct timespec *start)
+{
+	struct timespec now;
+	long long rec_ms, real_ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	rec_ms = (d->now_ns - d->start_ns) / 1000 / 1000;
+	real_ms = (now.tv_sec - start->tv_sec) * 1000LL +
+		(now.tv_nsec - start->tv_nsec) / 1000 / 1000;
+	pp_printf("Replayed %lu frames received, %lu sent (%lu as recorded)\n",
+		  d->n_rx, d->n_tx, d->n_tx_matched);
+	pp_printf("Replayed %lli.%03lli s in %lli.%03lli s: %lli recorded "
+		  "seconds per second\n", rec_ms / 1000, rec_ms % 1000,
+		  real_ms / 1000, real_ms % 1000,
+		  real_ms ? rec_ms / real_ms : rec_ms);
+}
+
+void replay_main_loop(struct pp_globals *ppg)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppg);
+	struct timespec start;
+	struct pp_instance *ppi;
+	struct pp_trace_rec *r;
+	int64_t next_ns, tmp_ns;
+	int i, j;
+
+	/* Initialize each link's state machine */
+	for (j = 0; j < ppg->nlinks; j++) {
+		ppi = INST(ppg, j);
+		ppi->is_new_state = 1;
+		/* the recorded links were up */
+		ppi->state = PPS_INITIALIZING;
+		ppi->link_up = TRUE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next_ns = d->now_ns + run_all_state_machines(ppg) * 1000LL * 1000LL;
+
+	while ((r = replay_rec_at(d, d->pos))) {
+		d->pos += pp_trace_rec_size(r);
+
+		/* Timeouts expire before this record, if so recorded */
+		while (next_ns < r->mono_ns) {
+			replay_advance(d, next_ns);
+			next_ns = d->now_ns +
+				run_all_state_machines(ppg) * 1000LL * 1000LL;
+		}
+		replay_advance(d, r->mono_ns);
+
+		if (r->type != PP_TRACE_RX) {
+			replay_recorded_time(d, r);
+			continue;
+		}
+		if (r->port >= ppg->nlinks)
+			continue;
+		ppi = INST(ppg, r->port);
+		d->cur = r;
+		i = __recv_and_count(ppi, ppi->rx_frame, PP_MAX_FRAME_LENGTH - 4,
+				     &ppi->last_rcv_time);
+		d->cur = NULL;
+		if (i <= ppi->rx_offset)
+			continue;
+		tmp_ns = d->now_ns + 1000LL * 1000LL * pp_state_machine(ppi,
+				ppi->rx_ptp, i - ppi->rx_offset);
+		if (tmp_ns < next_ns)
+			next_ns = tmp_ns;
+	}
+	replay_report(d, &start);
+}
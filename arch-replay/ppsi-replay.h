@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Replay of a trace recorded by a unix or wrs build (see <ppsi/trace.h>).
+ *
+ * The timeline is the CLOCK_MONOTONIC of the recording, and the received
+ * frames are handed to the instances when the trace says. The recorded
+ * clock (R) is known at the samples in the trace (get and set) and runs
+ * at the rate of the timeline in between. Our clock is virtual, R plus
+ * delta: the adjustments made by the recorded servo move R, so they are
+ * subtracted from delta, while ours are added to it, and so is the
+ * difference of the two frequencies over time. Time stamps are the
+ * recorded ones plus delta: with the servo of the recording, delta
+ * stays at 0 and the replay repeats the recording exactly.
+ */
+#ifndef __PPSI_REPLAY_H__
+#define __PPSI_REPLAY_H__
+
+/* A frame we send matches a recorded one of its type this close in time */
+#define REPLAY_TX_WINDOW_NS	(1000LL * 1000 * 1000)
+#define REPLAY_MSG_TYPES	16
+
+struct replay_port {
+	int found;			/* the trace has a PORT record */
+	int proto;
+	unsigned char mac[6];
+	char name[16];
+	size_t tx_pos[REPLAY_MSG_TYPES]; /* where to look for the next tx */
+};
+
+struct replay_arch_data {
+	char file[PP_TRACE_PATH_LEN];
+	unsigned char *trace;
+	size_t size;
+	size_t pos;			/* of the next record */
+	struct pp_trace_rec *cur;	/* the frame being received */
+	struct replay_port ports[CONFIG_NR_PORTS];
+	int64_t now_ns, start_ns;	/* timeline */
+	int64_t rec_ns, rec_at_ns;	/* a sample of R, and when */
+	long rec_ppb, ppb;		/* frequency adjustment: R and ours */
+	int64_t delta_ns;
+	double delta_frac;		/* below 1ns, not to lose it */
+	unsigned long n_rx, n_tx, n_tx_matched;
+};
+
+#define REPLAY_ARCH(ppg) ((struct replay_arch_data *)(ppg->arch_glbl_data))
+
+static inline int64_t replay_ns(int64_t secs, int64_t scaled_nsecs)
+{
+	return secs * PP_NSEC_PER_SEC + (scaled_nsecs >> 16);
+}
+
+static inline void replay_pp_time(struct pp_time *t, int64_t ns)
+{
+	t->secs = ns / PP_NSEC_PER_SEC;
+	t->scaled_nsecs = (ns % PP_NSEC_PER_SEC) << 16;
+}
+
+/* R at the current time of the timeline */
+static inline int64_t replay_rec_now(struct replay_arch_data *d)
+{
+	return d->rec_ns + d->now_ns - d->rec_at_ns;
+}
+
+/* The record at pos, or NULL at the end (a trace may be truncated) */
+static inline struct pp_trace_rec *replay_rec_at(struct replay_arch_data *d,
+						 size_t pos)
+{
+	struct pp_trace_rec *r = (void *)(d->trace + pos);
+
+	if (pos + sizeof(*r) > d->size ||
+	    pos + pp_trace_rec_size(r) > d->size)
+		return NULL;
+	return r;
+}
+
+/* main-loop.c */
+extern void replay_main_loop(struct pp_globals *ppg);
+
+/* time-replay */
+extern void replay_advance(struct replay_arch_data *d, int64_t to_ns);
+extern void replay_recorded_time(struct replay_arch_data *d,
+				 struct pp_trace_rec *r);
+extern const struct pp_time_operations replay_time_ops;
+extern const struct pp_network_operations replay_net_ops;
+
+#endif /* __PPSI_REPLAY_H__ */
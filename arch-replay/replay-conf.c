@@ -0,0 +1,20 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+#include <ppsi/ppsi.h>
+#include "ppsi-replay.h"
+
+static int f_replay_file(struct pp_argline *l, int lineno,
+			 struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	strncpy(REPLAY_ARCH(ppg)->file, arg->s, PP_TRACE_PATH_LEN - 1);
+	return 0;
+}
+
+struct pp_argline pp_arch_arglines[] = {
+	LEGACY_OPTION(f_replay_file, "replay-file", ARG_STR),
+	{}
+};
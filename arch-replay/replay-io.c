@@ -0,0 +1,12 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+#include <stdio.h>
+#include <ppsi/ppsi.h>
+
+void pp_puts(const char *s)
+{
+	fputs(s, stdout);
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Startup of the replay: map the trace, set up the ports as they were
+ * recorded, then run the main loop until the end of the trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ppsi/ppsi.h>
+#include "ppsi-replay.h"
+
+/* ppg and fields */
+static struct pp_globals ppg_static;
+static defaultDS_t defaultDS;
+static currentDS_t currentDS;
+static parentDS_t parentDS;
+static timePropertiesDS_t timePropertiesDS;
+static struct replay_arch_data replay_data;
+
+extern struct pp_ext_hooks const pp_hooks;
+
+static int replay_ppi_init(struct pp_globals *ppg, struct pp_instance *ppi)
+{
+	memcpy(&ppi->cfg, &__pp_default_instance_cfg,
+	       sizeof(__pp_default_instance_cfg));
+	ppi->glbs = ppg;
+	ppi->vlans_array_len = CONFIG_VLAN_ARRAY_SIZE;
+	ppi->proto = PP_DEFAULT_PROTO;
+	ppi->ext_hooks = &pp_hooks;
+	ppi->__tx_buffer = malloc(PP_MAX_FRAME_LENGTH);
+	ppi->__rx_buffer = malloc(PP_MAX_FRAME_LENGTH);
+	ppi->servo = calloc(1, sizeof(*ppi->servo));
+	ppi->portDS = calloc(1, sizeof(*ppi->portDS));
+	if (!ppi->__tx_buffer || !ppi->__rx_buffer || !ppi->servo ||
+	    !ppi->portDS)
+		return -1;
+	return 0;
+}
+
+/* Map the trace, and collect what is needed before the first frame */
+static int replay_open(struct pp_globals *ppg)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppg);
+	struct pp_trace_rec *r;
+	struct replay_port *p;
+	int got_servo = 0, got_time = 0;
+	struct stat st;
+	size_t pos;
+	int fd, i;
+
+	fd = open(d->file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		pp_printf("replay: %s: %s\n", d->file, strerror(errno));
+		return -1;
+	}
+	d->size = st.st_size;
+	d->trace = mmap(NULL, d->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (d->trace == MAP_FAILED) {
+		pp_printf("replay: %s: %s\n", d->file, strerror(errno));
+		return -1;
+	}
+	r = replay_rec_at(d, 0);
+	if (!r || r->type != PP_TRACE_HEADER || r->a != PP_TRACE_MAGIC) {
+		pp_printf("replay: %s: not a trace\n", d->file);
+		return -1;
+	}
+	if (r->b != PP_TRACE_VERSION) {
+		pp_printf("replay: %s: version %i, expected %i\n", d->file,
+			  (int)r->b, PP_TRACE_VERSION);
+		return -1;
+	}
+	d->start_ns = d->now_ns = d->rec_at_ns = r->mono_ns;
+	d->pos = pp_trace_rec_size(r);
+
+	for (pos = d->pos; (r = replay_rec_at(d, pos));
+	     pos += pp_trace_rec_size(r)) {
+		switch (r->type) {
+		case PP_TRACE_PORT:
+			if (r->port >= CONFIG_NR_PORTS || r->len < 7)
+				break;
+			p = d->ports + r->port;
+			if (p->found)
+				break;
+			p->found = 1;
+			p->proto = r->a;
+			memcpy(p->mac, r + 1, sizeof(p->mac));
+			strncpy(p->name, (char *)(r + 1) + 6,
+				sizeof(p->name) - 1);
+			break;
+		case PP_TRACE_INIT_SERVO:
+			if (!got_servo++)
+				d->ppb = d->rec_ppb = r->a;
+			break;
+		case PP_TRACE_GET:
+		case PP_TRACE_SET:
+			/* R before the first sample: go back from there */
+			if (!got_time++) {
+				d->rec_ns = replay_ns(r->a, r->b) -
+					(r->mono_ns - d->start_ns);
+			}
+			break;
+		}
+	}
+	for (i = 0; i < CONFIG_NR_PORTS; i++)
+		for (pos = 0; pos < REPLAY_MSG_TYPES; pos++)
+			d->ports[i].tx_pos[pos] = d->pos;
+	return 0;
+}
+
+/* Without "port" in the configuration, use the ports of the trace */
+static int replay_setup(struct pp_globals *ppg)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppg);
+	struct pp_instance *ppi;
+	struct replay_port *p;
+	char s[80];
+	int i;
+
+	if (!ppg->nlinks) {
+		for (i = 0; i < CONFIG_NR_PORTS && d->ports[i].found; i++) {
+			sprintf(s, "port %s; proto %s", d->ports[i].name,
+				d->ports[i].proto == PPSI_PROTO_UDP ?
+				"udp" : "raw");
+			if (pp_config_string(ppg, strdup(s)))
+				return -1;
+		}
+	}
+	if (!ppg->nlinks) {
+		pp_printf("replay: %s: no ports\n", d->file);
+		return -1;
+	}
+	for (i = 0; i < ppg->nlinks; i++) {
+		ppi = INST(ppg, i);
+		p = d->ports + i;
+		if (!p->found) {
+			pp_printf("replay: port %i (%s) is not in the trace\n",
+				  i, ppi->cfg.port_name);
+			return -1;
+		}
+		ppi->iface_name = ppi->cfg.iface_name;
+		ppi->port_name = ppi->cfg.port_name;
+		ppi->delayMechanism = ppi->cfg.delayMechanism;
+		/* The offsets of the frames in the buffers depend on it */
+		ppi->proto = p->proto;
+		ppi->ch[PP_NP_GEN].fd = -1;
+		ppi->ch[PP_NP_EVT].fd = -1;
+		ppi->t_ops = &DEFAULT_TIME_OPS;
+		ppi->n_ops = &DEFAULT_NET_OPS;
+
+		/* As in unix_init_instance, for the same time stamps */
+		ppi->asymmetryCorrectionPortDS.enable =
+			ppi->cfg.asymmetryCorrectionEnable;
+		if (ppi->asymmetryCorrectionPortDS.enable) {
+			ppi->asymmetryCorrectionPortDS.scaledDelayCoefficient =
+				ppi->cfg.scaledDelayCoefficient ?
+				ppi->cfg.scaledDelayCoefficient :
+				(RelativeDifference)(ppi->cfg.delayCoefficient *
+						     REL_DIFF_TWO_POW_FRACBITS);
+			ppi->portDS->delayAsymCoeff =
+				pp_servo_calculateDelayAsymCoefficient(
+				ppi->asymmetryCorrectionPortDS.scaledDelayCoefficient);
+		}
+		ppi->asymmetryCorrectionPortDS.constantAsymmetry =
+			picos_to_interval(ppi->cfg.constantAsymmetry_ps);
+		ppi->timestampCorrectionPortDS.egressLatency =
+			picos_to_interval(ppi->cfg.egressLatency_ps);
+		ppi->timestampCorrectionPortDS.ingressLatency =
+			picos_to_interval(ppi->cfg.ingressLatency_ps);
+		ppi->portDS->masterOnly = ppi->cfg.masterOnly;
+	}
+	pp_init_globals(ppg, ppg->rt_opts);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct pp_globals *ppg = &ppg_static;
+	int i;
+
+	setbuf(stdout, NULL);
+	pp_printf("PPSi. Commit %s, built on " __DATE__ "\n", PPSI_VERSION);
+
+	ppg->max_links = CONFIG_NR_PORTS;
+	ppg->cfg.cur_ppi_n = -1;
+	ppg->defaultDS = &defaultDS;
+	ppg->currentDS = &currentDS;
+	ppg->parentDS = &parentDS;
+	ppg->timePropertiesDS = &timePropertiesDS;
+	ppg->rt_opts = &__pp_default_rt_opts;
+	ppg->arch_glbl_data = &replay_data;
+	ppg->pp_instances = calloc(ppg->max_links, sizeof(struct pp_instance));
+	if (!ppg->pp_instances)
+		return -1;
+	for (i = 0; i < ppg->max_links; i++)
+		if (replay_ppi_init(ppg, INST(ppg, i)))
+			return -1;
+
+	/* The configuration of the recording is the best one to start with */
+	if (pp_parse_cmdline(ppg, argc, argv) != 0)
+		return -1;
+	if (ppg->cfg.cfg_items == 0)
+		pp_config_file(ppg, 0, PP_DEFAULT_CONFIGFILE);
+	if (!replay_data.file[0]) {
+		pp_printf("replay: no \"replay-file\" in the configuration\n");
+		return -1;
+	}
+	if (replay_open(ppg) || replay_setup(ppg))
+		return -1;
+
+	replay_main_loop(ppg);
+	return 0;
+}
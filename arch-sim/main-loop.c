@@ -10,23 +10,21 @@
  */
 #include <stdlib.h>
 #include <errno.h>
-#include <sys/select.h>
-#include <netinet/if_ether.h>
+#include <time.h>
 
 #include <ppsi/ppsi.h>
 #include <common-fun.h>
 #include "ppsi-sim.h"
 
-/* Call pp_state_machine for each instance. To be called periodically,
- * when no packets are incoming */
-static int run_all_state_machines(struct pp_globals *ppg)
+/* Call pp_state_machine for each port of a clock. To be called
+ * periodically, when no packets are incoming */
+static int run_clock_state_machines(struct pp_globals *ppg)
 {
 	int j;
 	int delay_ms = 0, delay_ms_j;
 
 	for (j = 0; j < ppg->nlinks; j++) {
 		struct pp_instance *ppi = INST(ppg, j);
-		sim_set_global_DS(ppi);
 		delay_ms_j = pp_state_machine(ppi, NULL, 0);
 
 		/* delay_ms is the least delay_ms among all instances */
@@ -50,37 +48,71 @@ static int run_all_state_machines(struct pp_globals *ppg)
 	return delay_ms;
 }
 
+/* Each clock has its own BMCA; return the least delay among them all */
+static int run_all_state_machines(struct sim_world *w)
+{
+	int i, delay_ms = 0, delay_ms_i;
+
+	for (i = 0; i < w->n_clocks; i++) {
+		delay_ms_i = run_clock_state_machines(w->clocks[i]);
+		if (i == 0 || delay_ms_i < delay_ms)
+			delay_ms = delay_ms_i;
+	}
+	return delay_ms;
+}
+
 
-void sim_main_loop(struct pp_globals *ppg)
+/* Simulated time against running time, in ms and with integers only */
+static void sim_report_speed(struct sim_world *w, struct timespec *start)
 {
+	struct timespec now;
+	long long sim_ms, real_ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	sim_ms = w->now_ns / 1000 / 1000;
+	real_ms = (now.tv_sec - start->tv_sec) * 1000LL +
+		(now.tv_nsec - start->tv_nsec) / 1000 / 1000;
+	pp_printf("Simulated %lli.%03lli s in %lli.%03lli s: %lli simulated "
+		  "seconds per second\n", sim_ms / 1000, sim_ms % 1000,
+		  real_ms / 1000, real_ms % 1000,
+		  real_ms ? sim_ms / real_ms : sim_ms);
+}
+
+void sim_main_loop(struct sim_world *w)
+{
+	struct timespec start;
+	struct pp_globals *ppg;
 	struct pp_instance *ppi;
-	struct sim_ppg_arch_data *data = SIM_PPG_ARCH(ppg);
 	int64_t delay_ns, tmp_ns;
-	int j, i;
+	int i, j;
 
 	/* Initialize each link's state machine */
-	for (j = 0; j < ppg->nlinks; j++) {
-		ppi = INST(ppg, j);
-		ppi->is_new_state = 1;
-		/* just tell that the links are up */
-		ppi->state = PPS_INITIALIZING;
-		ppi->link_up = TRUE;
+	for (i = 0; i < w->n_clocks; i++) {
+		ppg = w->clocks[i];
+		for (j = 0; j < ppg->nlinks; j++) {
+			ppi = INST(ppg, j);
+			ppi->is_new_state = 1;
+			/* just tell that the links are up */
+			ppi->state = PPS_INITIALIZING;
+			ppi->link_up = TRUE;
+		}
 	}
 
-	delay_ns = run_all_state_machines(ppg) * 1000LL * 1000LL;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	delay_ns = run_all_state_machines(w) * 1000LL * 1000LL;
 
-	while (data->sim_iter_n <= data->sim_iter_max) {
-		while (data->n_pending && data->pending->delay_ns <= delay_ns) {
-			ppi = INST(ppg, data->pending->which_ppi);
+	while (w->sim_iter_n <= w->sim_iter_max) {
+		while (w->n_pending && sim_pending_delay_ns(w) <= delay_ns) {
+			ppi = w->pending[0].dst;
 
-			sim_fast_forward_ns(ppg, data->pending->delay_ns);
-			delay_ns -= data->pending->delay_ns;
+			tmp_ns = sim_pending_delay_ns(w);
+			sim_fast_forward_ns(w, tmp_ns);
+			delay_ns -= tmp_ns;
 
 			i = __recv_and_count(ppi, ppi->rx_frame,
 						PP_MAX_FRAME_LENGTH - 4,
 						&ppi->last_rcv_time);
 
-			sim_set_global_DS(ppi);
 			tmp_ns = 1000LL * 1000LL * pp_state_machine(ppi,
 					ppi->rx_ptp, i - ppi->rx_offset);
 
@@ -91,8 +123,9 @@ void sim_main_loop(struct pp_globals *ppg)
 		 * machine is expired (so delay_ns == 0). If the timeout is not
 		 * expired we just fast forward till it's not expired, since we
 		 * know that there are no packets pending. */
-		sim_fast_forward_ns(ppg, delay_ns);
-		delay_ns = run_all_state_machines(ppg) * 1000LL * 1000LL;
+		sim_fast_forward_ns(w, delay_ns);
+		delay_ns = run_all_state_machines(w) * 1000LL * 1000LL;
 	}
+	sim_report_speed(w, &start);
 	return;
 }
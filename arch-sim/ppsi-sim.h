@@ -20,112 +20,194 @@ struct pp_sim_time_instance {
 	// Future parameters can be added
 };
 
+/* Generator of random numbers: one stream for the network, one per clock */
+struct sim_rand {
+	uint64_t s;
+};
+
+/* Distribution of the variable delay; jit_ns is its scale */
+enum sim_pdv {
+	SIM_PDV_UNIFORM = 0,	/* between 0 and jit_ns */
+	SIM_PDV_EXP,		/* exponential, mean jit_ns */
+	SIM_PDV_GAMMA,		/* gamma, integer shape pdv_shape, mean jit_ns */
+	SIM_PDV_BIMODAL,	/* pdv_shape percent of frames later by jit_ns */
+};
+
+/* Network load, changing over load_period_s (as in G.8261 test cases) */
+enum sim_load_profile {
+	SIM_LOAD_CONST = 0,	/* load_lo */
+	SIM_LOAD_SQUARE,	/* load_hi for half a period, then load_lo */
+	SIM_LOAD_RAMP,		/* from load_lo to load_hi and back */
+};
+
 /*
- * This structure holds the parameter representing the delays on the outgoing
- * link of every pp_instance. All the values are expressed in the *absolute*
- * timescale, which is represented by the master time.
+ * This structure holds the parameter representing the delays in one
+ * direction of a link. All the values are expressed in the *absolute*
+ * timescale, which is the one of the simulator itself.
  */
 struct pp_sim_net_delay {
 	unsigned int t_prop_ns; // propagation delay on outgoing link
 	uint64_t jit_ns; // jitter in nsec on outgoing link
 	uint64_t last_outgoing_jit_ns;
+	int pdv;			/* enum sim_pdv */
+	int pdv_shape;
+	int load_lo, load_hi;		/* percent; jit_ns is the delay at 50% */
+	int load_profile;		/* enum sim_load_profile */
+	int load_period_s;
+	int loss_ppm;
+	int reorder_ppm, reorder_ns;	/* frames held back by reorder_ns */
+	int wander_ns, wander_period_s;	/* sinusoidal change of t_prop_ns */
 };
 
 /*
- * This structure represets a pending packet. which_ppi is the destination ppi,
- * chtype is the channel and delay_ns is the time that should pass from when the
- * packet is sent until it will be received from the destination.
- * Every time a packet is sent a structure like this is filled and stored in the
- * ppg->arch_glbl_data so that we always know which is the first packet that
- * has to be received and when.
+ * Noise of the oscillator of a clock, on top of freq_ppb_real. Frequency
+ * noise is computed every SIM_NOISE_STEP_NS of absolute time and kept
+ * constant in between. Flicker frequency noise is the sum of first-order
+ * processes with time constants one octave apart (1 s to 9 hours), each
+ * with a variance of adev^2 / 2: in this range the Allan deviation is
+ * flat, at flicker_adev. White phase noise only affects the time stamps.
+ */
+#define SIM_NOISE_STEP_NS	(125LL * 1000 * 1000)
+#define SIM_FLICKER_OCTAVES	16
+
+struct sim_clock_noise {
+	double rw_ppb;			/* random walk, ppb per sqrt(second) */
+	int temp_ppb, temp_period_s;	/* sinusoidal, like a daily cycle */
+	double flicker_adev;
+	double wpm_ns;			/* rms, of each time stamp */
+	int enabled;			/* any frequency noise */
+	struct sim_rand rand;
+	int64_t next_step_ns;		/* absolute time */
+	double rw_state_ppb;
+	double flicker_ppb[SIM_FLICKER_OCTAVES];
+	double ppb;			/* the sum, during this step */
+	double frac_ns;			/* sub-nanosecond phase, carried on */
+};
+
+/*
+ * A link connects two ports, usually of different clocks. n_delay[0] is
+ * the direction from port[0] to port[1], n_delay[1] the other one. The
+ * link is declared from port[0] ("sim_link" in the configuration) and
+ * port[1] is looked up by name when the whole configuration is parsed.
+ * A port can have several links: what it sends goes to every peer.
+ */
+struct sim_link {
+	struct pp_instance *port[2];
+	char peer_name[16];
+	struct pp_sim_net_delay n_delay[2];
+};
+
+/*
+ * This structure represets a pending packet. dst is the destination ppi,
+ * src the sender, chtype is the channel and at_ns is the time, in the
+ * absolute timescale, when it will be received from the destination.
+ * seq orders packets with the same at_ns, the one sent first goes first.
+ * Every time a packet is sent a structure like this is filled for each
+ * peer and stored in the sim_world so that we always know which is the
+ * first packet that has to be received and when.
  */
 struct sim_pending_pkt {
-	int64_t delay_ns;
-	int which_ppi;
+	int64_t at_ns;
+	uint64_t seq;
+	struct pp_instance *dst, *src;
 	int chtype;
+	void *frame;		/* a copy for this destination */
+	int len;
 };
+
 /*
- * Structure holding an array of pending packets. 64 does not have a special
- * meaning. They could be less if you look inside the ptp specification, but
- * I put 64 just to be sure.
- * The aim of this structure is to store information on flying packets and when
- * the'll be received, because the standard state machine timeouts are not
- * enough for this. Infact the main loop need to know if there are some packets
- * arriving and when, otherwise it will not know how much fast forwarding is
- * needed. If you fast forward based on timeouts they will expire before any
- * packet has arrived and the state machine will do nothing.
+ * The whole simulation, shared by all the simulated clocks. now_ns is
+ * the absolute time, advanced by sim_fast_forward_ns. The pending
+ * packets are a binary min-heap on (at_ns, seq), grown as needed:
+ * pending[0] is the next one to be received. They are needed because
+ * the standard state machine timeouts are not enough. Infact the main
+ * loop need to know if there are some packets arriving and when,
+ * otherwise it will not know how much fast forwarding is needed. If you
+ * fast forward based on timeouts they will expire before any packet has
+ * arrived and the state machine will do nothing.
  */
-struct sim_ppg_arch_data {
-	int n_pending;
-	struct sim_pending_pkt pending[64];
+struct sim_world {
+	int64_t now_ns;
+	int n_pending, max_pending;
+	uint64_t pending_seq;
+	struct sim_pending_pkt *pending;
 	int64_t sim_iter_max;
 	int64_t sim_iter_n;
 	int enable_runtime_delay_updates;
+	int print_samples;
+	unsigned int seed;		/* for all the random models */
+	struct sim_rand rand;		/* for the network */
+	int64_t init_time_ns;		/* of the first clock */
+	struct pp_sim_net_delay def_delay[2]; /* for new links */
+	int n_clocks;
+	struct pp_globals **clocks;	/* the first is the reference */
+	int n_links;
+	struct sim_link *links;
 };
 
-static inline struct sim_ppg_arch_data *SIM_PPG_ARCH(struct pp_globals *ppg)
-{
-	return (struct sim_ppg_arch_data *)(ppg->arch_glbl_data);
-}
-
 /*
- * Structure holding parameters and informations restricted to just a single
- * instance, like timing informations. Infact in the simulator, even if both
- * master and slave are ppi inside the same ppg, they act like every one of
- * them had its own clock.
- * Some more data we need in every instance are Data Sets, runtime options,
- * servo and TimeProperties. We need them because, since we have two ppi
- * acting like two different machines, we have to use different copies of
- * these data for every one of them. So we just put the per-instance data
- * here and we will the pointers in ppg according to our needs every time
- * we will need to use them.
- * Even more stuff can be added if needed
+ * Each simulated clock is a pp_globals of its own, with its ports, Data
+ * Sets, runtime options and BMCA. A clock with several ports is a
+ * boundary clock. This is the arch data of each of them.
  */
-struct sim_ppi_arch_data {
+struct sim_ppg_arch_data {
+	char name[16];
+	int index;			/* in the sim_world */
 	struct pp_sim_time_instance time;
-	struct pp_sim_net_delay n_delay;
-	/* servo */
-	struct pp_servo *servo;
-	/* Runtime options */
-	struct pp_runtime_opts *rt_opts;
-	/* Data sets */
-	defaultDS_t *defaultDS;
-	currentDS_t *currentDS;
-	parentDS_t *parentDS;
-	timePropertiesDS_t *timePropertiesDS;
-	/* other pp_instance, used in net ops */
-	struct pp_instance *other_ppi;
+	struct sim_clock_noise noise;
+	int64_t init_ofm_ns;		/* from the first clock, if has_ofm */
+	int has_ofm;
+	struct pp_runtime_opts rt_opts;
+	struct sim_world *world;
 };
-/* symbolic names to address master and slave in ppg->pp_instances */
-#define SIM_SLAVE	1
-#define SIM_MASTER	0
 
-static inline struct sim_ppi_arch_data *SIM_PPI_ARCH(struct pp_instance *ppi)
+static inline struct sim_ppg_arch_data *SIM_PPG_ARCH(struct pp_globals *ppg)
 {
-	return (struct sim_ppi_arch_data *)(ppi->arch_inst_data);
+	return (struct sim_ppg_arch_data *)(ppg->arch_glbl_data);
 }
 
-static inline struct pp_instance *pp_sim_get_master(struct pp_globals *ppg)
+static inline struct sim_world *SIM_WORLD(struct pp_globals *ppg)
 {
-	return INST(ppg, SIM_MASTER);
+	return SIM_PPG_ARCH(ppg)->world;
 }
 
-static inline struct pp_instance *pp_sim_get_slave(struct pp_globals *ppg)
+/* Per-port data: the clock is in the pp_globals the port belongs to */
+struct sim_ppi_arch_data {
+	int last_link;		/* the latest declared, for configuration */
+};
+
+static inline struct sim_ppi_arch_data *SIM_PPI_ARCH(struct pp_instance *ppi)
 {
-	return INST(ppg, SIM_SLAVE);
+	return (struct sim_ppi_arch_data *)(ppi->arch_inst_data);
 }
 
-static inline int pp_sim_is_master(struct pp_instance *ppi)
+static inline struct pp_sim_time_instance *SIM_TIME(struct pp_instance *ppi)
 {
-	return ((ppi - ppi->glbs->pp_instances) == SIM_MASTER);
+	return &SIM_PPG_ARCH(ppi->glbs)->time;
 }
 
-static inline int pp_sim_is_slave(struct pp_instance *ppi)
+/* Time from now to the next pending packet; only if n_pending != 0 */
+static inline int64_t sim_pending_delay_ns(struct sim_world *w)
 {
-	return ((ppi - ppi->glbs->pp_instances) == SIM_SLAVE);
+	return w->pending[0].at_ns - w->now_ns;
 }
 
-extern void update_and_print_propagation_delays(struct pp_globals *ppg);
-extern int sim_fast_forward_ns(struct pp_globals *ppg, int64_t ff_ns);
-extern int sim_set_global_DS(struct pp_instance *ppi);
-extern void sim_main_loop(struct pp_globals *ppg);
+extern void update_and_print_propagation_delays(struct sim_world *w);
+extern int sim_fast_forward_ns(struct sim_world *w, int64_t ff_ns);
+extern int sim_new_clock(struct pp_globals *ppg, const char *name,
+			 struct pp_runtime_opts *rt_opts);
+extern int sim_add_link(struct pp_instance *ppi, const char *peer);
+extern void sim_main_loop(struct sim_world *w);
+
+/* Random models, in time-sim/sim-models.c */
+extern void sim_models_init(struct sim_world *w);
+extern double sim_rand_u01(struct sim_rand *r);
+extern double sim_rand_gauss(struct sim_rand *r);
+extern int sim_net_lost(struct sim_world *w, struct pp_sim_net_delay *nd);
+extern int64_t sim_net_jitter_ns(struct sim_world *w,
+				 struct pp_sim_net_delay *nd);
+extern int64_t sim_net_wander_ns(struct sim_world *w,
+				 struct pp_sim_net_delay *nd);
+extern void sim_clock_noise(struct sim_world *w, struct pp_globals *ppg,
+			    int64_t ff_ns);
+extern int64_t sim_stamp_noise_ns(struct pp_instance *ppi);
@@ -8,70 +8,111 @@
 #include <ppsi/ppsi.h>
 #include "ppsi-sim.h"
 
+/* Clock parameters apply to the clock being configured */
 static int f_ppm_real(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct pp_instance *ppi_slave;
-
-	/* master clock is supposed to be perfect. parameters about ppm are
-	 * modifiable only for slave ppi */
-	ppi_slave = pp_sim_get_slave(ppg);
-	SIM_PPI_ARCH(ppi_slave)->time.freq_ppb_real = arg->i * 1000;
+	SIM_PPG_ARCH(ppg)->time.freq_ppb_real = arg->i * 1000;
 	return 0;
 }
 
 static int f_ppm_servo(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct pp_instance *ppi_slave;
-
-	/* master clock is supposed to be perfect. parameters about ppm are
-	 * modifiable only for slave ppi */
-	ppi_slave = pp_sim_get_slave(ppg);
-	SIM_PPI_ARCH(ppi_slave)->time.freq_ppb_servo = arg->i * 1000;
+	SIM_PPG_ARCH(ppg)->time.freq_ppb_servo = arg->i * 1000;
 	return 0;
 }
 
+/* Offset from the first clock, whose initial time is "master_time" */
 static int f_ofm(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct pp_sim_time_instance *t_master, *t_slave;
+	struct sim_ppg_arch_data *data = SIM_PPG_ARCH(ppg);
 
-	t_master = &SIM_PPI_ARCH(pp_sim_get_master(ppg))->time;
-	t_slave = &SIM_PPI_ARCH(pp_sim_get_slave(ppg))->time;
-	t_slave->current_ns = t_master->current_ns + arg->ts.tv_nsec +
+	data->init_ofm_ns = arg->ts.tv_nsec +
 				arg->ts.tv_sec * (long long)PP_NSEC_PER_SEC;
-
+	data->has_ofm = 1;
 	return 0;
 }
 
 static int f_init_time(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct pp_sim_time_instance *t_inst;
-
-	t_inst = &SIM_PPI_ARCH(pp_sim_get_master(ppg))->time;
-	t_inst->current_ns = arg->ts.tv_nsec +
+	SIM_WORLD(ppg)->init_time_ns = arg->ts.tv_nsec +
 				arg->ts.tv_sec * (long long)PP_NSEC_PER_SEC;
+	return 0;
+}
+
+static int f_clock(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		   union pp_cfg_arg *arg)
+{
+	struct sim_ppg_arch_data *data = SIM_PPG_ARCH(ppg);
 
+	/* The first clock may have global options already, but no ports */
+	if (SIM_WORLD(ppg)->n_clocks == 1 && !data->name[0] && !ppg->nlinks) {
+		strncpy(data->name, arg->s, sizeof(data->name) - 1);
+		return 0;
+	}
+	return sim_new_clock(ppg, arg->s, &__pp_default_rt_opts);
+}
+
+int sim_add_link(struct pp_instance *ppi, const char *peer)
+{
+	struct sim_world *w = SIM_WORLD(ppi->glbs);
+	struct sim_link *links;
+
+	links = realloc(w->links, (w->n_links + 1) * sizeof(*links));
+	if (!links)
+		return -1;
+	w->links = links;
+	links += w->n_links;
+	memset(links, 0, sizeof(*links));
+	links->port[0] = ppi;
+	strncpy(links->peer_name, peer, sizeof(links->peer_name) - 1);
+	links->n_delay[0] = w->def_delay[0];
+	links->n_delay[1] = w->def_delay[1];
+	SIM_PPI_ARCH(ppi)->last_link = w->n_links++;
 	return 0;
 }
 
+static int f_link(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		  union pp_cfg_arg *arg)
+{
+	if (ppg->cfg.cur_ppi_n < 0) {
+		pp_printf("config line %i: no port for this config\n", lineno);
+		return -1;
+	}
+	return sim_add_link(INST(ppg, ppg->cfg.cur_ppi_n), arg->s);
+}
+
+/*
+ * Delays apply to the latest link of the current port. Otherwise, they
+ * are the default for links declared later, including the one between
+ * the default master and slave. Forward is from the port that declares
+ * the link (the master, by default), backward is towards it.
+ */
+static struct pp_sim_net_delay *sim_delay(struct pp_globals *ppg, int dir)
+{
+	struct sim_world *w = SIM_WORLD(ppg);
+	int n = ppg->cfg.cur_ppi_n;
+
+	if (n >= 0 && SIM_PPI_ARCH(INST(ppg, n))->last_link >= 0)
+		return w->links[SIM_PPI_ARCH(INST(ppg, n))->last_link].n_delay
+			+ dir;
+	return w->def_delay + dir;
+}
+
 static int f_fwd_t_prop(struct pp_argline *l, int lineno,
 			struct pp_globals *ppg, union pp_cfg_arg *arg)
 {
-	struct sim_ppi_arch_data *data;
-	data = SIM_PPI_ARCH(pp_sim_get_master(ppg));
-	data->n_delay.t_prop_ns = arg->i;
+	sim_delay(ppg, 0)->t_prop_ns = arg->i;
 	return 0;
 }
 
 static int f_bckwd_t_prop(struct pp_argline *l, int lineno,
 			  struct pp_globals *ppg, union pp_cfg_arg *arg)
 {
-	struct sim_ppi_arch_data *data;
-	data = SIM_PPI_ARCH(pp_sim_get_slave(ppg));
-	data->n_delay.t_prop_ns = arg->i;
+	sim_delay(ppg, 1)->t_prop_ns = arg->i;
 	return 0;
 }
 
@@ -86,9 +127,7 @@ static int f_t_prop(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 static int f_fwd_jit(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct sim_ppi_arch_data *data;
-	data = SIM_PPI_ARCH(pp_sim_get_master(ppg));
-	data->n_delay.jit_ns = arg->i;
+	sim_delay(ppg, 0)->jit_ns = arg->i;
 	return 0;
 }
 
@@ -96,9 +135,7 @@ static int f_fwd_jit(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 static int f_bckwd_jit(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	struct sim_ppi_arch_data *data;
-	data = SIM_PPI_ARCH(pp_sim_get_slave(ppg));
-	data->n_delay.jit_ns = arg->i;
+	sim_delay(ppg, 1)->jit_ns = arg->i;
 	return 0;
 }
 
@@ -110,20 +147,135 @@ static int f_jit(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 	return 0;
 }
 
+/*
+ * The models of a link, like the delays above, come in three flavours:
+ * "sim_fwd_<name>", "sim_bckwd_<name>", and "sim_<name>" for both.
+ */
+#define SIM_DELAY_OPTION(name, assignment)				\
+static int f_fwd_##name(struct pp_argline *l, int lineno,		\
+			struct pp_globals *ppg, union pp_cfg_arg *arg)	\
+{									\
+	struct pp_sim_net_delay *nd = sim_delay(ppg, 0);		\
+	assignment;							\
+	return 0;							\
+}									\
+static int f_bckwd_##name(struct pp_argline *l, int lineno,		\
+			  struct pp_globals *ppg, union pp_cfg_arg *arg) \
+{									\
+	struct pp_sim_net_delay *nd = sim_delay(ppg, 1);		\
+	assignment;							\
+	return 0;							\
+}									\
+static int f_##name(struct pp_argline *l, int lineno,			\
+		    struct pp_globals *ppg, union pp_cfg_arg *arg)	\
+{									\
+	f_fwd_##name(l, lineno, ppg, arg);				\
+	return f_bckwd_##name(l, lineno, ppg, arg);			\
+}
+
+#define SIM_DELAY_ARGLINES(name, typ, names)				\
+	{.f = f_##name, .keyword = "sim_" #name, .t = typ, .args = names}, \
+	{.f = f_fwd_##name, .keyword = "sim_fwd_" #name, .t = typ,	\
+	 .args = names},						\
+	{.f = f_bckwd_##name, .keyword = "sim_bckwd_" #name, .t = typ,	\
+	 .args = names}
+
+static struct pp_argname arg_pdv[] = {
+	{"uniform", SIM_PDV_UNIFORM},
+	{"exp exponential", SIM_PDV_EXP},
+	{"gamma", SIM_PDV_GAMMA},
+	{"bimodal", SIM_PDV_BIMODAL},
+	{},
+};
+
+static struct pp_argname arg_load_profile[] = {
+	{"const constant", SIM_LOAD_CONST},
+	{"square", SIM_LOAD_SQUARE},
+	{"ramp", SIM_LOAD_RAMP},
+	{},
+};
+
+SIM_DELAY_OPTION(pdv, nd->pdv = arg->i)
+SIM_DELAY_OPTION(pdv_shape, nd->pdv_shape = arg->i)
+SIM_DELAY_OPTION(load, nd->load_lo = arg->i2[0]; nd->load_hi = arg->i2[1])
+SIM_DELAY_OPTION(load_profile, nd->load_profile = arg->i)
+SIM_DELAY_OPTION(load_period_s, nd->load_period_s = arg->i)
+SIM_DELAY_OPTION(loss_ppm, nd->loss_ppm = arg->i)
+SIM_DELAY_OPTION(reorder, nd->reorder_ppm = arg->i2[0];
+		 nd->reorder_ns = arg->i2[1])
+SIM_DELAY_OPTION(wander, nd->wander_ns = arg->i2[0];
+		 nd->wander_period_s = arg->i2[1])
+
+/* Asymmetry that changes over time: the two directions in opposition */
+static int f_asym_wander(struct pp_argline *l, int lineno,
+			 struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	f_wander(l, lineno, ppg, arg);
+	sim_delay(ppg, 1)->wander_ns = -arg->i2[0];
+	return 0;
+}
+
+/* Noise of the oscillator of the clock being configured */
+static int f_freq_rw(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		     union pp_cfg_arg *arg)
+{
+	SIM_PPG_ARCH(ppg)->noise.rw_ppb = arg->d;
+	return 0;
+}
+
+static int f_temp(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		  union pp_cfg_arg *arg)
+{
+	SIM_PPG_ARCH(ppg)->noise.temp_ppb = arg->i2[0];
+	SIM_PPG_ARCH(ppg)->noise.temp_period_s = arg->i2[1];
+	return 0;
+}
+
+static int f_flicker_adev(struct pp_argline *l, int lineno,
+			  struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	SIM_PPG_ARCH(ppg)->noise.flicker_adev = arg->d;
+	return 0;
+}
+
+static int f_wpm(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		 union pp_cfg_arg *arg)
+{
+	SIM_PPG_ARCH(ppg)->noise.wpm_ns = arg->d;
+	return 0;
+}
+
 static int f_iter(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			union pp_cfg_arg *arg)
 {
-	SIM_PPG_ARCH(ppg)->sim_iter_max = arg->i;
+	SIM_WORLD(ppg)->sim_iter_max = arg->i;
 	return 0;
 }
 
 static int f_enable_runtime_delay_updates(struct pp_argline *l, int lineno,
                                           struct pp_globals *ppg, union pp_cfg_arg *arg)
 {
-    SIM_PPG_ARCH(ppg)->enable_runtime_delay_updates = arg->i;
+    SIM_WORLD(ppg)->enable_runtime_delay_updates = arg->i;
     return 0;
 }
+
+static int f_seed(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		  union pp_cfg_arg *arg)
+{
+	SIM_WORLD(ppg)->seed = arg->i;
+	return 0;
+}
+
+static int f_samples(struct pp_argline *l, int lineno, struct pp_globals *ppg,
+		     union pp_cfg_arg *arg)
+{
+	SIM_WORLD(ppg)->print_samples = arg->i;
+	return 0;
+}
+
 struct pp_argline pp_arch_arglines[] = {
+	LEGACY_OPTION(f_clock,		"sim_clock",		ARG_STR),
+	LEGACY_OPTION(f_link,		"sim_link",		ARG_STR),
 	LEGACY_OPTION(f_ppm_real,	"sim_ppm_real",		ARG_INT),
 	LEGACY_OPTION(f_ppm_servo,	"sim_init_ppm_servo",	ARG_INT),
 	LEGACY_OPTION(f_ofm,		"sim_init_ofm",		ARG_TIME),
@@ -136,6 +288,21 @@ struct pp_argline pp_arch_arglines[] = {
 	LEGACY_OPTION(f_bckwd_jit,	"sim_bckwd_jit_ns",	ARG_INT),
 	LEGACY_OPTION(f_iter,		"sim_iter_max",		ARG_TIME),
 	LEGACY_OPTION(f_enable_runtime_delay_updates, "sim_enable_runtime_delay_updates", ARG_INT),
+	LEGACY_OPTION(f_seed,		"sim_seed",		ARG_INT),
+	LEGACY_OPTION(f_samples,	"sim_print_samples",	ARG_INT),
+	SIM_DELAY_ARGLINES(pdv,		ARG_NAMES,	arg_pdv),
+	SIM_DELAY_ARGLINES(pdv_shape,	ARG_INT,	NULL),
+	SIM_DELAY_ARGLINES(load,	ARG_INT2,	NULL),
+	SIM_DELAY_ARGLINES(load_profile, ARG_NAMES,	arg_load_profile),
+	SIM_DELAY_ARGLINES(load_period_s, ARG_INT,	NULL),
+	SIM_DELAY_ARGLINES(loss_ppm,	ARG_INT,	NULL),
+	SIM_DELAY_ARGLINES(reorder,	ARG_INT2,	NULL),
+	SIM_DELAY_ARGLINES(wander,	ARG_INT2,	NULL),
+	LEGACY_OPTION(f_asym_wander,	"sim_asym_wander",	ARG_INT2),
+	LEGACY_OPTION(f_freq_rw,	"sim_freq_rw_ppb",	ARG_DOUBLE),
+	LEGACY_OPTION(f_temp,		"sim_temp",		ARG_INT2),
+	LEGACY_OPTION(f_flicker_adev,	"sim_flicker_adev",	ARG_DOUBLE),
+	LEGACY_OPTION(f_wpm,		"sim_wpm_ns",		ARG_DOUBLE),
 	{}
 };
 
@@ -102,28 +102,6 @@ const struct wrh_operations wrh_oper = {
 };
 #endif
 
-/*
- * In arch-sim we use two pp_instances in the same pp_globals to represent
- * two different machines. This means *completely differnt* machines, with
- * their own Data Sets. Given we can't put more all the different Data Sets in
- * the same ppg, we stored them in the ppi->arch_inst_data of every instance.
- * This function is used to set the inner Data Sets pointer of the ppg to
- * point to the Data Sets related to the pp_instange passed as argument
- */
-int sim_set_global_DS(struct pp_instance *ppi)
-{
-	struct sim_ppi_arch_data *data = SIM_PPI_ARCH(ppi);
-
-	ppi->glbs->defaultDS = data->defaultDS;
-	ppi->glbs->currentDS = data->currentDS;
-	ppi->glbs->parentDS = data->parentDS;
-	ppi->glbs->timePropertiesDS = data->timePropertiesDS;
-//	ppi->glbs->servo = data->servo;
-	ppi->glbs->rt_opts = data->rt_opts;
-
-	return 0;
-}
-
 #if CONFIG_HAS_EXT_L1SYNC
 /* TODO: share with wrs-startup.c */
 static void enable_asymmetryCorrection(struct pp_instance *ppi, Boolean enable ) {
@@ -139,7 +117,7 @@ static void enable_asymmetryCorrection(struct pp_instance *ppi, Boolean enable )
 }
 #endif
 
-static int sim_ppi_init(struct pp_instance *ppi, int which_ppi)
+static int sim_ppi_init(struct pp_instance *ppi)
 {
 	struct sim_ppi_arch_data *data;
 
@@ -190,104 +168,231 @@ static int sim_ppi_init(struct pp_instance *ppi, int which_ppi)
 #endif
 
 	data = SIM_PPI_ARCH(ppi);
-	data->defaultDS = calloc(1, sizeof(*data->defaultDS));
-	data->currentDS = calloc(1, sizeof(*data->currentDS));
-	data->parentDS = calloc(1, sizeof(*data->parentDS));
-	data->timePropertiesDS = calloc(1, sizeof(*data->timePropertiesDS));
-	data->servo = calloc(1, sizeof(*data->servo));
-	if ((!data->defaultDS) ||
-			(!data->currentDS) ||
-			(!data->parentDS) ||
-			(!data->timePropertiesDS) ||
-			(!data->servo))
-		return -1;
-	if (which_ppi == SIM_MASTER)
-		data->rt_opts = &sim_master_rt_opts;
-	else
-		data->rt_opts = &__pp_default_rt_opts;
-	data->other_ppi = INST(ppi->glbs, -(which_ppi - 1));
+	data->last_link = -1;
 	return 0;
 }
 
-int main(int argc, char **argv)
+/*
+ * Each simulated clock is a pp_globals, with its own Data Sets, runtime
+ * options and instances (its ports). The configuration is parsed into
+ * a single pp_globals, though: "sim_clock" moves the clock configured so
+ * far out of it (see sim_new_clock) and sets up a new one in its place.
+ */
+static int sim_init_clock(struct pp_globals *ppg, struct sim_world *w,
+			  const char *name, struct pp_runtime_opts *rt_opts)
 {
-	struct pp_globals *ppg;
+	struct sim_ppg_arch_data *data;
+	struct pp_globals **clocks;
 	struct pp_instance *ppi;
 	int i;
 
-	setbuf(stdout, NULL);
-	pp_printf("PPSi. Commit %s, built on " __DATE__ "\n", PPSI_VERSION);
-
-	ppg = calloc(1, sizeof(struct pp_globals));
-	ppg->max_links = 2; // master and slave, nothing else
-	ppg->arch_glbl_data = calloc(1, sizeof(struct sim_ppg_arch_data));
+	memset(ppg, 0, sizeof(*ppg));
+	ppg->max_links = CONFIG_NR_PORTS;
+	ppg->cfg.cur_ppi_n = -1;
+	ppg->arch_glbl_data = data = calloc(1, sizeof(*data));
+	ppg->defaultDS = calloc(1, sizeof(*ppg->defaultDS));
+	ppg->currentDS = calloc(1, sizeof(*ppg->currentDS));
+	ppg->parentDS = calloc(1, sizeof(*ppg->parentDS));
+	ppg->timePropertiesDS = calloc(1, sizeof(*ppg->timePropertiesDS));
 	ppg->pp_instances = calloc(ppg->max_links, sizeof(struct pp_instance));
-
-	if ((!ppg->arch_glbl_data) || (!ppg->pp_instances))
+	clocks = realloc(w->clocks, (w->n_clocks + 1) * sizeof(*clocks));
+	if (!data || !ppg->defaultDS || !ppg->currentDS || !ppg->parentDS ||
+	    !ppg->timePropertiesDS || !ppg->pp_instances || !clocks)
 		return -1;
+	w->clocks = clocks;
+
+	strncpy(data->name, name, sizeof(data->name) - 1);
+	data->world = w;
+	data->rt_opts = *rt_opts;
+	ppg->rt_opts = &data->rt_opts;
 
 	/* Alloc data stuctures inside the pp_instances */
 	for (i = 0; i < ppg->max_links; i++) {
 		ppi = INST(ppg, i);
-		ppi->glbs = ppg; // must be done before using sim_set_global_DS
+		ppi->glbs = ppg;
 		ppi->vlans_array_len = CONFIG_VLAN_ARRAY_SIZE;
 		ppi->servo = calloc(1, sizeof (struct pp_servo));
 		if (ppi->servo == NULL)
 			return -1;
-		if (sim_ppi_init(ppi, i))
+		if (sim_ppi_init(ppi))
 			return -1;
 	}
+	w->clocks[w->n_clocks++] = ppg;
+	return 0;
+}
+
+/* ppg is the clock being configured, always the last one in the world */
+int sim_new_clock(struct pp_globals *ppg, const char *name,
+		  struct pp_runtime_opts *rt_opts)
+{
+	struct sim_world *w = SIM_WORLD(ppg);
+	struct pp_globals *prev;
+	int i;
+
+	prev = malloc(sizeof(*prev));
+	if (!prev)
+		return -1;
+	*prev = *ppg;
+	for (i = 0; i < prev->max_links; i++)
+		INST(prev, i)->glbs = prev;
+	w->clocks[w->n_clocks - 1] = prev;
+
+	if (sim_init_clock(ppg, w, name, rt_opts))
+		return -1;
+	ppg->cfg.cfg_items = prev->cfg.cfg_items;
+	return 0;
+}
 
-	/*
-	 * Configure the master with standard configuration, only from default
-	 * string. The master is not configurable, but there's no need to do
-	 * it cause we are ok with a standard one. We just want to see the
-	 * behaviour of the slave.
-	 * NOTE: the master instance is initialized before parsing the command
-	 * line, so the diagnostics cannot be enabled here. We cannot put the
-	 * master config later because the initial time for the master is needed
-	 * to set the initial offset for the slave
-	 */
-	sim_set_global_DS(pp_sim_get_master(ppg));
-
-	pp_config_string(ppg, strdup("port SIM_MASTER; iface MASTER;"
-					"proto udp;"
-					"sim_iter_max 10000;"
-					"sim_init_master_time .9;"));
+/*
+ * Without any "sim_link", what was configured is the slave clock: add the
+ * master, as the first clock, and link it to every port of the slave.
+ * The master is not configurable, but there's no need to do it cause we
+ * are ok with a standard one. We just want to see the behaviour of the
+ * slave.
+ */
+static int sim_default_topology(struct pp_globals *ppg)
+{
+	struct sim_world *w = SIM_WORLD(ppg);
+	struct pp_globals *slave;
+	int i;
+
+	if (!SIM_PPG_ARCH(ppg)->name[0])
+		strcpy(SIM_PPG_ARCH(ppg)->name, "slave");
+	if (sim_new_clock(ppg, "master", &sim_master_rt_opts))
+		return -1;
+	if (pp_config_string(ppg, strdup("port SIM_MASTER; iface MASTER;"
+					 "proto udp;")))
+		return -1;
+	slave = w->clocks[0];
+	w->clocks[0] = ppg;
+	w->clocks[1] = slave;
+
+	for (i = 0; i < slave->nlinks; i++)
+		if (sim_add_link(INST(ppg, 0), INST(slave, i)->cfg.port_name))
+			return -1;
+	return 0;
+}
+
+static struct pp_instance *sim_find_port(struct sim_world *w,
+					 const char *name)
+{
+	struct pp_globals *ppg;
+	int i, j;
+
+	for (i = 0; i < w->n_clocks; i++) {
+		ppg = w->clocks[i];
+		for (j = 0; j < ppg->nlinks; j++)
+			if (!strcmp(INST(ppg, j)->cfg.port_name, name))
+				return INST(ppg, j);
+	}
+	return NULL;
+}
+
+/* Resolve links, set the initial time of clocks and init all ports */
+static int sim_setup(struct sim_world *w)
+{
+	struct sim_ppg_arch_data *data;
+	struct pp_globals *ppg;
+	struct pp_instance *ppi;
+	struct sim_link *l;
+	int i, j;
+
+	for (i = 0; i < w->n_clocks; i++) {
+		ppg = w->clocks[i];
+		data = SIM_PPG_ARCH(ppg);
+		if (!data->name[0])
+			sprintf(data->name, "clock%i", i);
+		if (!ppg->nlinks) {
+			pp_printf("sim: clock \"%s\" has no ports\n",
+				  data->name);
+			return -1;
+		}
+		/* links refer to ports by name: they must be unique */
+		for (j = 0; j < ppg->nlinks; j++) {
+			ppi = INST(ppg, j);
+			if (sim_find_port(w, ppi->cfg.port_name) != ppi) {
+				pp_printf("sim: port \"%s\" defined twice\n",
+					  ppi->cfg.port_name);
+				return -1;
+			}
+		}
+	}
+	for (i = 0; i < w->n_links; i++) {
+		l = w->links + i;
+		l->port[1] = sim_find_port(w, l->peer_name);
+		if (!l->port[1] || l->port[1] == l->port[0]) {
+			pp_printf("sim: port \"%s\": can't link to \"%s\"\n",
+				  l->port[0]->cfg.port_name, l->peer_name);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < w->n_clocks; i++) {
+		ppg = w->clocks[i];
+		data = SIM_PPG_ARCH(ppg);
+		data->index = i;
+		/* The first clock is the reference, the others start at 0 */
+		if (i == 0)
+			data->time.current_ns = w->init_time_ns;
+		else if (data->has_ofm)
+			data->time.current_ns = w->init_time_ns +
+				data->init_ofm_ns;
+
+		for (j = 0; j < ppg->nlinks; j++) {
+			ppi = INST(ppg, j);
+			ppi->iface_name = ppi->cfg.iface_name;
+			ppi->port_name = ppi->cfg.port_name;
+			ppi->delayMechanism = ppi->cfg.delayMechanism;
+			if (ppi->proto == PPSI_PROTO_RAW)
+				pp_printf("Warning: simulator doesn't support "
+					  "raw ethernet. Using UDP\n");
+			ppi->ch[PP_NP_GEN].fd = -1;
+			ppi->ch[PP_NP_EVT].fd = -1;
+			ppi->t_ops = &DEFAULT_TIME_OPS;
+			ppi->n_ops = &DEFAULT_NET_OPS;
+
+			ppi->portDS->logAnnounceInterval =
+				PP_DEFAULT_ANNOUNCE_INTERVAL;
+		}
+		pp_init_globals(ppg, ppg->rt_opts);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_world *w;
+	struct pp_globals *ppg;
+
+	setbuf(stdout, NULL);
+	pp_printf("PPSi. Commit %s, built on " __DATE__ "\n", PPSI_VERSION);
+
+	w = calloc(1, sizeof(*w));
+	ppg = calloc(1, sizeof(*ppg));
+	if (!w || !ppg)
+		return -1;
+	if (sim_init_clock(ppg, w, "", &__pp_default_rt_opts))
+		return -1;
+	w->sim_iter_max = 10000;
+	w->init_time_ns = 900LL * 1000 * 1000;
+	w->seed = 1; /* the default of rand() */
 
 	/* parse commandline for configuration options */
-	sim_set_global_DS(pp_sim_get_slave(ppg));
 	if (pp_parse_cmdline(ppg, argc, argv) != 0)
 		return -1;
 	/* If no item has been parsed, provide default file or string */
 	if (ppg->cfg.cfg_items == 0)
 		pp_config_file(ppg, 0, PP_DEFAULT_CONFIGFILE);
-	if (ppg->cfg.cfg_items == 0)
+	if (ppg->cfg.cfg_items == 0 && w->n_clocks == 1 && !ppg->nlinks)
 		pp_config_string(ppg, strdup("port SIM_SLAVE; iface SLAVE;"
 						"proto udp;"));
 
-	for (i = 0; i < ppg->nlinks; i++) {
-		ppi = INST(ppg, i);
-		sim_set_global_DS(ppi);
-		ppi->iface_name = ppi->cfg.iface_name;
-		ppi->port_name = ppi->cfg.port_name;
-		ppi->delayMechanism = ppi->cfg.delayMechanism;
-		if (ppi->proto == PPSI_PROTO_RAW)
-			pp_printf("Warning: simulator doesn't support raw "
-					"ethernet. Using UDP\n");
-		ppi->ch[PP_NP_GEN].fd = -1;
-		ppi->ch[PP_NP_EVT].fd = -1;
-		ppi->t_ops = &DEFAULT_TIME_OPS;
-		ppi->n_ops = &DEFAULT_NET_OPS;
-
-		ppi->portDS->logAnnounceInterval = PP_DEFAULT_ANNOUNCE_INTERVAL;
-
-		if (pp_sim_is_master(ppi))
-			pp_init_globals(ppg, &sim_master_rt_opts);
-		else
-			pp_init_globals(ppg, &__pp_default_rt_opts);
-	}
+	if (!w->n_links && w->n_clocks == 1 && sim_default_topology(ppg))
+		return -1;
+	if (sim_setup(w))
+		return -1;
+	sim_models_init(w);
 
-	sim_main_loop(ppg);
+	sim_main_loop(w);
 	return 0;
 }
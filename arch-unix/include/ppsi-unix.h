@@ -10,8 +10,80 @@
  */
 
 #define POSIX_ARCH(ppg) ((struct unix_arch_data *)(ppg->arch_glbl_data))
+#define UNIX_MAX_AUX_FD 4
+
+/* Other descriptors served by the main loop (metrics, ...) */
+struct unix_aux_fd {
+	int fd;
+	void (*action)(struct pp_globals *ppg, int fd);
+};
+
 struct unix_arch_data {
 	struct timeval tv;
+	int n_aux_fd;
+	struct unix_aux_fd aux_fd[UNIX_MAX_AUX_FD];
+	int run_now;	/* set by aux actions: run all state machines */
 };
 
 extern void unix_main_loop(struct pp_globals *ppg);
+extern int unix_add_aux_fd(struct pp_globals *ppg, int fd,
+			   void (*action)(struct pp_globals *ppg, int fd));
+extern void unix_port_down(struct pp_globals *ppg, struct pp_instance *ppi);
+
+/* unix-startup.c */
+extern int unix_parse_config(struct pp_globals *ppg, int argc, char **argv);
+extern int unix_init_instance(struct pp_globals *ppg, struct pp_instance *ppi);
+extern void unix_clear_instance(struct pp_globals *ppg,
+				struct pp_instance *ppi);
+extern void enable_asymmetryCorrection(struct pp_instance *ppi,
+				       Boolean enable);
+
+/* unix-arena.c */
+#if CONFIG_HAS_ARENA
+extern void *unix_zalloc(size_t size);
+extern size_t unix_arena_used(void);
+extern void unix_arena_footprint(struct pp_instance *ppi, size_t arena_bytes);
+extern void unix_arena_report(struct pp_globals *ppg);
+#else
+static inline void *unix_zalloc(size_t size)
+{
+	return calloc(1, size);
+}
+static inline size_t unix_arena_used(void) { return 0; }
+static inline void unix_arena_footprint(struct pp_instance *ppi,
+					size_t arena_bytes) {}
+static inline void unix_arena_report(struct pp_globals *ppg) {}
+#endif
+
+/* unix-reload.c */
+extern void unix_reload_init(struct pp_globals *ppg, int argc, char **argv);
+
+/* unix-diag.c */
+#define UNIX_DIAG_DRAIN_MAX 256 /* messages printed per main loop iteration */
+extern void unix_diag_init(struct pp_globals *ppg);
+extern void unix_diag_drain(int max);
+/* Frame dumps, deferred like messages; 0 if they must be dumped now */
+#if CONFIG_HAS_DIAG_RING
+extern int unix_diag_1588pkt(struct pp_instance *ppi, char *prefix, void *buf,
+			     int len, const struct pp_time *t, int vlan);
+extern int unix_diag_payloadpkt(struct pp_instance *ppi, char *prefix,
+				void *buf, int len, const struct pp_time *t);
+#else
+static inline int unix_diag_1588pkt(struct pp_instance *ppi, char *prefix,
+				    void *buf, int len,
+				    const struct pp_time *t, int vlan)
+{
+	return 0;
+}
+static inline int unix_diag_payloadpkt(struct pp_instance *ppi, char *prefix,
+				       void *buf, int len,
+				       const struct pp_time *t)
+{
+	return 0;
+}
+#endif
+
+/* unix-metrics.c */
+extern void unix_metrics_init(struct pp_globals *ppg);
+#define UNIX_PATH_LEN 108 /* sizeof(sun_path) */
+extern char unix_metrics_socket[UNIX_PATH_LEN];
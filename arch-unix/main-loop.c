@@ -10,6 +10,7 @@
  */
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/select.h>
 #include <netinet/if_ether.h>
 
@@ -31,7 +32,7 @@ static int run_all_state_machines(struct pp_globals *ppg)
 		int old_lu = ppi->link_up;
 		
 		/* TODO: add the proper discovery of link_up */
-		ppi->link_up = 1;
+		ppi->link_up = !ppi->removed;
 
 		if (old_lu != ppi->link_up) {
 			pp_diag(ppi, fsm, 1, "iface %s went %s\n",
@@ -40,11 +41,16 @@ static int run_all_state_machines(struct pp_globals *ppg)
 			if (ppi->link_up) {
 				ppi->state = PPS_INITIALIZING;
 				/* TODO: Get calibration values here */
+			} else {
+				unix_port_down(ppg, ppi);
 			}
 
 		}
 
-		delay_ms_j = pp_state_machine(ppi, NULL, 0);
+		/* Do not call state machine if link is down */
+		delay_ms_j = ppi->link_up ?
+			pp_loop_run(ppi, NULL, 0) :
+			PP_DEFAULT_NEXT_DELAY_MS;
 
 		/* delay_ms is the least delay_ms among all instances */
 		if (j == 0)
@@ -72,6 +78,43 @@ static int run_all_state_machines(struct pp_globals *ppg)
 	return delay_ms;
 }
 
+static inline int64_t unix_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Stop a port: leave its state, close its sockets, forget its masters */
+void unix_port_down(struct pp_globals *ppg, struct pp_instance *ppi)
+{
+	ppi->next_state = PPS_DISABLED;
+	if (ppi->current_state_item)
+		pp_leave_current_state(ppi);
+	else
+		ppi->state = PPS_DISABLED;
+	ppi->n_ops->exit(ppi);
+	ppi->frgn_rec_num = 0;
+	ppi->frgn_rec_best = -1;
+	if (ppg->ebest_idx == ppi->port_idx && ppi->ext_hooks->servo_reset)
+		ppi->ext_hooks->servo_reset(ppi);
+}
+
+/* Register another descriptor to be served by the main loop */
+int unix_add_aux_fd(struct pp_globals *ppg, int fd,
+		    void (*action)(struct pp_globals *ppg, int fd))
+{
+	struct unix_arch_data *arch_data = POSIX_ARCH(ppg);
+
+	if (arch_data->n_aux_fd >= UNIX_MAX_AUX_FD)
+		return -1;
+	arch_data->aux_fd[arch_data->n_aux_fd].fd = fd;
+	arch_data->aux_fd[arch_data->n_aux_fd].action = action;
+	arch_data->n_aux_fd++;
+	return 0;
+}
+
 void unix_main_loop(struct pp_globals *ppg)
 {
 	struct pp_instance *ppi;
@@ -96,12 +139,21 @@ void unix_main_loop(struct pp_globals *ppg)
 	while (1) {
 		int packet_available;
 
+		if (CONFIG_HAS_DIAG_RING)
+			unix_diag_drain(UNIX_DIAG_DRAIN_MAX);
+
+		pp_loop_wait(ppg, delay_ms);
 		packet_available = unix_net_ops.check_packet(ppg, delay_ms);
+		pp_loop_wake(ppg);
+		if (pp_frec_poll(ppg))
+			POSIX_ARCH(ppg)->run_now = 1;
 
-		if (packet_available < 0)
+		if (packet_available < 0 && !POSIX_ARCH(ppg)->run_now)
 			continue;
 
-		if (packet_available == 0) {
+		if (packet_available <= 0) {
+			POSIX_ARCH(ppg)->run_now = 0;
+			pp_loop_timer(ppg);
 			delay_ms = run_all_state_machines(ppg);
 			continue;
 		}
@@ -114,28 +166,38 @@ void unix_main_loop(struct pp_globals *ppg)
 
 		for (j = 0; j < ppg->nlinks; j++) {
 			int tmp_d, i;
+			int64_t t0 = 0;
 			ppi = INST(ppg, j);
 
 			if ((ppi->ch[PP_NP_GEN].pkt_present) ||
 			    (ppi->ch[PP_NP_EVT].pkt_present)) {
 
+				if (CONFIG_HAS_METRICS)
+					t0 = unix_monotonic_ns();
+
 				i = __recv_and_count(ppi, ppi->rx_frame,
 						PP_MAX_FRAME_LENGTH - 4,
 						&ppi->last_rcv_time);
 
 				if (i == PP_RECV_DROP) {
+					pp_metrics_drop(ppi, PP_DROP_RECV);
 					continue; /* dropped or not for us */
 				}
 				if (i == -1) {
 					pp_diag(ppi, frames, 1,
 						"Receive Error %i: %s\n",
 						errno, strerror(errno));
+					pp_metrics_drop(ppi, PP_DROP_RECV);
 					continue;
 				}
 
-				tmp_d = pp_state_machine(ppi, ppi->rx_ptp,
+				tmp_d = pp_loop_run(ppi, ppi->rx_ptp,
 					i - ppi->rx_offset);
 
+				if (CONFIG_HAS_METRICS)
+					pp_metrics_frame_time(ppi,
+						unix_monotonic_ns() - t0);
+
 				if ((delay_ms == -1) || (tmp_d < delay_ms))
 					delay_ms = tmp_d;
 			}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Arena for the data of each instance (data sets, servo, extension
+ * data, frame buffers). Objects are never freed: they are carved out
+ * of large mappings, one after the other and cache-line aligned, so
+ * the objects of one instance are contiguous and no line is shared
+ * by two instances. With CONFIG_ARENA_HUGEPAGES the mappings are
+ * hugepages, if the system has any available.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <ppsi/ppsi.h>
+#include "ppsi-unix.h"
+
+#define ARENA_ALIGN	64
+#define ARENA_CHUNK	(2 << 20) /* the usual size of a hugepage */
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+static struct {
+	char *cur, *end;
+	size_t used;		/* bytes given out, including padding */
+	size_t mapped;
+	int huge;		/* number of chunks in hugepages */
+} arena;
+
+static void *arena_map(size_t size)
+{
+	void *p = MAP_FAILED;
+
+	if (CONFIG_HAS_ARENA_HUGEPAGES && MAP_HUGETLB) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			arena.huge++;
+	}
+	if (p == MAP_FAILED)
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		pp_error("%s: %s\n", __func__, strerror(errno));
+		return NULL;
+	}
+	arena.mapped += size;
+	return p;
+}
+
+/* Memory is zeroed, as it comes from new anonymous mappings */
+void *unix_zalloc(size_t size)
+{
+	size_t chunk;
+	void *p;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (arena.cur + size > arena.end) {
+		chunk = size > ARENA_CHUNK ?
+			(size + ARENA_CHUNK - 1) & ~(size_t)(ARENA_CHUNK - 1) :
+			ARENA_CHUNK;
+		p = arena_map(chunk);
+		if (!p)
+			return NULL;
+		arena.cur = p;
+		arena.end = arena.cur + chunk;
+	}
+	p = arena.cur;
+	arena.cur += size;
+	arena.used += size;
+	return p;
+}
+
+size_t unix_arena_used(void)
+{
+	return arena.used;
+}
+
+/* Memory used by each instance outside of the arena */
+static size_t arena_inst_tables(void)
+{
+	return sizeof(struct pp_instance)
+		+ (CONFIG_HAS_METRICS ? sizeof(struct pp_metrics) : 0)
+		+ (CONFIG_HAS_LATENCY_TRACE ? sizeof(struct pp_lat_inst) : 0);
+}
+
+void unix_arena_footprint(struct pp_instance *ppi, size_t arena_bytes)
+{
+	pp_diag(ppi, config, 1, "footprint: %zu bytes (%zu in tables, "
+		"%zu in the arena)\n", arena_inst_tables() + arena_bytes,
+		arena_inst_tables(), arena_bytes);
+}
+
+void unix_arena_report(struct pp_globals *ppg)
+{
+	size_t per_inst = ppg->nlinks ? arena.used / ppg->nlinks : 0;
+
+	pp_printf("Memory: %i ports, %zu bytes each (%zu in tables, %zu in "
+		  "the arena); arena: %zu mapped, %i chunks in hugepages\n",
+		  ppg->nlinks, arena_inst_tables() + per_inst,
+		  arena_inst_tables(), per_inst, arena.mapped, arena.huge);
+}
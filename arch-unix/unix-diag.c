@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Deferred diagnostics for arch-unix. __pp_diag() does not format its
+ * message: it stores the format pointer, a timestamp, the thing, the
+ * level, the instance index and the raw arguments in a ring, and returns.
+ * The main loop formats pending records before waiting for frames, so
+ * formatting and output happen between frames, not while one is being
+ * processed. Strings are copied, so they can come from static buffers.
+ * The port name is looked up when printing, as the instance table may
+ * be reallocated in the meantime (see pp_grow_instances).
+ * Times of pp_diag_time() and frames to be dumped are stored raw as well,
+ * and time_to_string() and the dump functions run when printing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+#include "ptpdump.h"
+#include "ppsi-unix.h"
+
+#define RING_ARGS	8
+#define RING_STR	96	/* room for the strings of one record */
+#define RING_SPEC	32	/* max length of one conversion */
+#define RING_FRAME	192	/* longer frames are dumped at once */
+
+enum diag_arg_type {
+	DARG_NONE, DARG_INT, DARG_LONG, DARG_LLONG, DARG_PTR, DARG_STR, DARG_DBL,
+	DARG_TIME,	/* the "%s" of pp_diag_time, formatted from r->t */
+};
+
+enum diag_rec_type {
+	DREC_MSG, DREC_1588PKT, DREC_PAYLOADPKT,
+};
+
+union diag_arg {
+	int i;
+	long l;
+	long long ll;
+	void *p;
+	double d;
+	int s;		/* offset in str[] */
+};
+
+struct diag_rec {
+	const char *fmt;	/* or the prefix, for frames */
+	struct timespec ts;
+	int16_t inst;		/* -1 for global messages */
+	unsigned char th, level, type, has_t;
+	struct pp_time t;	/* of pp_diag_time, or the frame stamp */
+	union {
+		struct {	/* DREC_MSG */
+			union diag_arg a[RING_ARGS];
+			char str[RING_STR];
+		};
+		struct {	/* DREC_1588PKT, DREC_PAYLOADPKT */
+			int16_t len, vlan;
+			unsigned char data[RING_FRAME];
+		};
+	};
+};
+
+static struct diag_rec ring[CONFIG_DIAG_RING_SIZE];
+static unsigned ring_head, ring_tail, ring_lost;
+static struct pp_globals *diag_ppg;
+
+/*
+ * Parse one conversion, p points after the '%'. Return its length,
+ * or -1 if it can't be deferred (e.g. '*' width or unknown conversion)
+ */
+static int diag_conv(const char *p, int *type)
+{
+	const char *s = p;
+	int len = 0;
+
+	while (*s && strchr("-+ #0", *s))
+		s++;
+	while ((*s >= '0' && *s <= '9') || *s == '.')
+		s++;
+	for (; *s == 'h' || *s == 'l' || *s == 'z' || *s == 'L'; s++)
+		len += (*s == 'l' || *s == 'z') ? 1 : (*s == 'L') ? 2 : 0;
+
+	switch (*s) {
+	case '%':
+		*type = DARG_NONE;
+		break;
+	case 'c': case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+		*type = len == 0 ? DARG_INT : len == 1 ? DARG_LONG : DARG_LLONG;
+		break;
+	case 'p':
+		*type = DARG_PTR;
+		break;
+	case 's':
+		*type = DARG_STR;
+		break;
+	case 'f': case 'e': case 'g': case 'E': case 'G':
+		if (len > 1)
+			return -1; /* long double */
+		*type = DARG_DBL;
+		break;
+	default:
+		return -1;
+	}
+	return s - p + 1;
+}
+
+/* Whether fmt has other conversions than "%%" */
+static int diag_has_conv(const char *f)
+{
+	for (; (f = strchr(f, '%')); f += 2)
+		if (f[1] != '%')
+			return 1;
+	return 0;
+}
+
+static void diag_print(struct diag_rec *r)
+{
+	const char *f = r->fmt, *lit;
+	char spec[RING_SPEC];
+	const char *name = "ppsi";
+	int n = 0, len, type;
+
+	switch (r->type) {
+	case DREC_1588PKT:
+		dump_1588pkt((char *)r->fmt, r->data, r->len,
+			     r->has_t ? &r->t : NULL, r->vlan);
+		return;
+	case DREC_PAYLOADPKT:
+		dump_payloadpkt((char *)r->fmt, r->data, r->len,
+				r->has_t ? &r->t : NULL);
+		return;
+	}
+	if (r->inst >= 0 && r->inst < diag_ppg->nlinks)
+		name = INST(diag_ppg, r->inst)->port_name;
+	printf("%li.%06li diag-%s-%i-%s: ", (long)r->ts.tv_sec,
+	       r->ts.tv_nsec / 1000, pp_diag_thing_name[r->th], r->level,
+	       name);
+	while (*f) {
+		for (lit = f; *f && *f != '%'; f++)
+			;
+		fwrite(lit, 1, f - lit, stdout);
+		if (!*f)
+			break;
+		/* already validated by diag_put */
+		len = diag_conv(f + 1, &type) + 1;
+		memcpy(spec, f, len);
+		spec[len] = '\0';
+		f += len;
+		if (r->has_t && type == DARG_STR && !diag_has_conv(f))
+			type = DARG_TIME;
+		switch (type) {
+		case DARG_NONE: fputs("%", stdout); continue;
+		case DARG_INT: printf(spec, r->a[n].i); break;
+		case DARG_LONG: printf(spec, r->a[n].l); break;
+		case DARG_LLONG: printf(spec, r->a[n].ll); break;
+		case DARG_PTR: printf(spec, r->a[n].p); break;
+		case DARG_STR: printf(spec, r->str + r->a[n].s); break;
+		case DARG_DBL: printf(spec, r->a[n].d); break;
+		case DARG_TIME: printf(spec, time_to_string(&r->t)); break;
+		}
+		n++;
+	}
+}
+
+/* The next free record, or NULL if the ring is full */
+static struct diag_rec *diag_new(struct pp_instance *ppi, int th, int level)
+{
+	struct diag_rec *r;
+
+	if (ring_head - ring_tail >= CONFIG_DIAG_RING_SIZE) {
+		ring_lost++;
+		return NULL;
+	}
+	r = ring + ring_head % CONFIG_DIAG_RING_SIZE;
+	/* Instances of the reload's shadow globals are not kept */
+	r->inst = ppi && ppi->glbs == diag_ppg ?
+		ppi - diag_ppg->pp_instances : -1;
+	r->th = th;
+	r->level = level;
+	r->has_t = 0;
+	return r;
+}
+
+/* If t is not NULL, the last conversion of fmt is the "%s" for it */
+static int diag_put(struct pp_instance *ppi, int th, int level,
+		    const struct pp_time *t, const char *fmt, va_list args)
+{
+	struct diag_rec *r;
+	const char *f, *s;
+	int n = 0, len, type, used = 0, slen;
+
+	r = diag_new(ppi, th, level);
+	if (!r)
+		return 1;
+
+	for (f = fmt; (f = strchr(f, '%')); f += len + 1) {
+		len = diag_conv(f + 1, &type);
+		if (len < 0 || len >= RING_SPEC - 1 ||
+		    (type != DARG_NONE && n == RING_ARGS)) {
+			/* Print it now, after what is pending */
+			unix_diag_drain(ring_head - ring_tail);
+			return 0;
+		}
+		if (t && type == DARG_STR && !diag_has_conv(f + len + 1))
+			type = DARG_TIME;
+		switch (type) {
+		case DARG_NONE: continue;
+		case DARG_TIME:
+			r->t = *t;
+			r->has_t = 1;
+			break;
+		case DARG_INT: r->a[n].i = va_arg(args, int); break;
+		case DARG_LONG: r->a[n].l = va_arg(args, long); break;
+		case DARG_LLONG: r->a[n].ll = va_arg(args, long long); break;
+		case DARG_PTR: r->a[n].p = va_arg(args, void *); break;
+		case DARG_DBL: r->a[n].d = va_arg(args, double); break;
+		case DARG_STR:
+			s = va_arg(args, const char *);
+			if (!s)
+				s = "(null)";
+			/* Truncate if there's no room left */
+			slen = strnlen(s, RING_STR - 1 - used);
+			memcpy(r->str + used, s, slen);
+			r->str[used + slen] = '\0';
+			r->a[n].s = used;
+			used += slen + (used + slen < RING_STR - 1);
+			break;
+		}
+		n++;
+	}
+	r->type = DREC_MSG;
+	r->fmt = fmt;
+	clock_gettime(CLOCK_REALTIME, &r->ts);
+	ring_head++;
+	return 1;
+}
+
+int pp_diag_ring_put(struct pp_instance *ppi, int th, int level,
+		     const char *fmt, va_list args)
+{
+	return diag_put(ppi, th, level, NULL, fmt, args);
+}
+
+int pp_diag_ring_time(struct pp_instance *ppi, int th, int level,
+		      const struct pp_time *t, const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = diag_put(ppi, th, level, t, fmt, args);
+	va_end(args);
+	return ret;
+}
+
+static int diag_put_frame(struct pp_instance *ppi, int type, char *prefix,
+			  void *buf, int len, const struct pp_time *t,
+			  int vlan)
+{
+	struct diag_rec *r;
+
+	if (len < 0 || len > RING_FRAME) {
+		unix_diag_drain(ring_head - ring_tail);
+		return 0;
+	}
+	r = diag_new(ppi, pp_dt_frames, 2);
+	if (!r)
+		return 1;
+	r->type = type;
+	r->fmt = prefix;
+	r->len = len;
+	r->vlan = vlan;
+	memcpy(r->data, buf, len);
+	if (t) {
+		r->t = *t;
+		r->has_t = 1;
+	}
+	ring_head++;
+	return 1;
+}
+
+int unix_diag_1588pkt(struct pp_instance *ppi, char *prefix, void *buf,
+		      int len, const struct pp_time *t, int vlan)
+{
+	return diag_put_frame(ppi, DREC_1588PKT, prefix, buf, len, t, vlan);
+}
+
+int unix_diag_payloadpkt(struct pp_instance *ppi, char *prefix, void *buf,
+			 int len, const struct pp_time *t)
+{
+	return diag_put_frame(ppi, DREC_PAYLOADPKT, prefix, buf, len, t, -1);
+}
+
+void unix_diag_drain(int max)
+{
+	for (; max && ring_tail != ring_head; max--, ring_tail++)
+		diag_print(ring + ring_tail % CONFIG_DIAG_RING_SIZE);
+	if (ring_lost && ring_tail == ring_head) {
+		printf("diag: %u messages lost, ring full\n", ring_lost);
+		ring_lost = 0;
+	}
+	fflush(stdout);
+}
+
+static void unix_diag_exit(void)
+{
+	unix_diag_drain(-1);
+}
+
+void unix_diag_init(struct pp_globals *ppg)
+{
+	diag_ppg = ppg;
+	/* Output happens in bursts: buffer it, unix_diag_drain flushes */
+	setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+	atexit(unix_diag_exit);
+}
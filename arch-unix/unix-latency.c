@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Latency tracing for arch-unix (see <ppsi/latency.h>). Checkpoints use
+ * CLOCK_REALTIME, the clock used by software rx/tx timestamps. Stamps
+ * taken by other network operations (e.g. from a PHC, with TIME=) are
+ * in another timebase, so their frames are not measured.
+ */
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+#include "ppsi-unix.h"
+
+/* Print a summary every that many frames of a given type */
+#define LAT_DIAG_PERIOD 1024
+
+struct pp_lat_inst *pp_lat_data;
+
+const char * const pp_lat_stage_name[PP_LAT_NSTAGES] = {
+	[PP_LAT_RECV] = "recv",
+	[PP_LAT_PREFILTER] = "prefilter",
+	[PP_LAT_HANDLER] = "handler",
+	[PP_LAT_SERVO] = "servo",
+	[PP_LAT_DONE] = "done",
+	[PP_LAT_TX] = "tx",
+};
+
+int64_t pp_lat_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Only unix_net_ops stamps frames in software, with CLOCK_REALTIME. All
+ * ports use the operations selected by TIME= (ppi->n_ops may be those
+ * of the trace recorder, wrapping them), so the Makefile tells us.
+ */
+#ifndef LAT_SW_STAMPS
+#define LAT_SW_STAMPS 0
+#endif
+
+/* Stamps are TAI, while CLOCK_REALTIME is UTC */
+static int64_t lat_stamp_ns(struct pp_instance *ppi, struct pp_time *t)
+{
+	return (t->secs - DSPRO(ppi)->currentUtcOffset) * 1000000000LL
+		+ (t->scaled_nsecs >> 16);
+}
+
+uint32_t pp_lat_percentile(struct pp_lat_hist *h, int permille)
+{
+	uint64_t target = ((uint64_t)h->n * permille + 999) / 1000;
+	uint32_t cumul = 0;
+	int i;
+
+	for (i = 0; i < PP_LAT_NBUCKETS; i++) {
+		cumul += h->count[i];
+		if (cumul >= target && cumul)
+			return pp_lat_bucket_top(i);
+	}
+	return h->max;
+}
+
+void pp_lat_rx_begin(struct pp_instance *ppi, int msgtype)
+{
+	struct pp_lat_inst *l = pp_lat_get(ppi);
+
+	if (!LAT_SW_STAMPS || is_incorrect(&ppi->last_rcv_time) ||
+	    msgtype >= __PP_NR_MESSAGES_TYPES)
+		return;
+	l->msgtype = msgtype;
+	l->rx_ns = lat_stamp_ns(ppi, &ppi->last_rcv_time);
+	pp_lat_mark(ppi, PP_LAT_RECV);
+}
+
+void pp_lat_rx_end(struct pp_instance *ppi)
+{
+	struct pp_lat_inst *l = pp_lat_get(ppi);
+	struct pp_lat_hist *h;
+
+	if (!l->rx_ns)
+		return;
+	pp_lat_mark(ppi, PP_LAT_DONE);
+	l->rx_ns = 0;
+
+	h = &l->h[l->msgtype][PP_LAT_DONE];
+	if (h->n % LAT_DIAG_PERIOD == 0)
+		pp_diag(ppi, frames, 2, "latency %s: recv p50 %u p99 %u, "
+			"done p50 %u p99 %u max %u ns\n",
+			pp_msgtype_name[l->msgtype],
+			pp_lat_percentile(h - PP_LAT_DONE + PP_LAT_RECV, 500),
+			pp_lat_percentile(h - PP_LAT_DONE + PP_LAT_RECV, 990),
+			pp_lat_percentile(h, 500), pp_lat_percentile(h, 990),
+			h->max);
+}
+
+void pp_lat_tx_end(struct pp_instance *ppi, int msgtype)
+{
+	struct pp_lat_inst *l = pp_lat_get(ppi);
+	struct pp_lat_hist *h = &l->h[msgtype][PP_LAT_TX];
+
+	if (!l->tx_ns || !LAT_SW_STAMPS ||
+	    is_incorrect(&ppi->last_snt_time))
+		return;
+	pp_lat_add(h, lat_stamp_ns(ppi, &ppi->last_snt_time) - l->tx_ns);
+	l->tx_ns = 0;
+
+	if (h->n % LAT_DIAG_PERIOD == 0)
+		pp_diag(ppi, frames, 2, "latency %s: tx p50 %u p99 %u "
+			"max %u ns\n", pp_msgtype_name[msgtype],
+			pp_lat_percentile(h, 500), pp_lat_percentile(h, 990),
+			h->max);
+}
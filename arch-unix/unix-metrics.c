@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Metrics for arch-unix: storage for the hooks in <ppsi/metrics.h>, and
+ * a UNIX-domain stream socket, served by the main loop. Each client that
+ * connects receives the current values in Prometheus text format, and
+ * the connection is closed. E.g.: "socat - UNIX-CONNECT:<path>"
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <ppsi/ppsi.h>
+#include "ppsi-unix.h"
+
+struct pp_metrics *pp_metrics;
+
+char unix_metrics_socket[UNIX_PATH_LEN] = CONFIG_METRICS_SOCKET;
+
+const char * const pp_drop_reason_name[PP_DROP_COUNT] = {
+	[PP_DROP_NONE] = "none",
+	[PP_DROP_RECV] = "recv",
+	[PP_DROP_MALFORMED] = "malformed",
+	[PP_DROP_DOMAIN] = "domain",
+	[PP_DROP_ALT_MASTER] = "alternate_master",
+	[PP_DROP_LOOP] = "looping",
+	[PP_DROP_OWN_CLOCK] = "own_clock",
+	[PP_DROP_STATE] = "port_state",
+};
+
+const int64_t pp_hist_bounds_ns[PP_HIST_NBOUNDS] = {
+	10, 20, 50,
+	100, 200, 500,
+	1000, 2000, 5000,
+	10000, 20000, 50000,
+	100000, 200000, 500000,
+	1000000, 2000000, 5000000,
+	10000000, 20000000, 50000000,
+	100000000, 200000000, 500000000,
+	1000000000,
+};
+
+void pp_metrics_servo(struct pp_instance *ppi)
+{
+	struct pp_metrics *m = pp_metrics_get(ppi);
+	int64_t ofm = pp_time_to_picos(&SRV(ppi)->offsetFromMaster) / 1000;
+
+	pp_hist_add(&m->ofm, ofm < 0 ? -ofm : ofm);
+	pp_hist_add(&m->mean_delay,
+		    pp_time_to_picos(&SRV(ppi)->meanDelay) / 1000);
+}
+
+/*
+ * Output is built in a fixed buffer, flushed to the client when full.
+ * The client socket is blocking with a send timeout, so a stuck
+ * client only delays the protocol by a bounded time.
+ */
+static struct metrics_out {
+	int fd, len, err;
+	char buf[4096];
+} out;
+
+static void m_flush(void)
+{
+	int i, ret;
+
+	for (i = 0; i < out.len && !out.err; i += ret) {
+		ret = write(out.fd, out.buf + i, out.len - i);
+		if (ret <= 0)
+			out.err = 1;
+	}
+	out.len = 0;
+}
+
+static void __attribute__((format(printf, 1, 2))) m_printf(const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	if (out.len > sizeof(out.buf) - 256)
+		m_flush();
+	va_start(args, fmt);
+	n = vsnprintf(out.buf + out.len, sizeof(out.buf) - out.len, fmt, args);
+	va_end(args);
+	if (n > 0 && n < sizeof(out.buf) - out.len)
+		out.len += n;
+}
+
+static void m_header(const char *name, const char *type, const char *help)
+{
+	m_printf("# HELP ppsi_%s %s\n# TYPE ppsi_%s %s\n",
+		 name, help, name, type);
+}
+
+static void m_hist(struct pp_globals *ppg, const char *name,
+		   const char *help, int offset)
+{
+	int i, j;
+	uint32_t cumul;
+
+	m_header(name, "histogram", help);
+	for (i = 0; i < ppg->nlinks; i++) {
+		struct pp_histogram *h = (void *)(pp_metrics + i) + offset;
+		const char *port = INST(ppg, i)->port_name;
+
+		for (j = 0, cumul = 0; j < PP_HIST_NBOUNDS; j++) {
+			cumul += h->count[j];
+			m_printf("ppsi_%s_bucket{port=\"%s\",le=\"%g\"} %u\n",
+				 name, port, pp_hist_bounds_ns[j] / 1e9, cumul);
+		}
+		m_printf("ppsi_%s_bucket{port=\"%s\",le=\"+Inf\"} %u\n",
+			 name, port, h->n);
+		m_printf("ppsi_%s_sum{port=\"%s\"} %.9f\n",
+			 name, port, h->sum / 1e9);
+		m_printf("ppsi_%s_count{port=\"%s\"} %u\n", name, port, h->n);
+	}
+}
+
+/* Latency histograms are sparse: only non-empty buckets are listed */
+static void m_lat(struct pp_globals *ppg)
+{
+	struct pp_lat_hist *h;
+	int i, type, stage, j;
+	uint32_t cumul;
+
+	m_header("latency_seconds", "histogram",
+		 "Latency from rx stamp to each checkpoint, or to tx stamp");
+	for (i = 0; i < ppg->nlinks; i++)
+	    for (type = 0; type < __PP_NR_MESSAGES_TYPES; type++)
+		for (stage = 0; stage < PP_LAT_NSTAGES; stage++) {
+			h = &pp_lat_data[i].h[type][stage];
+			if (!h->n)
+				continue;
+#define LAT_LABELS "{port=\"%s\",type=\"%s\",stage=\"%s\""
+#define LAT_ARGS INST(ppg, i)->port_name, pp_msgtype_name[type], \
+		pp_lat_stage_name[stage]
+			for (j = 0, cumul = 0; j < PP_LAT_NBUCKETS - 1; j++) {
+				if (!h->count[j])
+					continue;
+				cumul += h->count[j];
+				m_printf("ppsi_latency_seconds_bucket" LAT_LABELS
+					 ",le=\"%g\"} %u\n", LAT_ARGS,
+					 pp_lat_bucket_top(j) / 1e9, cumul);
+			}
+			m_printf("ppsi_latency_seconds_bucket" LAT_LABELS
+				 ",le=\"+Inf\"} %u\n", LAT_ARGS, h->n);
+			m_printf("ppsi_latency_seconds_sum" LAT_LABELS "} %.9f\n",
+				 LAT_ARGS, h->sum / 1e9);
+			m_printf("ppsi_latency_seconds_count" LAT_LABELS "} %u\n",
+				 LAT_ARGS, h->n);
+#undef LAT_LABELS
+#undef LAT_ARGS
+		}
+}
+
+#if CONFIG_HAS_STABILITY
+/* Stability of offsetFromMaster: only estimates with data are listed */
+static void m_stab(struct pp_globals *ppg)
+{
+	struct pp_stability *s;
+	const char *port;
+	int64_t v;
+	double tau;
+	int i, j;
+
+	m_header("mtie_seconds", "gauge",
+		 "MTIE of offsetFromMaster, by observation window (s)");
+	for (i = 0; i < ppg->nlinks; i++) {
+		s = &SRV(INST(ppg, i))->stab;
+		port = INST(ppg, i)->port_name;
+		for (j = 0; j < PP_STAB_NWIN; j++)
+			if ((v = pp_stab_mtie_ps(s, j)) >= 0)
+				m_printf("ppsi_mtie_seconds{port=\"%s\","
+					 "window=\"%lli\"} %.12f\n", port,
+					 s->mtie[j].win_ns / 1000000000LL,
+					 v / 1e12);
+	}
+	m_header("tdev_seconds", "gauge",
+		 "TDEV of offsetFromMaster, by tau (s)");
+	for (i = 0; i < ppg->nlinks; i++) {
+		s = &SRV(INST(ppg, i))->stab;
+		port = INST(ppg, i)->port_name;
+		for (j = 0; j < PP_STAB_NTAU; j++) {
+			tau = pp_stab_tau0_ns(s) / 1e9 * (1 << j);
+			if ((v = pp_stab_tdev_ps(s, j)) >= 0)
+				m_printf("ppsi_tdev_seconds{port=\"%s\","
+					 "tau=\"%g\"} %.12f\n", port, tau,
+					 v / 1e12);
+		}
+	}
+	m_header("adev", "gauge", "ADEV of offsetFromMaster, by tau (s)");
+	for (i = 0; i < ppg->nlinks; i++) {
+		s = &SRV(INST(ppg, i))->stab;
+		port = INST(ppg, i)->port_name;
+		for (j = 0; j < PP_STAB_NTAU; j++) {
+			tau = pp_stab_tau0_ns(s) / 1e9 * (1 << j);
+			if (pp_stab_adev(s, j) >= 0)
+				m_printf("ppsi_adev{port=\"%s\",tau=\"%g\"} "
+					 "%.6e\n", port, tau,
+					 pp_stab_adev(s, j));
+		}
+	}
+}
+#endif
+
+#if CONFIG_HAS_FSM_PROFILE
+/* Time accounting of the state machine: only entries with calls */
+#define PROF_LABELS "{port=\"%s\",kind=\"%s\",name=\"%s\"}"
+
+static void m_prof_one(const char *port, const char *kind, const char *name,
+		       struct pp_prof_stat *s, int what)
+{
+	if (!s->n)
+		return;
+	switch (what) {
+	case 0:
+		m_printf("ppsi_fsm_calls_total" PROF_LABELS " %u\n",
+			 port, kind, name, s->n);
+		break;
+	case 1:
+		m_printf("ppsi_fsm_seconds_total" PROF_LABELS " %.9f\n",
+			 port, kind, name, s->sum / 1e9);
+		break;
+	case 2:
+		m_printf("ppsi_fsm_min_seconds" PROF_LABELS " %.9f\n",
+			 port, kind, name, s->min / 1e9);
+		break;
+	case 3:
+		m_printf("ppsi_fsm_max_seconds" PROF_LABELS " %.9f\n",
+			 port, kind, name, s->max / 1e9);
+		break;
+	}
+}
+
+static void m_prof(struct pp_globals *ppg)
+{
+	static const char * const headers[][3] = {
+		{"fsm_calls_total", "counter", "State machine calls"},
+		{"fsm_seconds_total", "counter", "Time spent in the calls"},
+		{"fsm_min_seconds", "gauge", "Shortest call"},
+		{"fsm_max_seconds", "gauge", "Longest call"},
+	};
+	struct pp_instance *ppi;
+	struct pp_prof *p;
+	int i, j, what;
+
+	for (what = 0; what < ARRAY_SIZE(headers); what++) {
+		m_header(headers[what][0], headers[what][1],
+			 headers[what][2]);
+		for (i = 0; i < ppg->nlinks; i++) {
+			ppi = INST(ppg, i);
+			p = &ppi->prof;
+			for (j = 0; j < PPS_LAST_STATE; j++)
+				m_prof_one(ppi->port_name, "state",
+					   pp_state_table[j].name,
+					   &p->state[j], what);
+			for (j = 0; j < __PP_NR_MESSAGES_TYPES; j++)
+				m_prof_one(ppi->port_name, "msg",
+					   pp_msgtype_name[j], &p->msg[j],
+					   what);
+			m_prof_one(ppi->port_name, "msg", "timer", &p->timer,
+				   what);
+			for (j = 0; j < PP_PROF_NHOOKS; j++)
+				m_prof_one(ppi->port_name, "hook",
+					   pp_prof_hook_name(j), &p->hook[j],
+					   what);
+		}
+	}
+}
+#undef PROF_LABELS
+#endif
+
+#if CONFIG_HAS_LOOP_MONITOR
+/* Main loop: sparse histograms, counters and the last stalls */
+static void m_loop(struct pp_globals *ppg)
+{
+	struct pp_loopmon *m = pp_loopmon;
+	struct pp_loop_stall *st;
+	struct pp_lat_hist *h;
+	const char *port;
+	uint32_t cumul, i;
+	int k, j;
+
+	m_header("loop_seconds", "histogram",
+		 "Lateness of timer wakeups, duration of iterations");
+	for (k = 0; k < PP_LOOP_NKINDS; k++) {
+		h = &m->h[k];
+		for (j = 0, cumul = 0; j < PP_LAT_NBUCKETS - 1; j++) {
+			if (!h->count[j])
+				continue;
+			cumul += h->count[j];
+			m_printf("ppsi_loop_seconds_bucket{kind=\"%s\","
+				 "le=\"%g\"} %u\n", pp_loop_kind_name(k),
+				 pp_lat_bucket_top(j) / 1e9, cumul);
+		}
+		m_printf("ppsi_loop_seconds_bucket{kind=\"%s\",le=\"+Inf\"}"
+			 " %u\n", pp_loop_kind_name(k), h->n);
+		m_printf("ppsi_loop_seconds_sum{kind=\"%s\"} %.9f\n",
+			 pp_loop_kind_name(k), h->sum / 1e9);
+		m_printf("ppsi_loop_seconds_count{kind=\"%s\"} %u\n",
+			 pp_loop_kind_name(k), h->n);
+	}
+	m_header("loop_stalls_total", "counter",
+		 "Wakeups and iterations beyond the stall thresholds");
+	for (k = 0; k < PP_LOOP_NKINDS; k++)
+		m_printf("ppsi_loop_stalls_total{kind=\"%s\"} %u\n",
+			 pp_loop_kind_name(k), m->stalls[k]);
+	m_header("loop_stall_seconds", "gauge",
+		 "Last stalls, by sequence number, with port and state");
+	i = m->nstalls > PP_LOOP_NSTALLS ? m->nstalls - PP_LOOP_NSTALLS : 0;
+	for (; i < m->nstalls; i++) {
+		st = &m->stall[i % PP_LOOP_NSTALLS];
+		port = st->inst >= 0 && st->inst < ppg->nlinks ?
+			INST(ppg, st->inst)->port_name : "";
+		m_printf("ppsi_loop_stall_seconds{seq=\"%u\",kind=\"%s\","
+			 "port=\"%s\",state=\"%s\"} %.9f\n", i,
+			 pp_loop_kind_name(st->kind), port,
+			 st->inst >= 0 ? get_state_as_string(NULL, st->state)
+			 : "", st->ns / 1e9);
+	}
+}
+#endif
+
+static void unix_metrics_dump(struct pp_globals *ppg)
+{
+	struct pp_instance *ppi;
+	struct pp_servo *s;
+	int i, j;
+
+	m_header("ptp_tx_total", "counter", "PTP frames sent");
+	for (i = 0; i < ppg->nlinks; i++)
+		m_printf("ppsi_ptp_tx_total{port=\"%s\"} %lu\n",
+			 INST(ppg, i)->port_name, INST(ppg, i)->ptp_tx_count);
+
+	m_header("ptp_rx_total", "counter", "PTP frames received");
+	for (i = 0; i < ppg->nlinks; i++)
+		m_printf("ppsi_ptp_rx_total{port=\"%s\"} %lu\n",
+			 INST(ppg, i)->port_name, INST(ppg, i)->ptp_rx_count);
+
+	m_header("rx_drop_total", "counter", "Received frames discarded");
+	for (i = 0; i < ppg->nlinks; i++)
+		for (j = 1; j < PP_DROP_COUNT; j++)
+			m_printf("ppsi_rx_drop_total{port=\"%s\",reason=\"%s\"}"
+				 " %u\n", INST(ppg, i)->port_name,
+				 pp_drop_reason_name[j], pp_metrics[i].drops[j]);
+
+	m_header("timeout_total", "counter", "Expired timeouts");
+	for (i = 0; i < ppg->nlinks; i++)
+		for (j = 0; j < PP_TO_COUNT; j++)
+			if (pp_timeout_name(j))
+				m_printf("ppsi_timeout_total{port=\"%s\","
+					 "timer=\"%s\"} %u\n",
+					 INST(ppg, i)->port_name,
+					 pp_timeout_name(j),
+					 pp_metrics[i].timeouts[j]);
+
+	m_header("port_state", "gauge", "Port state (enum pp_std_states)");
+	for (i = 0; i < ppg->nlinks; i++)
+		m_printf("ppsi_port_state{port=\"%s\"} %i\n",
+			 INST(ppg, i)->port_name, INST(ppg, i)->state);
+
+	m_header("servo", "gauge", "Servo values (seconds, or raw)");
+	for (i = 0; i < ppg->nlinks; i++) {
+		ppi = INST(ppg, i);
+		s = SRV(ppi);
+		m_printf("ppsi_servo{port=\"%s\",value=\"offset_from_master\"}"
+			 " %.12f\n", ppi->port_name,
+			 pp_time_to_picos(&s->offsetFromMaster) / 1e12);
+		m_printf("ppsi_servo{port=\"%s\",value=\"mean_delay\"}"
+			 " %.12f\n", ppi->port_name,
+			 pp_time_to_picos(&s->meanDelay) / 1e12);
+		m_printf("ppsi_servo{port=\"%s\",value=\"delay_ms\"}"
+			 " %.12f\n", ppi->port_name,
+			 pp_time_to_picos(&s->delayMS) / 1e12);
+		m_printf("ppsi_servo{port=\"%s\",value=\"obs_drift\"} %lli\n",
+			 ppi->port_name, s->obs_drift);
+		m_printf("ppsi_servo{port=\"%s\",value=\"update_count\"} %u\n",
+			 ppi->port_name, s->update_count);
+		m_printf("ppsi_servo{port=\"%s\",value=\"locked\"} %i\n",
+			 ppi->port_name, s->servo_locked);
+	}
+
+	m_hist(ppg, "offset_from_master_seconds",
+	       "Absolute offsetFromMaster at each servo update",
+	       offsetof(struct pp_metrics, ofm));
+	m_hist(ppg, "mean_delay_seconds", "meanDelay at each servo update",
+	       offsetof(struct pp_metrics, mean_delay));
+	m_hist(ppg, "frame_time_seconds",
+	       "Time to receive and process a frame",
+	       offsetof(struct pp_metrics, frame_time));
+	if (CONFIG_HAS_LATENCY_TRACE)
+		m_lat(ppg);
+#if CONFIG_HAS_STABILITY
+	m_stab(ppg);
+#endif
+#if CONFIG_HAS_FSM_PROFILE
+	m_prof(ppg);
+#endif
+#if CONFIG_HAS_LOOP_MONITOR
+	m_loop(ppg);
+#endif
+}
+
+static void unix_metrics_accept(struct pp_globals *ppg, int fd)
+{
+	struct timeval tv = {0, 100 * 1000};
+
+	out.fd = accept(fd, NULL, NULL);
+	if (out.fd < 0)
+		return;
+	setsockopt(out.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	out.len = out.err = 0;
+	unix_metrics_dump(ppg);
+	m_flush();
+	close(out.fd);
+}
+
+void unix_metrics_init(struct pp_globals *ppg)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (!unix_metrics_socket[0])
+		return; /* disabled by configuration */
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, unix_metrics_socket, sizeof(addr.sun_path) - 1);
+	unlink(addr.sun_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+	    || listen(fd, 4) < 0 || unix_add_aux_fd(ppg, fd,
+						     unix_metrics_accept) < 0) {
+		pp_error("%s: %s: %s\n", __func__, unix_metrics_socket,
+			 strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	pp_printf("Metrics available on %s\n", unix_metrics_socket);
+}
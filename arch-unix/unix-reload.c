@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Configuration reload for arch-unix. On SIGHUP the command line is
+ * parsed again (so configuration files are read again) into a shadow
+ * pp_globals. The result is compared with the running configuration
+ * and only the differences are applied: ports are matched by name, and
+ * ports that did not change are not touched at all.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include <ppsi/ppsi.h>
+#include "ppsi-unix.h"
+
+static int reload_argc;
+static char **reload_argv;
+static struct pp_runtime_opts reload_rt_opts; /* defaults, before parsing */
+static int reload_pipe[2];
+
+/* Copy a field if it differs, and tell whether it did */
+#define RELOAD_FIELD(name, dst, src, f)					\
+	({								\
+		int __changed = (dst)->f != (src)->f;			\
+									\
+		if (__changed) {					\
+			pp_diag(NULL, config, 1, "%s: %s changed\n",	\
+				name, #f);				\
+			(dst)->f = (src)->f;				\
+		}							\
+		__changed;						\
+	})
+
+/*
+ * Some options are stored by the parser in plain globals, not in the
+ * shadow pp_globals. They are saved before parsing and put back at once,
+ * so a rejected configuration changes nothing; the new values are staged
+ * and applied with the rest.
+ */
+struct reload_staged {
+	unsigned long d_flags;
+#if CONFIG_HAS_STABILITY
+	int stab_windows_s[PP_STAB_NWIN];
+#endif
+#if CONFIG_HAS_LOOP_MONITOR
+	int loop_stall_us[PP_LOOP_NKINDS];
+#endif
+#if CONFIG_HAS_METRICS
+	char metrics_socket[UNIX_PATH_LEN];
+#endif
+#if CONFIG_HAS_TRACE
+	char trace_file[PP_TRACE_PATH_LEN];
+#endif
+#if CONFIG_HAS_FLIGHT_RECORDER
+	char frec_file[PP_FREC_PATH_LEN];
+#endif
+};
+
+static void reload_stage_get(struct reload_staged *s)
+{
+	s->d_flags = pp_global_d_flags;
+#if CONFIG_HAS_STABILITY
+	memcpy(s->stab_windows_s, pp_stab_windows_s, sizeof(pp_stab_windows_s));
+#endif
+#if CONFIG_HAS_LOOP_MONITOR
+	memcpy(s->loop_stall_us, pp_loop_stall_us, sizeof(pp_loop_stall_us));
+#endif
+#if CONFIG_HAS_METRICS
+	memcpy(s->metrics_socket, unix_metrics_socket, UNIX_PATH_LEN);
+#endif
+#if CONFIG_HAS_TRACE
+	memcpy(s->trace_file, pp_trace_file, PP_TRACE_PATH_LEN);
+#endif
+#if CONFIG_HAS_FLIGHT_RECORDER
+	memcpy(s->frec_file, pp_frec_file, PP_FREC_PATH_LEN);
+#endif
+}
+
+static void reload_stage_set(struct reload_staged *s)
+{
+	pp_global_d_flags = s->d_flags;
+#if CONFIG_HAS_STABILITY
+	memcpy(pp_stab_windows_s, s->stab_windows_s, sizeof(pp_stab_windows_s));
+#endif
+#if CONFIG_HAS_LOOP_MONITOR
+	memcpy(pp_loop_stall_us, s->loop_stall_us, sizeof(pp_loop_stall_us));
+#endif
+#if CONFIG_HAS_METRICS
+	memcpy(unix_metrics_socket, s->metrics_socket, UNIX_PATH_LEN);
+#endif
+#if CONFIG_HAS_TRACE
+	memcpy(pp_trace_file, s->trace_file, PP_TRACE_PATH_LEN);
+#endif
+#if CONFIG_HAS_FLIGHT_RECORDER
+	memcpy(pp_frec_file, s->frec_file, PP_FREC_PATH_LEN);
+#endif
+}
+
+/* Apply the staged values; the files opened at startup stay as they are */
+static void reload_stage_apply(struct reload_staged *new)
+{
+	struct reload_staged cur;
+
+	reload_stage_get(&cur);
+#if CONFIG_HAS_METRICS
+	if (strcmp(cur.metrics_socket, new->metrics_socket))
+		pp_printf("Warning: reload: metrics-socket needs a restart\n");
+	memcpy(new->metrics_socket, cur.metrics_socket, UNIX_PATH_LEN);
+#endif
+#if CONFIG_HAS_TRACE
+	if (strcmp(cur.trace_file, new->trace_file))
+		pp_printf("Warning: reload: trace-file needs a restart\n");
+	memcpy(new->trace_file, cur.trace_file, PP_TRACE_PATH_LEN);
+#endif
+	reload_stage_set(new);
+}
+
+/* Global options: clock attributes and priorities go through the BMC */
+static int reload_globals(struct pp_globals *ppg, struct pp_runtime_opts *new)
+{
+	struct pp_runtime_opts *cur = GOPTS(ppg);
+	int bmc = 0;
+
+	/* For slave-only clocks, pp_init_globals forced the class */
+	if (is_slaveOnly(GDSDEF(ppg)))
+		new->clock_quality_clockClass = cur->clock_quality_clockClass;
+
+	bmc |= RELOAD_FIELD("global", cur, new, clock_quality_clockClass);
+	bmc |= RELOAD_FIELD("global", cur, new, clock_quality_clockAccuracy);
+	bmc |= RELOAD_FIELD("global", cur, new,
+			    clock_quality_offsetScaledLogVariance);
+	bmc |= RELOAD_FIELD("global", cur, new, timeSource);
+	bmc |= RELOAD_FIELD("global", cur, new, ptpTimeScale);
+	bmc |= RELOAD_FIELD("global", cur, new, frequencyTraceable);
+	bmc |= RELOAD_FIELD("global", cur, new, timeTraceable);
+	bmc |= RELOAD_FIELD("global", cur, new, priority1);
+	bmc |= RELOAD_FIELD("global", cur, new, priority2);
+	bmc |= RELOAD_FIELD("global", cur, new, domainNumber);
+	if (bmc)
+		bmc_apply_configured_device_attributes(ppg);
+
+	/* These are used as they are, every time */
+	RELOAD_FIELD("global", cur, new, flags);
+	RELOAD_FIELD("global", cur, new, ap);
+	RELOAD_FIELD("global", cur, new, ai);
+	RELOAD_FIELD("global", cur, new, s);
+	RELOAD_FIELD("global", cur, new, ptpPpsThresholdMs);
+	RELOAD_FIELD("global", cur, new, gmDelayToGenPpsSec);
+	RELOAD_FIELD("global", cur, new, forcePpsGen);
+	RELOAD_FIELD("global", cur, new, ptpFallbackPpsGen);
+
+	if (cur->slaveOnly != new->slaveOnly ||
+	    cur->externalPortConfigurationEnabled !=
+	    new->externalPortConfigurationEnabled || cur->ttl != new->ttl)
+		pp_printf("Warning: reload: some global changes need a restart\n");
+	return bmc;
+}
+
+/* Intervals: update the port data set and re-arm the periodic timers */
+static void reload_intervals(struct pp_instance *ppi)
+{
+	static const int periodic[] = {
+		PP_TO_SYNC_SEND, PP_TO_ANN_SEND, PP_TO_REQUEST,
+	};
+	portDS_t *port = DSPOR(ppi);
+	int disabled[PP_TO_COUNT];
+	int i;
+
+	/* Not running yet: pp_initializing will take the new values */
+	if (ppi->state == PPS_INITIALIZING || ppi->state == PPS_DISABLED)
+		return;
+
+	port->logAnnounceInterval = (Integer8)ppi->cfg.announce_interval;
+	port->announceReceiptTimeout =
+		(UInteger8)ppi->cfg.announce_receipt_timeout;
+	port->logSyncInterval = (Integer8)ppi->cfg.sync_interval;
+	port->logMinDelayReqInterval = (Integer8)ppi->cfg.min_delay_req_interval;
+	port->logMinPdelayReqInterval =
+		(Integer8)ppi->cfg.min_pdelay_req_interval;
+	ppi->frgn_master_time_window_ms =
+		pp_timeout_log_to_ms(port->logAnnounceInterval)
+		* PP_FOREIGN_MASTER_TIME_WINDOW;
+
+	for (i = 0; i < PP_TO_COUNT; i++)
+		disabled[i] = pp_timeout_is_disabled(ppi, i);
+	pp_timeout_init(ppi);
+	for (i = 0; i < PP_TO_COUNT; i++)
+		if (disabled[i] && i != PP_TO_BMC)
+			pp_timeout_disable(ppi, i);
+	for (i = 0; i < ARRAY_SIZE(periodic); i++)
+		if (!disabled[periodic[i]])
+			pp_timeout_reset(ppi, periodic[i]);
+}
+
+/* Apply the changes of one port; return 1 if the BMC should run */
+static int reload_port(struct pp_globals *ppg, struct pp_instance *ppi,
+		       struct pp_instance *new)
+{
+	struct pp_instance_cfg *cur = &ppi->cfg, tmp;
+	const char *name = ppi->port_name;
+	int restart = 0, bmc = 0, intervals = 0, asym = 0;
+
+	/* Also un-remove it, if it was removed by a previous reload */
+	if (ppi->removed) {
+		pp_printf("reload: port %s added back\n", name);
+		ppi->removed = FALSE;
+	}
+	ppi->d_flags = new->d_flags;
+
+	/* Changes in the communication path restart the port */
+	restart = strcmp(cur->iface_name, new->cfg.iface_name) ||
+		ppi->proto != new->proto || ppi->nvlans != new->nvlans ||
+		memcmp(ppi->vlans, new->vlans, sizeof(ppi->vlans)) ||
+		cur->delayMechanism != new->cfg.delayMechanism;
+	if (restart) {
+		pp_printf("reload: port %s restarted\n", name);
+		if (ppi->link_up)
+			unix_port_down(ppg, ppi); /* with the old proto */
+		strcpy(cur->iface_name, new->cfg.iface_name);
+		ppi->proto = new->proto;
+		ppi->nvlans = new->nvlans;
+		memcpy(ppi->vlans, new->vlans, sizeof(ppi->vlans));
+		cur->delayMechanism = new->cfg.delayMechanism;
+		ppi->delayMechanism = cur->delayMechanism;
+		ppi->state = PPS_INITIALIZING;
+		bmc = 1;
+	}
+
+	intervals |= RELOAD_FIELD(name, cur, &new->cfg, announce_interval);
+	intervals |= RELOAD_FIELD(name, cur, &new->cfg,
+				  announce_receipt_timeout);
+	intervals |= RELOAD_FIELD(name, cur, &new->cfg, sync_interval);
+	intervals |= RELOAD_FIELD(name, cur, &new->cfg, min_delay_req_interval);
+	intervals |= RELOAD_FIELD(name, cur, &new->cfg,
+				  min_pdelay_req_interval);
+	if (intervals && !restart)
+		reload_intervals(ppi);
+
+	if (RELOAD_FIELD(name, cur, &new->cfg, egressLatency_ps))
+		ppi->timestampCorrectionPortDS.egressLatency =
+			picos_to_interval(cur->egressLatency_ps);
+	if (RELOAD_FIELD(name, cur, &new->cfg, ingressLatency_ps))
+		ppi->timestampCorrectionPortDS.ingressLatency =
+			picos_to_interval(cur->ingressLatency_ps);
+
+	asym |= RELOAD_FIELD(name, cur, &new->cfg, asymmetryCorrectionEnable);
+	asym |= RELOAD_FIELD(name, cur, &new->cfg, constantAsymmetry_ps);
+	asym |= RELOAD_FIELD(name, cur, &new->cfg, delayCoefficient);
+	asym |= RELOAD_FIELD(name, cur, &new->cfg, scaledDelayCoefficient);
+	if (asym)
+		enable_asymmetryCorrection(ppi,
+			cur->profile == PPSI_PROFILE_WR ||
+			cur->profile == PPSI_PROFILE_HA ?
+			TRUE : cur->asymmetryCorrectionEnable);
+
+	if (RELOAD_FIELD(name, cur, &new->cfg, masterOnly)) {
+		if (!is_externalPortConfigurationEnabled(GDSDEF(ppg)))
+			DSPOR(ppi)->masterOnly = cur->masterOnly;
+		bmc = 1;
+	}
+	if (RELOAD_FIELD(name, cur, &new->cfg, desiredState)) {
+		if (is_externalPortConfigurationEnabled(GDSDEF(ppg)))
+			ppi->externalPortConfigurationPortDS.desiredState =
+				cur->desiredState;
+		bmc = 1;
+	}
+
+	/* Whatever else is different (profile, l1sync) needs a restart */
+	tmp = new->cfg;
+	strcpy(tmp.port_name, cur->port_name);
+	if (memcmp(&tmp, cur, sizeof(tmp)))
+		pp_printf("Warning: reload: port %s: some changes need "
+			  "a restart\n", name);
+	return bmc;
+}
+
+/* The slot of a port removed by a previous reload, once it is down */
+static struct pp_instance *reload_free_slot(struct pp_globals *ppg)
+{
+	struct pp_instance *ppi;
+	int i;
+
+	for (i = 0; i < ppg->nlinks; i++) {
+		ppi = INST(ppg, i);
+		if (ppi->removed && !ppi->link_up)
+			return ppi;
+	}
+	return NULL;
+}
+
+static int reload_add_port(struct pp_globals *ppg, struct pp_instance *new)
+{
+	struct pp_instance *ppi = reload_free_slot(ppg);
+	int reused = ppi != NULL;
+
+	if (reused) {
+		pp_printf("reload: port %s takes the slot of %s\n",
+			  new->cfg.port_name, ppi->port_name);
+		/* Pending messages of the old port, while it has a name */
+		if (CONFIG_HAS_DIAG_RING)
+			unix_diag_drain(-1);
+		unix_clear_instance(ppg, ppi);
+	} else {
+		if (ppg->nlinks >= ppg->max_links &&
+		    pp_grow_instances(ppg) < 0) {
+			pp_error("reload: port %s: out of memory\n",
+				 new->cfg.port_name);
+			return 0;
+		}
+		ppi = INST(ppg, ppg->nlinks);
+	}
+	ppi->cfg = new->cfg;
+	ppi->proto = new->proto;
+	ppi->nvlans = new->nvlans;
+	memcpy(ppi->vlans, new->vlans, sizeof(ppi->vlans));
+	ppi->d_flags = new->d_flags;
+	if (unix_init_instance(ppg, ppi) < 0) {
+		pp_error("reload: port %s: out of memory\n", ppi->cfg.port_name);
+		if (reused)
+			ppi->removed = TRUE; /* keep it down */
+		return 0;
+	}
+	if (!reused)
+		ppg->nlinks++;
+	if (pp_open_instance(ppg, ppi) < 0)
+		pp_error("reload: port %s: can't open extension\n",
+			 ppi->cfg.port_name);
+	/* link_up is 0: the main loop will bring it up */
+	pp_printf("reload: port %s added\n", ppi->port_name);
+	return 1;
+}
+
+static void unix_reload(struct pp_globals *ppg)
+{
+	struct pp_globals shadow;
+	struct pp_runtime_opts rt_opts = reload_rt_opts;
+	struct reload_staged running, staged;
+	struct pp_instance *ppi, *new;
+	char **argv;
+	int i, j, ret, bmc = 0;
+
+	pp_printf("Reloading configuration\n");
+
+	/* Parse into a shadow copy, using the same defaults as at startup */
+	memset(&shadow, 0, sizeof(shadow));
+	shadow.rt_opts = &rt_opts;
+	argv = calloc(reload_argc + 1, sizeof(*argv));
+	if (!argv) {
+		pp_error("reload: out of memory\n");
+		goto out;
+	}
+	/* parsing modifies the strings */
+	for (i = 0; i < reload_argc; i++)
+		argv[i] = strdup(reload_argv[i]);
+	reload_stage_get(&running);
+	ret = unix_parse_config(&shadow, reload_argc, argv);
+	reload_stage_get(&staged);
+	reload_stage_set(&running);
+	if (ret != 0) {
+		pp_error("reload: configuration error, nothing changed\n");
+		goto out;
+	}
+	bmc_set_default_device_attributes(&shadow);
+
+	/* Ports that are there already, or are new */
+	for (j = 0; j < shadow.nlinks; j++) {
+		new = INST(&shadow, j);
+		for (i = 0; i < ppg->nlinks; i++)
+			if (!strcmp(INST(ppg, i)->cfg.port_name,
+				    new->cfg.port_name))
+				break;
+		if (i < ppg->nlinks)
+			bmc |= reload_port(ppg, INST(ppg, i), new);
+		else
+			bmc |= reload_add_port(ppg, new);
+	}
+
+	/* Ports that are gone: the main loop brings them down */
+	for (i = 0; i < ppg->nlinks; i++) {
+		ppi = INST(ppg, i);
+		for (j = 0; j < shadow.nlinks; j++)
+			if (!strcmp(ppi->cfg.port_name,
+				    INST(&shadow, j)->cfg.port_name))
+				break;
+		if (j == shadow.nlinks && !ppi->removed) {
+			pp_printf("reload: port %s removed\n", ppi->port_name);
+			ppi->removed = TRUE;
+			bmc = 1;
+		}
+	}
+
+	bmc |= reload_globals(ppg, &rt_opts);
+	reload_stage_apply(&staged);
+
+	/* Run the BMC now, with the new priorities and ports */
+	if (bmc)
+		pp_timeout_reset_N(INST(ppg, 0), PP_TO_BMC, 0);
+	POSIX_ARCH(ppg)->run_now = 1;
+
+out:
+	if (argv)
+		for (i = 0; i < reload_argc; i++)
+			free(argv[i]);
+	free(argv);
+	free(shadow.pp_instances);
+}
+
+static void reload_action(struct pp_globals *ppg, int fd)
+{
+	char buf[16];
+
+	/* Several signals may have arrived: reload once */
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	unix_reload(ppg);
+}
+
+static void reload_sighup(int sig)
+{
+	int e = errno;
+
+	if (write(reload_pipe[1], "", 1) < 0)
+		; /* already full: a reload is pending anyways */
+	errno = e;
+}
+
+void unix_reload_init(struct pp_globals *ppg, int argc, char **argv)
+{
+	struct sigaction sa;
+	int i;
+
+	/* Save what is needed to parse again: arguments and defaults */
+	reload_rt_opts = *GOPTS(ppg);
+	reload_argc = argc;
+	reload_argv = calloc(argc + 1, sizeof(*argv));
+	if (!reload_argv)
+		return;
+	for (i = 0; i < argc; i++)
+		reload_argv[i] = strdup(argv[i]);
+
+	if (pipe(reload_pipe) < 0) {
+		pp_error("%s: pipe: %s\n", __func__, strerror(errno));
+		return;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(reload_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(reload_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	if (unix_add_aux_fd(ppg, reload_pipe[0], reload_action) < 0) {
+		pp_error("%s: no room for the descriptor\n", __func__);
+		return;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = reload_sighup;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGHUP, &sa, NULL);
+}
@@ -99,6 +99,39 @@ const struct wrh_operations wrh_oper = {
 };
 #endif
 
+/*
+ * Extension objects have the size of the largest extension built in, so
+ * a reused slot (see unix_clear_instance) can change its profile
+ */
+union unix_ext_dsport {
+#if CONFIG_HAS_PROFILE_WR
+	struct wr_dsport wr;
+#endif
+#if CONFIG_HAS_EXT_L1SYNC
+	l1e_ext_portDS_t l1e;
+#endif
+	char none;
+};
+
+union unix_ext_data {
+#if CONFIG_HAS_PROFILE_WR
+	struct wr_data wr;
+#endif
+#if CONFIG_HAS_EXT_L1SYNC
+	struct l1e_data l1e;
+#endif
+	char none;
+};
+
+/* Objects of a cleared instance (see unix_clear_instance) are reused */
+static void *unix_reuse_zalloc(void *p, size_t size)
+{
+	if (!p)
+		return unix_zalloc(size);
+	memset(p, 0, size);
+	return p;
+}
+
 #if CONFIG_HAS_EXT_L1SYNC
 /**
  * Enable the l1sync extension for a given ppsi instance
@@ -109,12 +142,14 @@ static int enable_l1Sync(struct pp_instance *ppi, Boolean enable) {
 
 	ppi->protocol_extension = PPSI_EXT_L1S;
 	/* Add L1SYNC extension portDS */
-	if (!(ppi->portDS->ext_dsport = calloc(1, sizeof(l1e_ext_portDS_t)))) {
+	if (!(ppi->portDS->ext_dsport = unix_reuse_zalloc(
+		      ppi->portDS->ext_dsport, sizeof(union unix_ext_dsport)))) {
 		return 0;
 	}
 
 	/* Allocate L1SYNC data extension */
-	if (!(ppi->ext_data = calloc(1, sizeof(struct l1e_data)))) {
+	if (!(ppi->ext_data = unix_reuse_zalloc(ppi->ext_data,
+					       sizeof(union unix_ext_data)))) {
 		return 0;
 	}
 	/* Set L1SYNC state. Must be done here because the init hook is called only in the initializing state. If
@@ -133,7 +168,7 @@ static int enable_l1Sync(struct pp_instance *ppi, Boolean enable) {
 /**
  * Enable/disable asymmetry correction
  */
-static void enable_asymmetryCorrection(struct pp_instance *ppi, Boolean enable ) {
+void enable_asymmetryCorrection(struct pp_instance *ppi, Boolean enable ) {
 	if ((ppi->asymmetryCorrectionPortDS.enable = enable) == TRUE ) {
 		/* Enabled: The delay asymmetry will be calculated */
 
@@ -148,15 +183,253 @@ static void enable_asymmetryCorrection(struct pp_instance *ppi, Boolean enable )
 		picos_to_interval(ppi->cfg.constantAsymmetry_ps);
 }
 
+/* Set up one instance, after its configuration has been parsed */
+int unix_init_instance(struct pp_globals *ppg, struct pp_instance *ppi)
+{
+	size_t arena0 = unix_arena_used();
+	void *ext_dsport = ppi->portDS ? ppi->portDS->ext_dsport : NULL;
+
+	ppi->ch[PP_NP_EVT].fd = -1;
+	ppi->ch[PP_NP_GEN].fd = -1;
+	ppi->glbs = ppg;
+	ppi->vlans_array_len = CONFIG_VLAN_ARRAY_SIZE,
+	ppi->iface_name = ppi->cfg.iface_name;
+	ppi->port_name = ppi->cfg.port_name;
+	ppi->delayMechanism = ppi->cfg.delayMechanism;
+	ppi->servo = unix_reuse_zalloc(ppi->servo, sizeof(*ppi->servo));
+	ppi->portDS = unix_reuse_zalloc(ppi->portDS, sizeof(*ppi->portDS));
+	if (ppi->portDS)
+		ppi->portDS->ext_dsport = ext_dsport; /* of a reused slot */
+	ppi->ext_hooks = &pp_hooks;
+	ppi->ptp_fallback = TRUE;
+
+	if (ppi->portDS) {
+		switch (ppi->cfg.profile) {
+		case PPSI_PROFILE_WR:
+#if CONFIG_HAS_PROFILE_WR
+			ppi->protocol_extension = PPSI_EXT_WR;
+			/* Add WR extension portDS */
+			if ( !(ppi->portDS->ext_dsport =
+				    unix_reuse_zalloc(ppi->portDS->ext_dsport,
+					    sizeof(union unix_ext_dsport))
+			      )
+			    ) {
+				return -1;
+			}
+
+			/* Allocate WR data extension */
+			if (! (ppi->ext_data =
+				    unix_reuse_zalloc(ppi->ext_data,
+					    sizeof(union unix_ext_data))
+			      )
+			   ) {
+				return -1;
+			}
+			/* Set WR extension hooks */
+			ppi->ext_hooks = &wr_ext_hooks;
+			enable_asymmetryCorrection(ppi, TRUE);
+#else
+			fprintf(stderr, "ppsi: Profile WR not supported");
+			exit(1);
+#endif
+			break;
+
+		case PPSI_PROFILE_HA:
+#if CONFIG_HAS_PROFILE_HA
+			if (!enable_l1Sync(ppi, TRUE))
+				return -1;
+			/* Force mandatory attributes - Do not take care of the configuration */
+			L1E_DSPOR_BS(ppi)->rxCoherentIsRequired = TRUE;
+			L1E_DSPOR_BS(ppi)->txCoherentIsRequired = TRUE;
+			L1E_DSPOR_BS(ppi)->congruentIsRequired = TRUE;
+			L1E_DSPOR_BS(ppi)->L1SyncEnabled = TRUE;
+			L1E_DSPOR_BS(ppi)->optParamsEnabled = FALSE;
+			enable_asymmetryCorrection(ppi, TRUE);
+#else
+			fprintf(stderr, "ppsi: Profile HA not supported");
+			exit(1);
+#endif
+			break;
+
+		case PPSI_PROFILE_PTP :
+			/* Do not take care of L1SYNC */
+			enable_asymmetryCorrection(ppi,
+				    ppi->cfg.asymmetryCorrectionEnable);
+			ppi->protocol_extension = PPSI_EXT_NONE;
+
+			break;
+
+		case PPSI_PROFILE_CUSTOM :
+#if CONFIG_HAS_PROFILE_CUSTOM
+			ppi->protocol_extension = PPSI_EXT_NONE; /* can be changed ...*/
+#if CONFIG_HAS_EXT_L1SYNC
+			if (ppi->cfg.l1SyncEnabled) {
+				if (!enable_l1Sync(ppi, TRUE))
+					return -1;
+				/* Read L1SYNC parameters */
+				L1E_DSPOR_BS(ppi)->rxCoherentIsRequired = ppi->cfg.l1SyncRxCoherentIsRequired;
+				L1E_DSPOR_BS(ppi)->txCoherentIsRequired = ppi->cfg.l1SyncTxCoherentIsRequired;
+				L1E_DSPOR_BS(ppi)->congruentIsRequired = ppi->cfg.l1SyncCongruentIsRequired;
+				L1E_DSPOR_BS(ppi)->optParamsEnabled = ppi->cfg.l1SyncOptParamsEnabled;
+				if (L1E_DSPOR_BS(ppi)->optParamsEnabled) {
+					L1E_DSPOR_OP(ppi)->timestampsCorrectedTx = ppi->cfg.l1SyncOptParamsTimestampsCorrectedTx;
+				}
+			}
+			enable_asymmetryCorrection(ppi, ppi->cfg.asymmetryCorrectionEnable);
+#endif
+#else
+				fprintf(stderr, "ppsi: Profile CUSTOM not supported");
+				exit(1);
+#endif
+			break;
+		}
+		/* Parameters profile independent */
+		ppi->timestampCorrectionPortDS.egressLatency = picos_to_interval(ppi->cfg.egressLatency_ps);
+		ppi->timestampCorrectionPortDS.ingressLatency = picos_to_interval(ppi->cfg.ingressLatency_ps);
+		ppi->timestampCorrectionPortDS.messageTimestampPointLatency = 0;
+		ppi->portDS->masterOnly = ppi->cfg.masterOnly; /* can be overridden in pp_init_globals() */
+	} else {
+		return -1;
+	}
+
+	/* The following default names depend on TIME= at build time */
+	ppi->n_ops = &DEFAULT_NET_OPS;
+	ppi->t_ops = &DEFAULT_TIME_OPS;
+	pp_trace_attach(ppi);
+
+	ppi->__tx_buffer = unix_reuse_zalloc(ppi->__tx_buffer,
+					     PP_MAX_FRAME_LENGTH);
+	ppi->__rx_buffer = unix_reuse_zalloc(ppi->__rx_buffer,
+					     PP_MAX_FRAME_LENGTH);
+
+	if (!ppi->portDS || !ppi->__tx_buffer || !ppi->__rx_buffer) {
+		return -1;
+	}
+	if (CONFIG_HAS_ARENA)
+		unix_arena_footprint(ppi, unix_arena_used() - arena0);
+	return 0;
+}
+
+/* Parse the command line, and fall back to defaults if no config is there */
+int unix_parse_config(struct pp_globals *ppg, int argc, char **argv)
+{
+	if (pp_parse_cmdline(ppg, argc, argv) != 0)
+		return -1;
+
+	/* If no item has been parsed, provide a default file or string */
+	if (ppg->cfg.cfg_items == 0)
+		pp_config_file(ppg, 0, PP_DEFAULT_CONFIGFILE);
+
+	/* No config found, add default */
+	if (ppg->cfg.cfg_items == 0)
+		pp_config_string(ppg, strdup("link 0; iface eth0; proto udp"));
+	return 0;
+}
+
+/* Extend a per-instance array from n0 to n items, the new ones zeroed */
+static void *unix_grow_array(void *arr, int n0, int n, size_t size)
+{
+	void *new = calloc(n, size);
+
+	if (!new)
+		return NULL;
+	if (arr)
+		memcpy(new, arr, n0 * size);
+	free(arr);
+	return new;
+}
+
+/*
+ * Make room for more instances, with the default configuration. The
+ * table doubles, so building it costs linear time. It may move, so no
+ * pointer to an instance can be kept across a call (but indexes can,
+ * and other per-instance tables use the same index).
+ */
+int pp_grow_instances(struct pp_globals *ppg)
+{
+	struct pp_instance *ppi;
+	int i, n0 = ppg->max_links, n = n0 ? 2 * n0 : 1;
+	void *p;
+
+	/* The reload's shadow globals have no arch data, nor other tables */
+	if (ppg->arch_glbl_data) {
+		if (CONFIG_HAS_METRICS) {
+			p = unix_grow_array(pp_metrics, n0, n,
+					    sizeof(*pp_metrics));
+			if (!p)
+				return -1;
+			pp_metrics = p;
+		}
+		if (CONFIG_HAS_LATENCY_TRACE) {
+			p = unix_grow_array(pp_lat_data, n0, n,
+					    sizeof(*pp_lat_data));
+			if (!p)
+				return -1;
+			pp_lat_data = p;
+		}
+	}
+	ppi = unix_grow_array(ppg->pp_instances, n0, n, sizeof(*ppi));
+	if (!ppi)
+		return -1;
+	ppg->pp_instances = ppi;
+	ppg->max_links = n;
+	for (i = n0; i < n; i++)
+		INST(ppg, i)->cfg = __pp_default_instance_cfg;
+
+	/* Names point within the instance: follow it if it moved */
+	for (i = 0; i < n0; i++) {
+		ppi = INST(ppg, i);
+		if (ppi->port_name)
+			ppi->port_name = ppi->cfg.port_name;
+		if (ppi->iface_name)
+			ppi->iface_name = ppi->cfg.iface_name;
+	}
+	return 0;
+}
+
+/*
+ * Clear the instance of a port that was removed (and is down), so the
+ * slot can be used by another port. The objects allocated for it by
+ * unix_init_instance are kept, and will be cleared and used again.
+ * The extension objects stay with the slot even if the next port has
+ * no extension, so they are cleared here already.
+ */
+void unix_clear_instance(struct pp_globals *ppg, struct pp_instance *ppi)
+{
+	struct pp_instance old = *ppi;
+	int i = ppi - ppg->pp_instances;
+
+	if (is_ext_hook_available(ppi, close))
+		ppi->ext_hooks->close(ppi);
+	memset(ppi, 0, sizeof(*ppi));
+	ppi->cfg = __pp_default_instance_cfg;
+	ppi->servo = old.servo;
+	ppi->portDS = old.portDS;
+	ppi->ext_data = old.ext_data;
+	if (ppi->portDS && ppi->portDS->ext_dsport)
+		memset(ppi->portDS->ext_dsport, 0,
+		       sizeof(union unix_ext_dsport));
+	if (ppi->ext_data)
+		memset(ppi->ext_data, 0, sizeof(union unix_ext_data));
+	ppi->__tx_buffer = old.__tx_buffer;
+	ppi->__rx_buffer = old.__rx_buffer;
+	if (CONFIG_HAS_METRICS)
+		memset(pp_metrics + i, 0, sizeof(*pp_metrics));
+	if (CONFIG_HAS_LATENCY_TRACE)
+		memset(pp_lat_data + i, 0, sizeof(*pp_lat_data));
+}
+
 int main(int argc, char **argv)
 {
 	struct pp_globals *ppg;
-	struct pp_instance *ppi;
 	unsigned long seed;
 	struct timex t;
 	int i;
 
-	setbuf(stdout, NULL);
+	if (CONFIG_HAS_DIAG_RING)
+		unix_diag_init(&ppg_static);
+	else
+		setbuf(stdout, NULL);
 
 	pp_printf("PPSi. Commit %s, built on " __DATE__ "\n", PPSI_VERSION);
 
@@ -176,160 +449,45 @@ int main(int argc, char **argv)
 	ppg->timePropertiesDS = &timePropertiesDS;
 	ppg->rt_opts = &__pp_default_rt_opts;
 
-	/* We are hosted, so we can allocate */
-	ppg->max_links = PP_MAX_LINKS;
+	/* We are hosted, so we can allocate; instances come with "port" */
 	ppg->arch_glbl_data = calloc(1, sizeof(struct unix_arch_data));
-	ppg->pp_instances = calloc(ppg->max_links, sizeof(struct pp_instance));
 
-	if ((!ppg->arch_glbl_data) || (!ppg->pp_instances)) {
+	if (!ppg->arch_glbl_data) {
 		fprintf(stderr, "ppsi: out of memory\n");
 		exit(1);
 	}
 
-	/* Set default configuration value for all instances */
-	for (i = 0; i < ppg->max_links; i++) {
-		memcpy(&INST(ppg, i)->cfg, &__pp_default_instance_cfg,
-		       sizeof(__pp_default_instance_cfg));
-	}
-
 	/* Set offset here, so config parsing can override it */
 	memset(&t, 0, sizeof(t));
 	if (adjtimex(&t) >= 0) {
 		ppg->timePropertiesDS->currentUtcOffset = (Integer16)t.tai;
 	}
 
-	if (pp_parse_cmdline(ppg, argc, argv) != 0)
-		return -1;
-
-	/* If no item has been parsed, provide a default file or string */
-	if (ppg->cfg.cfg_items == 0)
-		pp_config_file(ppg, 0, PP_DEFAULT_CONFIGFILE);
-
-	/* No config found, add default */
-	if (ppg->cfg.cfg_items == 0)
-		pp_config_string(ppg, strdup("link 0; iface eth0; proto udp"));
-
-	for (i = 0; i < ppg->nlinks; i++) {
+	if (CONFIG_HAS_RELOAD)
+		unix_reload_init(ppg, argc, argv);
 
-		ppi = INST(ppg, i);
-		ppi->ch[PP_NP_EVT].fd = -1;
-		ppi->ch[PP_NP_GEN].fd = -1;
-		ppi->glbs = ppg;
-		ppi->vlans_array_len = CONFIG_VLAN_ARRAY_SIZE,
-		ppi->iface_name = ppi->cfg.iface_name;
-		ppi->port_name = ppi->cfg.port_name;
-		ppi->delayMechanism = ppi->cfg.delayMechanism;
-		ppi->portDS = calloc(1, sizeof(*ppi->portDS));
-		ppi->servo = calloc(1, sizeof(*ppi->servo));
-		ppi->ext_hooks = &pp_hooks;
-		ppi->ptp_fallback = TRUE;
-
-		if (ppi->portDS) {
-			switch (ppi->cfg.profile) {
-			case PPSI_PROFILE_WR:
-#if CONFIG_HAS_PROFILE_WR
-				ppi->protocol_extension = PPSI_EXT_WR;
-				/* Add WR extension portDS */
-				if ( !(ppi->portDS->ext_dsport =
-					    calloc(1, sizeof(struct wr_dsport))
-				      )
-				    ) {
-					goto exit_out_of_memory;
-				}
-
-				/* Allocate WR data extension */
-				if (! (ppi->ext_data =
-					    calloc(1, sizeof(struct wr_data))
-				      )
-				   ) {
-					goto exit_out_of_memory;
-				}
-				/* Set WR extension hooks */
-				ppi->ext_hooks = &wr_ext_hooks;
-				enable_asymmetryCorrection(ppi, TRUE);
-#else
-				fprintf(stderr, "ppsi: Profile WR not supported");
-				exit(1);
-#endif
-				break;
-
-			case PPSI_PROFILE_HA:
-#if CONFIG_HAS_PROFILE_HA
-				if (!enable_l1Sync(ppi, TRUE))
-					goto exit_out_of_memory;
-				/* Force mandatory attributes - Do not take care of the configuration */
-				L1E_DSPOR_BS(ppi)->rxCoherentIsRequired = TRUE;
-				L1E_DSPOR_BS(ppi)->txCoherentIsRequired = TRUE;
-				L1E_DSPOR_BS(ppi)->congruentIsRequired = TRUE;
-				L1E_DSPOR_BS(ppi)->L1SyncEnabled = TRUE;
-				L1E_DSPOR_BS(ppi)->optParamsEnabled = FALSE;
-				enable_asymmetryCorrection(ppi, TRUE);
-#else
-				fprintf(stderr, "ppsi: Profile HA not supported");
-				exit(1);
-#endif
-				break;
-
-			case PPSI_PROFILE_PTP :
-				/* Do not take care of L1SYNC */
-				enable_asymmetryCorrection(ppi,
-					    ppi->cfg.asymmetryCorrectionEnable);
-				ppi->protocol_extension = PPSI_EXT_NONE;
-
-				break;
+	if (unix_parse_config(ppg, argc, argv) != 0)
+		return -1;
+	if (pp_trace_open(ppg) < 0)
+		return -1;
 
-			case PPSI_PROFILE_CUSTOM :
-#if CONFIG_HAS_PROFILE_CUSTOM
-				ppi->protocol_extension = PPSI_EXT_NONE; /* can be changed ...*/
-#if CONFIG_HAS_EXT_L1SYNC
-				if (ppi->cfg.l1SyncEnabled) {
-					if (!enable_l1Sync(ppi, TRUE))
-						goto exit_out_of_memory;
-					/* Read L1SYNC parameters */
-					L1E_DSPOR_BS(ppi)->rxCoherentIsRequired = ppi->cfg.l1SyncRxCoherentIsRequired;
-					L1E_DSPOR_BS(ppi)->txCoherentIsRequired = ppi->cfg.l1SyncTxCoherentIsRequired;
-					L1E_DSPOR_BS(ppi)->congruentIsRequired = ppi->cfg.l1SyncCongruentIsRequired;
-					L1E_DSPOR_BS(ppi)->optParamsEnabled = ppi->cfg.l1SyncOptParamsEnabled;
-					if (L1E_DSPOR_BS(ppi)->optParamsEnabled) {
-						L1E_DSPOR_OP(ppi)->timestampsCorrectedTx = ppi->cfg.l1SyncOptParamsTimestampsCorrectedTx;
-					}
-				}
-				enable_asymmetryCorrection(ppi, ppi->cfg.asymmetryCorrectionEnable);
-#endif
-#else
-					fprintf(stderr, "ppsi: Profile CUSTOM not supported");
-					exit(1);
-#endif
-				break;
-			}
-			/* Parameters profile independent */
-			ppi->timestampCorrectionPortDS.egressLatency = picos_to_interval(ppi->cfg.egressLatency_ps);
-			ppi->timestampCorrectionPortDS.ingressLatency = picos_to_interval(ppi->cfg.ingressLatency_ps);
-			ppi->timestampCorrectionPortDS.messageTimestampPointLatency = 0;
-			ppi->portDS->masterOnly = ppi->cfg.masterOnly; /* can be overridden in pp_init_globals() */
-		} else {
+	for (i = 0; i < ppg->nlinks; i++)
+		if (unix_init_instance(ppg, INST(ppg, i)) < 0)
 			goto exit_out_of_memory;
-		}
-
-		/* The following default names depend on TIME= at build time */
-		ppi->n_ops = &DEFAULT_NET_OPS;
-		ppi->t_ops = &DEFAULT_TIME_OPS;
 
-		ppi->__tx_buffer = malloc(PP_MAX_FRAME_LENGTH);
-		ppi->__rx_buffer = malloc(PP_MAX_FRAME_LENGTH);
-
-		if (!ppi->portDS || !ppi->__tx_buffer || !ppi->__rx_buffer) {
-			goto exit_out_of_memory;
-		}
-		
-	}
-	
 	pp_init_globals(ppg, &__pp_default_rt_opts);
 
+	if (CONFIG_HAS_ARENA)
+		unix_arena_report(ppg);
+
 	seed = time(NULL);
 	if (getenv("PPSI_DROP_SEED"))
 		seed = atoi(getenv("PPSI_DROP_SEED"));
 	ppsi_drop_init(ppg, seed);
+	pp_frec_init(ppg);
+
+	if (CONFIG_HAS_METRICS)
+		unix_metrics_init(ppg);
 
 	unix_main_loop(ppg);
 	return 0; /* never reached */
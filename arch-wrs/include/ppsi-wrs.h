@@ -38,8 +38,17 @@ static inline struct hal_port_state *pp_wrs_lookup_port(char *name)
 #define DEFAULT_TO 200000 /* ms */
 
 #define POSIX_ARCH(ppg) ((struct unix_arch_data *)(ppg->arch_glbl_data))
+#define UNIX_MAX_AUX_FD 4 /* Same as in ppsi-unix.h: check_packet is shared */
+
+struct unix_aux_fd {
+	int fd;
+	void (*action)(struct pp_globals *ppg, int fd);
+};
+
 struct unix_arch_data {
 	struct timeval tv;
+	int n_aux_fd;
+	struct unix_aux_fd aux_fd[UNIX_MAX_AUX_FD];
 };
 
 typedef struct  wrs_arch_data_t {
@@ -47,8 +56,45 @@ typedef struct  wrs_arch_data_t {
 	wrh_timing_mode_locking_state_t timingModeLockingState; /* Locking state for PLL */
 	wrh_timing_mode_t timingMode; /* Timing mode: Grand master, Free running,...*/
 	int gmUnlockErr; /* Error counter: Give the number of time the PLL was unlocked in GM mode */
+	struct wrs_shm_inst *inst_seg; /* Per-instance shmem segments (max_links entries) */
+#if CONFIG_HAS_LOOP_MONITOR
+	struct pp_loopmon loop; /* Main loop monitor, pp_loopmon points here */
+#endif
 }wrs_arch_data_t;
 
+/*
+ * Per-instance shmem segment. The sequence in ppsi_head only protects the
+ * globals (ppg and the global data sets); what belongs to an instance
+ * (portDS, servo, extension data) is protected by the sequence of its own
+ * segment, so a reader of one port never retries because of another port.
+ * Pointers are in the writer's map: readers must use wrs_shm_follow().
+ *
+ * Each servo update is also appended to a small ring of samples, so a
+ * reader polling more often than every WRS_SHM_INST_NSAMPLES updates
+ * sees all of them: "nsamples" counts the samples ever written.
+ */
+#define WRS_SHM_INST_NSAMPLES 32
+
+struct wrs_shm_sample {
+	uint32_t update_count;	/* of the servo, 0 after a reset */
+	uint8_t state;		/* servo state, as in struct pp_servo */
+	uint8_t servo_locked;
+	struct pp_time update_time;
+	struct pp_time offsetFromMaster;
+	struct pp_time meanDelay;
+};
+
+struct wrs_shm_inst {
+	unsigned sequence;
+	uint32_t stamp;
+	int index;
+	struct pp_instance *ppi;
+	const char *last_write_caller;
+	int last_write_line;
+	uint32_t nsamples;
+	struct wrs_shm_sample sample[WRS_SHM_INST_NSAMPLES];
+};
+
 static inline wrs_arch_data_t *WRS_ARCH_I(struct pp_instance *ppi)
 {
 	return (wrs_arch_data_t *) GLBS(ppi)->arch_glbl_data;
@@ -59,6 +105,93 @@ static inline wrs_arch_data_t *WRS_ARCH_G(struct pp_globals *ppg)
 	return (wrs_arch_data_t *) ppg->arch_glbl_data;
 }
 
+/* Writer side, in wrs-shmem.c */
+extern int wrs_shm_inst_init(struct pp_globals *ppg);
+extern void wrs_shm_inst_write_caller(struct pp_instance *ppi, int flags,
+				      const char *caller, int line);
+#define wrs_shm_inst_write(ppi, flags) \
+	wrs_shm_inst_write_caller(ppi, flags, __func__, __LINE__)
+
+/* Reader side, for the dump and SNMP tools: "head" is the reader's mapping */
+static inline struct pp_globals *wrs_shm_ppg(struct wrs_shm_head *head)
+{
+	return (void *)head + head->data_off;
+}
+
+static inline struct wrs_shm_inst *wrs_shm_inst_lookup(struct wrs_shm_head *head,
+						       int index)
+{
+	struct pp_globals *ppg = wrs_shm_ppg(head);
+	wrs_arch_data_t *arch_data = wrs_shm_follow(head, WRS_ARCH_G(ppg));
+	struct wrs_shm_inst *seg;
+
+	if (!arch_data || index < 0 || index >= ppg->nlinks)
+		return NULL;
+	seg = wrs_shm_follow(head, arch_data->inst_seg);
+	return seg ? seg + index : NULL;
+}
+
+static inline struct wrs_shm_inst *wrs_shm_inst_lookup_name(struct wrs_shm_head *head,
+							    const char *port_name)
+{
+	struct pp_globals *ppg = wrs_shm_ppg(head);
+	struct pp_instance *ppi = wrs_shm_follow(head, ppg->pp_instances);
+	int i;
+
+	for (i = 0; ppi && i < ppg->nlinks; i++)
+		if (!strcmp(ppi[i].cfg.port_name, port_name))
+			return wrs_shm_inst_lookup(head, i);
+	return NULL;
+}
+
+static inline struct pp_instance *wrs_shm_inst_ppi(struct wrs_shm_head *head,
+						   struct wrs_shm_inst *seg)
+{
+	return wrs_shm_follow(head, seg->ppi);
+}
+
+/* Same as wrs_shm_seqbegin/seqretry, but on one instance only */
+static inline unsigned wrs_shm_inst_seqbegin(struct wrs_shm_inst *seg)
+{
+	unsigned ret = *(volatile unsigned *)&seg->sequence;
+
+	__sync_synchronize();
+	return ret;
+}
+
+static inline int wrs_shm_inst_seqretry(struct wrs_shm_inst *seg, unsigned start)
+{
+	__sync_synchronize();
+	if (start & WRS_SHM_LOCK_MASK)
+		return 1; /* it was odd: retry */
+	return *(volatile unsigned *)&seg->sequence != start;
+}
+
+/*
+ * Streaming mode of the dump tool (PPSI_STREAM="<text|json|bin>[,<ms>]").
+ * The binary format is a sequence of these records, in host byte order:
+ * one per servo sample, or one with no sample when "lost" are missing.
+ */
+enum {
+	PPSI_STREAM_TEXT = 0,
+	PPSI_STREAM_JSON,
+	PPSI_STREAM_BIN,
+};
+
+#define WRS_SHM_STREAM_MAGIC 0x50505353 /* "PPSS" */
+
+struct wrs_shm_stream_rec {
+	uint32_t magic;
+	uint16_t index;		/* of the instance */
+	uint16_t ppi_state;
+	uint32_t lost;		/* samples overwritten before being read */
+	uint32_t pad;
+	struct wrs_shm_sample sample;
+};
+
+extern int stream_ppsi_mem(struct wrs_shm_head *head, int format,
+			   int period_ms);
+
 extern void wrs_main_loop(struct pp_globals *ppg);
 
 extern void wrs_init_ipcserver(struct minipc_ch *ppsi_ch);
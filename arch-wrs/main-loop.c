@@ -191,7 +191,7 @@ static unsigned int run_all_state_machines(struct pp_globals *ppg)
 
 		/* Do not call state machine if link is down */
 		delay_ms_j =  ppi->link_up ?
-			 pp_state_machine(ppi, NULL, 0) :
+			 pp_loop_run(ppi, NULL, 0) :
 			 PP_DEFAULT_NEXT_DELAY_MS;
 
 		/* delay_ms is the least delay_ms among all instances */
@@ -319,8 +319,13 @@ void wrs_main_loop(struct pp_globals *ppg)
 		 * (see skipped_checks)
 		 */
 		if ( !alarmDetected && (skipped_checks > 10 || delay_ms !=0) ) {
+			pp_loop_wait(ppg, delay_ms == UINT_MAX ? -1 : delay_ms);
 			minipc_server_action(ppsi_ch, 1 /* ms */);
 			packet_available = wrs_net_ops.check_packet(ppg, delay_ms);
+			pp_loop_wake(ppg);
+			/* The dump signal cut the wait short: run now, as unix does */
+			if (pp_frec_poll(ppg))
+				alarmDetected = 1;
 			skipped_checks=0;
 		} else {
 			skipped_checks++;
@@ -330,6 +335,7 @@ void wrs_main_loop(struct pp_globals *ppg)
 		if ((packet_available<=0) && (alarmDetected || (delay_ms==0))) {
 			/* Time to run the state machine */
 			stop_alarm(&timerid); /* Clear previous alarm */
+			pp_loop_timer(ppg);
 		    delay_ms = run_all_state_machines(ppg);
 		    /* We force to run the state machine at a minimum rate of PP_DEFAULT_NEXT_DELAY_MS */
 			if (delay_ms>PP_DEFAULT_NEXT_DELAY_MS )
@@ -367,7 +373,7 @@ void wrs_main_loop(struct pp_globals *ppg)
 						continue;
 					}
 
-					tmp_d = pp_state_machine(ppi, ppi->rx_ptp,
+					tmp_d = pp_loop_run(ppi, ppi->rx_ptp,
 						i - ppi->rx_offset);
 
 					if ( tmp_d < delay_ms )
@@ -5,11 +5,35 @@
  * Released according to GNU LGPL, version 2.1 or any later
  */
 
+#include <string.h>
 #include <ppsi/ppsi.h>
 
+#if CONFIG_HAS_TRACE
+static int f_trace_file(struct pp_argline *l, int lineno,
+			struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	strncpy(pp_trace_file, arg->s, PP_TRACE_PATH_LEN - 1);
+	return 0;
+}
+#endif
+
+#if CONFIG_HAS_FLIGHT_RECORDER
+static int f_frec_file(struct pp_argline *l, int lineno,
+		       struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	strncpy(pp_frec_file, arg->s, PP_FREC_PATH_LEN - 1);
+	return 0;
+}
+#endif
 
 struct pp_argline pp_arch_arglines[] = {
 	GLOB_OPTION_INT("rx-drop", ARG_INT, NULL, rxdrop),
 	GLOB_OPTION_INT("tx-drop", ARG_INT, NULL, txdrop),
+#if CONFIG_HAS_TRACE
+	LEGACY_OPTION(f_trace_file, "trace-file", ARG_STR),
+#endif
+#if CONFIG_HAS_FLIGHT_RECORDER
+	LEGACY_OPTION(f_frec_file, "flight-recorder-file", ARG_STR),
+#endif
 	{}
 };
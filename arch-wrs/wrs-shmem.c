@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Per-instance segments in the ppsi shmem. Each instance has its own
+ * sequence counter, so writing the servo of a port does not invalidate
+ * the readers of all other ports (see struct wrs_shm_inst).
+ */
+#include <ppsi/ppsi.h>
+#include <ppsi-wrs.h>
+#include <libwr/util.h>
+#include <libwr/wrs-msg.h>
+
+extern struct wrs_shm_head *ppsi_head;
+
+/* Called at startup, before the per-instance data are allocated */
+int wrs_shm_inst_init(struct pp_globals *ppg)
+{
+	struct wrs_shm_inst *seg;
+	int i;
+
+	seg = wrs_shm_alloc(ppsi_head, ppg->max_links * sizeof(*seg));
+	if (!seg)
+		return -1;
+	for (i = 0; i < ppg->max_links; i++) {
+		seg[i].index = i;
+		seg[i].ppi = INST(ppg, i);
+	}
+	WRS_ARCH_G(ppg)->inst_seg = seg;
+	return 0;
+}
+
+/* The servo ran while the segment was locked: record the new sample */
+static void wrs_shm_inst_sample(struct pp_instance *ppi,
+				struct wrs_shm_inst *seg)
+{
+	struct pp_servo *s = SRV(ppi);
+	struct wrs_shm_sample *smp;
+
+	if (!s->update_count)
+		return;
+	if (seg->nsamples && s->update_count ==
+	    seg->sample[(seg->nsamples - 1) % WRS_SHM_INST_NSAMPLES].update_count)
+		return;
+	smp = seg->sample + seg->nsamples % WRS_SHM_INST_NSAMPLES;
+	smp->update_count = s->update_count;
+	smp->state = s->state;
+	smp->servo_locked = s->servo_locked;
+	smp->update_time = s->update_time;
+	smp->offsetFromMaster = s->offsetFromMaster;
+	smp->meanDelay = s->meanDelay;
+	seg->nsamples++;
+}
+
+void wrs_shm_inst_write_caller(struct pp_instance *ppi, int flags,
+			       const char *caller, int line)
+{
+	struct wrs_shm_inst *seg = WRS_ARCH_I(ppi)->inst_seg +
+		(ppi - GLBS(ppi)->pp_instances);
+
+	if (flags == WRS_SHM_WRITE_BEGIN) {
+		if (seg->sequence & WRS_SHM_LOCK_MASK)
+			pr_error("%s: shmem of instance %i already locked "
+				 "by %s (line %i)\n", caller, seg->index,
+				 seg->last_write_caller, seg->last_write_line);
+		seg->sequence += 2;
+		seg->sequence |= WRS_SHM_LOCK_MASK;
+		__sync_synchronize();
+	}
+	if (flags == WRS_SHM_WRITE_END) {
+		wrs_shm_inst_sample(ppi, seg);
+		__sync_synchronize();
+		seg->stamp = get_monotonic_sec();
+		/* The head is not locked, but wrs_shm_age() looks at it */
+		ppsi_head->stamp = seg->stamp;
+		if (!(seg->sequence & WRS_SHM_LOCK_MASK))
+			pr_error("%s: shmem of instance %i already unlocked "
+				 "by %s (line %i)\n", caller, seg->index,
+				 seg->last_write_caller, seg->last_write_line);
+		seg->sequence += 2;
+		seg->sequence &= ~WRS_SHM_LOCK_MASK;
+	}
+	seg->last_write_caller = caller;
+	seg->last_write_line = line;
+}
@@ -232,10 +232,16 @@ int main(int argc, char **argv)
 	ppg->pp_instances = wrs_shm_alloc(ppsi_head,
 				     ppg->max_links * sizeof(struct pp_instance));
 
-	if ((!ppg->arch_glbl_data) || (!ppg->pp_instances)) {
+	if ((!ppg->arch_glbl_data) || (!ppg->pp_instances) ||
+	    wrs_shm_inst_init(ppg) < 0) {
 		fprintf(stderr, "ppsi: out of memory\n");
 		exit(1);
 	}
+#if CONFIG_HAS_LOOP_MONITOR
+	/* Export the main loop monitor in shared memory */
+	WRS_ARCH_G(ppg)->loop = *pp_loopmon;
+	pp_loopmon = &WRS_ARCH_G(ppg)->loop;
+#endif
 	/* Set default configuration value for all instances */
 	for (i = 0; i < ppg->max_links; i++) {
 		memcpy(&INST(ppg, i)->cfg, &__pp_default_instance_cfg,sizeof(__pp_default_instance_cfg));
@@ -269,6 +275,8 @@ int main(int argc, char **argv)
 			pp_config_string(ppg, s);
 		}
 	}
+	if (pp_trace_open(ppg) < 0)
+		return -1;
 	for (i = 0; i < ppg->nlinks; i++) {
 		struct pp_instance *ppi= INST(ppg, i);
 
@@ -365,6 +373,7 @@ int main(int argc, char **argv)
 		/* The following default names depend on TIME= at build time */
 		ppi->n_ops = &DEFAULT_NET_OPS;
 		ppi->t_ops = &DEFAULT_TIME_OPS;
+		pp_trace_attach(ppi);
 
 		ppi->__tx_buffer = malloc(PP_MAX_FRAME_LENGTH);
 		ppi->__rx_buffer = malloc(PP_MAX_FRAME_LENGTH);
@@ -448,6 +457,7 @@ int main(int argc, char **argv)
 	if (getenv("PPSI_DROP_SEED"))
 		seed = (unsigned long) atoi(getenv("PPSI_DROP_SEED"));
 	ppsi_drop_init(ppg, seed);
+	pp_frec_init(ppg);
 
 	/* release lock from wrs_shm_get */
 	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
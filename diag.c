@@ -11,7 +11,7 @@
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #endif
 
-static const char * const thing_name[] = {
+const char * const pp_diag_thing_name[] = {
 	[pp_dt_fsm]	= "fsm",
 	[pp_dt_time]	= "time",
 	[pp_dt_frames]	= "frames",
@@ -27,10 +27,19 @@ void __pp_diag(struct pp_instance *ppi, enum pp_diag_things th,
 {
 	va_list args;
 	const char *name;
+	int done;
 
 	if (!__PP_DIAG_ALLOW(ppi, th, level))
 		return;
 
+	if (CONFIG_HAS_DIAG_RING) {
+		va_start(args, fmt);
+		done = pp_diag_ring_put(ppi, th, level, fmt, args);
+		va_end(args);
+		if (done)
+			return;
+	}
+
 	name = ppi ? ppi->port_name : "ppsi";
 
 	/* Use the normal output channel for diagnostics */
@@ -43,7 +52,7 @@ void __pp_diag(struct pp_instance *ppi, enum pp_diag_things th,
 			hours=minutes=seconds=0;
 		pp_printf("%02d:%02d:%02d ", hours, minutes,seconds);
 	}
-	pp_printf("diag-%s-%i-%s: ", thing_name[th], level, name);
+	pp_printf("diag-%s-%i-%s: ", pp_diag_thing_name[th], level, name);
 	va_start(args, fmt);
 	pp_vprintf(fmt, args);
 	va_end(args);
@@ -53,7 +62,7 @@ unsigned long pp_diag_parse(const char *diaglevel)
 {
 	unsigned long res = 0;
 	int i = 28; /* number of bits to shift the nibble: 28..31 is first */
-	int nthings = ARRAY_SIZE(thing_name);
+	int nthings = ARRAY_SIZE(pp_diag_thing_name);
 
 	while (*diaglevel && i >= (32 - 4 * nthings)) {
 		if (*diaglevel < '0' || *diaglevel > '3')
@@ -100,7 +100,8 @@ int pp_leave_current_state(struct pp_instance *ppi)
 		if ( ppi->state==PPS_MASTER || ppi->state==PPS_SLAVE)
 			bzero(ppi->activePeer,sizeof(ppi->activePeer));
 
-		ppi->ext_hooks->state_change(ppi);
+		PP_PROF_HOOK(ppi, PP_PROF_STATE_CHANGE,
+			     ppi->ext_hooks->state_change(ppi));
 	}
 	
 	/* if the next or old state is non standard PTP reset all timeouts */
@@ -108,6 +109,7 @@ int pp_leave_current_state(struct pp_instance *ppi)
 	    || (ppi->next_state >= PPS_LAST_STATE))
 		pp_timeout_setall(ppi);
 
+	pp_frec_state(ppi, ppi->state, ppi->next_state);
 	ppi->state = ppi->next_state;
 	if ( ppi->state==PPS_DISABLED ){
 		ppi->pdstate = PP_PDSTATE_NONE; // Clear state
@@ -122,7 +124,7 @@ int pp_leave_current_state(struct pp_instance *ppi)
 
 /*
  * Checks whether a packet has to be discarded and maybe updates port status
- * accordingly. Returns new packet length (0 if packet has to be discarded)
+ * accordingly. Returns 0, or -reason (enum pp_drop_reason) to discard it
  */
 static int pp_packet_prefilter(struct pp_instance *ppi)
 {
@@ -137,7 +139,7 @@ static int pp_packet_prefilter(struct pp_instance *ppi)
 	if (hdr->domainNumber != GDSDEF(GLBS(ppi))->domainNumber) {
 		pp_diag(ppi, frames, 1, "Wrong domain %i: discard\n",
 			hdr->domainNumber);
-		return -1;
+		return -PP_DROP_DOMAIN;
 	}
 
 	/*
@@ -148,7 +150,7 @@ static int pp_packet_prefilter(struct pp_instance *ppi)
 	 */
 	if (hdr->flagField[0] & PP_ALTERNATE_MASTER_FLAG) {
 		pp_diag(ppi, frames, 1, "Alternate master: discard\n");
-		return -1;
+		return -PP_DROP_ALT_MASTER;
 	}
 
 	/*
@@ -159,7 +161,7 @@ static int pp_packet_prefilter(struct pp_instance *ppi)
 		    &DSPOR(ppi)->portIdentity,
 		    sizeof(PortIdentity))) {
 		pp_diag(ppi, frames, 1, "Looping frame: discard\n");
-		return -1;
+		return -PP_DROP_LOOP;
 	}
 
 	/*
@@ -174,7 +176,7 @@ static int pp_packet_prefilter(struct pp_instance *ppi)
 			 * also the PASSIVE states in this case is overwritten */
 			if (hdr->messageType != PPM_ANNOUNCE) {
 				/* ignore messages, except announce coming from its own clock */
-				return -1;	
+				return -PP_DROP_OWN_CLOCK;
 			}		
 		}
 	}
@@ -187,7 +189,7 @@ static int pp_packet_prefilter(struct pp_instance *ppi)
 	 * DISABLED: The port shall not place any messages on its communication path
 	 */
 	if ( ppi->state==PPS_INITIALIZING || ppi->state==PPS_DISABLED || ppi->state==PPS_FAULTY ) {
-		return -1;/* ignore messages all messages */
+		return -PP_DROP_STATE; /* ignore all messages */
 	}
 	return 0;
 }
@@ -229,15 +231,17 @@ static int fsm_unpack_verify_frame(struct pp_instance *ppi,
  * is that of the extension, otherwise the one in state-table-default.c
  */
 
-int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
+static int __pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 {
 	const struct pp_state_table_item *ip;
 	struct pp_time *t = &ppi->last_rcv_time;
 	int state, err = 0;
 	int msgtype;
+	int64_t t0;
 
 	if (len > 0) {
 		msgtype = ((*(UInteger8 *) (buf + 0)) & 0x0F);
+		pp_lat_rx_begin(ppi, msgtype);
 		pp_diag(ppi, frames, 1,
 			"RECV %02d bytes at %9d.%09d.%03d (type %x, %s)\n",
 			len, (int)t->secs, (int)(t->scaled_nsecs >> 16),
@@ -261,6 +265,8 @@ int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 	 */
 	err = fsm_unpack_verify_frame(ppi, buf, len);
 	if (err) {
+		if (len)
+			pp_metrics_drop(ppi, PP_DROP_MALFORMED);
 		len = 0;
 		buf = NULL;
 	}
@@ -289,9 +295,13 @@ int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 	 */
 	if (buf) {
 		err = pp_packet_prefilter(ppi);
+		pp_frec_rx(ppi, err < 0 ? -err : 0);
 		if (err < 0) {
+			pp_metrics_drop(ppi, -err);
 			buf = NULL;
 			len = 0;
+		} else {
+			pp_lat_mark(ppi, PP_LAT_PREFILTER);
 		}
 	}
 
@@ -310,10 +320,14 @@ int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 	} else
 		ppi->received_ptp_header.messageType = PPM_NO_MESSAGE;
 
+	t0 = pp_prof_begin();
 	err = ip->f1(ppi, buf, len);
+	pp_prof_state(ppi, state, t0);
 	if (err)
 		pp_printf("fsm for %s: Error %i in %s\n",
 			  ppi->port_name, err, ip->name);
+	if (len)
+		pp_lat_mark(ppi, PP_LAT_HANDLER);
 
 	/* done: if new state mark it, and enter it now (0 ms) */
 	if (ppi->state != ppi->next_state)
@@ -341,7 +355,10 @@ int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 
 	/* Run the extension state machine. The extension can provide its own time-out */
 	if ( is_ext_hook_available(ppi,run_ext_state_machine) ) {
-		int delay = ppi->ext_hooks->run_ext_state_machine(ppi,buf,len);
+		int delay;
+
+		delay = PP_PROF_HOOK(ppi, PP_PROF_RUN_EXT_SM,
+			ppi->ext_hooks->run_ext_state_machine(ppi,buf,len));
 
 		/* if new state mark it, and enter it now (0 ms) */
 		if (ppi->state != ppi->next_state)
@@ -356,6 +373,16 @@ int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
 	return ppi->next_delay;
 }
 
+int pp_state_machine(struct pp_instance *ppi, void *buf, int len)
+{
+	int64_t t0 = pp_prof_begin();
+	int ret = __pp_state_machine(ppi, buf, len);
+
+	pp_lat_rx_end(ppi);
+	pp_prof_run(ppi, buf, len, t0);
+	return ret;
+}
+
 /* link state functions to manage the extension (Enable/disable) */
 void pdstate_disable_extension(struct pp_instance * ppi)
 {
@@ -10,7 +10,7 @@
 #define __WRH_H__
 
 /* Please increment WRS_PPSI_SHMEM_VERSION if you change any exported data structure */
-#define WRS_PPSI_SHMEM_VERSION 36
+#define WRS_PPSI_SHMEM_VERSION 46
 
 /* Don't include the Following when this file is included in assembler. */
 #ifndef __ASSEMBLY__
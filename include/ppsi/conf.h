@@ -74,6 +74,7 @@ struct pp_argline {
 	struct pp_argname *args;
 	size_t field_offset;
 	int needs_port;
+	int in_globals;	/* field_offset is in pp_globals, not rt_opts */
 	pp_argline_min_max_t min_max;
 };
 
@@ -172,11 +173,13 @@ struct pp_argline {
 #define GLOB_OPTION(func,k,t,a,field)					\
 	OPTION_OPEN() \
 	OPTION(struct pp_globals,func,k,t,a,field,0) \
+	.in_globals = 1, \
 	OPTION_CLOSE()
 
 #define GLOB_OPTION_INT_RANGE(k,t,a,field,mn,mx)					\
 	OPTION_OPEN() \
 	OPTION(struct pp_globals,f_simple_int,k,t,a,field,0) \
+	.in_globals = 1, \
 	.min_max.min.min_int = mn,\
 	.min_max.max.max_int = mx,\
 	OPTION_CLOSE()
@@ -66,6 +66,31 @@ extern void __pp_diag(struct pp_instance *ppi, enum pp_diag_things th,
 		      int level, const char *fmt, ...)
 	__attribute__((format(printf, 4, 5)));
 
+extern const char * const pp_diag_thing_name[];
+
+/*
+ * With CONFIG_DIAG_RING, __pp_diag only records its arguments and the
+ * arch formats them later. The arch returns 0 if it can't defer a message
+ */
+#if CONFIG_HAS_DIAG_RING
+extern int pp_diag_ring_put(struct pp_instance *ppi, int th, int level,
+			    const char *fmt, va_list args);
+extern int pp_diag_ring_time(struct pp_instance *ppi, int th, int level,
+			     const struct pp_time *t, const char *fmt, ...);
+#else
+static inline int pp_diag_ring_put(struct pp_instance *ppi, int th,
+				   int level, const char *fmt, va_list args)
+{
+	return 0;
+}
+static inline int pp_diag_ring_time(struct pp_instance *ppi, int th,
+				    int level, const struct pp_time *t,
+				    const char *fmt, ...)
+{
+	return 0;
+}
+#endif
+
 /* Now, *still* use PPSI_NO_DIAG as an escape route to kill all diag code */
 #ifdef PPSI_NO_DIAG
 #  define PP_HAS_DIAG 0
@@ -76,16 +101,48 @@ extern void __pp_diag(struct pp_instance *ppi, enum pp_diag_things th,
 /* Constant used to enable extra diagnostic information - Inserted at compilation time */
 #define PP_DIAG_EXTRA_PRINT_TIME (0 && PP_HAS_DIAG) /* Print time on each pp_diag calls */
 
+/*
+ * Highest level compiled in for each thing (Kconfig, "Diagnostics"):
+ * with a constant level, messages above it are removed by the compiler,
+ * together with the evaluation of their arguments.
+ */
+#define __PP_DIAG_MAX_fsm	CONFIG_DIAG_MAX_FSM
+#define __PP_DIAG_MAX_time	CONFIG_DIAG_MAX_TIME
+#define __PP_DIAG_MAX_frames	CONFIG_DIAG_MAX_FRAMES
+#define __PP_DIAG_MAX_servo	CONFIG_DIAG_MAX_SERVO
+#define __PP_DIAG_MAX_bmc	CONFIG_DIAG_MAX_BMC
+#define __PP_DIAG_MAX_ext	CONFIG_DIAG_MAX_EXT
+#define __PP_DIAG_MAX_config	CONFIG_DIAG_MAX_CONFIG
+
+#define __PP_DIAG_BUILT(th_, level_) \
+		(PP_HAS_DIAG && (level_) <= __PP_DIAG_MAX_ ## th_)
+
 /* So, this is the function that is to be used by real ppsi code */
 #define pp_diag(ppi_, th_, level_, ...)					\
 	({								\
-	if (PP_HAS_DIAG)						\
+	if (__PP_DIAG_BUILT(th_, level_))				\
 		__pp_diag(ppi_, pp_dt_ ## th_, level_, __VA_ARGS__);	\
 	PP_HAS_DIAG; /* return 1 if done, 0 if not done */		\
 	})
 
 #define pp_diag_allow(ppi_, th_, level_) \
-		(PP_HAS_DIAG && __PP_DIAG_ALLOW(ppi_,  pp_dt_ ## th_, level_))
+		(__PP_DIAG_BUILT(th_, level_) &&			\
+		 __PP_DIAG_ALLOW(ppi_,  pp_dt_ ## th_, level_))
+
+/*
+ * A message with a time: the last conversion of fmt is a "%s" for it.
+ * time_to_string() only runs if the message is printed, and the ring
+ * stores the time itself, so it runs when the ring is drained.
+ */
+#define pp_diag_time(ppi_, th_, level_, t_, fmt_, ...)			\
+	({								\
+	if (pp_diag_allow(ppi_, th_, level_) &&				\
+	    !pp_diag_ring_time(ppi_, pp_dt_ ## th_, level_, t_,		\
+			       fmt_, ##__VA_ARGS__))			\
+		__pp_diag(ppi_, pp_dt_ ## th_, level_, fmt_,		\
+			  ##__VA_ARGS__, time_to_string(t_));		\
+	PP_HAS_DIAG; /* return 1 if done, 0 if not done */		\
+	})
 
 /*
  * Set of useful macros to store temporary diag messages
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Flight recorder: each instance keeps, always, a ring of its last
+ * events in compact binary form: the header and time stamp of the
+ * frames received and sent, the state transitions, the changes of the
+ * BMC decision and the servo events. The ring is written to a file
+ * ("flight-recorder-file") when the port enters FAULTY and, for all
+ * ports, on SIGUSR1; tools/ppsi-frec decodes it. wrs keeps the ring in
+ * the instance, in shared memory, so wrs_dump_shmem_ppsi can write the
+ * same file at any time. Without CONFIG_FLIGHT_RECORDER the hooks compile to
+ * nothing; the same happens with PPSI_NO_DIAG, for tools that link the
+ * protocol code.
+ */
+#ifndef __PPSI_FLIGHTREC_H__
+#define __PPSI_FLIGHTREC_H__
+
+#define PP_FREC_LEN		256 /* entries per instance, a power of 2 */
+#define PP_FREC_PATH_LEN	256
+#define PP_FREC_MAX_FILE	(1 << 20) /* then it is renamed to .old */
+
+enum pp_frec_type {
+	PP_FREC_NONE = 0,
+	PP_FREC_RX,	/* code: msg type, seq, source id; a, b: stamp */
+	PP_FREC_TX,	/* code: msg type, seq; a, b: stamp */
+	PP_FREC_STATE,	/* code: new state, seq: old state */
+	PP_FREC_BMC,	/* code: decision, seq: state, id: erbest */
+	PP_FREC_SERVO,	/* code: event; a: offset, b: meanDelay (ns) */
+};
+
+/* Flags of frames: the drop reason (enum pp_drop_reason) is in the low
+ * byte of received frames */
+#define PP_FREC_F_NO_STAMP	0x100	/* sent without a time stamp */
+
+enum pp_frec_servo {
+	PP_FREC_SERVO_INIT = 0,	/* a: observed drift (ppb) instead */
+	PP_FREC_SERVO_UPDATE,
+	PP_FREC_SERVO_JUMP,	/* the clock was set: a is the step */
+	PP_FREC_SERVO_BAD,	/* meanDelay over one second: ignored */
+};
+
+struct pp_frec_entry {
+	int64_t mono_ns;	/* CLOCK_MONOTONIC when recorded */
+	uint8_t type;
+	uint8_t code;
+	uint16_t seq;
+	uint16_t port;		/* portNumber of the source port identity */
+	uint16_t flags;		/* BMC: index of the ebest port, or -1 */
+	ClockIdentity id;	/* clockIdentity of the source port identity */
+	int64_t a, b;		/* a pp_time is secs and scaled_nsecs */
+};
+
+struct pp_frec {
+	uint32_t n;		/* ever recorded, the ring is modulo */
+	uint32_t bmc_last;	/* BMC entries only change: index + 1, or 0 */
+	struct pp_frec_entry e[PP_FREC_LEN];
+};
+
+/*
+ * The dump file: a header and, for each port, a pp_frec_port followed
+ * by its entries, oldest first. Dumps are appended to the file, in host
+ * byte order, so tools/ppsi-frec prints them all.
+ */
+#define PP_FREC_MAGIC		0x52465050 /* "PPFR" in little endian */
+#define PP_FREC_VERSION		2
+
+enum pp_frec_reason {
+	PP_FREC_DUMP_SIGNAL = 0,
+	PP_FREC_DUMP_FAULTY,
+	PP_FREC_DUMP_SHMEM,	/* written by wrs_dump_shmem_ppsi */
+};
+
+struct pp_frec_file {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t entry_size;	/* sizeof(struct pp_frec_entry) */
+	uint8_t reason;
+	uint8_t reserved;
+	int16_t inst;		/* index of the port that caused it, or -1 */
+	uint16_t nports;
+	uint16_t reserved2;
+	int64_t mono_ns;	/* CLOCK_MONOTONIC at the dump */
+	int64_t real_ns;	/* CLOCK_REALTIME at the same time */
+};
+
+struct pp_frec_port {
+	char name[16];
+	uint32_t n;		/* entries ever recorded */
+	uint32_t count;		/* entries that follow */
+};
+
+static inline const char *pp_frec_reason_name(int reason)
+{
+	static const char * const names[] = {
+		[PP_FREC_DUMP_SIGNAL] = "signal",
+		[PP_FREC_DUMP_FAULTY] = "faulty",
+		[PP_FREC_DUMP_SHMEM] = "shmem",
+	};
+
+	return reason >= 0 && reason <= PP_FREC_DUMP_SHMEM ?
+		names[reason] : "unknown";
+}
+
+static inline const char *pp_frec_servo_name(int event)
+{
+	static const char * const names[] = {
+		[PP_FREC_SERVO_INIT] = "init",
+		[PP_FREC_SERVO_UPDATE] = "update",
+		[PP_FREC_SERVO_JUMP] = "jump",
+		[PP_FREC_SERVO_BAD] = "bad_delay",
+	};
+
+	return event >= 0 && event <= PP_FREC_SERVO_BAD ?
+		names[event] : "unknown";
+}
+
+/* The last entry of a ring, or NULL if it is empty */
+static inline struct pp_frec_entry *pp_frec_last(struct pp_frec *f)
+{
+	return f->n ? &f->e[(f->n - 1) % PP_FREC_LEN] : NULL;
+}
+
+struct pp_instance;
+struct pp_globals;
+struct pp_time;
+#if CONFIG_HAS_FLIGHT_RECORDER && !defined(PPSI_NO_DIAG)
+extern char pp_frec_file[PP_FREC_PATH_LEN];
+extern void pp_frec_rx(struct pp_instance *ppi, int drop);
+extern void pp_frec_tx(struct pp_instance *ppi, int msgtype, int flags);
+extern void pp_frec_state(struct pp_instance *ppi, int old, int new);
+extern void pp_frec_bmc(struct pp_instance *ppi, int decision);
+extern void pp_frec_servo(struct pp_instance *ppi, int event,
+			  struct pp_time *ofm, struct pp_time *mpd);
+extern int pp_frec_dump(struct pp_globals *ppg, struct pp_instance *ppi,
+			int reason);
+extern void pp_frec_init(struct pp_globals *ppg);
+extern int pp_frec_poll(struct pp_globals *ppg);
+#else
+static inline void pp_frec_rx(struct pp_instance *ppi, int drop) {}
+static inline void pp_frec_tx(struct pp_instance *ppi, int msgtype,
+			      int flags) {}
+static inline void pp_frec_state(struct pp_instance *ppi, int old,
+				 int new) {}
+static inline void pp_frec_bmc(struct pp_instance *ppi, int decision) {}
+static inline void pp_frec_servo(struct pp_instance *ppi, int event,
+				 struct pp_time *ofm, struct pp_time *mpd) {}
+static inline int pp_frec_dump(struct pp_globals *ppg,
+			       struct pp_instance *ppi, int reason)
+{
+	return 0;
+}
+static inline void pp_frec_init(struct pp_globals *ppg) {}
+static inline int pp_frec_poll(struct pp_globals *ppg)
+{
+	return 0;
+}
+#endif
+
+#endif /* __PPSI_FLIGHTREC_H__ */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Latency tracing: for each received frame, the time elapsed since its
+ * RX timestamp is sampled at a few checkpoints; for each event message
+ * sent, the time from the decision to send to its TX timestamp.
+ * Samples go to per-port, per-message-type log-linear histograms.
+ * Without CONFIG_LATENCY_TRACE all hooks compile to nothing; the same
+ * happens with PPSI_NO_DIAG, for tools that link the protocol code.
+ */
+#ifndef __PPSI_LATENCY_H__
+#define __PPSI_LATENCY_H__
+
+enum pp_lat_stage {
+	PP_LAT_RECV,		/* rx stamp -> state machine called */
+	PP_LAT_PREFILTER,	/* rx stamp -> frame accepted */
+	PP_LAT_HANDLER,		/* rx stamp -> state handler done */
+	PP_LAT_SERVO,		/* rx stamp -> servo updated */
+	PP_LAT_DONE,		/* rx stamp -> state machine done */
+	PP_LAT_TX,		/* decision to send -> tx stamp */
+	PP_LAT_NSTAGES
+};
+
+extern const char * const pp_lat_stage_name[PP_LAT_NSTAGES];
+
+/*
+ * Log-linear buckets: 4 linear sub-buckets for each power of two, so
+ * the relative error is below 25%. Values above 2^27 ns (134ms) are
+ * accounted in the last bucket.
+ */
+#define PP_LAT_SUB_BITS 2
+#define PP_LAT_MAX_BITS 27
+#define PP_LAT_NBUCKETS ((PP_LAT_MAX_BITS - PP_LAT_SUB_BITS + 1) << PP_LAT_SUB_BITS)
+
+struct pp_lat_hist {
+	uint32_t count[PP_LAT_NBUCKETS];
+	uint32_t n;
+	uint32_t max;
+	uint64_t sum;
+};
+
+struct pp_lat_inst {
+	int64_t rx_ns;		/* rx stamp of the current frame, 0 if none */
+	int64_t tx_ns;		/* decision to send, 0 if none */
+	int msgtype;
+	struct pp_lat_hist h[__PP_NR_MESSAGES_TYPES][PP_LAT_NSTAGES];
+};
+
+static inline int pp_lat_bucket(uint32_t v)
+{
+	int shift;
+
+	if (v >= 1U << PP_LAT_MAX_BITS)
+		return PP_LAT_NBUCKETS - 1;
+	if (v < 1 << PP_LAT_SUB_BITS)
+		return v;
+	shift = 31 - __builtin_clz(v) - PP_LAT_SUB_BITS;
+	return ((shift + 1) << PP_LAT_SUB_BITS) + (v >> shift)
+		- (1 << PP_LAT_SUB_BITS);
+}
+
+/* Upper bound (excluded) of a bucket, in ns */
+static inline uint32_t pp_lat_bucket_top(int i)
+{
+	int shift = (i >> PP_LAT_SUB_BITS) - 1;
+	int sub = i & ((1 << PP_LAT_SUB_BITS) - 1);
+
+	if (shift < 0)
+		return i + 1;
+	return (sub + 1 + (1 << PP_LAT_SUB_BITS)) << shift;
+}
+
+static inline void pp_lat_add(struct pp_lat_hist *h, int64_t ns)
+{
+	uint32_t v = ns < 0 ? 0 : ns > UINT32_MAX ? UINT32_MAX : ns;
+
+	h->count[pp_lat_bucket(v)]++;
+	h->n++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+extern struct pp_lat_inst *pp_lat_data; /* one per instance */
+extern uint32_t pp_lat_percentile(struct pp_lat_hist *h, int permille);
+
+#if CONFIG_HAS_LATENCY_TRACE && !defined(PPSI_NO_DIAG)
+extern int64_t pp_lat_now_ns(void);
+extern void pp_lat_rx_begin(struct pp_instance *ppi, int msgtype);
+extern void pp_lat_rx_end(struct pp_instance *ppi);
+extern void pp_lat_tx_end(struct pp_instance *ppi, int msgtype);
+
+static inline struct pp_lat_inst *pp_lat_get(struct pp_instance *ppi)
+{
+	return pp_lat_data + (ppi - GLBS(ppi)->pp_instances);
+}
+
+static inline void pp_lat_mark(struct pp_instance *ppi, int stage)
+{
+	struct pp_lat_inst *l = pp_lat_get(ppi);
+
+	if (l->rx_ns)
+		pp_lat_add(&l->h[l->msgtype][stage],
+			   pp_lat_now_ns() - l->rx_ns);
+}
+
+static inline void pp_lat_tx_begin(struct pp_instance *ppi)
+{
+	pp_lat_get(ppi)->tx_ns = pp_lat_now_ns();
+}
+#else
+static inline void pp_lat_rx_begin(struct pp_instance *ppi, int msgtype) {}
+static inline void pp_lat_rx_end(struct pp_instance *ppi) {}
+static inline void pp_lat_tx_end(struct pp_instance *ppi, int msgtype) {}
+static inline void pp_lat_mark(struct pp_instance *ppi, int stage) {}
+static inline void pp_lat_tx_begin(struct pp_instance *ppi) {}
+#endif
+
+#endif /* __PPSI_LATENCY_H__ */
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Main loop monitor: the lateness of each timer wakeup (the earliest
+ * deadline the loop asked for, against the time the wait returned) and
+ * the duration of each iteration (from the end of a wait to the start
+ * of the next one) go to log-linear histograms, like the latency ones.
+ * Wakeups and iterations over a threshold ("stall-wakeup-us" and
+ * "stall-iteration-us" in the configuration) are recorded in a small
+ * ring, with the instance involved and its state: for a late wakeup the
+ * one whose timeout was due, for a long iteration the one whose state
+ * machine ran longest. Without CONFIG_LOOP_MONITOR the hooks compile to
+ * nothing, and the main loops call pp_state_machine() directly.
+ */
+#ifndef __PPSI_LOOPMON_H__
+#define __PPSI_LOOPMON_H__
+
+enum pp_loop_kind {
+	PP_LOOP_WAKEUP = 0,	/* timer wakeup later than requested */
+	PP_LOOP_ITER,		/* iteration longer than the threshold */
+	PP_LOOP_NKINDS
+};
+
+#define PP_LOOP_NSTALLS 16 /* last ones recorded */
+
+struct pp_loop_stall {
+	int64_t when_ns;	/* CLOCK_MONOTONIC, at detection */
+	uint32_t ns;		/* lateness or duration */
+	uint8_t kind;
+	uint8_t state;		/* state of the instance, at the time */
+	int16_t inst;		/* index of the instance, -1 if none */
+};
+
+struct pp_loopmon {
+	int64_t deadline_ns;	/* earliest wakeup requested, 0 if none */
+	int64_t wait_ns;	/* the wait that requested it */
+	int64_t due_ns;		/* earliest deadline of an instance */
+	int due_inst, due_state;
+	int64_t wake_ns;	/* end of the last wait, 0 if none */
+	uint32_t slow_ns;	/* longest state machine since then */
+	int slow_inst, slow_state;
+	struct pp_lat_hist h[PP_LOOP_NKINDS];
+	uint32_t stalls[PP_LOOP_NKINDS];
+	uint32_t nstalls;	/* ever recorded, the ring is modulo */
+	struct pp_loop_stall stall[PP_LOOP_NSTALLS];
+};
+
+static inline const char *pp_loop_kind_name(int kind)
+{
+	return kind == PP_LOOP_WAKEUP ? "wakeup" : "iteration";
+}
+
+/* Thresholds, in microseconds, 0 to record no stalls of that kind */
+extern int pp_loop_stall_us[PP_LOOP_NKINDS];
+
+/* The arch may move the data elsewhere (wrs: in shared memory) */
+extern struct pp_loopmon *pp_loopmon;
+
+#if CONFIG_HAS_LOOP_MONITOR
+extern void pp_loop_wait(struct pp_globals *ppg, int delay_ms);
+extern void pp_loop_wake(struct pp_globals *ppg);
+extern void pp_loop_timer(struct pp_globals *ppg);
+extern int pp_loop_run(struct pp_instance *ppi, void *buf, int len);
+#else
+static inline void pp_loop_wait(struct pp_globals *ppg, int delay_ms) {}
+static inline void pp_loop_wake(struct pp_globals *ppg) {}
+static inline void pp_loop_timer(struct pp_globals *ppg) {}
+static inline int pp_loop_run(struct pp_instance *ppi, void *buf, int len)
+{
+	return pp_state_machine(ppi, buf, len);
+}
+#endif
+
+#endif /* __PPSI_LOOPMON_H__ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Metrics: per-port counters, servo gauges and histograms. The protocol
+ * code only calls the hooks below; the arch keeps the storage and exports
+ * it (arch-unix serves it in Prometheus text format, see unix-metrics.c).
+ * Hooks never allocate, and compile to nothing without CONFIG_METRICS.
+ */
+#ifndef __PPSI_METRICS_H__
+#define __PPSI_METRICS_H__
+
+/* Reasons for dropping a received frame before the state handler */
+enum pp_drop_reason {
+	PP_DROP_NONE = 0,
+	PP_DROP_RECV,		/* rx error, rx-drop or not for us */
+	PP_DROP_MALFORMED,	/* too short or wrong version */
+	PP_DROP_DOMAIN,		/* 9.5.1 */
+	PP_DROP_ALT_MASTER,	/* 17.4.2 */
+	PP_DROP_LOOP,		/* 9.5.2.2, same port */
+	PP_DROP_OWN_CLOCK,	/* 9.5.2.3, same clock, not an announce */
+	PP_DROP_STATE,		/* INITIALIZING, DISABLED or FAULTY */
+	PP_DROP_COUNT
+};
+
+extern const char * const pp_drop_reason_name[PP_DROP_COUNT];
+
+/* Fixed-bucket histogram: bucket i counts values <= bounds[i] */
+#define PP_HIST_NBOUNDS 25 /* 10ns to 1s, 1-2-5 steps */
+
+struct pp_histogram {
+	uint32_t count[PP_HIST_NBOUNDS + 1]; /* last one is +Inf */
+	uint32_t n;
+	int64_t sum;
+};
+
+extern const int64_t pp_hist_bounds_ns[PP_HIST_NBOUNDS];
+
+static inline void pp_hist_add(struct pp_histogram *h, int64_t v)
+{
+	int i;
+
+	for (i = 0; i < PP_HIST_NBOUNDS && v > pp_hist_bounds_ns[i]; i++)
+		;
+	h->count[i]++;
+	h->n++;
+	h->sum += v;
+}
+
+struct pp_metrics {
+	uint32_t drops[PP_DROP_COUNT];
+	uint32_t timeouts[PP_TO_COUNT];
+	struct pp_histogram ofm;	/* |offsetFromMaster|, ns */
+	struct pp_histogram mean_delay;	/* meanDelay, ns */
+	struct pp_histogram frame_time;	/* frame processing time, ns */
+};
+
+extern struct pp_metrics *pp_metrics; /* one per instance */
+
+#if CONFIG_HAS_METRICS
+extern void pp_metrics_servo(struct pp_instance *ppi);
+
+static inline struct pp_metrics *pp_metrics_get(struct pp_instance *ppi)
+{
+	return pp_metrics + (ppi - GLBS(ppi)->pp_instances);
+}
+
+static inline void pp_metrics_drop(struct pp_instance *ppi, int reason)
+{
+	pp_metrics_get(ppi)->drops[reason]++;
+}
+
+static inline void pp_metrics_timeout(struct pp_instance *ppi, int index)
+{
+	pp_metrics_get(ppi)->timeouts[index]++;
+}
+
+static inline void pp_metrics_frame_time(struct pp_instance *ppi, int64_t ns)
+{
+	pp_hist_add(&pp_metrics_get(ppi)->frame_time, ns);
+}
+#else
+static inline void pp_metrics_servo(struct pp_instance *ppi) {}
+static inline void pp_metrics_drop(struct pp_instance *ppi, int reason) {}
+static inline void pp_metrics_timeout(struct pp_instance *ppi, int index) {}
+static inline void pp_metrics_frame_time(struct pp_instance *ppi, int64_t ns)
+{}
+#endif
+
+#endif /* __PPSI_METRICS_H__ */
@@ -150,6 +150,9 @@ struct pp_servo {
 	uint32_t update_count; /* incremented each time the servo is running */
 	struct pp_time update_time; /* Last updated time of the servo */
 	struct pp_time t1, t2, t3, t4, t5, t6;
+#if CONFIG_HAS_STABILITY
+	struct pp_stability stab; /* MTIE, TDEV, ADEV of offsetFromMaster */
+#endif
 };
 
 enum { /* The two sockets. They are called "net path" for historical reasons */
@@ -214,21 +217,46 @@ typedef enum {
  * Structure for the individual ppsi link
  */
 struct pp_instance {
+	/*
+	 * Hot data: looked at for every instance at each iteration of
+	 * the main loop (state machine, timeouts, descriptors) and when
+	 * the BMC scans all ports. Keep it first and compact.
+	 */
 	int state;
 	int next_state, next_delay, is_new_state; /* set by state processing */
 	const struct pp_state_table_item *current_state_item;
-	void *arch_inst_data;		/* if arch needs it */
-	void *ext_data;			/* if protocol ext needs it */
+	unsigned char flags;		/* protocol flags (see below) */
+	Boolean link_up;
+	Boolean bmca_execute; /* True: Ask fsm to run bmca state decision */
+	Boolean removed; /* by a config reload: the arch keeps it down */
+	pp_pdstate_t pdstate;  /* Protocol detection state */
+	pp_exstate_t extState; /* Extension state */
 	int protocol_extension; /* PPSI_EXT_NONE, PPSI_EXT_WR, PPSI_EXT_L1S */
 	const struct pp_ext_hooks *ext_hooks; /* if protocol ext needs it */
+	void *ext_data;			/* if protocol ext needs it */
 	unsigned long d_flags;		/* diagnostics, ppi-specific flags */
-	unsigned char flags;		/* protocol flags (see below) */
-	int	proto;			/* same as in config file */
-	int delayMechanism;			/* same as in config file */
 
 	/* Pointer to global instance owning this pp_instance*/
 	struct pp_globals *glbs;
 
+	portDS_t *portDS;		 /* page 72 */
+	struct pp_servo *servo;  /* Servo moved from globals because we may have more than one servo : redundancy */
+	int port_idx;
+	UInteger16 frgn_rec_num;
+	Integer16  frgn_rec_best;
+
+	timeOutInstCnt_t tmo_cfg[PP_TO_COUNT];
+
+	/* The net_path used to be allocated separately, but there's no need */
+	struct pp_channel ch[__NR_PP_NP];	/* general and event ch */
+
+	/*
+	 * Data used for each frame received or sent by this instance
+	 */
+	void *arch_inst_data;		/* if arch needs it */
+	int	proto;			/* same as in config file */
+	int delayMechanism;			/* same as in config file */
+
 	/* Operations that may be different in each instance */
 	const struct pp_network_operations *n_ops;
 	const struct pp_time_operations *t_ops;
@@ -240,11 +268,9 @@ struct pp_instance {
 	 */
 	void *__tx_buffer, *__rx_buffer;
 	void *tx_frame, *rx_frame, *tx_ptp, *rx_ptp;
+	int tx_offset, rx_offset;		/* ptp payload vs send/recv */
 
-	/* The net_path used to be allocated separately, but there's no need */
-	struct pp_channel ch[__NR_PP_NP];	/* general and event ch */
 	Integer32 mcast_addr[MECH_MAX_SUPPORTED + 1];	/* only ipv4/udp */
-	int tx_offset, rx_offset;		/* ptp payload vs send/recv */
 	unsigned char peer[6];			/* Our peer's MAC address from last received msg*/
 	unsigned char activePeer[6];	/* Our peer's MAC address we talk with */
 	uint16_t peer_vid;	/* Our peer's VID (for PROTO_VLAN) */
@@ -254,46 +280,45 @@ struct pp_instance {
 	uint64_t syncCF;				/* transp. clocks */
 	struct pp_time last_rcv_time, last_snt_time;	/* two temporaries */
 
-	/* Page 85: each port shall maintain an implementation-specific
-	 * foreignMasterDS data set for the purposes of qualifying Announce
-	 * messages */
-	UInteger16 frgn_rec_num;
-	Integer16  frgn_rec_best;
-	UInteger32 frgn_master_time_window_ms;
-	struct pp_frgn_master frgn_master[PP_NR_FOREIGN_RECORDS];
+	UInteger16 recv_sync_sequence_id;
+	UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]; /* last sent this type */
+	MsgHeader received_ptp_header;
+	Boolean received_dresp; /* Count the number of delay response messages received for a given delay request */
+	Boolean received_dresp_fup; /* Count the number of delay response follow up messages received for a given delay request */
 
-	portDS_t *portDS;		 /* page 72 */
-	struct pp_servo *servo;  /* Servo moved from globals because we may have more than one servo : redundancy */
+	unsigned long ptp_tx_count;
+	unsigned long ptp_rx_count;
 
 	/** (IEEE1588-2019) */
 	asymmetryCorrectionPortDS_t asymmetryCorrectionPortDS; /* 1588-2019 8.2.17 */
 	timestampCorrectionPortDS_t timestampCorrectionPortDS; /* 1588-2019 8.2.16 */
-	externalPortConfigurationPortDS_t  externalPortConfigurationPortDS; /* 1588-2019 8.2.28 */
-	/************************* */
 
-	timeOutInstCnt_t tmo_cfg[PP_TO_COUNT];
-	UInteger16 recv_sync_sequence_id;
+	/*
+	 * Cold data: foreign masters (only used with announce messages),
+	 * names and configuration
+	 */
 
-	UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]; /* last sent this type */
-	MsgHeader received_ptp_header;
+	/* Page 85: each port shall maintain an implementation-specific
+	 * foreignMasterDS data set for the purposes of qualifying Announce
+	 * messages */
+	UInteger32 frgn_master_time_window_ms;
+	struct pp_frgn_master frgn_master[PP_NR_FOREIGN_RECORDS];
+
+	externalPortConfigurationPortDS_t  externalPortConfigurationPortDS; /* 1588-2019 8.2.28 */
+	Boolean ptp_fallback; /* True if allow pure PTP support */
 
-	Boolean link_up;
 	char *iface_name; /* for direct actions on hardware */
 	char *port_name; /* for diagnostics, mainly */
-	int port_idx;
 	int vlans_array_len; /* those looking at shared mem must check */
 	int vlans[CONFIG_VLAN_ARRAY_SIZE];
 	int nvlans; /* according to configuration */
 	struct pp_instance_cfg cfg;
-
-	unsigned long ptp_tx_count;
-	unsigned long ptp_rx_count;
-	Boolean received_dresp; /* Count the number of delay response messages received for a given delay request */
-	Boolean received_dresp_fup; /* Count the number of delay response follow up messages received for a given delay request */
-	Boolean ptp_fallback; /* True if allow pure PTP support */
-	Boolean bmca_execute; /* True: Ask fsm to run bmca state decision */
-	pp_pdstate_t pdstate;  /* Protocol detection state */
-	pp_exstate_t extState; /* Extension state */
+#if CONFIG_HAS_FSM_PROFILE
+	struct pp_prof prof; /* time spent in handlers and hooks */
+#endif
+#if CONFIG_HAS_FLIGHT_RECORDER
+	struct pp_frec frec; /* last frames, transitions and events */
+#endif
 };
 
 /* The following things used to be bit fields. Other flags are now enums */
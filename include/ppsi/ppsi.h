@@ -19,6 +19,9 @@
 #include <ppsi/constants.h>
 #include <ppsi/jiffies.h>
 #include <ppsi/timeout_def.h>
+#include <ppsi/stability.h>
+#include <ppsi/profile.h>
+#include <ppsi/flightrec.h>
 #include <ppsi/pp-instance.h>
 #include <ppsi/diag-macros.h>
 #include <ppsi/bmc.h>
@@ -304,6 +307,10 @@ extern const struct pp_time_operations unix_time_ops;
 /* The channel for an instance must be created and possibly destroyed. */
 extern int pp_init_globals(struct pp_globals *ppg, struct pp_runtime_opts *opts);
 extern int pp_close_globals(struct pp_globals *ppg);
+extern int pp_open_instance(struct pp_globals *ppg, struct pp_instance *ppi);
+
+/* Hosted archs may add instances when max_links are in use */
+extern int pp_grow_instances(struct pp_globals *ppg);
 
 extern int pp_parse_cmdline(struct pp_globals *ppg, int argc, char **argv);
 
@@ -459,6 +466,10 @@ extern void pdstate_enable_extension(struct pp_instance * ppi);
 #include <ppsi/faults.h>
 #include <ppsi/timeout_prot.h>
 #include <ppsi/conf.h>
+#include <ppsi/metrics.h>
+#include <ppsi/latency.h>
+#include <ppsi/loopmon.h>
+#include <ppsi/trace.h>
 
 
 #endif /* __PPSI_PPSI_H__ */
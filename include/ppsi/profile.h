@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Time accounting of the state machine: for each instance, the number
+ * of calls and the min, average and max duration of each state handler,
+ * of each extension hook and of a whole state machine run by message
+ * type received (or by timer, when no frame came). The data lives in
+ * struct pp_instance, so wrs exports it in shared memory; the readers
+ * below are inline for the tools. Without CONFIG_FSM_PROFILE nothing is
+ * compiled in; the same happens with PPSI_NO_DIAG, for tools that link
+ * the protocol code.
+ */
+#ifndef __PPSI_PROFILE_H__
+#define __PPSI_PROFILE_H__
+
+enum pp_prof_hook {
+	PP_PROF_STATE_CHANGE = 0,
+	PP_PROF_RUN_EXT_SM,
+	PP_PROF_STATE_DECISION,
+	PP_PROF_HANDLE_ANNOUNCE,
+	PP_PROF_HANDLE_SIGNALING,
+	PP_PROF_HANDLE_PRESP,
+	PP_PROF_HANDLE_PREQ,
+	PP_PROF_PACK_ANNOUNCE,
+	PP_PROF_UNPACK_ANNOUNCE,
+	PP_PROF_HANDLE_DREQ,
+	PP_PROF_HANDLE_SYNC,
+	PP_PROF_HANDLE_FOLLOWUP,
+	PP_PROF_HANDLE_RESP,
+	PP_PROF_NEW_SLAVE,
+	PP_PROF_LISTENING,
+	PP_PROF_NHOOKS
+};
+
+/* Durations are in ns; sum is 64 bits, so it does not wrap in practice */
+struct pp_prof_stat {
+	uint32_t n;
+	uint32_t min, max;
+	uint64_t sum;
+};
+
+struct pp_prof {
+	uint32_t runs;		/* of the state machine, all kinds */
+	struct pp_prof_stat state[PPS_LAST_STATE];	/* handlers */
+	struct pp_prof_stat msg[__PP_NR_MESSAGES_TYPES]; /* runs, by frame */
+	struct pp_prof_stat timer;	/* runs without a frame */
+	struct pp_prof_stat hook[PP_PROF_NHOOKS];
+};
+
+static inline const char *pp_prof_hook_name(int hook)
+{
+	static const char * const names[PP_PROF_NHOOKS] = {
+		[PP_PROF_STATE_CHANGE] = "state_change",
+		[PP_PROF_RUN_EXT_SM] = "run_ext_state_machine",
+		[PP_PROF_STATE_DECISION] = "state_decision",
+		[PP_PROF_HANDLE_ANNOUNCE] = "handle_announce",
+		[PP_PROF_HANDLE_SIGNALING] = "handle_signaling",
+		[PP_PROF_HANDLE_PRESP] = "handle_presp",
+		[PP_PROF_HANDLE_PREQ] = "handle_preq",
+		[PP_PROF_PACK_ANNOUNCE] = "pack_announce",
+		[PP_PROF_UNPACK_ANNOUNCE] = "unpack_announce",
+		[PP_PROF_HANDLE_DREQ] = "handle_dreq",
+		[PP_PROF_HANDLE_SYNC] = "handle_sync",
+		[PP_PROF_HANDLE_FOLLOWUP] = "handle_followup",
+		[PP_PROF_HANDLE_RESP] = "handle_resp",
+		[PP_PROF_NEW_SLAVE] = "new_slave",
+		[PP_PROF_LISTENING] = "listening",
+	};
+
+	return hook >= 0 && hook < PP_PROF_NHOOKS ? names[hook] : "unknown";
+}
+
+static inline uint32_t pp_prof_avg(struct pp_prof_stat *s)
+{
+	return s->n ? s->sum / s->n : 0;
+}
+
+static inline void pp_prof_add(struct pp_prof_stat *s, int64_t ns)
+{
+	uint32_t v = ns < 0 ? 0 : ns > UINT32_MAX ? UINT32_MAX : ns;
+
+	if (!s->n || v < s->min)
+		s->min = v;
+	if (v > s->max)
+		s->max = v;
+	s->n++;
+	s->sum += v;
+}
+
+struct pp_instance;
+#if CONFIG_HAS_FSM_PROFILE && !defined(PPSI_NO_DIAG)
+extern int64_t pp_prof_now_ns(void);
+extern void pp_prof_state(struct pp_instance *ppi, int state, int64_t t0);
+extern void pp_prof_hook(struct pp_instance *ppi, int hook, int64_t t0);
+extern void pp_prof_run(struct pp_instance *ppi, void *buf, int len,
+			int64_t t0);
+
+static inline int64_t pp_prof_begin(void)
+{
+	return pp_prof_now_ns();
+}
+
+struct pp_prof_scope {
+	struct pp_instance *ppi;
+	int hook;
+	int64_t t0;
+};
+
+static inline void pp_prof_scope_end(struct pp_prof_scope *s)
+{
+	pp_prof_hook(s->ppi, s->hook, s->t0);
+}
+
+/* Time a call of an extension hook; the value is the one of the call */
+#define PP_PROF_HOOK(ppi, hook, call)					\
+	({								\
+		struct pp_prof_scope __prof				\
+			__attribute__((cleanup(pp_prof_scope_end))) =	\
+			{(ppi), (hook), pp_prof_begin()};		\
+		call;							\
+	})
+#else
+#define PP_PROF_HOOK(ppi, hook, call) (call)
+
+static inline int64_t pp_prof_begin(void) {return 0;}
+static inline void pp_prof_run(struct pp_instance *ppi, void *buf, int len,
+			       int64_t t0) {}
+static inline void pp_prof_state(struct pp_instance *ppi, int state,
+				 int64_t t0) {}
+static inline void pp_prof_hook(struct pp_instance *ppi, int hook,
+				int64_t t0) {}
+#endif
+
+#endif /* __PPSI_PROFILE_H__ */
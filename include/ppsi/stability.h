@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Stability of offsetFromMaster, estimated online at each servo update:
+ * MTIE over a few observation windows, TDEV and ADEV at octave multiples
+ * of the sample interval. Memory is fixed and each sample costs the same,
+ * whatever the windows. The data lives at the end of struct pp_servo, so
+ * it is reset with the servo and wrs exports it in shared memory. The
+ * readers below are inline for the tools that look at the shmem.
+ */
+#ifndef __PPSI_STABILITY_H__
+#define __PPSI_STABILITY_H__
+
+#define PP_STAB_NWIN	8	/* MTIE observation windows */
+#define PP_STAB_NBLK	16	/* blocks in a window, the MTIE granularity */
+#define PP_STAB_NTAU	12	/* TDEV and ADEV: tau is 2^i samples */
+
+/*
+ * MTIE: samples are grouped in blocks of 1/16 of the window, and the
+ * min and max of complete blocks go to two monotonic deques. The range
+ * of the last 16 blocks is thus known in O(1) amortized time.
+ */
+struct pp_stab_ext {
+	int64_t v;		/* min or max of a block, ps */
+	uint32_t blk;
+};
+
+struct pp_stab_mtie {
+	int64_t win_ns;			/* 0: unused */
+	int64_t blk_end_ns;		/* end of the current block */
+	uint32_t blk;			/* index of the current block */
+	uint32_t cur_n;			/* samples in the current block */
+	int64_t min, max;		/* of the current block */
+	struct pp_stab_ext qmax[PP_STAB_NBLK], qmin[PP_STAB_NBLK];
+	uint8_t hmax, nmax, hmin, nmin;	/* head and length of each deque */
+	uint32_t n_windows;		/* complete windows seen */
+	int64_t mtie_ps;
+};
+
+/*
+ * TDEV and ADEV use non-overlapping blocks of 2^i samples: the second
+ * difference of block means gives TVAR, that of the first sample of each
+ * block gives AVAR. Only sums of squares are kept.
+ */
+struct pp_stab_tau {
+	int64_t sum, first;		/* current block, ps */
+	uint32_t count;
+	uint32_t nblk;			/* previous blocks, up to 2 */
+	int64_t mean[2], point[2];	/* of the previous blocks */
+	uint32_t n;			/* second differences */
+	double tvar, avar;		/* sums of their squares, ps^2 */
+};
+
+struct pp_stability {
+	uint32_t n;			/* samples */
+	int64_t first_ns, last_ns;	/* servo time of first and last one */
+	struct pp_stab_mtie mtie[PP_STAB_NWIN];
+	struct pp_stab_tau tau[PP_STAB_NTAU];
+};
+
+/* Readers: no libm in ppsi, so the square root is on integers */
+static inline uint64_t pp_stab_isqrt(double d)
+{
+	uint64_t v, r = 0, b = 1ULL << 62;
+
+	v = d >= 18e18 ? 18000000000000000000ULL : d > 0 ? d : 0;
+	while (b > v)
+		b >>= 2;
+	for (; b; b >>= 2) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+	}
+	return r;
+}
+
+/* The mean interval between samples, the tau of index 0 */
+static inline int64_t pp_stab_tau0_ns(const struct pp_stability *s)
+{
+	return s->n > 1 ? (s->last_ns - s->first_ns) / (s->n - 1) : 0;
+}
+
+/* MTIE, in ps, or -1 if no window is complete */
+static inline int64_t pp_stab_mtie_ps(const struct pp_stability *s, int i)
+{
+	return s->mtie[i].n_windows ? s->mtie[i].mtie_ps : -1;
+}
+
+/* TDEV, in ps, or -1 */
+static inline int64_t pp_stab_tdev_ps(const struct pp_stability *s, int i)
+{
+	const struct pp_stab_tau *t = s->tau + i;
+
+	return t->n ? pp_stab_isqrt(t->tvar / 6 / t->n) : -1;
+}
+
+/* ADEV, or -1 */
+static inline double pp_stab_adev(const struct pp_stability *s, int i)
+{
+	const struct pp_stab_tau *t = s->tau + i;
+	double tau_ps = pp_stab_tau0_ns(s) * 1000.0 * (1 << i);
+
+	if (!t->n || tau_ps <= 0)
+		return -1;
+	return pp_stab_isqrt(t->avar / 2 / t->n) / tau_ps;
+}
+
+/* Observation windows, in seconds, set by "mtie-windows" */
+extern int pp_stab_windows_s[PP_STAB_NWIN];
+
+struct pp_instance;
+#if CONFIG_HAS_STABILITY
+extern void pp_stab_servo(struct pp_instance *ppi);
+#else
+static inline void pp_stab_servo(struct pp_instance *ppi) {}
+#endif
+
+#endif /* __PPSI_STABILITY_H__ */
@@ -24,6 +24,7 @@ extern int pp_next_delay_3(struct pp_instance *ppi, int i1, int i2, int i3);
 extern int pp_timeout_get_timer(struct pp_instance *ppi, int index, to_rand_t rand);
 extern void pp_timeout_set_rename(struct pp_instance *ppi, int index, int millisec);
 extern void pp_timeout_disable_all(struct pp_instance *ppi);
+extern const char *pp_timeout_name(int index);
 
 
 /*
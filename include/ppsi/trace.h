@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Trace of a live session: the frames received and sent by each port,
+ * with their time stamps, and the calls to the time operations. The
+ * recorder wraps the network and time operations of each instance;
+ * arch-replay reads the trace back. Records are in host byte order,
+ * each followed by its data, padded to 8 bytes.
+ * Without CONFIG_TRACE the hooks compile to nothing.
+ */
+#ifndef __PPSI_TRACE_H__
+#define __PPSI_TRACE_H__
+
+#define PP_TRACE_MAGIC		0x52545050 /* "PPTR" in little endian */
+#define PP_TRACE_VERSION	1
+#define PP_TRACE_PATH_LEN	256
+
+enum pp_trace_type {
+	PP_TRACE_HEADER = 1,	/* a: magic, b: version */
+	PP_TRACE_PORT,		/* a: proto; data: mac address, port name */
+	PP_TRACE_RX,		/* a, b: stamp; data: PTP message */
+	PP_TRACE_TX,		/* a, b: stamp; data: PTP message */
+	PP_TRACE_GET,		/* a, b: time */
+	PP_TRACE_SET,		/* a, b: time */
+	PP_TRACE_ADJ,		/* a: offset_ns, b: freq_ppb, as flags say */
+	PP_TRACE_INIT_SERVO,	/* a: the frequency returned */
+};
+
+#define PP_TRACE_ADJ_OFFSET	1
+#define PP_TRACE_ADJ_FREQ	2
+
+struct pp_trace_rec {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t port;		/* index of the instance */
+	uint16_t len;		/* of the data that follows */
+	uint16_t reserved;
+	int64_t mono_ns;	/* CLOCK_MONOTONIC when recorded */
+	int64_t a, b;		/* a pp_time is secs and scaled_nsecs */
+};
+
+static inline int pp_trace_rec_size(const struct pp_trace_rec *r)
+{
+	return sizeof(*r) + ((r->len + 7) & ~7);
+}
+
+#if CONFIG_HAS_TRACE
+extern char pp_trace_file[PP_TRACE_PATH_LEN];
+extern int pp_trace_open(struct pp_globals *ppg);
+extern void pp_trace_attach(struct pp_instance *ppi);
+#else
+static inline int pp_trace_open(struct pp_globals *ppg)
+{
+	return 0;
+}
+static inline void pp_trace_attach(struct pp_instance *ppi) {}
+#endif
+
+#endif /* __PPSI_TRACE_H__ */
@@ -36,7 +36,8 @@ static int f_port(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 			return 0;
 	}
 	/* check if there are still some free pp_instances to be used */
-	if (ppg->nlinks >= ppg->max_links) {
+	if (ppg->nlinks >= ppg->max_links &&
+	    (!CONFIG_HAS_DYNAMIC_INSTANCES || pp_grow_instances(ppg) < 0)) {
 		pp_printf("config line %i: out of available ports\n",
 			  lineno);
 		/* we are out of available ports. set cur_ppi_n to -1 so if
@@ -55,6 +56,14 @@ static int f_port(struct pp_argline *l, int lineno, struct pp_globals *ppg,
 	return 0;
 }
 
+/* Where the field of a simple option lives */
+static inline void *cfg_dest(struct pp_argline *l, struct pp_globals *ppg)
+{
+	if (l->needs_port)
+		return CUR_PPI(ppg);
+	return l->in_globals ? (void *)ppg : (void *)GOPTS(ppg);
+}
+
 #define CHECK_PPI(need) /* Quick hack to factorize errors later */ 	\
 	({if (need && !CUR_PPI(ppg)) {		\
 		pp_printf("config line %i: no port for this config\n", lineno);\
@@ -70,7 +79,7 @@ static inline void ASSIGN_INT_FIELD(struct pp_argline *l,
 				    struct pp_globals *ppg,
 					int v)
 {
-	void *dest=(l->needs_port) ? (void *)CUR_PPI(ppg) : (void *) GOPTS(ppg);
+	void *dest = cfg_dest(l, ppg);
 
 	/* Check min/max */
 	if ( v<l->min_max.min.min_int || v>l->min_max.max.max_int) {
@@ -92,7 +101,7 @@ static inline void ASSIGN_INT64_FIELD(struct pp_argline *l,
 				    struct pp_globals *ppg,
 				    int64_t v)
 {
-	void *dest=(l->needs_port) ? (void *)CUR_PPI(ppg) : (void *) GOPTS(ppg);
+	void *dest = cfg_dest(l, ppg);
 
 	/* Check min/max */
 	if ( v<l->min_max.min.min_int64 || v>l->min_max.max.max_int64 ) {
@@ -114,7 +123,7 @@ static inline void ASSIGN_DOUBLE_FIELD(struct pp_argline *l,
 				    struct pp_globals *ppg,
 				    double v)
 {
-	void *dest=(l->needs_port) ? (void *)CUR_PPI(ppg) : (void *) GOPTS(ppg);
+	void *dest = cfg_dest(l, ppg);
 
 	/* Check min/max */
 	if ( v<l->min_max.min.min_double || v>l->min_max.max.max_double ) {
@@ -136,7 +145,7 @@ static inline void ASSIGN_BOOL_FIELD(struct pp_argline *l,
 				    struct pp_globals *ppg,
 				    Boolean v)
 {
-	void *dest=(l->needs_port) ? (void *)CUR_PPI(ppg) : (void *) GOPTS(ppg);
+	void *dest = cfg_dest(l, ppg);
 
 	*(Boolean *)( dest + l->field_offset) = v;
 }
@@ -154,7 +163,7 @@ static inline void ASSIGN_STRING_FIELD(struct pp_argline *l,
 				    struct pp_globals *ppg,
 				    char *src)
 {
-	void *dest=(l->needs_port) ? (void *)CUR_PPI(ppg) : (void *) GOPTS(ppg);
+	void *dest = cfg_dest(l, ppg);
 
 	strcpy((char *)dest+l->field_offset, src);
 }
@@ -256,6 +265,58 @@ static int f_servo_pi(struct pp_argline *l, int lineno,
 	return 0;
 }
 
+#if CONFIG_HAS_STABILITY
+/* "mtie-windows 1 10 100": up to PP_STAB_NWIN windows, in seconds */
+static int f_mtie_windows(struct pp_argline *l, int lineno,
+			  struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	int w[PP_STAB_NWIN] = {0,};
+	char *s = arg->s;
+	int i, n = 0;
+
+	CHECK_PPI(0);
+	while (*s) {
+		if (*s == ' ' || *s == '\t' || *s == ',') {
+			s++;
+			continue;
+		}
+		if (n == PP_STAB_NWIN || *s < '0' || *s > '9') {
+			pp_printf("config line %i: at most %i windows, "
+				  "in seconds\n", lineno, PP_STAB_NWIN);
+			return -1;
+		}
+		for (; *s >= '0' && *s <= '9'; s++)
+			w[n] = w[n] * 10 + *s - '0';
+		if (!w[n]) {
+			pp_printf("config line %i: null window\n", lineno);
+			return -1;
+		}
+		n++;
+	}
+	for (i = 0; i < PP_STAB_NWIN; i++)
+		pp_stab_windows_s[i] = w[i];
+	return 0;
+}
+#endif
+
+#if CONFIG_HAS_LOOP_MONITOR
+/* "stall-wakeup-us" and "stall-iteration-us": 0 records no stalls */
+static int f_stall_us(struct pp_argline *l, int lineno,
+		      struct pp_globals *ppg, union pp_cfg_arg *arg)
+{
+	CHECK_PPI(0);
+	if (arg->i < 0) {
+		pp_printf("config line %i: negative threshold\n", lineno);
+		return -1;
+	}
+	if (!strcmp(l->keyword, "stall-wakeup-us"))
+		pp_loop_stall_us[PP_LOOP_WAKEUP] = arg->i;
+	else
+		pp_loop_stall_us[PP_LOOP_ITER] = arg->i;
+	return 0;
+}
+#endif
+
 /* These are the tables for the parser */
 static struct pp_argname arg_proto[] = {
 	{"raw", PPSI_PROTO_RAW},
@@ -397,6 +458,13 @@ static struct pp_argline pp_global_arglines[] = {
 #endif
 	RT_OPTION_BOOL("forcePpsGen",forcePpsGen),
 	RT_OPTION_BOOL("ptpFallbackPpsGen",ptpFallbackPpsGen),
+#if CONFIG_HAS_STABILITY
+	LEGACY_OPTION(f_mtie_windows, "mtie-windows", ARG_STR),
+#endif
+#if CONFIG_HAS_LOOP_MONITOR
+	LEGACY_OPTION(f_stall_us, "stall-wakeup-us", ARG_INT),
+	LEGACY_OPTION(f_stall_us, "stall-iteration-us", ARG_INT),
+#endif
 	{}
 };
 
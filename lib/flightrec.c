@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Flight recorder (see <ppsi/flightrec.h>). Hosted architectures only:
+ * entries are stamped with CLOCK_MONOTONIC, and dumps go to a file. A
+ * record is a few stores in the ring of the instance, so it is always
+ * on; the file is only written when a dump is asked for.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <ppsi/ppsi.h>
+
+char pp_frec_file[PP_FREC_PATH_LEN] = CONFIG_FLIGHT_RECORDER_FILE;
+
+static volatile sig_atomic_t frec_signal;
+
+static int64_t frec_now_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct pp_frec_entry *frec_new(struct pp_instance *ppi, int type,
+				      int code, int seq)
+{
+	struct pp_frec_entry *e = &ppi->frec.e[ppi->frec.n++ % PP_FREC_LEN];
+
+	memset(e, 0, sizeof(*e));
+	e->mono_ns = frec_now_ns(CLOCK_MONOTONIC);
+	e->type = type;
+	e->code = code;
+	e->seq = seq;
+	return e;
+}
+
+static void frec_stamp(struct pp_frec_entry *e, struct pp_time *t)
+{
+	e->a = t->secs;
+	e->b = t->scaled_nsecs;
+}
+
+void pp_frec_rx(struct pp_instance *ppi, int drop)
+{
+	MsgHeader *hdr = &ppi->received_ptp_header;
+	struct pp_frec_entry *e;
+
+	e = frec_new(ppi, PP_FREC_RX, hdr->messageType, hdr->sequenceId);
+	e->id = hdr->sourcePortIdentity.clockIdentity;
+	e->port = hdr->sourcePortIdentity.portNumber;
+	e->flags = drop;
+	frec_stamp(e, &ppi->last_rcv_time);
+}
+
+/* Called after the frame is sent: the header is still in the buffer */
+void pp_frec_tx(struct pp_instance *ppi, int msgtype, int flags)
+{
+	void *hdr = ppi->tx_ptp;
+	struct pp_frec_entry *e;
+
+	e = frec_new(ppi, PP_FREC_TX, msgtype,
+		     ntohs(*(UInteger16 *)(hdr + 30)));
+	/* For responses, the port we answer: requestingPortIdentity */
+	if (msgtype == PPM_DELAY_RESP || msgtype == PPM_PDELAY_RESP ||
+	    msgtype == PPM_PDELAY_R_FUP) {
+		memcpy(&e->id, hdr + 44, sizeof(e->id));
+		e->port = ntohs(*(UInteger16 *)(hdr + 52));
+	}
+	e->flags = flags;
+	frec_stamp(e, &ppi->last_snt_time);
+}
+
+void pp_frec_state(struct pp_instance *ppi, int old, int new)
+{
+	frec_new(ppi, PP_FREC_STATE, new, old);
+	if (new == PPS_FAULTY && old != PPS_FAULTY)
+		pp_frec_dump(GLBS(ppi), ppi, PP_FREC_DUMP_FAULTY);
+}
+
+/* The BMC runs every announce interval: only record what it changed */
+void pp_frec_bmc(struct pp_instance *ppi, int decision)
+{
+	struct pp_frec *f = &ppi->frec;
+	struct pp_frec_entry *e, cur;
+	PortIdentity *id;
+
+	memset(&cur, 0, sizeof(cur));
+	cur.code = decision;
+	cur.flags = GLBS(ppi)->ebest_idx;
+	if (ppi->frgn_rec_best >= 0) {
+		id = &ppi->frgn_master[ppi->frgn_rec_best].sourcePortIdentity;
+		cur.id = id->clockIdentity;
+		cur.port = id->portNumber;
+	}
+	if (f->bmc_last && f->n - f->bmc_last < PP_FREC_LEN) {
+		e = &f->e[(f->bmc_last - 1) % PP_FREC_LEN];
+		if (e->code == cur.code && e->flags == cur.flags &&
+		    e->port == cur.port &&
+		    !memcmp(&e->id, &cur.id, sizeof(cur.id)))
+			return;
+	}
+	e = frec_new(ppi, PP_FREC_BMC, decision, ppi->state);
+	e->id = cur.id;
+	e->port = cur.port;
+	e->flags = cur.flags;
+	f->bmc_last = f->n;
+}
+
+/* Offset and mean delay in ns; after an init, the drift in ppb */
+void pp_frec_servo(struct pp_instance *ppi, int event, struct pp_time *ofm,
+		   struct pp_time *mpd)
+{
+	struct pp_frec_entry *e = frec_new(ppi, PP_FREC_SERVO, event, 0);
+
+	if (event == PP_FREC_SERVO_INIT)
+		e->a = SRV(ppi)->obs_drift >> 10;
+	if (ofm)
+		e->a = pp_time_to_picos(ofm) / 1000;
+	if (mpd)
+		e->b = pp_time_to_picos(mpd) / 1000;
+}
+
+static int frec_write_port(FILE *f, struct pp_instance *ppi)
+{
+	struct pp_frec *r = &ppi->frec;
+	struct pp_frec_port p;
+	uint32_t first, i;
+
+	memset(&p, 0, sizeof(p));
+	strncpy(p.name, ppi->port_name, sizeof(p.name) - 1);
+	p.n = r->n;
+	p.count = r->n < PP_FREC_LEN ? r->n : PP_FREC_LEN;
+	if (fwrite(&p, sizeof(p), 1, f) != 1)
+		return -1;
+	/* Oldest first: the ring may wrap once in the middle */
+	first = r->n - p.count;
+	for (i = first; i < r->n; ) {
+		uint32_t pos = i % PP_FREC_LEN;
+		uint32_t len = PP_FREC_LEN - pos;
+
+		if (len > r->n - i)
+			len = r->n - i;
+		if (fwrite(r->e + pos, sizeof(r->e[0]), len, f) != len)
+			return -1;
+		i += len;
+	}
+	return 0;
+}
+
+/* Append a dump of one port, or all of them, to the file */
+int pp_frec_dump(struct pp_globals *ppg, struct pp_instance *ppi, int reason)
+{
+	char old[PP_FREC_PATH_LEN + 8];
+	struct pp_frec_file h;
+	struct stat st;
+	FILE *f;
+	int i, ret = 0;
+
+	if (!pp_frec_file[0])
+		return 0;
+	/* Keep the size bounded: one older file, like log rotation */
+	if (stat(pp_frec_file, &st) == 0 && st.st_size >= PP_FREC_MAX_FILE) {
+		sprintf(old, "%s.old", pp_frec_file);
+		rename(pp_frec_file, old);
+	}
+	f = fopen(pp_frec_file, "a");
+	if (!f) {
+		pp_error("%s: %s: %s\n", __func__, pp_frec_file,
+			 strerror(errno));
+		return -1;
+	}
+	memset(&h, 0, sizeof(h));
+	h.magic = PP_FREC_MAGIC;
+	h.version = PP_FREC_VERSION;
+	h.entry_size = sizeof(struct pp_frec_entry);
+	h.reason = reason;
+	h.inst = ppi ? ppi - ppg->pp_instances : -1;
+	h.nports = ppi ? 1 : ppg->nlinks;
+	h.mono_ns = frec_now_ns(CLOCK_MONOTONIC);
+	h.real_ns = frec_now_ns(CLOCK_REALTIME);
+	if (fwrite(&h, sizeof(h), 1, f) != 1)
+		ret = -1;
+	for (i = 0; !ret && i < h.nports; i++)
+		ret = frec_write_port(f, ppi ? ppi : INST(ppg, i));
+	if (fclose(f) != 0 || ret < 0) {
+		pp_error("%s: %s: %s\n", __func__, pp_frec_file,
+			 strerror(errno));
+		return -1;
+	}
+	pp_diag(ppi, fsm, 1, "flight recorder: %s dump to %s\n",
+		pp_frec_reason_name(reason), pp_frec_file);
+	return 0;
+}
+
+static void frec_sigusr1(int sig)
+{
+	frec_signal = 1;
+}
+
+void pp_frec_init(struct pp_globals *ppg)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = frec_sigusr1;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+}
+
+/*
+ * Called by the main loop: the signal handler only sets a flag. Returns
+ * 1 after a dump, as the signal may have cut short the wait
+ */
+int pp_frec_poll(struct pp_globals *ppg)
+{
+	if (!frec_signal)
+		return 0;
+	frec_signal = 0;
+	pp_frec_dump(ppg, NULL, PP_FREC_DUMP_SIGNAL);
+	return 1;
+}
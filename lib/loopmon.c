@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Main loop monitor (see <ppsi/loopmon.h>). Hosted architectures only:
+ * times come from CLOCK_MONOTONIC, like the timeouts of the main loops.
+ */
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+
+int pp_loop_stall_us[PP_LOOP_NKINDS] = {
+	[PP_LOOP_WAKEUP] = 2000,
+	[PP_LOOP_ITER] = 10000,
+};
+
+static struct pp_loopmon loop_data = {
+	.due_inst = -1,
+	.slow_inst = -1,
+};
+struct pp_loopmon *pp_loopmon = &loop_data;
+
+static int64_t loop_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void loop_account(struct pp_globals *ppg, int kind, int64_t ns,
+			 int64_t slack, int inst, int state, int64_t now)
+{
+	struct pp_loopmon *m = pp_loopmon;
+	struct pp_instance *ppi = NULL;
+	struct pp_loop_stall *s;
+
+	pp_lat_add(&m->h[kind], ns);
+	if (!pp_loop_stall_us[kind] ||
+	    ns <= pp_loop_stall_us[kind] * 1000LL + slack)
+		return;
+
+	s = m->stall + m->nstalls++ % PP_LOOP_NSTALLS;
+	s->when_ns = now;
+	s->ns = ns > UINT32_MAX ? UINT32_MAX : ns;
+	s->kind = kind;
+	s->inst = inst;
+	s->state = state;
+	m->stalls[kind]++;
+
+	if (inst >= 0 && inst < ppg->nlinks)
+		ppi = INST(ppg, inst);
+	pp_diag(ppi, fsm, 1, "stall: %s of %lli us, %s\n",
+		pp_loop_kind_name(kind), (long long)ns / 1000,
+		ppi ? get_state_as_string(ppi, state) : "no instance");
+}
+
+/* Before waiting: close the iteration, and note the requested wakeup */
+void pp_loop_wait(struct pp_globals *ppg, int delay_ms)
+{
+	struct pp_loopmon *m = pp_loopmon;
+	int64_t now = loop_now_ns(), t;
+
+	if (m->wake_ns) {
+		loop_account(ppg, PP_LOOP_ITER, now - m->wake_ns, 0,
+			     m->slow_inst, m->slow_state, now);
+		m->wake_ns = 0;
+	}
+	/* A negative delay keeps the current timeout, as check_packet does */
+	if (delay_ms < 0)
+		return;
+	t = now + delay_ms * 1000000LL;
+	if (!m->deadline_ns || t < m->deadline_ns) {
+		m->deadline_ns = t;
+		m->wait_ns = delay_ms * 1000000LL;
+	}
+}
+
+/* After waiting: a new iteration starts */
+void pp_loop_wake(struct pp_globals *ppg)
+{
+	struct pp_loopmon *m = pp_loopmon;
+
+	m->wake_ns = loop_now_ns();
+	m->slow_ns = 0;
+	m->slow_inst = -1;
+}
+
+/* The state machines run for the timeout: how late are we? */
+void pp_loop_timer(struct pp_globals *ppg)
+{
+	struct pp_loopmon *m = pp_loopmon;
+	int64_t now = loop_now_ns();
+
+	if (!m->deadline_ns)
+		return;
+	/*
+	 * Run early, e.g. by a signal: nothing to account. Otherwise, for
+	 * the stall log, allow the slack Linux gives itself on select()
+	 * timeouts of non-realtime tasks: 0.1% of the wait.
+	 */
+	if (now >= m->deadline_ns)
+		loop_account(ppg, PP_LOOP_WAKEUP, now - m->deadline_ns,
+			     m->wait_ns / 1000, m->due_inst, m->due_state,
+			     now);
+	m->deadline_ns = 0;
+	m->due_ns = 0;
+	m->due_inst = -1;
+}
+
+/* Run one state machine, noting the slowest and the first one due */
+int pp_loop_run(struct pp_instance *ppi, void *buf, int len)
+{
+	struct pp_loopmon *m = pp_loopmon;
+	int inst = ppi - GLBS(ppi)->pp_instances;
+	int state = ppi->state;
+	int64_t t0 = loop_now_ns(), t1;
+	int ret = pp_state_machine(ppi, buf, len);
+
+	t1 = loop_now_ns();
+	if (t1 - t0 > m->slow_ns) {
+		m->slow_ns = t1 - t0;
+		m->slow_inst = inst;
+		m->slow_state = state;
+	}
+	t1 += ret * 1000000LL;
+	if (!m->due_ns || t1 < m->due_ns) {
+		m->due_ns = t1;
+		m->due_inst = inst;
+		m->due_state = ppi->state;
+	}
+	return ret;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Time accounting of the state machine (see <ppsi/profile.h>). Hosted
+ * architectures only: durations come from CLOCK_MONOTONIC, which is not
+ * affected by the adjustments ppsi itself makes to the system clock.
+ */
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+
+/* Print a summary every that many runs of the state machine */
+#define PROF_DIAG_PERIOD 4096
+
+int64_t pp_prof_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void pp_prof_state(struct pp_instance *ppi, int state, int64_t t0)
+{
+	if (state >= 0 && state < PPS_LAST_STATE)
+		pp_prof_add(&ppi->prof.state[state], pp_prof_now_ns() - t0);
+}
+
+void pp_prof_hook(struct pp_instance *ppi, int hook, int64_t t0)
+{
+	pp_prof_add(&ppi->prof.hook[hook], pp_prof_now_ns() - t0);
+}
+
+static void prof_diag(struct pp_instance *ppi, const char *kind,
+		      const char *name, struct pp_prof_stat *s)
+{
+	if (!s->n)
+		return;
+	pp_diag(ppi, fsm, 2, "prof %s %s: %u calls, min %u avg %u max %u ns\n",
+		kind, name, s->n, s->min, pp_prof_avg(s), s->max);
+}
+
+/* Called at the end of each run: buf and len are those of the caller */
+void pp_prof_run(struct pp_instance *ppi, void *buf, int len, int64_t t0)
+{
+	struct pp_prof *p = &ppi->prof;
+	int i, type = -1;
+
+	if (len >= PP_HEADER_LENGTH)
+		type = *(UInteger8 *)buf & 0x0f;
+	pp_prof_add(type >= 0 && type < __PP_NR_MESSAGES_TYPES ?
+		    &p->msg[type] : &p->timer, pp_prof_now_ns() - t0);
+
+	if (++p->runs % PROF_DIAG_PERIOD || !pp_diag_allow(ppi, fsm, 2))
+		return;
+	for (i = 0; i < PPS_LAST_STATE; i++)
+		prof_diag(ppi, "state", pp_state_table[i].name, &p->state[i]);
+	for (i = 0; i < __PP_NR_MESSAGES_TYPES; i++)
+		prof_diag(ppi, "msg", pp_msgtype_name[i], &p->msg[i]);
+	prof_diag(ppi, "msg", "timer", &p->timer);
+	for (i = 0; i < PP_PROF_NHOOKS; i++)
+		prof_diag(ppi, "hook", pp_prof_hook_name(i), &p->hook[i]);
+}
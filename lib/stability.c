@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Online MTIE, TDEV and ADEV of offsetFromMaster (see <ppsi/stability.h>).
+ * The servo calls pp_stab_servo() after each update; the cost does not
+ * depend on the windows, and nothing is allocated.
+ */
+#include <ppsi/ppsi.h>
+
+int pp_stab_windows_s[PP_STAB_NWIN] = {1, 10, 100, 1000, 10000};
+
+/* Drop from the back the blocks the new one dominates, then append it */
+static void stab_push(struct pp_stab_ext *q, uint8_t h, uint8_t *n,
+		      int64_t v, uint32_t blk, int is_max)
+{
+	struct pp_stab_ext *e;
+
+	while (*n) {
+		e = q + (h + *n - 1) % PP_STAB_NBLK;
+		if (is_max ? e->v > v : e->v < v)
+			break;
+		(*n)--;
+	}
+	e = q + (h + *n) % PP_STAB_NBLK;
+	e->v = v;
+	e->blk = blk;
+	(*n)++;
+}
+
+/* Drop from the front the blocks that left the window */
+static void stab_expire(struct pp_stab_ext *q, uint8_t *h, uint8_t *n,
+			uint32_t oldest)
+{
+	while (*n && q[*h].blk < oldest) {
+		*h = (*h + 1) % PP_STAB_NBLK;
+		(*n)--;
+	}
+}
+
+/* A block is complete: the window is made of it and the 15 before */
+static void mtie_close(struct pp_stab_mtie *m)
+{
+	int full = m->blk + 1 >= PP_STAB_NBLK;
+	uint32_t oldest = full ? m->blk + 1 - PP_STAB_NBLK : 0;
+	int64_t range;
+
+	stab_expire(m->qmax, &m->hmax, &m->nmax, oldest);
+	stab_expire(m->qmin, &m->hmin, &m->nmin, oldest);
+	stab_push(m->qmax, m->hmax, &m->nmax, m->max, m->blk, 1);
+	stab_push(m->qmin, m->hmin, &m->nmin, m->min, m->blk, 0);
+	if (!full)
+		return;
+	range = m->qmax[m->hmax].v - m->qmin[m->hmin].v;
+	if (range > m->mtie_ps)
+		m->mtie_ps = range;
+	m->n_windows++;
+}
+
+static void mtie_add(struct pp_stab_mtie *m, int64_t t_ns, int64_t x,
+		     int first)
+{
+	int64_t blk_ns = m->win_ns / PP_STAB_NBLK, skip;
+
+	if (first) {
+		m->blk_end_ns = t_ns + blk_ns;
+	} else if (t_ns >= m->blk_end_ns) {
+		if (m->cur_n)
+			mtie_close(m);
+		/* Blocks with no samples are just skipped */
+		skip = (t_ns - m->blk_end_ns) / blk_ns + 1;
+		m->blk += skip;
+		m->blk_end_ns += skip * blk_ns;
+		m->cur_n = 0;
+	}
+	if (!m->cur_n || x < m->min)
+		m->min = x;
+	if (!m->cur_n || x > m->max)
+		m->max = x;
+	m->cur_n++;
+}
+
+static void tau_add(struct pp_stab_tau *t, int i, int64_t x)
+{
+	int64_t mean, d;
+
+	if (!t->count)
+		t->first = x;
+	t->sum += x;
+	if (++t->count < (1U << i))
+		return;
+	mean = t->sum / (1 << i);
+	if (t->nblk == 2) {
+		d = mean - 2 * t->mean[1] + t->mean[0];
+		t->tvar += (double)d * d;
+		d = t->first - 2 * t->point[1] + t->point[0];
+		t->avar += (double)d * d;
+		t->n++;
+	} else {
+		t->nblk++;
+	}
+	t->mean[0] = t->mean[1];
+	t->mean[1] = mean;
+	t->point[0] = t->point[1];
+	t->point[1] = t->first;
+	t->sum = t->count = 0;
+}
+
+void pp_stab_servo(struct pp_instance *ppi)
+{
+	struct pp_servo *servo = SRV(ppi);
+	struct pp_stability *s = &servo->stab;
+	int64_t x = pp_time_to_picos(&servo->offsetFromMaster);
+	int64_t t_ns = servo->update_time.secs * 1000LL * 1000 * 1000 +
+		(servo->update_time.scaled_nsecs >> TIME_FRACBITS);
+	int i;
+
+	/* The servo has been reset: take the windows of the configuration */
+	if (!s->n) {
+		for (i = 0; i < PP_STAB_NWIN; i++)
+			s->mtie[i].win_ns = pp_stab_windows_s[i] *
+				1000LL * 1000 * 1000;
+		s->first_ns = t_ns;
+	}
+	for (i = 0; i < PP_STAB_NWIN; i++)
+		if (s->mtie[i].win_ns)
+			mtie_add(s->mtie + i, t_ns, x, !s->n);
+	for (i = 0; i < PP_STAB_NTAU; i++)
+		tau_add(s->tau + i, i, x);
+	s->last_ns = t_ns;
+	s->n++;
+}
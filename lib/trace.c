@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Trace recorder, for hosted architectures (unix, wrs). The network and
+ * time operations of each instance are replaced by wrappers that call
+ * the real ones and record what happened. Frames are flushed as they
+ * are recorded (a few per second), so a trace is complete up to the
+ * last frame even if the daemon is killed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <ppsi/ppsi.h>
+
+char pp_trace_file[PP_TRACE_PATH_LEN];
+
+static FILE *trace_f;
+static const struct pp_network_operations *trace_real_n;
+static const struct pp_time_operations *trace_real_t;
+
+/* Built from the real ones: operations they lack are left NULL */
+static struct pp_network_operations trace_net_ops;
+static struct pp_time_operations trace_time_ops;
+
+static void trace_write(struct pp_instance *ppi, int type, int flags,
+			int64_t a, int64_t b, const void *data, int len)
+{
+	static const char pad[8];
+	struct pp_trace_rec r;
+	struct timespec ts;
+	int npad;
+
+	if (!trace_f)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	memset(&r, 0, sizeof(r));
+	r.type = type;
+	r.flags = flags;
+	r.port = ppi ? ppi - ppi->glbs->pp_instances : 0;
+	r.len = len;
+	r.mono_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	r.a = a;
+	r.b = b;
+	npad = pp_trace_rec_size(&r) - sizeof(r) - len;
+	if (fwrite(&r, sizeof(r), 1, trace_f) != 1
+	    || (len && fwrite(data, len, 1, trace_f) != 1)
+	    || (npad && fwrite(pad, npad, 1, trace_f) != 1)) {
+		pp_error("%s: %s: %s\n", __func__, pp_trace_file,
+			 strerror(errno));
+		fclose(trace_f);
+		trace_f = NULL;
+	}
+}
+
+static void trace_frame(struct pp_instance *ppi, int type, void *pkt,
+			int len, struct pp_time *t)
+{
+	trace_write(ppi, type, 0, t->secs, t->scaled_nsecs, pkt, len);
+	if (trace_f)
+		fflush(trace_f);
+}
+
+static int trace_net_init(struct pp_instance *ppi)
+{
+	char data[6 + sizeof(ppi->cfg.port_name) + 1];
+	int ret = trace_real_n->init(ppi);
+
+	memcpy(data, ppi->ch[PP_NP_GEN].addr, 6);
+	strncpy(data + 6, ppi->port_name, sizeof(data) - 7);
+	data[sizeof(data) - 1] = '\0';
+	trace_write(ppi, PP_TRACE_PORT, 0, ppi->proto, 0, data,
+		    6 + strlen(data + 6) + 1);
+	return ret;
+}
+
+static int trace_net_recv(struct pp_instance *ppi, void *pkt, int len,
+			  struct pp_time *t)
+{
+	int ret = trace_real_n->recv(ppi, pkt, len, t);
+
+	if (ret > ppi->rx_offset)
+		trace_frame(ppi, PP_TRACE_RX, pkt + ppi->rx_offset,
+			    ret - ppi->rx_offset, t);
+	return ret;
+}
+
+static int trace_net_send(struct pp_instance *ppi, void *pkt, int len,
+			  enum pp_msg_format msg_fmt)
+{
+	int ret = trace_real_n->send(ppi, pkt, len, msg_fmt);
+
+	if (ret > ppi->tx_offset)
+		trace_frame(ppi, PP_TRACE_TX, pkt + ppi->tx_offset,
+			    len - ppi->tx_offset, &ppi->last_snt_time);
+	return ret;
+}
+
+static int trace_get(struct pp_instance *ppi, struct pp_time *t)
+{
+	int ret = trace_real_t->get(ppi, t);
+
+	trace_write(ppi, PP_TRACE_GET, 0, t->secs, t->scaled_nsecs, NULL, 0);
+	return ret;
+}
+
+static int trace_set(struct pp_instance *ppi, const struct pp_time *t)
+{
+	int ret = trace_real_t->set(ppi, t);
+
+	if (t) /* not a change of the UTC offset */
+		trace_write(ppi, PP_TRACE_SET, 0, t->secs, t->scaled_nsecs,
+			    NULL, 0);
+	return ret;
+}
+
+static int trace_adjust(struct pp_instance *ppi, long offset_ns,
+			long freq_ppb)
+{
+	int ret = trace_real_t->adjust(ppi, offset_ns, freq_ppb);
+
+	trace_write(ppi, PP_TRACE_ADJ,
+		    (offset_ns ? PP_TRACE_ADJ_OFFSET : 0) |
+		    (freq_ppb ? PP_TRACE_ADJ_FREQ : 0),
+		    offset_ns, freq_ppb, NULL, 0);
+	return ret;
+}
+
+static int trace_adjust_offset(struct pp_instance *ppi, long offset_ns)
+{
+	int ret = trace_real_t->adjust_offset(ppi, offset_ns);
+
+	trace_write(ppi, PP_TRACE_ADJ, PP_TRACE_ADJ_OFFSET, offset_ns, 0,
+		    NULL, 0);
+	return ret;
+}
+
+static int trace_adjust_freq(struct pp_instance *ppi, long freq_ppb)
+{
+	int ret = trace_real_t->adjust_freq(ppi, freq_ppb);
+
+	trace_write(ppi, PP_TRACE_ADJ, PP_TRACE_ADJ_FREQ, 0, freq_ppb,
+		    NULL, 0);
+	return ret;
+}
+
+static int trace_init_servo(struct pp_instance *ppi)
+{
+	int ret = trace_real_t->init_servo(ppi);
+
+	trace_write(ppi, PP_TRACE_INIT_SERVO, 0, ret, 0, NULL, 0);
+	return ret;
+}
+
+int pp_trace_open(struct pp_globals *ppg)
+{
+	if (!pp_trace_file[0])
+		return 0; /* not requested */
+	trace_f = fopen(pp_trace_file, "w");
+	if (!trace_f) {
+		pp_error("%s: %s: %s\n", __func__, pp_trace_file,
+			 strerror(errno));
+		return -1;
+	}
+	trace_write(NULL, PP_TRACE_HEADER, 0, PP_TRACE_MAGIC,
+		    PP_TRACE_VERSION, NULL, 0);
+	pp_printf("Recording a trace to %s\n", pp_trace_file);
+	return 0;
+}
+
+/*
+ * All instances use the same operations: wrap them. The tables start as
+ * a copy of the real ones, and only the operations that are recorded,
+ * if present, are replaced; the others are called directly.
+ */
+#define TRACE_WRAP(ops, real, op, wrapper)				\
+	do {								\
+		if ((real)->op)						\
+			(ops).op = wrapper;				\
+	} while (0)
+
+void pp_trace_attach(struct pp_instance *ppi)
+{
+	if (!trace_f)
+		return;
+	if (ppi->n_ops != &trace_net_ops) {
+		trace_real_n = ppi->n_ops;
+		trace_net_ops = *trace_real_n;
+		TRACE_WRAP(trace_net_ops, trace_real_n, init, trace_net_init);
+		TRACE_WRAP(trace_net_ops, trace_real_n, recv, trace_net_recv);
+		TRACE_WRAP(trace_net_ops, trace_real_n, send, trace_net_send);
+		ppi->n_ops = &trace_net_ops;
+	}
+	if (ppi->t_ops != &trace_time_ops) {
+		trace_real_t = ppi->t_ops;
+		trace_time_ops = *trace_real_t;
+		TRACE_WRAP(trace_time_ops, trace_real_t, get, trace_get);
+		TRACE_WRAP(trace_time_ops, trace_real_t, set, trace_set);
+		TRACE_WRAP(trace_time_ops, trace_real_t, adjust, trace_adjust);
+		TRACE_WRAP(trace_time_ops, trace_real_t, adjust_offset,
+			   trace_adjust_offset);
+		TRACE_WRAP(trace_time_ops, trace_real_t, adjust_freq,
+			   trace_adjust_freq);
+		TRACE_WRAP(trace_time_ops, trace_real_t, init_servo,
+			   trace_init_servo);
+		ppi->t_ops = &trace_time_ops;
+	}
+}
@@ -12,10 +12,10 @@
 #include "wrh-servo_state_name.h"
 
 #if CONFIG_ARCH_IS_WRS
-#include <libwr/shmem.h>
+#include <ppsi-wrs.h>
 #else
 /* No shmem */
-#define wrs_shm_write(ppi, FLAG) do {} while (0)
+#define wrs_shm_inst_write(ppi, FLAG) do {} while (0)
 #endif
 
 /* Define threshold values for SNMP */
@@ -29,9 +29,6 @@ static int wrh_tracking_enabled = 1;
 static int __wrh_servo_update(struct pp_instance *ppi);
 static void  setState(struct pp_instance *ppi, int newState);
 
-/* External data */
-extern struct wrs_shm_head *ppsi_head;
-
 void wrh_servo_enable_tracking(int enable)
 {
 	wrh_tracking_enabled = enable;
@@ -46,7 +43,7 @@ int wrh_servo_init(struct pp_instance *ppi)
 	pp_servo_init(ppi); // Initialize the standard servo data
 
 	/* shmem lock */
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
 
 	WRH_SERVO_RESET_DATA(s);
 
@@ -72,7 +69,7 @@ int wrh_servo_init(struct pp_instance *ppi)
 	setState(ppi,WRH_SYNC_TAI);
 
 	/* shmem unlock */
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 	return ret;
 }
 
@@ -81,7 +78,7 @@ void wrh_servo_reset(struct pp_instance *ppi)
 {
 	if ( ppi->extState==PP_EXSTATE_ACTIVE ) {
 		/* shmem lock */
-		wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
+		wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
 		ppi->flags = 0;
 
 		WRH_SERVO_RESET_DATA(WRH_SRV(ppi));
@@ -89,7 +86,7 @@ void wrh_servo_reset(struct pp_instance *ppi)
 		setState(ppi,WRH_UNINITIALIZED);
 
 		/* shmem unlock */
-		wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
+		wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 	}
 }
 
@@ -101,7 +98,7 @@ int wrh_servo_got_sync(struct pp_instance *ppi)
 	struct pp_servo *gs=SRV(ppi);
 
 	/* shmem lock */
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
 
 	gs->t1=ppi->t1;apply_faulty_stamp(ppi,1);
 	gs->t2=ppi->t2;apply_faulty_stamp(ppi,2);
@@ -114,7 +111,7 @@ int wrh_servo_got_sync(struct pp_instance *ppi)
 	}
 
 	/* shmem unlock */
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 
 	return 0;
 }
@@ -136,13 +133,13 @@ int wrh_servo_got_resp(struct pp_instance *ppi)
 	if (is_timestamp_incorrect_thres(ppi,&errcount,0xC /* mask=t3&t4 */))
 		return 0;
 
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
 
 	gs->t3 = ppi->t3; apply_faulty_stamp(ppi,3);
 	gs->t4 = ppi->t4; apply_faulty_stamp(ppi,4);
 
 	ret=__wrh_servo_update(ppi);
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 	return ret;
 }
 
@@ -158,7 +155,7 @@ int wrh_servo_got_presp(struct pp_instance *ppi)
 	if (is_timestamp_incorrect_thres(ppi,&errcount,0x3C /* t3,t4,t5,t6 */))
 		return 0;
 
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
 
 	gs->t3 = ppi->t3; apply_faulty_stamp(ppi,3);
 	gs->t4 = ppi->t4; apply_faulty_stamp(ppi,4);
@@ -167,7 +164,7 @@ int wrh_servo_got_presp(struct pp_instance *ppi)
 
 	gs->got_sync=1;
 
-	wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
+	wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 
 	return 1;
 }
@@ -213,6 +210,8 @@ static int __wrh_servo_update(struct pp_instance *ppi)
 	// Servo updated
 	gs->update_count++;
 	TOPS(ppi)->get(ppi, &gs->update_time);
+	pp_metrics_servo(ppi);
+	pp_lat_mark(ppi, PP_LAT_SERVO);
 
 	if (!s->readyForSync )
 		return 1; /* We have to wait before to start the synchronization */
@@ -291,8 +290,8 @@ static int __wrh_servo_update(struct pp_instance *ppi)
 			struct pp_time t;
 			TOPS(ppi)->get(ppi,&t);
 			unix_time_ops.set(ppi, &t);
-			pp_diag(ppi, time, 1, "system time set to %s TAI\n",
-				time_to_string(&t));
+			pp_diag_time(ppi, time, 1, &t,
+				     "system time set to %s TAI\n");
 		}
 		break;
 
@@ -340,6 +339,10 @@ static int __wrh_servo_update(struct pp_instance *ppi)
 
 	gs->servo_locked = (gs->state==WRH_TRACK_PHASE);
 
+	/* Stability only makes sense while tracking the phase */
+	if (gs->servo_locked)
+		pp_stab_servo(ppi);
+
 	/* Increase number of servo updates with state different than
 	 * WRH_TRACK_PHASE. (Used by SNMP) */
 	if (gs->state != WRH_TRACK_PHASE)
@@ -1399,6 +1399,10 @@ int bmc_apply_state_descision(struct pp_instance *ppi) {
 
 	/* Extra states handled here */
 	if (is_ext_hook_available(ppi,state_decision))
-		next_state = ppi->ext_hooks->state_decision(ppi, ppi->next_state);
-	return is_externalPortConfigurationEnabled(DSDEF(ppi)) ? ppi->state : next_state;
+		next_state = PP_PROF_HOOK(ppi, PP_PROF_STATE_DECISION,
+			ppi->ext_hooks->state_decision(ppi, ppi->next_state));
+	if (is_externalPortConfigurationEnabled(DSDEF(ppi)))
+		next_state = ppi->state;
+	pp_frec_bmc(ppi, next_state);
+	return next_state;
 }
@@ -20,9 +20,10 @@ static int presp_call_servo(struct pp_instance *ppi)
 	if (is_incorrect(&ppi->t4))
 		return 0; /* not an error, just no data */
 
-	if (is_ext_hook_available(ppi,handle_presp))
-		ret = ppi->ext_hooks->handle_presp(ppi);
-	else {
+	if (is_ext_hook_available(ppi,handle_presp)) {
+		ret = PP_PROF_HOOK(ppi, PP_PROF_HANDLE_PRESP,
+				   ppi->ext_hooks->handle_presp(ppi));
+	} else {
 		pp_servo_got_presp(ppi);
 	}
 	if ( ppi->state==PPS_MASTER) {
@@ -170,7 +171,8 @@ int st_com_peer_handle_preq(struct pp_instance *ppi, void *buf,
 		return 0;
 	
 	if (is_ext_hook_available(ppi,handle_preq))
-		e = ppi->ext_hooks->handle_preq(ppi);
+		e = PP_PROF_HOOK(ppi, PP_PROF_HANDLE_PREQ,
+				 ppi->ext_hooks->handle_preq(ppi));
 	if (e)
 		return e;
 
@@ -117,16 +117,18 @@ int st_com_check_announce_receive_timeout(struct pp_instance *ppi)
 
 int st_com_handle_announce(struct pp_instance *ppi, void *buf, int len)
 {
-	if (is_ext_hook_available(ppi,handle_announce))
-		return ppi->ext_hooks->handle_announce(ppi);
-	return 0;
+	if (!is_ext_hook_available(ppi,handle_announce))
+		return 0;
+	return PP_PROF_HOOK(ppi, PP_PROF_HANDLE_ANNOUNCE,
+			    ppi->ext_hooks->handle_announce(ppi));
 }
 
 int st_com_handle_signaling(struct pp_instance *ppi, void *buf, int len)
 {
-	if (is_ext_hook_available(ppi,handle_signaling))
-		return ppi->ext_hooks->handle_signaling(ppi,buf,len);
-	return 0;
+	if (!is_ext_hook_available(ppi,handle_signaling))
+		return 0;
+	return PP_PROF_HOOK(ppi, PP_PROF_HANDLE_SIGNALING,
+			    ppi->ext_hooks->handle_signaling(ppi,buf,len));
 }
 
 
@@ -153,14 +155,19 @@ int __send_and_log(struct pp_instance *ppi, int msglen, int chtype,enum pp_msg_f
 		adjust=ppi->timestampCorrectionPortDS.egressLatency;
 	}
 	pp_time_add_interval(t,adjust);
+	if (chtype == PP_NP_EVT)
+		pp_lat_tx_end(ppi, mf->msg_type);
 
 	/* FIXME: diagnostics should be looped back in the send method */
 	pp_diag(ppi, frames, 1, "SENT %02d bytes at %d.%09d.%03d (%s)\n",
 		msglen, (int)t->secs, (int)(t->scaled_nsecs >> 16),
 		((int)(t->scaled_nsecs & 0xffff) * 1000) >> 16,
 		pp_msgtype_name[mf->msg_type]);
-	if (chtype == PP_NP_EVT && is_incorrect(&ppi->last_snt_time))
+	if (chtype == PP_NP_EVT && is_incorrect(&ppi->last_snt_time)) {
+		pp_frec_tx(ppi, mf->msg_type, PP_FREC_F_NO_STAMP);
 		return PP_SEND_NO_STAMP;
+	}
+	pp_frec_tx(ppi, mf->msg_type, 0);
 
 	/* count sent packets */
 	ppi->ptp_tx_count++;
@@ -146,6 +146,7 @@ int msg_issue_pdelay_req(struct pp_instance *ppi)
 	int len;
 
 	mark_incorrect(&ppi->t4); /* see commit message */
+	pp_lat_tx_begin(ppi);
 	TOPS(ppi)->get(ppi, &now);
 	ppi->received_dresp=
 			ppi->received_dresp_fup=0;
@@ -158,6 +159,7 @@ int msg_issue_pdelay_resp(struct pp_instance *ppi, struct pp_time *t)
 {
 	int len;
 
+	pp_lat_tx_begin(ppi);
 	len = msg_pack_pdelay_resp(ppi, &ppi->received_ptp_header, t);
 	return __send_and_log(ppi, len, PP_NP_EVT,PPM_PDELAY_RESP_FMT);
 }
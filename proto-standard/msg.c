@@ -236,7 +236,8 @@ static int msg_pack_announce(struct pp_instance *ppi)
 	*(Enumeration8 *) (buf + 63) = DSPRO(ppi)->timeSource;
 
 	if (is_ext_hook_available(ppi,pack_announce))
-		len = ppi->ext_hooks->pack_announce(ppi);
+		len = PP_PROF_HOOK(ppi, PP_PROF_PACK_ANNOUNCE,
+				   ppi->ext_hooks->pack_announce(ppi));
 	return len;
 }
 
@@ -263,7 +264,8 @@ void msg_unpack_announce(struct pp_instance *ppi, void *buf, MsgAnnounce *ann)
 
 	/* this can fill in extention specific flags otherwise just zero them*/
 	if (is_ext_hook_available(ppi,unpack_announce))
-		ppi->ext_hooks->unpack_announce(ppi,buf, ann);
+		PP_PROF_HOOK(ppi, PP_PROF_UNPACK_ANNOUNCE,
+			     ppi->ext_hooks->unpack_announce(ppi,buf, ann));
 }
 
 /* Pack Follow Up message into out buffer of ppi*/
@@ -384,6 +386,7 @@ int msg_issue_sync_followup(struct pp_instance *ppi)
 	int e, len;
 
 	/* Send sync on the event channel with the "current" timestamp */
+	pp_lat_tx_begin(ppi);
 	TOPS(ppi)->get(ppi, &now);
 	len = msg_pack_sync(ppi, &now);
 	e = __send_and_log(ppi, len, PP_NP_EVT,PPM_SYNC_FMT);
@@ -401,6 +404,7 @@ static int msg_issue_delay_req(struct pp_instance *ppi)
 	struct pp_time now;
 	int len;
 
+	pp_lat_tx_begin(ppi);
 	TOPS(ppi)->get(ppi, &now);
 	len = msg_pack_delay_req(ppi, &now);
 
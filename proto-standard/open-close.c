@@ -72,6 +72,16 @@ const struct pp_instance_cfg __pp_default_instance_cfg = {
  * state machine to the first state.
  */
 
+static void pp_init_instance(struct pp_instance *ppi, int i)
+{
+	ppi->state = PPS_DISABLED;
+	ppi->pdstate = PP_PDSTATE_NONE;
+	ppi->current_state_item = NULL;
+	ppi->port_idx = i;
+	ppi->frgn_rec_best = -1;
+	pp_timeout_disable_all(ppi); /* By default, disable all timers */
+}
+
 int pp_init_globals(struct pp_globals *ppg, struct pp_runtime_opts *pp_rt_opts)
 {
 	/*
@@ -137,16 +147,8 @@ int pp_init_globals(struct pp_globals *ppg, struct pp_runtime_opts *pp_rt_opts)
 
 	}
 
-	for (i = 0; i < get_numberPorts(def); i++) {
-		struct pp_instance *ppi = INST(ppg, i);
-
-		ppi->state = PPS_DISABLED;
-		ppi->pdstate = PP_PDSTATE_NONE;
-		ppi->current_state_item = NULL;
-		ppi->port_idx = i;
-		ppi->frgn_rec_best = -1;
-		pp_timeout_disable_all(ppi); /* By default, disable all timers */
-	}
+	for (i = 0; i < get_numberPorts(def); i++)
+		pp_init_instance(INST(ppg, i), i);
 
 	if ( is_externalPortConfigurationEnabled(GDSDEF(ppg)) ) {
 		Boolean isSlavePresent=FALSE;
@@ -184,6 +186,27 @@ int pp_init_globals(struct pp_globals *ppg, struct pp_runtime_opts *pp_rt_opts)
 	return ret;
 }
 
+/*
+ * Open an instance added after pp_init_globals (i.e. by a configuration
+ * reload). The caller already incremented ppg->nlinks.
+ */
+int pp_open_instance(struct pp_globals *ppg, struct pp_instance *ppi)
+{
+	defaultDS_t *def = ppg->defaultDS;
+
+	def->numberPorts = ppg->nlinks;
+	pp_init_instance(ppi, ppi - ppg->pp_instances);
+
+	if (is_externalPortConfigurationEnabled(def)) {
+		ppi->portDS->masterOnly = FALSE;
+		ppi->externalPortConfigurationPortDS.desiredState =
+			ppi->cfg.desiredState;
+	}
+	if (is_ext_hook_available(ppi, open))
+		return ppi->ext_hooks->open(ppi, ppg->rt_opts);
+	return 0;
+}
+
 int pp_close_globals(struct pp_globals *ppg)
 {
 	int i,ret=0;;
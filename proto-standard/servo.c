@@ -10,13 +10,12 @@
 #include "../proto-standard/common-fun.h"
 
 #ifdef CONFIG_ARCH_WRS
-#include <libwr/shmem.h>
-#define shmem_lock() wrs_shm_write(ppsi_head, WRS_SHM_WRITE_BEGIN);
-#define shmem_unlock() wrs_shm_write(ppsi_head, WRS_SHM_WRITE_END);
-extern struct wrs_shm_head *ppsi_head;
+#include <ppsi-wrs.h>
+#define shmem_lock(ppi) wrs_shm_inst_write(ppi, WRS_SHM_WRITE_BEGIN);
+#define shmem_unlock(ppi) wrs_shm_inst_write(ppi, WRS_SHM_WRITE_END);
 #else
-#define shmem_lock()
-#define shmem_unlock()
+#define shmem_lock(ppi)
+#define shmem_unlock(ppi)
 #endif
 
 static void pp_servo_mpd_fltr(struct pp_instance *, struct pp_avg_fltr *,
@@ -28,9 +27,9 @@ static void __pp_servo_update(struct pp_instance *ppi);
 
 void pp_servo_init(struct pp_instance *ppi)
 {
-	shmem_lock(); /* Share memory locked */
+	shmem_lock(ppi); /* Share memory locked */
 	_pp_servo_init(ppi);
-	shmem_unlock(); /* Share memory unlocked */
+	shmem_unlock(ppi); /* Share memory unlocked */
 }
 
 static void _pp_servo_init(struct pp_instance *ppi)
@@ -56,6 +55,7 @@ static void _pp_servo_init(struct pp_instance *ppi)
 	}
 
 	servo->flags |= PP_SERVO_FLAG_VALID;
+	pp_frec_servo(ppi, PP_FREC_SERVO_INIT, NULL, NULL);
 
 	pp_diag(ppi, servo, 1, "Initialized: obs_drift %lli\n",
 			servo->obs_drift);
@@ -191,11 +191,11 @@ static int calculate_p2p_delayMM(struct pp_instance *ppi) {
 	if (is_timestamp_incorrect_thres(ppi,&errcount, 0x3C /* t3,t4,t5,t6*/))
 		return 0; /* Error. Invalid timestamps */
 
-	if (__PP_DIAG_ALLOW(ppi, pp_dt_servo, 2)) {
-		pp_diag(ppi, servo, 2, "T3: %s s\n", time_to_string(&ppi->t3));
-		pp_diag(ppi, servo, 2, "T4: %s s\n", time_to_string(&ppi->t4));
-		pp_diag(ppi, servo, 2, "T5: %s s\n", time_to_string(&ppi->t5));
-		pp_diag(ppi, servo, 2, "T6: %s s\n", time_to_string(&ppi->t6));
+	if (pp_diag_allow(ppi, servo, 2)) {
+		pp_diag_time(ppi, servo, 2, &ppi->t3, "T3: %s s\n");
+		pp_diag_time(ppi, servo, 2, &ppi->t4, "T4: %s s\n");
+		pp_diag_time(ppi, servo, 2, &ppi->t5, "T5: %s s\n");
+		pp_diag_time(ppi, servo, 2, &ppi->t6, "T6: %s s\n");
 	}
 	/*
 	 * Calculate of the round trip delay (delayMM)
@@ -217,11 +217,11 @@ static int calculate_e2e_delayMM(struct pp_instance *ppi) {
 	if (is_timestamp_incorrect_thres(ppi, &errcount, 0xF /* t1,t2,t3,t4 */))
 		return 0; /* Error. Invalid timestamps */
 
-	if (__PP_DIAG_ALLOW(ppi, pp_dt_servo, 2)) {
-		pp_diag(ppi, servo, 2, "T1: %s s\n", time_to_string(&servo->t1));
-		pp_diag(ppi, servo, 2, "T2: %s s\n", time_to_string(&servo->t2));
-		pp_diag(ppi, servo, 2, "T3: %s s\n", time_to_string(&servo->t3));
-		pp_diag(ppi, servo, 2, "T4: %s s\n", time_to_string(&servo->t4));
+	if (pp_diag_allow(ppi, servo, 2)) {
+		pp_diag_time(ppi, servo, 2, &servo->t1, "T1: %s s\n");
+		pp_diag_time(ppi, servo, 2, &servo->t2, "T2: %s s\n");
+		pp_diag_time(ppi, servo, 2, &servo->t3, "T3: %s s\n");
+		pp_diag_time(ppi, servo, 2, &servo->t4, "T4: %s s\n");
 	}
 	/*
 	 * Calculate the round trip delay (delayMM)
@@ -285,13 +285,13 @@ int pp_servo_calculate_delays(struct pp_instance *ppi) {
 	picos_to_pp_time(meanDelay_ps,&servo->meanDelay); /* update servo.meanDelay */
 	update_meanDelay(ppi,picos_to_interval(meanDelay_ps)); /* update currentDS.meanDelay and portDS.meanLinkDelay (if needed) */
 
-	if (__PP_DIAG_ALLOW(ppi, pp_dt_servo, 2)) {
-		pp_diag(ppi, servo, 2,"delayMM         : %s s\n", time_to_string(&servo->delayMM));
-		pp_diag(ppi, servo, 2,"delayMS         : %s s\n", time_to_string(&servo->delayMS));
+	if (pp_diag_allow(ppi, servo, 2)) {
+		pp_diag_time(ppi, servo, 2, &servo->delayMM, "delayMM         : %s s\n");
+		pp_diag_time(ppi, servo, 2, &servo->delayMS, "delayMS         : %s s\n");
 		pp_diag(ppi, servo, 2,"delayAsym       : %s ns\n", interval_to_string(ppi->portDS->delayAsymmetry));
 		pp_diag(ppi, servo, 2,"delayAsymCoeff  : %s ns\n", relative_interval_to_string(ppi->portDS->delayAsymCoeff));
-		pp_diag(ppi, servo, 2,"meanDelay       : %s s\n", time_to_string(&servo->meanDelay));
-		pp_diag(ppi, servo, 2,"offsetFromMaster: %s s\n", time_to_string(&servo->offsetFromMaster));
+		pp_diag_time(ppi, servo, 2, &servo->meanDelay, "meanDelay       : %s s\n");
+		pp_diag_time(ppi, servo, 2, &servo->offsetFromMaster, "offsetFromMaster: %s s\n");
 	}
 	return 1;
 }
@@ -328,7 +328,7 @@ void pp_servo_got_sync(struct pp_instance *ppi, int allowTimingOutput)
 {
 	struct pp_servo *servo=SRV(ppi);
 
-	shmem_lock(); /* Share memory locked */
+	shmem_lock(ppi); /* Share memory locked */
 
 	servo->t1=ppi->t1;
 	servo->t2=ppi->t2;
@@ -342,7 +342,7 @@ void pp_servo_got_sync(struct pp_instance *ppi, int allowTimingOutput)
 	} else
 		servo->got_sync=1;
 
-	shmem_unlock(); /* Share memory locked */
+	shmem_unlock(ppi); /* Share memory locked */
 }
 
 /* called by slave states when delay_resp is received (all t1..t4 are valid) */
@@ -359,7 +359,7 @@ int pp_servo_got_resp(struct pp_instance *ppi, int allowTimingOutput)
 	if (is_timestamp_incorrect_thres(ppi, &errcount, 0xC /* t3,t4 */))
 		return 0;
 
-	shmem_lock(); /* Share memory locked */
+	shmem_lock(ppi); /* Share memory locked */
 
 	/* Save t3 and t4 */
 	servo->t3=ppi->t3;
@@ -367,7 +367,7 @@ int pp_servo_got_resp(struct pp_instance *ppi, int allowTimingOutput)
 
 	__pp_servo_update(ppi);
 
-	shmem_unlock(); /* Share memory locked */
+	shmem_unlock(ppi); /* Share memory locked */
 
 	if (allowTimingOutput)
 		control_timing_output(ppi);
@@ -384,7 +384,7 @@ int pp_servo_got_presp(struct pp_instance *ppi)
 	if (is_timestamp_incorrect_thres(ppi, &errcount, 0x3C /* t3-t6 */))
 		return 0;
 
-	shmem_lock(); /* Share memory locked */
+	shmem_lock(ppi); /* Share memory locked */
 
 	servo->t3=ppi->t3;
 	servo->t4=ppi->t4;
@@ -392,7 +392,7 @@ int pp_servo_got_presp(struct pp_instance *ppi)
 	servo->t6=ppi->t6;
 	servo->got_sync=1;
 
-	shmem_unlock(); /* Share memory unlocked */
+	shmem_unlock(ppi); /* Share memory unlocked */
 	return 1;
 }
 
@@ -402,18 +402,22 @@ static void __pp_servo_update(struct pp_instance *ppi) {
 	struct pp_time *meanDelay =&servo->meanDelay;
 	struct pp_avg_fltr *meanDelayFilter = &servo->mpd_fltr;
 	struct pp_time *offsetFromMaster = &servo->offsetFromMaster;
-	int adj32;
+	int adj32, jumped;
 
 	if ( !pp_servo_calculate_delays(ppi) )
 		return;
 
-	if (meanDelay->secs) /* Hmm.... we called this "bad event" */
+	if (meanDelay->secs) { /* Hmm.... we called this "bad event" */
+		pp_frec_servo(ppi, PP_FREC_SERVO_BAD, offsetFromMaster,
+			      meanDelay);
 		return;
+	}
 
 	pp_servo_mpd_fltr(ppi, meanDelayFilter, meanDelay);
 
 	/* update 'offsetFromMaster' and possibly jump in time */
-	if (!pp_servo_offset_master(ppi,offsetFromMaster)) {
+	jumped = pp_servo_offset_master(ppi, offsetFromMaster);
+	if (!jumped) {
 
 		/* PI controller returns a scaled_nsecs adjustment, so shift back */
 		adj32 = (int)(pp_servo_pi_controller(ppi, offsetFromMaster) >> 16);
@@ -431,7 +435,15 @@ static void __pp_servo_update(struct pp_instance *ppi) {
 			(int)SRV(ppi)->obs_drift >> 10);
 	}
 	servo->update_count++;
+	if (!jumped)
+		pp_frec_servo(ppi, PP_FREC_SERVO_UPDATE, offsetFromMaster,
+			      meanDelay);
 	TOPS(ppi)->get(ppi, &servo->update_time);
+	pp_metrics_servo(ppi);
+	/* After a jump the servo is reset, and this offset is not relevant */
+	if (!jumped)
+		pp_stab_servo(ppi);
+	pp_lat_mark(ppi, PP_LAT_SERVO);
 
 }
 
@@ -490,8 +502,9 @@ static void pp_servo_mpd_fltr(struct pp_instance *ppi, struct pp_avg_fltr *meanD
 	__div64_32(&y, meanDelayFilter->s_exp);
 	meanDelay->scaled_nsecs =	meanDelayFilter->y = y;
 	update_meanDelay(ppi,pp_time_to_interval(meanDelay)); /* update currentDS.meanDelay and portDS.meanLinkDelay (idf needed) */
-	pp_diag(ppi, servo, 1, "After avg(%i), meanDelay: %s \n",
-		(int)meanDelayFilter->s_exp, time_to_string(meanDelay));
+	pp_diag_time(ppi, servo, 1, meanDelay,
+		     "After avg(%i), meanDelay: %s \n",
+		     (int)meanDelayFilter->s_exp);
 }
 
 /* Thresholds are used to decide if we must use time or frequency adjustment
@@ -513,6 +526,7 @@ static int pp_servo_offset_master(struct pp_instance *ppi, struct pp_time *ofm)
 	if (!pp_can_adjust(ppi))
 		return 0; /* e.g., a loopback test run... "-t" on cmdline */
 
+	pp_frec_servo(ppi, PP_FREC_SERVO_JUMP, ofm, &SRV(ppi)->meanDelay);
 	TOPS(ppi)->get(ppi, &time_tmp);
 	pp_time_add(&time_tmp, ofm);
 	TOPS(ppi)->set(ppi, &time_tmp);
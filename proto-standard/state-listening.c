@@ -52,7 +52,8 @@ int pp_listening(struct pp_instance *ppi, void *buf, int len)
 	MsgHeader *hdr = &ppi->received_ptp_header;
 
 	if (is_ext_hook_available(ppi,listening)) {
-		e=ppi->ext_hooks->listening(ppi, buf, len);
+		e = PP_PROF_HOOK(ppi, PP_PROF_LISTENING,
+				 ppi->ext_hooks->listening(ppi, buf, len));
 		if ( e ) {
 			if (is_externalPortConfigurationEnabled(DSDEF(ppi)) )
 				goto epc_out;
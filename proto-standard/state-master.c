@@ -57,7 +57,8 @@ static int master_handle_delay_request(struct pp_instance *ppi,
 		if (ppi->state == PPS_MASTER) { /* not pre-master */
 			if ( !msg_issue_delay_resp(ppi, &ppi->last_rcv_time) ) {
 				if (is_ext_hook_available(ppi,handle_dreq))
-					ppi->ext_hooks->handle_dreq(ppi);
+					PP_PROF_HOOK(ppi, PP_PROF_HANDLE_DREQ,
+						ppi->ext_hooks->handle_dreq(ppi));
 
 				/* Save active peer MAC address */
 				memcpy(ppi->activePeer,ppi->peer, sizeof(ppi->activePeer));
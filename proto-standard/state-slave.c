@@ -65,7 +65,9 @@ static int slave_handle_sync(struct pp_instance *ppi, void *buf,
 
 		/* Call the extension; it may do it all and ask to return */
 		if ( is_ext_hook_available(ppi,handle_sync) ) {
-			int ret = ppi->ext_hooks->handle_sync(ppi);
+			int ret = PP_PROF_HOOK(ppi, PP_PROF_HANDLE_SYNC,
+					       ppi->ext_hooks->handle_sync(ppi));
+
 			if (ret == 1)
 				return 0;
 			if (ret < 0)
@@ -114,7 +116,9 @@ static int slave_handle_followup(struct pp_instance *ppi, void *buf,
 		return 0;
 	/* Call the extension; it may do it all and ask to return */
 	if (is_ext_hook_available(ppi,handle_followup)) {
-		int ret = ppi->ext_hooks->handle_followup(ppi);
+		int ret = PP_PROF_HOOK(ppi, PP_PROF_HANDLE_FOLLOWUP,
+				       ppi->ext_hooks->handle_followup(ppi));
+
 		if (ret == 1)
 			return 0;
 		if (ret < 0)
@@ -163,7 +167,8 @@ static int slave_handle_response(struct pp_instance *ppi, void *buf,
 	}
 
 	if (is_ext_hook_available(ppi,handle_resp)) {
-		ret=ppi->ext_hooks->handle_resp(ppi);
+		ret = PP_PROF_HOOK(ppi, PP_PROF_HANDLE_RESP,
+				   ppi->ext_hooks->handle_resp(ppi));
 	}
 	else {
 		ret=pp_servo_got_resp(ppi,1);
@@ -279,7 +284,8 @@ int pp_slave(struct pp_instance *ppi, void *buf, int len)
 		pp_servo_init(ppi);
 
 		if (is_ext_hook_available(ppi,new_slave))
-			ret = ppi->ext_hooks->new_slave(ppi, buf, len);
+			ret = PP_PROF_HOOK(ppi, PP_PROF_NEW_SLAVE,
+				ppi->ext_hooks->new_slave(ppi, buf, len));
 		if (ret!=PP_SEND_OK)
 			goto out;
 	}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Network of the replay: received frames come from the trace, and sent
+ * frames go nowhere. The peers of the recording answered to the frames
+ * it sent, so a frame we send takes the time stamp and sequenceId of the
+ * recorded one: then the answers in the trace match our requests.
+ */
+#include <netinet/if_ether.h>
+#include <ppsi/ppsi.h>
+#include "ptpdump.h"
+#include "../arch-replay/ppsi-replay.h"
+
+/* The main loop only calls us when the frame in the trace is for this port */
+static int replay_net_recv(struct pp_instance *ppi, void *pkt, int len,
+			   struct pp_time *t)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+	struct pp_trace_rec *r = d->cur;
+	struct ethhdr *hdr = pkt;
+	int ret;
+
+	if (!r)
+		return 0;
+	ret = r->len + ppi->rx_offset < len ? r->len + ppi->rx_offset : len;
+	if (ppi->rx_offset) {
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->h_proto = htons(ETH_P_1588);
+	}
+	memcpy(pkt + ppi->rx_offset, r + 1, ret - ppi->rx_offset);
+
+	replay_pp_time(t, replay_ns(r->a, r->b) + d->delta_ns);
+	pp_diag(ppi, time, 2, "recv stamp: %i.%09i (%s)\n",
+		(int)t->secs, (int)(t->scaled_nsecs >> 16), "trace");
+	if (pp_diag_allow(ppi, frames, 2))
+		dump_payloadpkt("recv: ", pkt + ppi->rx_offset,
+				ret - ppi->rx_offset, t);
+	d->n_rx++;
+	return ret;
+}
+
+/* The recorded tx of this type, if any, close to the current time */
+static struct pp_trace_rec *replay_find_tx(struct replay_arch_data *d,
+					   int port, int type)
+{
+	struct replay_port *p = d->ports + port;
+	struct pp_trace_rec *r;
+	size_t pos;
+	uint8_t *msg;
+
+	for (pos = p->tx_pos[type]; (r = replay_rec_at(d, pos));
+	     pos += pp_trace_rec_size(r)) {
+		if (r->mono_ns > d->now_ns + REPLAY_TX_WINDOW_NS)
+			break;
+		if (r->type != PP_TRACE_TX || r->port != port || !r->len)
+			continue;
+		msg = (uint8_t *)(r + 1);
+		if ((msg[0] & 0x0f) != type)
+			continue;
+		/* Too old: we didn't send that one, don't look at it again */
+		p->tx_pos[type] = pos + pp_trace_rec_size(r);
+		if (r->mono_ns < d->now_ns - REPLAY_TX_WINDOW_NS)
+			continue;
+		return r;
+	}
+	return NULL;
+}
+
+static int replay_net_send(struct pp_instance *ppi, void *pkt, int len,
+			   enum pp_msg_format msg_fmt)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+	struct pp_time *t = &ppi->last_snt_time;
+	struct pp_trace_rec *r;
+	uint8_t *msg;
+	int type = *(uint8_t *)(pkt + ppi->tx_offset) & 0x0f;
+
+	r = replay_find_tx(d, ppi - ppi->glbs->pp_instances, type);
+	if (r && r->len >= 32) {
+		msg = (uint8_t *)(r + 1);
+		replay_pp_time(t, replay_ns(r->a, r->b) + d->delta_ns);
+		/* Answers in the trace have the recorded sequenceId */
+		if (type < ARRAY_SIZE(ppi->sent_seq))
+			ppi->sent_seq[type] = (msg[30] << 8) | msg[31];
+		memcpy(pkt + ppi->tx_offset + 30, msg + 30, 2);
+		d->n_tx_matched++;
+	} else {
+		ppi->t_ops->get(ppi, t);
+	}
+	if (pp_diag_allow(ppi, frames, 2))
+		dump_payloadpkt("send: ", pkt + ppi->tx_offset,
+				len - ppi->tx_offset, t);
+	d->n_tx++;
+	return len;
+}
+
+static int replay_net_exit(struct pp_instance *ppi)
+{
+	return 0;
+}
+
+/* The clockIdentity comes from the address: use the recorded one */
+static int replay_net_init(struct pp_instance *ppi)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+	struct replay_port *p = d->ports + (ppi - ppi->glbs->pp_instances);
+	int i;
+
+	pp_prepare_pointers(ppi);
+	for (i = PP_NP_GEN; i <= PP_NP_EVT; i++)
+		memcpy(ppi->ch[i].addr, p->mac, sizeof(p->mac));
+	pp_diag(ppi, frames, 1, "replay_net_init\n");
+	return 0;
+}
+
+const struct pp_network_operations replay_net_ops = {
+	.init = replay_net_init,
+	.exit = replay_net_exit,
+	.recv = replay_net_recv,
+	.send = replay_net_send,
+	.check_packet = NULL,
+};
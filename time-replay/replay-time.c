@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Time operations for the replay: a virtual clock that follows the
+ * recorded one, as explained in ppsi-replay.h. Timeouts run on the
+ * timeline of the recording, as unix timeouts use CLOCK_MONOTONIC.
+ */
+#include <math.h>
+#include <ppsi/ppsi.h>
+#include "../arch-replay/ppsi-replay.h"
+
+/* Move the timeline forward; our frequency may not be the recorded one */
+void replay_advance(struct replay_arch_data *d, int64_t to_ns)
+{
+	double x;
+	int64_t i;
+
+	if (to_ns <= d->now_ns)
+		return;
+	if (d->ppb != d->rec_ppb) {
+		x = (double)(d->ppb - d->rec_ppb) * (to_ns - d->now_ns) / 1e9
+			+ d->delta_frac;
+		i = (int64_t)floor(x);
+		d->delta_frac = x - i;
+		d->delta_ns += i;
+	}
+	d->now_ns = to_ns;
+}
+
+/* What the recorded instance did to its clock; the main loop calls us */
+void replay_recorded_time(struct replay_arch_data *d, struct pp_trace_rec *r)
+{
+	int64_t ns = replay_ns(r->a, r->b);
+
+	switch (r->type) {
+	case PP_TRACE_GET:
+		d->rec_ns = ns;
+		d->rec_at_ns = d->now_ns;
+		break;
+	case PP_TRACE_SET:
+		/* R jumps, our clock doesn't */
+		d->delta_ns += replay_rec_now(d) - ns;
+		d->rec_ns = ns;
+		d->rec_at_ns = d->now_ns;
+		break;
+	case PP_TRACE_ADJ:
+		/* Offsets are slewed by the kernel: take them as a step */
+		if (r->flags & PP_TRACE_ADJ_OFFSET) {
+			d->rec_ns += r->a;
+			d->delta_ns -= r->a;
+		}
+		if (r->flags & PP_TRACE_ADJ_FREQ)
+			d->rec_ppb = r->b;
+		break;
+	}
+}
+
+static int replay_time_get_utc_time(struct pp_instance *ppi, int *hours,
+				    int *minutes, int *seconds)
+{
+	/* no UTC time */
+	*hours = 0;
+	*minutes = 0;
+	*seconds = 0;
+	return -1;
+}
+
+static int replay_time_get_utc_offset(struct pp_instance *ppi, int *offset,
+				      int *leap59, int *leap61)
+{
+	/* no UTC offset */
+	*leap59 = 0;
+	*leap61 = 0;
+	*offset = 0;
+	return -1;
+}
+
+static int replay_time_set_utc_offset(struct pp_instance *ppi, int offset,
+				      int leap59, int leap61)
+{
+	/* no UTC offset */
+	return -1;
+}
+
+static int replay_time_get(struct pp_instance *ppi, struct pp_time *t)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+	int64_t ns = replay_rec_now(d) + d->delta_ns;
+
+	replay_pp_time(t, ns);
+
+	if (!(pp_global_d_flags & PP_FLAG_NOTIMELOG))
+		pp_diag(ppi, time, 2, "%s: %9li.%09li\n", __func__,
+			(long)t->secs, (long)(t->scaled_nsecs >> 16));
+	return 0;
+}
+
+static int replay_time_set(struct pp_instance *ppi, const struct pp_time *t)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+
+	if (!t) {
+		/* Change the network notion of utc/tai offset */
+		return 0;
+	}
+	d->delta_ns = replay_ns(t->secs, t->scaled_nsecs) - replay_rec_now(d);
+
+	pp_diag(ppi, time, 1, "%s: %9i.%09i\n", __func__,
+		(int)t->secs, (int)(t->scaled_nsecs >> 16));
+	return 0;
+}
+
+static int replay_time_adjust(struct pp_instance *ppi, long offset_ns,
+			      long freq_ppb)
+{
+	struct replay_arch_data *d = REPLAY_ARCH(ppi->glbs);
+
+	if (freq_ppb) {
+		if (freq_ppb > PP_ADJ_FREQ_MAX)
+			freq_ppb = PP_ADJ_FREQ_MAX;
+		if (freq_ppb < -PP_ADJ_FREQ_MAX)
+			freq_ppb = -PP_ADJ_FREQ_MAX;
+		d->ppb = freq_ppb;
+	}
+	if (offset_ns)
+		d->delta_ns += offset_ns;
+
+	pp_diag(ppi, time, 1, "%s: %li %li\n", __func__, offset_ns, freq_ppb);
+	return 0;
+}
+
+static int replay_adjust_freq(struct pp_instance *ppi, long freq_ppb)
+{
+	return replay_time_adjust(ppi, 0, freq_ppb);
+}
+
+static int replay_adjust_offset(struct pp_instance *ppi, long offset_ns)
+{
+	return replay_time_adjust(ppi, offset_ns, 0);
+}
+
+/* What the recorded one returned: startup found it in the trace */
+static int replay_init_servo(struct pp_instance *ppi)
+{
+	return REPLAY_ARCH(ppi->glbs)->ppb;
+}
+
+static unsigned long replay_calc_timeout(struct pp_instance *ppi,
+					 int millisec)
+{
+	return millisec + REPLAY_ARCH(ppi->glbs)->now_ns / 1000LL / 1000LL;
+}
+
+static int replay_get_GM_lock_state(struct pp_globals *ppg,
+				    pp_timing_mode_state_t *state)
+{
+	*state = PP_TIMING_MODE_STATE_LOCKED;
+	return 0;
+}
+
+static int replay_enable_timing_output(struct pp_globals *ppg, int enable)
+{
+	return 0;
+}
+
+const struct pp_time_operations replay_time_ops = {
+	.get_utc_time = replay_time_get_utc_time,
+	.get_utc_offset = replay_time_get_utc_offset,
+	.set_utc_offset = replay_time_set_utc_offset,
+	.get = replay_time_get,
+	.set = replay_time_set,
+	.adjust = replay_time_adjust,
+	.adjust_offset = replay_adjust_offset,
+	.adjust_freq = replay_adjust_freq,
+	.init_servo = replay_init_servo,
+	.calc_timeout = replay_calc_timeout,
+	.get_GM_lock_state = replay_get_GM_lock_state,
+	.enable_timing_output = replay_enable_timing_output,
+};
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Random models for the simulator: variable delay, loss and reordering
+ * of frames in each direction of a link, and noise of the oscillators.
+ * All values are drawn from generators seeded by "sim_seed": the network
+ * has a stream of its own, and so does each clock, so a change in the
+ * network model doesn't change the noise of the clocks.
+ */
+#include <math.h>
+#include <ppsi/ppsi.h>
+#include "../arch-sim/ppsi-sim.h"
+
+static uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static void sim_rand_seed(struct sim_rand *r, uint64_t seed)
+{
+	r->s = splitmix64(seed) | 1; /* xorshift can't leave 0 */
+}
+
+/* xorshift64*, good enough for this and much faster than rand() */
+static uint64_t sim_rand(struct sim_rand *r)
+{
+	r->s ^= r->s >> 12;
+	r->s ^= r->s << 25;
+	r->s ^= r->s >> 27;
+	return r->s * 0x2545f4914f6cdd1dULL;
+}
+
+/* In [0, 1) */
+double sim_rand_u01(struct sim_rand *r)
+{
+	return (sim_rand(r) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/* Box-Muller, one value out of the two */
+double sim_rand_gauss(struct sim_rand *r)
+{
+	double u = 1.0 - sim_rand_u01(r); /* not 0 */
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * sim_rand_u01(r));
+}
+
+static double sim_rand_exp(struct sim_rand *r)
+{
+	return -log(1.0 - sim_rand_u01(r));
+}
+
+void sim_models_init(struct sim_world *w)
+{
+	struct sim_clock_noise *n;
+	int i;
+
+	sim_rand_seed(&w->rand, w->seed);
+	for (i = 0; i < w->n_clocks; i++) {
+		n = &SIM_PPG_ARCH(w->clocks[i])->noise;
+		sim_rand_seed(&n->rand, w->seed + 0x10000ULL * (i + 1));
+		n->enabled = n->rw_ppb || n->temp_ppb || n->flicker_adev;
+		n->next_step_ns = w->now_ns;
+	}
+}
+
+/*
+ * Mean queueing delay, relative to the one at 50% load, as in a M/M/1
+ * queue: rho / (1 - rho). Load is capped at 95%, 19 times the delay.
+ */
+static double sim_load_factor(struct sim_world *w, struct pp_sim_net_delay *nd)
+{
+	int64_t period_ns = nd->load_period_s * (int64_t)PP_NSEC_PER_SEC;
+	double rho = nd->load_lo, x;
+
+	if (!nd->load_lo && !nd->load_hi)
+		return 1.0;
+	if (period_ns) {
+		x = (double)(w->now_ns % period_ns) / period_ns;
+		switch (nd->load_profile) {
+		case SIM_LOAD_SQUARE:
+			rho = x < 0.5 ? nd->load_hi : nd->load_lo;
+			break;
+		case SIM_LOAD_RAMP:
+			x = x < 0.5 ? 2 * x : 2 - 2 * x;
+			rho = nd->load_lo + x * (nd->load_hi - nd->load_lo);
+			break;
+		}
+	}
+	rho /= 100.0;
+	if (rho > 0.95)
+		rho = 0.95;
+	return rho / (1 - rho);
+}
+
+int sim_net_lost(struct sim_world *w, struct pp_sim_net_delay *nd)
+{
+	return nd->loss_ppm && sim_rand_u01(&w->rand) * 1e6 < nd->loss_ppm;
+}
+
+/* The variable part of the delay, including reordering */
+int64_t sim_net_jitter_ns(struct sim_world *w, struct pp_sim_net_delay *nd)
+{
+	struct sim_rand *r = &w->rand;
+	double d, mean = nd->jit_ns * sim_load_factor(w, nd);
+	int i, shape;
+
+	switch (nd->pdv) {
+	case SIM_PDV_EXP:
+		d = mean * sim_rand_exp(r);
+		break;
+	case SIM_PDV_GAMMA:
+		/* sum of exponentials, as the shape is an integer */
+		shape = nd->pdv_shape > 0 ? nd->pdv_shape : 2;
+		for (i = 0, d = 0; i < shape; i++)
+			d += sim_rand_exp(r);
+		d *= mean / shape;
+		break;
+	case SIM_PDV_BIMODAL:
+		/* two modes, mean apart, each 1/10 of that wide */
+		d = mean * sim_rand_u01(r) / 10;
+		if (sim_rand_u01(r) * 100 < (nd->pdv_shape ? nd->pdv_shape : 10))
+			d += mean;
+		break;
+	default:
+		d = mean * sim_rand_u01(r);
+		break;
+	}
+	if (nd->reorder_ppm && sim_rand_u01(r) * 1e6 < nd->reorder_ppm)
+		d += nd->reorder_ns;
+	return (int64_t)d;
+}
+
+/* A sinusoidal change of the propagation delay; opposite ones are asymmetry */
+int64_t sim_net_wander_ns(struct sim_world *w, struct pp_sim_net_delay *nd)
+{
+	int64_t period_ns = nd->wander_period_s * (int64_t)PP_NSEC_PER_SEC;
+
+	if (!nd->wander_ns || !period_ns)
+		return 0;
+	return (int64_t)(nd->wander_ns *
+		sin(2 * M_PI * (w->now_ns % period_ns) / period_ns));
+}
+
+static void sim_noise_step(struct sim_clock_noise *n, int64_t now_ns)
+{
+	double dt = SIM_NOISE_STEP_NS / 1e9, a, s, tau;
+	int64_t period_ns = n->temp_period_s * (int64_t)PP_NSEC_PER_SEC;
+	int i;
+
+	n->rw_state_ppb += n->rw_ppb * sqrt(dt) * sim_rand_gauss(&n->rand);
+	n->ppb = n->rw_state_ppb;
+
+	if (n->flicker_adev) {
+		s = n->flicker_adev * 1e9 / M_SQRT2; /* ppb */
+		for (i = 0, tau = 1.0; i < SIM_FLICKER_OCTAVES; i++, tau *= 2) {
+			a = exp(-dt / tau);
+			n->flicker_ppb[i] = a * n->flicker_ppb[i] +
+				s * sqrt(1 - a * a) * sim_rand_gauss(&n->rand);
+			n->ppb += n->flicker_ppb[i];
+		}
+	}
+	if (n->temp_ppb && period_ns)
+		n->ppb += n->temp_ppb *
+			sin(2 * M_PI * (now_ns % period_ns) / period_ns);
+}
+
+/* Called before the world time advances by ff_ns */
+void sim_clock_noise(struct sim_world *w, struct pp_globals *ppg,
+		     int64_t ff_ns)
+{
+	struct sim_ppg_arch_data *data = SIM_PPG_ARCH(ppg);
+	struct sim_clock_noise *n = &data->noise;
+	int64_t now = w->now_ns, end = w->now_ns + ff_ns, dt, i;
+	double x;
+
+	if (!n->enabled)
+		return;
+	while (now < end) {
+		if (now >= n->next_step_ns) {
+			sim_noise_step(n, now);
+			n->next_step_ns = now + SIM_NOISE_STEP_NS;
+		}
+		dt = (end < n->next_step_ns ? end : n->next_step_ns) - now;
+		x = n->ppb * dt / 1e9 + n->frac_ns;
+		i = (int64_t)floor(x);
+		n->frac_ns = x - i;
+		data->time.current_ns += i;
+		now += dt;
+	}
+}
+
+int64_t sim_stamp_noise_ns(struct pp_instance *ppi)
+{
+	struct sim_clock_noise *n = &SIM_PPG_ARCH(ppi->glbs)->noise;
+
+	if (!n->wpm_ns)
+		return 0;
+	return llround(n->wpm_ns * sim_rand_gauss(&n->rand));
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2013 CERN (www.cern.ch)
+ * Author: Pietro Fezzardi (pietrofezzardi@gmail.com)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Simulated network, in memory: a frame sent is copied in a pending
+ * packet for each peer, and handed over when the packet is received.
+ * There are no sockets and no system calls.
+ */
+
+#include <stdlib.h>
+
+#include <ppsi/ppsi.h>
+#include "ptpdump.h"
+#include "../arch-sim/ppsi-sim.h"
+
+/*
+ * Returns 1 if p1 has higher priority than p2: it expires earlier. With the
+ * same expire time, the one sent first is received first: this keeps the
+ * simulation deterministic, and a Sync before its Follow_Up.
+ */
+static int compare_pending(struct sim_pending_pkt *p1,
+				struct sim_pending_pkt *p2)
+{
+	if (p1->at_ns != p2->at_ns)
+		return p1->at_ns < p2->at_ns;
+	return p1->seq < p2->seq;
+}
+
+static void swap_pending(struct sim_pending_pkt *p1,
+			 struct sim_pending_pkt *p2)
+{
+	struct sim_pending_pkt tmp = *p1;
+
+	*p1 = *p2;
+	*p2 = tmp;
+}
+
+/* Binary heap: sift the new packet up from the bottom */
+static int insert_pending(struct sim_world *w, struct sim_pending_pkt *new)
+{
+	struct sim_pending_pkt *heap;
+	int i, n;
+
+	if (w->n_pending == w->max_pending) {
+		n = w->max_pending ? 2 * w->max_pending : 64;
+		heap = realloc(w->pending, n * sizeof(*heap));
+		if (!heap) {
+			pp_error("%s: out of memory\n", __func__);
+			return -1;
+		}
+		w->pending = heap;
+		w->max_pending = n;
+	}
+	heap = w->pending;
+	new->seq = w->pending_seq++;
+	i = w->n_pending++;
+	heap[i] = *new;
+	while (i > 0 && compare_pending(heap + i, heap + (i - 1) / 2)) {
+		swap_pending(heap + i, heap + (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	return 0;
+}
+
+/* Remove the head: move the last one there and sift it down */
+static int pending_received(struct sim_world *w)
+{
+	struct sim_pending_pkt *heap = w->pending;
+	int i, child;
+
+	if (w->n_pending == 0)
+		return 0;
+	heap[0] = heap[--w->n_pending];
+	for (i = 0; (child = 2 * i + 1) < w->n_pending; i = child) {
+		if (child + 1 < w->n_pending &&
+		    compare_pending(heap + child + 1, heap + child))
+			child++;
+		if (!compare_pending(heap + child, heap + i))
+			break;
+		swap_pending(heap + i, heap + child);
+	}
+	return 0;
+}
+
+/* Compare the requestingPortIdentity of a Delay_Resp with the port */
+static int sim_resp_is_ours(struct pp_instance *ppi, void *pkt)
+{
+	struct PortIdentity *id = &ppi->portDS->portIdentity;
+	unsigned char *req = pkt + 44;
+
+	return !memcmp(req, &id->clockIdentity, PP_CLOCK_IDENTITY_LENGTH) &&
+		((req[8] << 8) | req[9]) == id->portNumber;
+}
+
+/* The main loop only calls us when the pending packet is for this port */
+static int sim_net_recv(struct pp_instance *ppi, void *pkt, int len,
+		   struct pp_time *t)
+{
+	struct sim_world *w = SIM_WORLD(ppi->glbs);
+	struct sim_pending_pkt *p = w->pending;
+	int64_t ofm;
+	int ret;
+
+	if (w->n_pending <= 0)
+		return 0;
+
+	ret = p->len < len ? p->len : len;
+	memcpy(pkt, p->frame, ret);
+
+	ppi->t_ops->get(ppi, t);
+	/* This is not really hw... */
+	pp_diag(ppi, time, 2, "recv stamp: %i.%09i (%s)\n",
+		(int)t->secs, (int)(t->scaled_nsecs >> 16), "user");
+	/*
+	 * If we got a DelayResponse print out the offset from master, i.e.
+	 * from the clock of the port that sent it. Masters with several
+	 * slaves send it to all of them: only count the one for this port.
+	 */
+	if (((*(Enumeration4 *) (pkt + 0)) & 0x0F) == PPM_DELAY_RESP &&
+	    sim_resp_is_ours(ppi, pkt)) {
+		ofm = SIM_TIME(ppi)->current_ns - SIM_TIME(p->src)->current_ns;
+		pp_diag(ppi, ext, 1, "Real ofm %lli\n", (long long)ofm);
+		/* For tools/sim-batch: port, simulated time, offset */
+		if (w->print_samples)
+			pp_printf("sim-sample %s %lli %lli\n", ppi->port_name,
+				  (long long)w->now_ns, (long long)ofm);
+		w->sim_iter_n++;
+	}
+
+	if (pp_diag_allow(ppi, frames, 2))
+		dump_payloadpkt("recv: ", pkt, ret, t);
+	/* remove received packet from pending */
+	free(p->frame);
+	pending_received(w);
+	return ret;
+}
+
+/* Every peer of the port receives the frame, after the delay of its link */
+static int sim_net_send(struct pp_instance *ppi, void *pkt, int len,enum pp_msg_format msg_fmt)
+{
+	const struct pp_msgtype_info *mf = pp_msgtype_info + msg_fmt;
+	int chtype = mf->chtype;
+	struct pp_time *t = &ppi->last_snt_time;
+	struct sim_world *w = SIM_WORLD(ppi->glbs);
+	struct sim_link *l;
+	struct pp_sim_net_delay *nd;
+	struct pp_instance *peer;
+	struct sim_pending_pkt pending;
+	int64_t jit_ns;
+	int i, dir;
+
+	if (t)
+		ppi->t_ops->get(ppi, t);
+	if (pp_diag_allow(ppi, frames, 2))
+		dump_payloadpkt("send: ", pkt, len, t);
+
+	for (i = 0; i < w->n_links; i++) {
+		l = w->links + i;
+		if (l->port[0] == ppi)
+			dir = 0;
+		else if (l->port[1] == ppi)
+			dir = 1;
+		else
+			continue;
+		peer = l->port[!dir];
+		nd = l->n_delay + dir;
+		if (sim_net_lost(w, nd))
+			continue;
+
+		/* check if we are sending a FollowUp. In this case we have to
+		 * add the previous jitter, that was added to the previous Sync.
+		 * Sync and FollowUp are sent out during the same cycle of the
+		 * state machine. The simulator is not designed to fast-forward
+		 * the time from within a cycle of state machine, so Sync and
+		 * FollowUp are sent out without any time interval in the
+		 * middle. The simulator acts like if they were sent exactly at
+		 * the same time. So we need a way to be sure that the FollowUp
+		 * is received after the Sync. This can be done adding the
+		 * jitter of the Sync to the one of the FollowUp. In this way
+		 * the first will always arrive first to the destination and
+		 * will not cause the FollowUp to be discarded by the slave
+		 * state machine when it comes earlier then the Sync */
+		jit_ns = 0;
+		if (((*(Enumeration4 *) (pkt + 0)) & 0x0F) == PPM_FOLLOW_UP)
+			jit_ns += nd->last_outgoing_jit_ns;
+		jit_ns += sim_net_jitter_ns(w, nd);
+		/* store the jitter, used from the next send if it is a FollowUp */
+		nd->last_outgoing_jit_ns = jit_ns;
+
+		/* store pending packets in the world */
+		pending.dst = peer;
+		pending.src = ppi;
+		pending.chtype = chtype;
+		pending.at_ns = w->now_ns + nd->t_prop_ns + jit_ns +
+			sim_net_wander_ns(w, nd);
+		if (pending.at_ns < w->now_ns)
+			pending.at_ns = w->now_ns;
+		pending.frame = malloc(len);
+		pending.len = len;
+		if (!pending.frame)
+			return -1;
+		memcpy(pending.frame, pkt, len);
+		if (insert_pending(w, &pending) < 0) {
+			free(pending.frame);
+			return -1;
+		}
+	}
+	return len;
+}
+
+static int sim_net_exit(struct pp_instance *ppi)
+{
+	return 0;
+}
+
+static int sim_net_init(struct pp_instance *ppi)
+{
+	int i;
+
+	/* The buffer is inside ppi, but we need to set pointers and align */
+	pp_prepare_pointers(ppi);
+
+	/*
+	 * The clockIdentity comes from this address: make it locally
+	 * administered, with the clock index, plus the port index (that
+	 * state-initializing subtracts for the other ports). So the first
+	 * clock has the best identity, and the others don't drop its frames.
+	 */
+	for (i = PP_NP_GEN; i <= PP_NP_EVT; i++) {
+		ppi->ch[i].addr[0] = 0x02;
+		ppi->ch[i].addr[3] = SIM_PPG_ARCH(ppi->glbs)->index >> 8;
+		ppi->ch[i].addr[4] = SIM_PPG_ARCH(ppi->glbs)->index;
+		ppi->ch[i].addr[5] = ppi - ppi->glbs->pp_instances;
+	}
+	pp_diag(ppi, frames, 1, "sim_net_init\n");
+	return 0;
+}
+
+const struct pp_network_operations sim_net_ops = {
+	.init = sim_net_init,
+	.exit = sim_net_exit,
+	.recv = sim_net_recv,
+	.send = sim_net_send,
+	.check_packet = NULL,
+};
@@ -15,95 +15,66 @@
 #include <ppsi/ppsi.h>
 #include "../arch-sim/ppsi-sim.h"
 
-void update_and_print_propagation_delays(struct pp_globals *ppg)
+/* When enabled, every step makes the propagation of all links longer */
+#define SIM_DELAY_STEP_NS 10000
+
+void update_and_print_propagation_delays(struct sim_world *w)
 {
-    struct sim_ppi_arch_data *master_data, *slave_data;
-    struct pp_instance *master_ppi, *slave_ppi;
-    struct sim_ppg_arch_data *ppg_data = SIM_PPG_ARCH(ppg);
-
-	if (!ppg_data->enable_runtime_delay_updates) {
-        return; // Skip updates if disabled
-    }
-    
-    // Get instances
-    master_ppi = pp_sim_get_master(ppg);
-    slave_ppi = pp_sim_get_slave(ppg);
-    master_data = SIM_PPI_ARCH(master_ppi);
-    slave_data = SIM_PPI_ARCH(slave_ppi);
-    
-    // Store old delays to calculate the change
-    unsigned int old_master_delay = master_data->n_delay.t_prop_ns;
-    unsigned int old_slave_delay = slave_data->n_delay.t_prop_ns;
-    
-    // Print current values
-    pp_diag(0, ext, 3, "Current propagation delays:\n");
-    pp_diag(0, ext, 3, "  Master->Slave: %u ns\n", old_master_delay);
-    pp_diag(0, ext, 3, "  Slave->Master: %u ns\n", old_slave_delay);
-    
-    // Update delays (your logic here)
-    master_data->n_delay.t_prop_ns += 10000;  // Example: +10μs
-    slave_data->n_delay.t_prop_ns += 10000;
-    
-    // Calculate the change in delays
-    int master_delay_change = (int)master_data->n_delay.t_prop_ns - (int)old_master_delay;
-    int slave_delay_change = (int)slave_data->n_delay.t_prop_ns - (int)old_slave_delay;
-    
-    // Adjust in-flight packets - they should arrive later if delay increased
-    if (ppg_data->n_pending > 0) {
-        for (int i = 0; i < ppg_data->n_pending; i++) {
-            struct sim_pending_pkt *pkt = &ppg_data->pending[i];
-            
-            if (pkt->which_ppi == SIM_SLAVE) {
-                // Master->Slave packet in flight
-                pkt->delay_ns += master_delay_change;
-                pp_diag(NULL, ext, 3, "Adjusted M->S packet delay by %d ns\n", master_delay_change);
-            } else if (pkt->which_ppi == SIM_MASTER) {
-                // Slave->Master packet in flight  
-                pkt->delay_ns += slave_delay_change;
-                pp_diag(NULL, ext, 3, "Adjusted S->M packet delay by %d ns\n", slave_delay_change);
-            }
-            
-            // Ensure delay doesn't go negative
-            if (pkt->delay_ns < 0) {
-                pkt->delay_ns = 0;
-            }
-        }
-    }
-    
-    // Print new values
-    pp_diag(0, ext, 3, "Updated propagation delays:\n");
-    pp_diag(0, ext, 3, "  Master->Slave: %u ns\n", master_data->n_delay.t_prop_ns);
-    pp_diag(0, ext, 3, "  Slave->Master: %u ns\n", slave_data->n_delay.t_prop_ns);
+	struct sim_link *l;
+	struct sim_pending_pkt *pkt;
+	int i;
+
+	if (!w->enable_runtime_delay_updates)
+		return;
+
+	for (i = 0; i < w->n_links; i++) {
+		l = w->links + i;
+		l->n_delay[0].t_prop_ns += SIM_DELAY_STEP_NS;
+		l->n_delay[1].t_prop_ns += SIM_DELAY_STEP_NS;
+		pp_diag(NULL, ext, 3, "Propagation delays %s->%s %u ns, "
+			"%s->%s %u ns\n",
+			l->port[0]->port_name, l->port[1]->port_name,
+			l->n_delay[0].t_prop_ns,
+			l->port[1]->port_name, l->port[0]->port_name,
+			l->n_delay[1].t_prop_ns);
+	}
+
+	/*
+	 * In-flight packets arrive later, as the delay increased. They all
+	 * move by the same amount, so the heap is still in order
+	 */
+	for (i = 0; i < w->n_pending; i++) {
+		pkt = &w->pending[i];
+		pkt->at_ns += SIM_DELAY_STEP_NS;
+		pp_diag(NULL, ext, 3, "Adjusted %s->%s packet delay by %d ns\n",
+			pkt->src->port_name, pkt->dst->port_name,
+			SIM_DELAY_STEP_NS);
+	}
 }
 
-int sim_fast_forward_ns(struct pp_globals *ppg, int64_t ff_ns)
+int sim_fast_forward_ns(struct sim_world *w, int64_t ff_ns)
 {
 	struct pp_sim_time_instance *t_inst;
 	int i;
 	int64_t tmp;
 
-	for (i = 0; i < ppg->nlinks; i++) {
-		t_inst = &SIM_PPI_ARCH(INST(ppg, i))->time;
+	for (i = 0; i < w->n_clocks; i++) {
+		t_inst = &SIM_PPG_ARCH(w->clocks[i])->time;
 		tmp = ff_ns + t_inst->freq_ppb_real * ff_ns / 1000 / 1000 / 1000;
 		t_inst->current_ns += tmp + (t_inst->freq_ppb_servo) *
 						tmp / 1000 / 1000 / 1000;
+		sim_clock_noise(w, w->clocks[i], ff_ns);
 	}
 	pp_diag(0, ext, 2, "%s: %lli ns\n", __func__, (long long)ff_ns);
 
-	update_and_print_propagation_delays(ppg);
+	w->now_ns += ff_ns;
+	update_and_print_propagation_delays(w);
 
-	struct sim_pending_pkt *pkt;
-	struct sim_ppg_arch_data *data = SIM_PPG_ARCH(ppg);
-	if (data->n_pending) {
-		for (i = 0; i < data->n_pending; i++) {
-			pkt = &data->pending[i];
-			pkt->delay_ns -= ff_ns;
-			if (pkt->delay_ns < 0) {
-				pp_error("pkt->delay_ns = %lli\n",
-						(long long)pkt->delay_ns);
-				exit(1);
-			}
-		}
+	/* Fast forwarding beyond the next packet is a bug */
+	if (w->n_pending && sim_pending_delay_ns(w) < 0) {
+		pp_error("pending packet delay = %lli\n",
+			 (long long)sim_pending_delay_ns(w));
+		exit(1);
 	}
 
 	return 0;
@@ -141,12 +112,15 @@ static int sim_time_get_servo_state(struct pp_instance *ppi, int *state)
 }
 #endif
 
+/* Time stamps come from here too, so white phase noise is added */
 static int sim_time_get(struct pp_instance *ppi, struct pp_time *t)
 {
-	t->scaled_nsecs = (SIM_PPI_ARCH(ppi)->time.current_ns %
-			   (long long)PP_NSEC_PER_SEC) << 16;
-	t->secs = SIM_PPI_ARCH(ppi)->time.current_ns /
-		(long long)PP_NSEC_PER_SEC;
+	int64_t ns = SIM_TIME(ppi)->current_ns + sim_stamp_noise_ns(ppi);
+
+	if (ns < 0)
+		ns = SIM_TIME(ppi)->current_ns;
+	t->scaled_nsecs = (ns % (long long)PP_NSEC_PER_SEC) << 16;
+	t->secs = ns / (long long)PP_NSEC_PER_SEC;
 
 	if (!(pp_global_d_flags & PP_FLAG_NOTIMELOG))
 		pp_diag(ppi, time, 2, "%s: %9li.%09li\n", __func__,
@@ -161,7 +135,7 @@ static int sim_time_set(struct pp_instance *ppi, const struct pp_time *t)
 		return 0;
 	}
 
-	SIM_PPI_ARCH(ppi)->time.current_ns = (t->scaled_nsecs >> 16)
+	SIM_TIME(ppi)->current_ns = (t->scaled_nsecs >> 16)
 				+ t->secs * (long long)PP_NSEC_PER_SEC;
 
 	pp_diag(ppi, time, 1, "%s: %9i.%09i\n", __func__,
@@ -177,11 +151,11 @@ static int sim_time_adjust(struct pp_instance *ppi, long offset_ns,
 			freq_ppb = PP_ADJ_FREQ_MAX;
 		if (freq_ppb < -PP_ADJ_FREQ_MAX)
 			freq_ppb = -PP_ADJ_FREQ_MAX;
-		SIM_PPI_ARCH(ppi)->time.freq_ppb_servo = freq_ppb;
+		SIM_TIME(ppi)->freq_ppb_servo = freq_ppb;
 	}
 
 	if (offset_ns)
-		SIM_PPI_ARCH(ppi)->time.current_ns += offset_ns;
+		SIM_TIME(ppi)->current_ns += offset_ns;
 
 	pp_diag(ppi, time, 1, "%s: %li %li\n", __func__, offset_ns, freq_ppb);
 	return 0;
@@ -199,12 +173,12 @@ static int sim_adjust_offset(struct pp_instance *ppi, long offset_ns)
 
 static inline int sim_init_servo(struct pp_instance *ppi)
 {
-	return SIM_PPI_ARCH(ppi)->time.freq_ppb_real;
+	return SIM_TIME(ppi)->freq_ppb_real;
 }
 
 static unsigned long sim_calc_timeout(struct pp_instance *ppi, int millisec)
 {
-	return millisec + SIM_PPI_ARCH(ppi)->time.current_ns / 1000LL / 1000LL;
+	return millisec + SIM_TIME(ppi)->current_ns / 1000LL / 1000LL;
 }
 
 static int sim_get_GM_lock_state(struct pp_globals *ppg,
@@ -147,9 +147,11 @@ static int unix_net_recv(struct pp_instance *ppi, void *pkt, int len,
 
 		memcpy(ppi->peer, hdr->h_source, ETH_ALEN);
 		if (pp_diag_allow(ppi, frames, 2)) {
-			if (ppi->proto == PPSI_PROTO_VLAN)
-				pp_printf("recv: VLAN %i\n", ppi->peer_vid);
-			dump_1588pkt("recv: ", pkt, ret, t, -1);
+			int vlan = ppi->proto == PPSI_PROTO_VLAN ?
+				ppi->peer_vid : -1;
+
+			if (!unix_diag_1588pkt(ppi, "recv: ", pkt, ret, t, vlan))
+				dump_1588pkt("recv: ", pkt, ret, t, vlan);
 		}
 		return ret;
 
@@ -167,7 +169,8 @@ static int unix_net_recv(struct pp_instance *ppi, void *pkt, int len,
 		if (ret <= 0)
 			return ret;
 		/* We can't save the peer's mac address in UDP mode */
-		if (pp_diag_allow(ppi, frames, 2))
+		if (pp_diag_allow(ppi, frames, 2) &&
+		    !unix_diag_payloadpkt(ppi, "recv: ", pkt, ret, t))
 			dump_payloadpkt("recv: ", pkt, ret, t);
 		return ret;
 
@@ -223,7 +226,8 @@ static int unix_net_send(struct pp_instance *ppi, void *pkt, int len,enum pp_msg
 		pp_diag(ppi, time, 1, "send stamp: %lli.%09i (%s)\n",
 			(long long)t->secs, (int)(t->scaled_nsecs >> 16),
 			"user");
-		if (pp_diag_allow(ppi, frames, 2))
+		if (pp_diag_allow(ppi, frames, 2) &&
+		    !unix_diag_1588pkt(ppi, "send: ", pkt, len, t, -1))
 			dump_1588pkt("send: ", pkt, len, t, -1);
 		return ret;
 
@@ -248,7 +252,9 @@ static int unix_net_send(struct pp_instance *ppi, void *pkt, int len,enum pp_msg
 		pp_diag(ppi, time, 1, "send stamp: %lli.%09i (%s)\n",
 			(long long)t->secs, (int)(t->scaled_nsecs >> 16),
 			"user");
-		if (pp_diag_allow(ppi, frames, 2))
+		if (pp_diag_allow(ppi, frames, 2) &&
+		    !unix_diag_1588pkt(ppi, "send: ", vhdr, len, t,
+				       ppi->peer_vid))
 			dump_1588pkt("send: ", vhdr, len, t, ppi->peer_vid);
 
 	case PPSI_PROTO_UDP:
@@ -269,7 +275,8 @@ static int unix_net_send(struct pp_instance *ppi, void *pkt, int len,enum pp_msg
 		pp_diag(ppi, time, 1, "send stamp: %lli.%09i (%s)\n",
 			(long long)t->secs, (int)(t->scaled_nsecs >> 16),
 			"user");
-		if (pp_diag_allow(ppi, frames, 2))
+		if (pp_diag_allow(ppi, frames, 2) &&
+		    !unix_diag_payloadpkt(ppi, "send: ", pkt, len, t))
 			dump_payloadpkt("send: ", pkt, len, t);
 		return ret;
 
@@ -589,13 +596,19 @@ static int unix_net_check_packet(struct pp_globals *ppg, int delay_ms)
 	int ret = 0;
 	int maxfd = -1;
 	struct unix_arch_data *arch_data = POSIX_ARCH(ppg);
-	int old_delay_ms;
+	int64_t old_delay_us;
+	int waiting;
 
-	old_delay_ms = arch_data->tv.tv_sec * 1000 +
-		arch_data->tv.tv_usec / 1000;
+	/*
+	 * Compare in microseconds: the remaining time may be below 1ms,
+	 * and taking it for an expired timeout would replace it with a
+	 * longer one, making the next wakeup late.
+	 */
+	old_delay_us = arch_data->tv.tv_sec * 1000000LL +
+		arch_data->tv.tv_usec;
 
 	if ((delay_ms >=0 ) &&
-		((old_delay_ms == 0) || (delay_ms < old_delay_ms))) {
+		((old_delay_us == 0) || (delay_ms * 1000LL < old_delay_us))) {
 		/* Wait for a packet or for the timeout */
 		arch_data->tv.tv_sec = delay_ms / 1000;
 		arch_data->tv.tv_usec = (delay_ms % 1000) * 1000;
@@ -618,6 +631,12 @@ static int unix_net_check_packet(struct pp_globals *ppg, int delay_ms)
 			maxfd = fd_to_set > maxfd ? fd_to_set : maxfd;
 		}
 	}
+	for (k = 0; k < arch_data->n_aux_fd; k++) {
+		FD_SET(arch_data->aux_fd[k].fd, &set);
+		if (arch_data->aux_fd[k].fd > maxfd)
+			maxfd = arch_data->aux_fd[k].fd;
+	}
+	waiting = arch_data->tv.tv_sec || arch_data->tv.tv_usec;
 	i = select(maxfd + 1, &set, NULL, NULL, &arch_data->tv);
 
 	if ( i < 0 ) {
@@ -632,6 +651,13 @@ static int unix_net_check_packet(struct pp_globals *ppg, int delay_ms)
 	}
 	if (i == 0)
 		return 0;
+	/*
+	 * The timeout expired too: report it first, or the new delay would
+	 * replace it and the instances would not run in time. The frames
+	 * are still there for the next call.
+	 */
+	if (waiting && !arch_data->tv.tv_sec && !arch_data->tv.tv_usec)
+		return 0;
 
 	for (j = 0; j < ppg->nlinks; j++) {
 		struct pp_instance *ppi = INST(ppg, j);
@@ -649,7 +675,14 @@ static int unix_net_check_packet(struct pp_globals *ppg, int delay_ms)
 			ppi->ch[PP_NP_EVT].pkt_present = 1;
 		}
 	}
-	return ret;
+	for (k = 0; k < arch_data->n_aux_fd; k++) {
+		struct unix_aux_fd *aux = arch_data->aux_fd + k;
+
+		if (FD_ISSET(aux->fd, &set))
+			aux->action(ppg, aux->fd);
+	}
+	/* Only other descriptors: keep consuming the current timeout */
+	return ret ? ret : -1;
 }
 
 const struct pp_network_operations unix_net_ops = {
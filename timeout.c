@@ -93,6 +93,11 @@ void pp_timeout_disable_all(struct pp_instance *ppi) {
 	}
 }
 
+const char *pp_timeout_name(int index)
+{
+	return timeOutConfigs[index].name;
+}
+
 /* Return counter index or -1 if not available */
 int pp_timeout_get_timer(struct pp_instance *ppi, int index, to_rand_t rand) {
 	timeOutInstCnt_t *tmoCnt;
@@ -264,9 +269,11 @@ int pp_timeout(struct pp_instance *ppi, int index)
 
 	now=TOPS(ppi)->calc_timeout(ppi, 0);
 	ret = time_after_eq(now,tmoCnt->tmo);
-	if (ret)
+	if (ret) {
 		pp_diag(ppi, time, 1, "timeout expired: %s - %lu\n",
 				timeOutConfigs[index].name,now);
+		pp_metrics_timeout(ppi, index);
+	}
 	return ret;
 }
 
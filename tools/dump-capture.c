@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU GPL, version 2 or any later version.
+ */
+
+/*
+ * Capture mode of ptpdump: frames are read from a TPACKET_V3 ring, so the
+ * kernel hands over a block of frames at a time, and are written as
+ * pcap-ng with nanosecond time stamps. Writing is done by another thread,
+ * through a large buffer: a slow disk doesn't stop us from draining the
+ * ring, which is what makes the kernel drop frames.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#include "ptpdump.h"
+
+#define CAPTURE_BLOCK_SIZE	(1 << 20)
+#define CAPTURE_FRAME_SIZE	2048
+#define CAPTURE_BLOCK_TOV_MS	50	/* hand over a block at least so often */
+#define CAPTURE_FIFO_SIZE	(64 << 20)
+
+/* pcap-ng block types and options */
+#define PCAPNG_SHB		0x0a0d0d0a
+#define PCAPNG_IDB		0x00000001
+#define PCAPNG_ISB		0x00000005
+#define PCAPNG_EPB		0x00000006
+#define PCAPNG_BYTE_ORDER	0x1a2b3c4d
+#define PCAPNG_OPT_END		0
+#define PCAPNG_SHB_USERAPPL	4
+#define PCAPNG_IF_NAME		2
+#define PCAPNG_IF_TSRESOL	9
+#define PCAPNG_ISB_IFRECV	4
+#define PCAPNG_ISB_OSDROP	7
+#define PCAPNG_ISB_USRDELIV	8
+#define PCAPNG_LINKTYPE_ETHERNET 1
+
+/*
+ * PTP over Ethernet or over UDP/IPv4 to port 319 or 320, both with an
+ * optional VLAN tag (incoming tags are usually stripped by the kernel
+ * and found in the ring header instead). Fragments are not PTP.
+ */
+static struct sock_filter ptp_filter[] = {
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_1588, 21, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 12, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_8021Q, 0, 20),
+	/* VLAN */
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 16),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_1588, 17, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 17),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 18 + 9),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 15),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 18 + 6),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 13, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 18),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 18 + 2),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 319, 9, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 320, 8, 9),
+	/* IPv4 */
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 14 + 9),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 7),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 14 + 6),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 5, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 14 + 2),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 319, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 320, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 0x40000),	/* accept */
+	BPF_STMT(BPF_RET | BPF_K, 0),		/* drop */
+};
+
+int ptpdump_attach_filter(int sock)
+{
+	struct sock_fprog prog = {
+		.len = sizeof(ptp_filter) / sizeof(ptp_filter[0]),
+		.filter = ptp_filter,
+	};
+
+	return setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER,
+			  &prog, sizeof(prog));
+}
+
+/* Blocks for the writer; head and tail only grow, positions are modulo */
+struct capture_fifo {
+	unsigned char *buf;
+	size_t head, tail;
+	int done;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	FILE *f;
+	int error;
+};
+
+static volatile sig_atomic_t capture_stop;
+
+static void capture_signal(int sig)
+{
+	capture_stop = 1;
+}
+
+static void *capture_writer(void *arg)
+{
+	struct capture_fifo *fifo = arg;
+	size_t pos, n;
+
+	pthread_mutex_lock(&fifo->lock);
+	while (1) {
+		while (fifo->head == fifo->tail && !fifo->done)
+			pthread_cond_wait(&fifo->cond, &fifo->lock);
+		if (fifo->head == fifo->tail)
+			break;
+		/* Write what is there, up to the end of the buffer */
+		pos = fifo->tail % CAPTURE_FIFO_SIZE;
+		n = fifo->head - fifo->tail;
+		if (n > CAPTURE_FIFO_SIZE - pos)
+			n = CAPTURE_FIFO_SIZE - pos;
+		pthread_mutex_unlock(&fifo->lock);
+		if (!fifo->error && fwrite(fifo->buf + pos, n, 1, fifo->f) != 1)
+			fifo->error = errno;
+		pthread_mutex_lock(&fifo->lock);
+		fifo->tail += n;
+	}
+	pthread_mutex_unlock(&fifo->lock);
+	return NULL;
+}
+
+/* Called with the lock held; the caller checked there is space */
+static void fifo_put(struct capture_fifo *fifo, const void *data, size_t len)
+{
+	size_t pos = fifo->head % CAPTURE_FIFO_SIZE;
+	size_t n = len < CAPTURE_FIFO_SIZE - pos ? len : CAPTURE_FIFO_SIZE - pos;
+
+	memcpy(fifo->buf + pos, data, n);
+	memcpy(fifo->buf, data + n, len - n);
+	fifo->head += len;
+}
+
+/* An option is code, length and value, padded to 32 bits */
+static int pcapng_opt(uint8_t *p, int code, const void *val, int len)
+{
+	uint16_t hdr[2] = {code, len};
+	int padded = (len + 3) & ~3;
+
+	memcpy(p, hdr, sizeof(hdr));
+	memset(p + 4, 0, padded);
+	memcpy(p + 4, val, len);
+	return 4 + padded;
+}
+
+/* Header and trailer of a block around its body, already in b + 8 */
+static int pcapng_block(uint8_t *b, uint32_t type, int body_len)
+{
+	uint32_t len = 12 + body_len;
+
+	memcpy(b, &type, 4);
+	memcpy(b + 4, &len, 4);
+	memcpy(b + 8 + body_len, &len, 4);
+	return len;
+}
+
+static int pcapng_header(FILE *f, const char *ifname)
+{
+	static const char appl[] = "ppsi ptpdump";
+	uint8_t b[256], res = 9; /* nanoseconds */
+	uint32_t u32;
+	uint16_t u16[2];
+	int64_t section_len = -1;
+	int n;
+
+	u32 = PCAPNG_BYTE_ORDER;
+	u16[0] = 1; /* version 1.0 */
+	u16[1] = 0;
+	memcpy(b + 8, &u32, 4);
+	memcpy(b + 12, u16, 4);
+	memcpy(b + 16, &section_len, 8);
+	n = 16;
+	n += pcapng_opt(b + 8 + n, PCAPNG_SHB_USERAPPL, appl, strlen(appl));
+	n += pcapng_opt(b + 8 + n, PCAPNG_OPT_END, NULL, 0);
+	n = pcapng_block(b, PCAPNG_SHB, n);
+	if (fwrite(b, n, 1, f) != 1)
+		return -1;
+
+	u16[0] = PCAPNG_LINKTYPE_ETHERNET;
+	u16[1] = 0;
+	u32 = 65535; /* snaplen */
+	memcpy(b + 8, u16, 4);
+	memcpy(b + 12, &u32, 4);
+	n = 8;
+	n += pcapng_opt(b + 8 + n, PCAPNG_IF_NAME, ifname,
+			strnlen(ifname, 64));
+	n += pcapng_opt(b + 8 + n, PCAPNG_IF_TSRESOL, &res, 1);
+	n += pcapng_opt(b + 8 + n, PCAPNG_OPT_END, NULL, 0);
+	n = pcapng_block(b, PCAPNG_IDB, n);
+	return fwrite(b, n, 1, f) == 1 ? 0 : -1;
+}
+
+/* Interface statistics at the end of the capture */
+static int pcapng_stats(FILE *f, uint64_t ts_ns, uint64_t recv,
+			uint64_t drop, uint64_t deliv)
+{
+	uint8_t b[128];
+	uint32_t u32[3] = {0, ts_ns >> 32, ts_ns};
+	int n = 12;
+
+	memcpy(b + 8, u32, 12);
+	n += pcapng_opt(b + 8 + n, PCAPNG_ISB_IFRECV, &recv, 8);
+	n += pcapng_opt(b + 8 + n, PCAPNG_ISB_OSDROP, &drop, 8);
+	n += pcapng_opt(b + 8 + n, PCAPNG_ISB_USRDELIV, &deliv, 8);
+	n += pcapng_opt(b + 8 + n, PCAPNG_OPT_END, NULL, 0);
+	n = pcapng_block(b, PCAPNG_ISB, n);
+	return fwrite(b, n, 1, f) == 1 ? 0 : -1;
+}
+
+struct capture_stats {
+	unsigned long frames, fifo_drops;
+	uint64_t last_ns;
+};
+
+/* Queue one frame from the ring, putting back its VLAN tag if stripped */
+static void capture_frame(struct capture_fifo *fifo, struct tpacket3_hdr *h,
+			  struct capture_stats *st, int verbose)
+{
+	uint8_t *data = (uint8_t *)h + h->tp_mac;
+	uint32_t epb[7], caplen = h->tp_snaplen, len = h->tp_len;
+	uint64_t ns = h->tp_sec * 1000000000ULL + h->tp_nsec;
+	uint16_t tag[2];
+	int vlan = -1, pad;
+	struct pp_time ti;
+
+	if (h->tp_status & TP_STATUS_VLAN_VALID) {
+		vlan = h->hv1.tp_vlan_tci & 0xfff;
+		tag[0] = htons(h->tp_status & TP_STATUS_VLAN_TPID_VALID ?
+			       h->hv1.tp_vlan_tpid : ETH_P_8021Q);
+		tag[1] = htons(h->hv1.tp_vlan_tci);
+	}
+	if (verbose) {
+		ti.secs = h->tp_sec;
+		ti.scaled_nsecs = (int64_t)h->tp_nsec << 16;
+		ptpdump_frame(data, caplen, &ti, vlan);
+	}
+	if (vlan >= 0 && caplen >= 12) {
+		caplen += 4;
+		len += 4;
+	}
+	pad = -caplen & 3;
+	epb[0] = PCAPNG_EPB;
+	epb[1] = 12 + 20 + caplen + pad;
+	epb[2] = 0;
+	epb[3] = ns >> 32;
+	epb[4] = ns;
+	epb[5] = caplen;
+	epb[6] = len;
+
+	if (CAPTURE_FIFO_SIZE - (fifo->head - fifo->tail) < epb[1]) {
+		st->fifo_drops++;
+		return;
+	}
+	fifo_put(fifo, epb, sizeof(epb));
+	if (vlan >= 0 && caplen >= 16) {
+		fifo_put(fifo, data, 12);
+		fifo_put(fifo, tag, 4);
+		fifo_put(fifo, data + 12, caplen - 16);
+	} else {
+		fifo_put(fifo, data, caplen);
+	}
+	fifo_put(fifo, "\0\0\0", pad);
+	fifo_put(fifo, epb + 1, 4);
+	st->frames++;
+	st->last_ns = ns;
+}
+
+int ptpdump_capture(int sock, const char *ifname, const char *fname,
+		    int ring_mb, unsigned long count, int verbose)
+{
+	struct tpacket_req3 req;
+	struct tpacket_block_desc *bd;
+	struct tpacket_stats_v3 kstats;
+	struct capture_fifo fifo;
+	struct capture_stats st;
+	struct pollfd pfd;
+	struct tpacket3_hdr *h;
+	pthread_t writer;
+	socklen_t slen;
+	uint8_t *ring;
+	int val = TPACKET_V3, blk = 0, i;
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = CAPTURE_BLOCK_SIZE;
+	req.tp_block_nr = ring_mb;
+	req.tp_frame_size = CAPTURE_FRAME_SIZE;
+	req.tp_frame_nr = req.tp_block_nr *
+		(CAPTURE_BLOCK_SIZE / CAPTURE_FRAME_SIZE);
+	req.tp_retire_blk_tov = CAPTURE_BLOCK_TOV_MS;
+	if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) < 0
+	    || setsockopt(sock, SOL_PACKET, PACKET_RX_RING,
+			  &req, sizeof(req)) < 0) {
+		fprintf(stderr, "ptpdump: TPACKET_V3 ring: %s\n",
+			strerror(errno));
+		return -1;
+	}
+	ring = mmap(NULL, (size_t)req.tp_block_size * req.tp_block_nr,
+		    PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+	if (ring == MAP_FAILED) {
+		fprintf(stderr, "ptpdump: mmap(ring): %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&fifo, 0, sizeof(fifo));
+	memset(&st, 0, sizeof(st));
+	fifo.f = strcmp(fname, "-") ? fopen(fname, "w") : stdout;
+	if (!fifo.f) {
+		fprintf(stderr, "ptpdump: %s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+	fifo.buf = malloc(CAPTURE_FIFO_SIZE);
+	if (!fifo.buf || pcapng_header(fifo.f, ifname) < 0) {
+		fprintf(stderr, "ptpdump: %s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+	pthread_mutex_init(&fifo.lock, NULL);
+	pthread_cond_init(&fifo.cond, NULL);
+	if (pthread_create(&writer, NULL, capture_writer, &fifo)) {
+		fprintf(stderr, "ptpdump: can't create writer thread\n");
+		return -1;
+	}
+	signal(SIGINT, capture_signal);
+	signal(SIGTERM, capture_signal);
+	fprintf(stderr, "Capturing to \"%s\" (ring of %i MB)\n", fname, ring_mb);
+
+	pfd.fd = sock;
+	pfd.events = POLLIN | POLLERR;
+	while (!capture_stop && (!count || st.frames < count)) {
+		bd = (void *)(ring + (size_t)blk * req.tp_block_size);
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+			poll(&pfd, 1, 100);
+			continue;
+		}
+		h = (void *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+		pthread_mutex_lock(&fifo.lock);
+		for (i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+			if (!count || st.frames < count)
+				capture_frame(&fifo, h, &st, verbose);
+			h = (void *)((uint8_t *)h + h->tp_next_offset);
+		}
+		pthread_cond_signal(&fifo.cond);
+		pthread_mutex_unlock(&fifo.lock);
+		/* Give the block back to the kernel */
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		blk = (blk + 1) % req.tp_block_nr;
+	}
+
+	pthread_mutex_lock(&fifo.lock);
+	fifo.done = 1;
+	pthread_cond_signal(&fifo.cond);
+	pthread_mutex_unlock(&fifo.lock);
+	pthread_join(writer, NULL);
+
+	slen = sizeof(kstats);
+	memset(&kstats, 0, sizeof(kstats));
+	getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &kstats, &slen);
+	pcapng_stats(fifo.f, st.last_ns, kstats.tp_packets, kstats.tp_drops,
+		     st.frames);
+	if (fclose(fifo.f) < 0 && !fifo.error)
+		fifo.error = errno;
+	fprintf(stderr, "%lu frames written, %u dropped by the kernel, "
+		"%lu by ptpdump\n", st.frames, kstats.tp_drops, st.fifo_drops);
+	if (fifo.error) {
+		fprintf(stderr, "ptpdump: %s: %s\n", fname,
+			strerror(fifo.error));
+		return -1;
+	}
+	return 0;
+}
@@ -42,7 +42,7 @@ void print_spaces(struct pp_time *ti)
 
 		diffms = (ti->secs - prev_ti.secs) * 1000
 			+ ((ti->scaled_nsecs >> 16) / 1000 / 1000)
-			- ((prev_ti.scaled_nsecs) / 1000 / 1000);
+			- ((prev_ti.scaled_nsecs >> 16) / 1000 / 1000);
 		/* empty lines, one every .25 seconds, at most 10 of them */
 		for (i = 250; i < 2500 && i < diffms; i += 250)
 			printf("\n");
@@ -52,22 +52,126 @@ void print_spaces(struct pp_time *ti)
 }
 
 
+/* Print a frame, starting from the Ethernet header, if it is PTP */
+int ptpdump_frame(void *buf, int len, struct pp_time *ti, int vlan)
+{
+	struct ethhdr *eth;
+	struct pp_vlanhdr *vhdr;
+	struct iphdr *ip;
+	int proto, ret;
+
+	if (len < ETH_HLEN)
+		return -1;
+
+	eth = buf;
+	ip = buf + ETH_HLEN;
+
+	proto = ntohs(eth->h_proto);
+
+	/* Get the VLAN for outgoing frames */
+	if (proto == 0x8100) { /* VLAN is visible (e.g.: outgoing) */
+		vhdr = buf;
+		proto = ntohs(vhdr->h_proto);
+		ip = buf + sizeof(*vhdr);
+		vlan = ntohs(vhdr->h_tci) & 0xfff;
+	}
+
+	switch(proto) {
+	case ETH_P_IP:
+	{
+		struct udphdr *udp = (void *)(ip + 1);
+		int udpdest = ntohs(udp->dest);
+
+		/*
+		 * Filter before calling the dump function, otherwise
+		 * we'll report TIMEDELAY for not-relevant frames
+		 */
+		if (len < ETH_HLEN + sizeof(*ip) + sizeof(*udp))
+			return -1;
+		if (ip->protocol != IPPROTO_UDP)
+			return -1;
+		if (udpdest != 319 && udpdest != 320)
+			return -1;
+		print_spaces(ti);
+		ret = dump_udppkt("", buf, len, ti, vlan);
+		break;
+	}
+
+	case ETH_P_1588:
+		print_spaces(ti);
+		ret = dump_1588pkt("", buf, len, ti, vlan);
+		break;
+	default:
+		return -1;
+	}
+	if (ret == 0)
+		putchar('\n');
+	return ret;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Use: \"%s [-w <file.pcapng>] [-b <ring-MB>] "
+		"[-c <count>] [-a] [-v] [<ifname>]\"\n"
+		"   -w <file>   capture to pcap-ng (\"-\" is stdout)\n"
+		"   -b <MB>     size of the capture ring (default 16)\n"
+		"   -c <count>  stop after so many frames\n"
+		"   -a          all frames, not only PTP (no kernel filter)\n"
+		"   -v          when capturing, print frames too\n", name);
+	exit(1);
+}
+
 int main(int argc, char **argv)
 {
-	int sock, ret;
+	int sock;
 	struct packet_mreq req;
 	struct sockaddr_ll addr;
 	struct ifreq ifr;
 	char *ifname = "eth0";
-	int val;
+	char *fname = NULL;
+	unsigned long count = 0, n_frames = 0;
+	int val, opt, ring_mb = 16, all = 0, verbose = 0;
+
+	while ((opt = getopt(argc, argv, "w:b:c:av")) != -1) {
+		switch (opt) {
+		case 'w':
+			fname = optarg;
+			break;
+		case 'b':
+			ring_mb = atoi(optarg);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			all = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc - 1 || ring_mb <= 0)
+		usage(argv[0]);
+	if (optind < argc)
+		ifname = argv[optind];
+	if (fname && verbose && !strcmp(fname, "-"))
+		usage(argv[0]); /* both on stdout */
 
 	sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
 	if (sock < 0) {
 		fprintf(stderr, "%s: socket(): %s\n", argv[0], strerror(errno));
 		exit(1);
 	}
-	if (argc > 1)
-		ifname = argv[1];
+
+	/* Filter in the kernel, before binding: no other frame comes in */
+	if (!all && ptpdump_attach_filter(sock) < 0) {
+		fprintf(stderr, "%s: attach filter: %s\n", argv[0],
+			strerror(errno));
+		exit(1);
+	}
 
 	memset(&ifr, 0, sizeof(ifr));
 	strcpy(ifr.ifr_name, ifname);
@@ -102,6 +206,10 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (fname)
+		return ptpdump_capture(sock, ifname, fname, ring_mb, count,
+				       verbose) ? 1 : 0;
+
 	/* enable AUXDATA */
 	val = 1;
 	if (setsockopt(sock, SOL_PACKET, PACKET_AUXDATA,
@@ -113,9 +221,6 @@ int main(int argc, char **argv)
 
 	/* Ok, now we are promiscuous. Just read stuff forever */
 	while(1) {
-		struct ethhdr *eth;
-		struct pp_vlanhdr *vhdr;
-		struct iphdr *ip;
 		unsigned char buf[1500];
 		struct pp_time ti;
 		struct timeval tv;
@@ -128,8 +233,8 @@ int main(int argc, char **argv)
 		} control;
 		struct cmsghdr *cmsg;
 		struct tpacket_auxdata *aux = NULL;
-		int vlan = 0;
-		int len, proto;
+		int vlan = -1;
+		int len;
 
 		memset(&msg, 0, sizeof(msg));
 		memset(&from_addr, 0, sizeof(from_addr));
@@ -162,61 +267,15 @@ int main(int argc, char **argv)
 				aux = (struct tpacket_auxdata *)dp;
 		}
 
-		/* now only print ptp packets */
-		if (len < ETH_HLEN)
-			continue;
-
-		eth = (void *)buf;
-		ip = (void *)(buf + ETH_HLEN);
-
-		proto = ntohs(eth->h_proto);
-
 		/* get the VLAN for incomming frames */
-		vlan = -1;
 		if (aux && aux->tp_status & TP_STATUS_VLAN_VALID) {
 			/* already in the network order */
 			vlan = aux->tp_vlan_tci & 0xfff;
 		}
 
-		/* Get the VLAN for outgoing frames */
-		if (proto == 0x8100) { /* VLAN is visible (e.g.: outgoing) */
-			vhdr = (void *)buf;
-			proto = ntohs(vhdr->h_proto);
-			ip = (void *)(buf + sizeof(*vhdr));
-			vlan = ntohs(vhdr->h_tci) & 0xfff;
-		}
-
-		switch(proto) {
-		case ETH_P_IP:
-		{
-			struct udphdr *udp = (void *)(ip + 1);
-			int udpdest = ntohs(udp->dest);
-
-			/*
-			 * Filter before calling the dump function, otherwise
-			 * we'll report TIMEDELAY for not-relevant frames
-			 */
-			if (len < ETH_HLEN + sizeof(*ip) + sizeof(*udp))
-				continue;
-			if (ip->protocol != IPPROTO_UDP)
-				continue;
-			if (udpdest != 319 && udpdest != 320)
-				continue;
-			print_spaces(&ti);
-			ret = dump_udppkt("", buf, len, &ti, vlan);
+		if (ptpdump_frame(buf, len, &ti, vlan) == 0 && count &&
+		    ++n_frames == count)
 			break;
-		}
-
-		case ETH_P_1588:
-			print_spaces(&ti);
-			ret = dump_1588pkt("", buf, len, &ti, vlan);
-			break;
-		default:
-			ret = -1;
-			continue;
-		}
-		if (ret == 0)
-			putchar('\n');
 		fflush(stdout);
 	}
 
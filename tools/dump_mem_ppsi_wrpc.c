@@ -208,28 +208,28 @@ struct dump_info  dump_ppsi_info[] = {
 #define DUMP_STRUCT struct pp_instance
 
 	DUMP_HEADER("pp_instance"),
+	/* hot data */
 	DUMP_FIELD(ppi_state, state),
 	DUMP_FIELD(ppi_state, next_state),
 	DUMP_FIELD(int, next_delay),
 	DUMP_FIELD(yes_no, is_new_state),
 	DUMP_FIELD(pointer, current_state_item),
-	DUMP_FIELD(pointer, arch_inst_data),
-	DUMP_FIELD(pointer, ext_data),
+	DUMP_FIELD(ppi_flag, flags),
+	DUMP_FIELD(yes_no_Boolean, link_up),
+	DUMP_FIELD(yes_no_Boolean, bmca_execute), /* True: Ask fsm to run bmca state decision */
+	DUMP_FIELD(pp_pdstate, pdstate),  /* Protocol detection state */
+	DUMP_FIELD(exstate, extState), /* Extension state */
 	DUMP_FIELD(protocol_extension, protocol_extension),
 	DUMP_FIELD(pointer, ext_hooks),
+	DUMP_FIELD(pointer, ext_data),
 	DUMP_FIELD(unsigned_long, d_flags),
-	DUMP_FIELD(ppi_flag, flags),
-	DUMP_FIELD(ppi_proto, proto),
-	DUMP_FIELD(delay_mechanism, delayMechanism),
 	DUMP_FIELD(pointer, glbs),
-	DUMP_FIELD(pointer, n_ops),
-	DUMP_FIELD(pointer, t_ops),
-	DUMP_FIELD(pointer, __tx_buffer),
-	DUMP_FIELD(pointer, __rx_buffer),
-	DUMP_FIELD(pointer, tx_frame),
-	DUMP_FIELD(pointer, rx_frame),
-	DUMP_FIELD(pointer, tx_ptp),
-	DUMP_FIELD(pointer, rx_ptp),
+	DUMP_FIELD(pointer, portDS),
+	DUMP_FIELD(pointer, servo),
+	DUMP_FIELD(int, port_idx),
+	DUMP_FIELD(UInteger16, frgn_rec_num),
+	DUMP_FIELD(Integer16,  frgn_rec_best),
+// 	timeOutInstCnt_t tmo_cfg[PP_TO_COUNT];
 
 	/* This is a sub-structure */
 	DUMP_FIELD(int, ch[0].fd),
@@ -243,10 +243,23 @@ struct dump_info  dump_ppsi_info[] = {
 	DUMP_FIELD_SIZE(bina, ch[1].addr, 6),
 	DUMP_FIELD(yes_no, ch[1].pkt_present),
 
-	DUMP_FIELD(ip_address, mcast_addr[0]),
-	DUMP_FIELD(ip_address, mcast_addr[1]),
+	/* per-frame data */
+	DUMP_FIELD(pointer, arch_inst_data),
+	DUMP_FIELD(ppi_proto, proto),
+	DUMP_FIELD(delay_mechanism, delayMechanism),
+	DUMP_FIELD(pointer, n_ops),
+	DUMP_FIELD(pointer, t_ops),
+	DUMP_FIELD(pointer, __tx_buffer),
+	DUMP_FIELD(pointer, __rx_buffer),
+	DUMP_FIELD(pointer, tx_frame),
+	DUMP_FIELD(pointer, rx_frame),
+	DUMP_FIELD(pointer, tx_ptp),
+	DUMP_FIELD(pointer, rx_ptp),
 	DUMP_FIELD(int, tx_offset),
 	DUMP_FIELD(int, rx_offset),
+
+	DUMP_FIELD(ip_address, mcast_addr[0]),
+	DUMP_FIELD(ip_address, mcast_addr[1]),
 	DUMP_FIELD_SIZE(bina, peer, 6),
 	DUMP_FIELD_SIZE(bina, activePeer, 6),
 	DUMP_FIELD(uint16_t, peer_vid),
@@ -260,12 +273,17 @@ struct dump_info  dump_ppsi_info[] = {
 	DUMP_FIELD(UInteger64, syncCF),
 	DUMP_FIELD(pp_time, last_rcv_time),
 	DUMP_FIELD(pp_time, last_snt_time),
-	DUMP_FIELD(UInteger16, frgn_rec_num),
-	DUMP_FIELD(Integer16,  frgn_rec_best),
-	DUMP_FIELD(UInteger32, frgn_master_time_window_ms),
-	DUMP_FIELD(dummy /*struct pp_frgn_master */, frgn_master), /* use dummy type just to save the offset */
-	DUMP_FIELD(pointer, portDS),
-	DUMP_FIELD(pointer, servo),
+
+	DUMP_FIELD(UInteger16, recv_sync_sequence_id),
+
+	//DUMP_FIELD(UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]),
+
+	DUMP_FIELD_SIZE(bina, received_ptp_header, sizeof(MsgHeader)),
+	DUMP_FIELD(yes_no_Boolean, received_dresp), /* Count the number of delay response messages received for a given delay request */
+	DUMP_FIELD(yes_no_Boolean, received_dresp_fup), /* Count the number of delay response follow up messages received for a given delay request */
+
+	DUMP_FIELD(unsigned_long, ptp_tx_count),
+	DUMP_FIELD(unsigned_long, ptp_rx_count),
 
 	/*  dump of substructure asymmetryCorrectionPortDS_t; 1588-2019 8.2.17 */
 	DUMP_FIELD(TimeInterval, asymmetryCorrectionPortDS.constantAsymmetry),
@@ -278,20 +296,16 @@ struct dump_info  dump_ppsi_info[] = {
 	DUMP_FIELD(TimeInterval, timestampCorrectionPortDS.messageTimestampPointLatency),
 	DUMP_FIELD(TimeInterval, timestampCorrectionPortDS.semistaticLatency),
 
+	/* cold data */
+	DUMP_FIELD(UInteger32, frgn_master_time_window_ms),
+	DUMP_FIELD(dummy /*struct pp_frgn_master */, frgn_master), /* use dummy type just to save the offset */
+
 	/* dump of substructure externalPortConfigurationPortDS_t; 1588-2019 8.2.28 */
 	DUMP_FIELD(ppi_state_Enumeration8, externalPortConfigurationPortDS.desiredState),
-	
-// 	timeOutInstCnt_t tmo_cfg[PP_TO_COUNT];
-	DUMP_FIELD(UInteger16, recv_sync_sequence_id),
-
-	//DUMP_FIELD(UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]),
-
-	DUMP_FIELD_SIZE(bina, received_ptp_header, sizeof(MsgHeader)),
+	DUMP_FIELD(yes_no_Boolean, ptp_fallback), /* True if allow pure PTP support */
 
-	DUMP_FIELD(yes_no_Boolean, link_up),
 	DUMP_FIELD_SIZE(char, iface_name, 16), /* for direct actions on hardware */
 	DUMP_FIELD_SIZE(char, port_name, 16), /* for diagnostics, mainly */
-	DUMP_FIELD(int, port_idx),
 	DUMP_FIELD(int, vlans_array_len),
 	/* FIXME: array */
 // 	int vlans[CONFIG_VLAN_ARRAY_SIZE];
@@ -304,15 +318,6 @@ struct dump_info  dump_ppsi_info[] = {
 	DUMP_FIELD(delay_mechanism, cfg.delayMechanism),
 	/* FIXME: other fields from cfg */
 
-	DUMP_FIELD(unsigned_long, ptp_tx_count),
-	DUMP_FIELD(unsigned_long, ptp_rx_count),
-	DUMP_FIELD(yes_no_Boolean, received_dresp), /* Count the number of delay response messages received for a given delay request */
-	DUMP_FIELD(yes_no_Boolean, received_dresp_fup), /* Count the number of delay response follow up messages received for a given delay request */
-	DUMP_FIELD(yes_no_Boolean, ptp_fallback), /* True if allow pure PTP support */
-	DUMP_FIELD(yes_no_Boolean, bmca_execute), /* True: Ask fsm to run bmca state decision */
-	DUMP_FIELD(pp_pdstate, pdstate),  /* Protocol detection state */
-	DUMP_FIELD(exstate, extState), /* Extension state */
-
 #undef DUMP_STRUCT
 #define DUMP_STRUCT struct pp_frgn_master
 	DUMP_HEADER_SIZE("pp_frgn_master", sizeof(struct pp_frgn_master)),
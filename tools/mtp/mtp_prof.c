@@ -0,0 +1,746 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU GPL, version 2 or any later version.
+ */
+
+/*
+ * mtp_prof: timestamp latency profiler, built on the mtp exchange.
+ *
+ * Each flow is a thread running the mtp_udp exchange at a fixed rate:
+ * FORWARD (t1) is reflected as BACKWARD (t2, t3, t4), then BACKSTAMP
+ * brings back t2 and t3. Every stamp is taken at three points: in the
+ * application (clock_gettime around send/recv), by the kernel
+ * (software SO_TIMESTAMPING) and by the NIC (raw hardware stamps),
+ * so the profiler reports the legs as seen at each point and the
+ * distance between points. Distributions are kept in log-linear
+ * histograms ("HDR" style, 1/32 relative precision).
+ *
+ * Unlike stamp-funcs.c, nothing here is global: flows run in parallel.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <linux/errqueue.h>
+
+#include "mtp.h"
+#include "net_tstamp.h" /* copied from Linux headers */
+#include "misc-common.h"
+
+#ifndef SOF_TIMESTAMPING_OPT_ID
+# define SOF_TIMESTAMPING_OPT_ID (1 << 7)
+#endif
+#ifndef SOF_TIMESTAMPING_OPT_TSONLY
+# define SOF_TIMESTAMPING_OPT_TSONLY (1 << 11)
+#endif
+
+#define MTP_PORT 0x6d74		/* 'm' 't', as mtp_udp */
+#define MAX_FLOWS 64
+#define MAX_SIZE 9000
+#define TX_WAIT_MS 10		/* for the tx stamps in the error queue */
+#define RX_WAIT_MS 200		/* for the answers, then the packet is lost */
+
+enum src { SRC_APP, SRC_SW, SRC_HW, NSRC };
+static char *src_names[NSRC] = {"app", "sw", "hw"};
+
+/* One stamp for each point; a zero one is missing */
+struct stamps {
+	struct timespec t[NSRC];
+};
+
+/*
+ * Log-linear histogram of signed nanoseconds: values below 64 have their
+ * own bucket, then each power of two is split in 32 buckets.
+ */
+#define HDR_SUB_BITS 5
+#define HDR_SUB (1 << HDR_SUB_BITS)
+#define HDR_MAX_BITS 41		/* about 36 minutes */
+#define HDR_NB ((HDR_MAX_BITS - HDR_SUB_BITS + 1) * HDR_SUB)
+
+struct hdr {
+	uint64_t pos[HDR_NB], neg[HDR_NB];
+	uint64_t count;
+	int64_t min, max;
+	double sum, sum2;
+};
+
+static int hdr_index(uint64_t v)
+{
+	int msb, shift;
+
+	if (v < 2 * HDR_SUB)
+		return v;
+	msb = 63 - __builtin_clzll(v);
+	if (msb >= HDR_MAX_BITS)
+		return HDR_NB - 1;
+	shift = msb - HDR_SUB_BITS;
+	return (shift + 1) * HDR_SUB + (v >> shift) - HDR_SUB;
+}
+
+/* The middle of a bucket, the value reported for it */
+static uint64_t hdr_value(int i)
+{
+	int shift;
+
+	if (i < 2 * HDR_SUB)
+		return i;
+	shift = i / HDR_SUB - 1;
+	return ((uint64_t)(HDR_SUB + i % HDR_SUB) << shift) +
+		(1ULL << shift) / 2;
+}
+
+static void hdr_add(struct hdr *h, int64_t v)
+{
+	if (v < 0)
+		h->neg[hdr_index(-v)]++;
+	else
+		h->pos[hdr_index(v)]++;
+	if (!h->count || v < h->min)
+		h->min = v;
+	if (!h->count || v > h->max)
+		h->max = v;
+	h->count++;
+	h->sum += v;
+	h->sum2 += (double)v * v;
+}
+
+static void hdr_merge(struct hdr *h, struct hdr *other)
+{
+	int i;
+
+	if (!other->count)
+		return;
+	for (i = 0; i < HDR_NB; i++) {
+		h->pos[i] += other->pos[i];
+		h->neg[i] += other->neg[i];
+	}
+	if (!h->count || other->min < h->min)
+		h->min = other->min;
+	if (!h->count || other->max > h->max)
+		h->max = other->max;
+	h->count += other->count;
+	h->sum += other->sum;
+	h->sum2 += other->sum2;
+}
+
+/* Walk from the most negative value to the most positive one */
+static int64_t hdr_percentile(struct hdr *h, double p)
+{
+	uint64_t rank = p * h->count, seen = 0;
+	int64_t v;
+	int i;
+
+	for (i = HDR_NB - 1; i >= 0; i--)
+		if ((seen += h->neg[i]) > rank)
+			break;
+	if (i >= 0) {
+		v = -(int64_t)hdr_value(i);
+	} else {
+		for (i = 0; i < HDR_NB; i++)
+			if ((seen += h->pos[i]) > rank)
+				break;
+		v = hdr_value(i < HDR_NB ? i : HDR_NB - 1);
+	}
+	return v < h->min ? h->min : v > h->max ? h->max : v;
+}
+
+/*
+ * What is measured: the legs as seen at each point, and the distance
+ * between points at each stamp (tx: kernel after application, rx:
+ * application after kernel; hardware is compared with the kernel).
+ */
+enum leg { LEG_RTT, LEG_FWD, LEG_BWD, LEG_REMOTE, NLEG };
+static char *leg_names[NLEG] = {"rtt", "fwd", "bwd", "remote"};
+
+enum cmp { CMP_APP_SW, CMP_HW_SW, NCMP };
+static char *cmp_names[NCMP] = {"app-sw", "hw-sw"};
+
+struct flow_stats {
+	struct hdr leg[NLEG][NSRC];
+	struct hdr cmp[4][NCMP];	/* for t1..t4 */
+	unsigned long sent, received, lost, bad, no_txstamp;
+};
+
+struct flow {
+	int index;
+	pthread_t thread;
+	int sock, report_sock;		/* report_sock: reflector only */
+	uint32_t tx_id;			/* packets sent on sock, for OPT_ID */
+	struct sockaddr_in peer;
+	struct flow_stats st;
+};
+
+/* Configuration, from the command line */
+static int opt_listen, opt_flows = 1, opt_size = sizeof(struct mtp_packet);
+static int opt_rate = 100, opt_port = MTP_PORT, opt_verbose;
+static long opt_count = 1000;
+static char *opt_iface, *opt_hist;
+static int hw_enabled;
+static volatile int stop;
+
+static struct flow *flows;
+
+static void sighandler(int sig)
+{
+	stop = 1;
+}
+
+static int64_t ts_ns(struct timespec *ts)
+{
+	return ts->tv_sec * 1000LL * 1000 * 1000 + ts->tv_nsec;
+}
+
+static int ts_valid(struct timespec *ts)
+{
+	return ts->tv_sec || ts->tv_nsec;
+}
+
+/* Stamps of a received message: software is ts[0], hardware ts[2] */
+static void collect_rx(struct msghdr *msg, struct stamps *s)
+{
+	struct cmsghdr *cmsg;
+	struct timespec *ts;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SO_TIMESTAMPING)
+			continue;
+		ts = (struct timespec *)CMSG_DATA(cmsg);
+		s->t[SRC_SW] = ts[0];
+		s->t[SRC_HW] = ts[2];
+	}
+}
+
+static int recv_stamped(int sock, void *buf, int len, struct stamps *s,
+			struct sockaddr_in *from)
+{
+	struct msghdr msg;
+	struct iovec iov = {buf, len};
+	char control[512];
+	int ret;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_name = from;
+	msg.msg_namelen = from ? sizeof(*from) : 0;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	ret = recvmsg(sock, &msg, MSG_DONTWAIT);
+	clock_gettime(CLOCK_REALTIME, &s->t[SRC_APP]);
+	if (ret < 0)
+		return ret;
+	collect_rx(&msg, s);
+	return ret;
+}
+
+/* Stamps that came too late, when we are waiting for data */
+static void drain_errqueue(int sock)
+{
+	char control[512];
+	struct msghdr msg;
+
+	do {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+	} while (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0);
+}
+
+/*
+ * The tx stamps of packet "id" come back in the error queue, software
+ * and hardware possibly in two messages. Older ones are dropped.
+ */
+static int collect_tx(struct flow *f, uint32_t id, struct stamps *s)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct sock_extended_err *err;
+	struct timespec *ts, sw, hw;
+	struct pollfd pfd = {f->sock, 0, 0};
+	char control[512];
+	int want_hw = hw_enabled, got_sw = 0, got_hw = 0, match;
+
+	while (!got_sw || (want_hw && !got_hw)) {
+		if (poll(&pfd, 1, TX_WAIT_MS) <= 0)
+			break;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(f->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+		match = 0;
+		memset(&sw, 0, sizeof(sw));
+		memset(&hw, 0, sizeof(hw));
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+			    cmsg->cmsg_type == SO_TIMESTAMPING) {
+				ts = (struct timespec *)CMSG_DATA(cmsg);
+				sw = ts[0];
+				hw = ts[2];
+				continue;
+			}
+			err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+			if ((cmsg->cmsg_level == SOL_IP ||
+			     cmsg->cmsg_level == SOL_IPV6) &&
+			    err->ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+				match = err->ee_data == id;
+		}
+		if (!match)
+			continue;
+		if (ts_valid(&sw)) {
+			s->t[SRC_SW] = sw;
+			got_sw = 1;
+		}
+		if (ts_valid(&hw)) {
+			s->t[SRC_HW] = hw;
+			got_hw = 1;
+		}
+	}
+	return got_sw || got_hw ? 0 : -1;
+}
+
+static int send_stamped(struct flow *f, void *buf, int len,
+			struct sockaddr_in *to, struct stamps *s)
+{
+	uint32_t id = f->tx_id++;
+
+	memset(s, 0, sizeof(*s));
+	clock_gettime(CLOCK_REALTIME, &s->t[SRC_APP]);
+	if (sendto(f->sock, buf, len, 0, (struct sockaddr *)to,
+		   sizeof(*to)) < 0)
+		return -1;
+	if (collect_tx(f, id, s) < 0)
+		f->st.no_txstamp++;
+	return 0;
+}
+
+static int make_socket(char *argv0, int port, int stamping)
+{
+	struct sockaddr_in addr;
+	struct hwtstamp_config hwconfig;
+	struct ifreq ifr;
+	int sock, bits;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0) {
+		fprintf(stderr, "%s: socket(): %s\n", argv0, strerror(errno));
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(port);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "%s: bind(%i): %s\n", argv0, port,
+			strerror(errno));
+		close(sock);
+		return -1;
+	}
+	if (!stamping)
+		return sock;
+
+	bits = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+		SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID |
+		SOF_TIMESTAMPING_OPT_TSONLY;
+	if (opt_iface) {
+		memset(&ifr, 0, sizeof(ifr));
+		strncpy(ifr.ifr_name, opt_iface, sizeof(ifr.ifr_name) - 1);
+		memset(&hwconfig, 0, sizeof(hwconfig));
+		hwconfig.tx_type = HWTSTAMP_TX_ON;
+		hwconfig.rx_filter = HWTSTAMP_FILTER_ALL;
+		ifr.ifr_data = (void *)&hwconfig;
+		if (ioctl(sock, SIOCSHWTSTAMP, &ifr) < 0) {
+			if (!hw_enabled)
+				fprintf(stderr, "%s: SIOCSHWTSTAMP(%s): %s: "
+					"software stamps only\n", argv0,
+					opt_iface, strerror(errno));
+		} else {
+			hw_enabled = 1;
+		}
+	}
+	if (hw_enabled)
+		bits |= SOF_TIMESTAMPING_TX_HARDWARE |
+			SOF_TIMESTAMPING_RX_HARDWARE |
+			SOF_TIMESTAMPING_RAW_HARDWARE;
+	if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING,
+		       &bits, sizeof(bits)) < 0) {
+		fprintf(stderr, "%s: setsockopt(TIMESTAMPING): %s\n", argv0,
+			strerror(errno));
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/* Reflector: answer FORWARD with BACKWARD, then report t2 and t3 */
+static void *run_reflector(void *arg)
+{
+	struct flow *f = arg;
+	static __thread char buf[MAX_SIZE];
+	struct mtp_packet *pkt = (void *)buf;
+	struct stamps s2, s3;
+	struct sockaddr_in from;
+	struct pollfd pfd = {f->sock, POLLIN, 0};
+	int len, i;
+
+	while (!stop) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		if (!(pfd.revents & POLLIN)) {
+			drain_errqueue(f->sock);
+			continue;
+		}
+		memset(&s2, 0, sizeof(s2));
+		len = recv_stamped(f->sock, buf, sizeof(buf), &s2, &from);
+		if (len < (int)sizeof(*pkt) || pkt->ptype != MTP_FORWARD) {
+			f->st.bad++;
+			continue;
+		}
+		f->st.received++;
+		pkt->ptype = MTP_BACKWARD;
+		if (send_stamped(f, buf, len, &from, &s3) < 0)
+			continue;
+		for (i = 0; i < NSRC; i++) {
+			pkt->t[1][i] = s2.t[i];
+			pkt->t[2][i] = s3.t[i];
+		}
+		pkt->ptype = MTP_BACKSTAMP;
+		sendto(f->report_sock, pkt, sizeof(*pkt), 0,
+		       (struct sockaddr *)&from, sizeof(from));
+		f->st.sent++;
+	}
+	return NULL;
+}
+
+static void account(struct flow_stats *st, struct mtp_packet *pkt)
+{
+	struct timespec (*t)[3] = pkt->t;
+	int i;
+
+	for (i = 0; i < NSRC; i++) {
+		if (!ts_valid(&t[0][i]) || !ts_valid(&t[1][i]) ||
+		    !ts_valid(&t[2][i]) || !ts_valid(&t[3][i]))
+			continue;
+		hdr_add(&st->leg[LEG_RTT][i],
+			ts_ns(&t[3][i]) - ts_ns(&t[0][i]) -
+			(ts_ns(&t[2][i]) - ts_ns(&t[1][i])));
+		hdr_add(&st->leg[LEG_FWD][i], ts_ns(&t[1][i]) - ts_ns(&t[0][i]));
+		hdr_add(&st->leg[LEG_BWD][i], ts_ns(&t[3][i]) - ts_ns(&t[2][i]));
+		hdr_add(&st->leg[LEG_REMOTE][i],
+			ts_ns(&t[2][i]) - ts_ns(&t[1][i]));
+	}
+	for (i = 0; i < 4; i++) {
+		/* t1 and t3 are sent, t2 and t4 received */
+		if (ts_valid(&t[i][SRC_APP]) && ts_valid(&t[i][SRC_SW]))
+			hdr_add(&st->cmp[i][CMP_APP_SW], (i & 1 ? -1 : 1) *
+				(ts_ns(&t[i][SRC_SW]) - ts_ns(&t[i][SRC_APP])));
+		if (ts_valid(&t[i][SRC_HW]) && ts_valid(&t[i][SRC_SW]))
+			hdr_add(&st->cmp[i][CMP_HW_SW],
+				ts_ns(&t[i][SRC_HW]) - ts_ns(&t[i][SRC_SW]));
+	}
+}
+
+/* Wait for both answers to "seq"; they may come in any order */
+static int wait_answers(struct flow *f, uint32_t seq, struct stamps *s4,
+			struct mtp_packet *back)
+{
+	static __thread char buf[MAX_SIZE];
+	struct mtp_packet *pkt = (void *)buf;
+	struct pollfd pfd = {f->sock, POLLIN, 0};
+	struct timespec now, end;
+	struct stamps s;
+	int got = 0, len, ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_nsec += RX_WAIT_MS * 1000 * 1000;
+	end.tv_sec += end.tv_nsec / (1000 * 1000 * 1000);
+	end.tv_nsec %= 1000 * 1000 * 1000;
+	while (got != 3 && !stop) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ms = (ts_ns(&end) - ts_ns(&now)) / (1000 * 1000);
+		if (ms < 0 || poll(&pfd, 1, ms) <= 0)
+			return -1;
+		if (!(pfd.revents & POLLIN)) {
+			drain_errqueue(f->sock);
+			continue;
+		}
+		memset(&s, 0, sizeof(s));
+		len = recv_stamped(f->sock, buf, sizeof(buf), &s, NULL);
+		if (len < (int)sizeof(*pkt) || pkt->tragic != seq)
+			continue; /* late answer to a lost one */
+		if (pkt->ptype == MTP_BACKWARD) {
+			*s4 = s;
+			got |= 1;
+		} else if (pkt->ptype == MTP_BACKSTAMP) {
+			*back = *pkt;
+			got |= 2;
+		}
+	}
+	return got == 3 ? 0 : -1;
+}
+
+static void *run_flow(void *arg)
+{
+	struct flow *f = arg;
+	static __thread char buf[MAX_SIZE];
+	struct mtp_packet *pkt = (void *)buf, back;
+	struct stamps s1, s4;
+	struct timespec next;
+	long period_ns = 1000L * 1000 * 1000 / opt_rate, n;
+	int i;
+
+	memset(buf, 0, sizeof(buf));
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (n = 0; n < opt_count && !stop; n++) {
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		next.tv_nsec += period_ns;
+		next.tv_sec += next.tv_nsec / (1000 * 1000 * 1000);
+		next.tv_nsec %= 1000 * 1000 * 1000;
+
+		pkt->tragic = n;
+		pkt->ptype = MTP_FORWARD;
+		if (send_stamped(f, buf, opt_size, &f->peer, &s1) < 0) {
+			f->st.bad++;
+			continue;
+		}
+		f->st.sent++;
+		if (wait_answers(f, n, &s4, &back) < 0) {
+			f->st.lost++;
+			continue;
+		}
+		f->st.received++;
+		for (i = 0; i < NSRC; i++) {
+			back.t[0][i] = s1.t[i];
+			back.t[3][i] = s4.t[i];
+		}
+		account(&f->st, &back);
+	}
+	return NULL;
+}
+
+static void print_hdr(FILE *out, char *name, char *src, struct hdr *h)
+{
+	double mean, var;
+
+	if (!h->count)
+		return;
+	mean = h->sum / h->count;
+	var = h->sum2 / h->count - mean * mean;
+	fprintf(out, "%-10s %-6s %8llu %10lli %10lli %10lli %10lli %10lli "
+		"%10lli %10.0f %10.0f\n", name, src,
+		(unsigned long long)h->count, (long long)h->min,
+		(long long)hdr_percentile(h, 0.5),
+		(long long)hdr_percentile(h, 0.9),
+		(long long)hdr_percentile(h, 0.99),
+		(long long)hdr_percentile(h, 0.999),
+		(long long)h->max, mean, var > 0 ? sqrt(var) : 0);
+}
+
+static void report(FILE *out, struct flow_stats *st)
+{
+	char name[16];
+	int i, j;
+
+	fprintf(out, "%lu sent, %lu answered, %lu lost, %lu bad, "
+		"%lu without tx stamp\n", st->sent, st->received, st->lost,
+		st->bad, st->no_txstamp);
+	fprintf(out, "%-10s %-6s %8s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+		"ns", "point", "count", "min", "p50", "p90", "p99", "p99.9",
+		"max", "mean", "stddev");
+	for (i = 0; i < NLEG; i++)
+		for (j = 0; j < NSRC; j++)
+			print_hdr(out, leg_names[i], src_names[j],
+				  &st->leg[i][j]);
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < NCMP; j++) {
+			sprintf(name, "t%i", i + 1);
+			print_hdr(out, name, cmp_names[j], &st->cmp[i][j]);
+		}
+}
+
+static void write_one(FILE *f, char *name, char *point, struct hdr *h)
+{
+	int k;
+
+	for (k = HDR_NB - 1; k >= 0; k--)
+		if (h->neg[k])
+			fprintf(f, "%s %s %lli %llu\n", name, point,
+				-(long long)hdr_value(k),
+				(unsigned long long)h->neg[k]);
+	for (k = 0; k < HDR_NB; k++)
+		if (h->pos[k])
+			fprintf(f, "%s %s %lli %llu\n", name, point,
+				(long long)hdr_value(k),
+				(unsigned long long)h->pos[k]);
+}
+
+/* Non-empty buckets, for plotting: "<name> <point> <value> <count>" */
+static void write_hist(char *fname, struct flow_stats *st)
+{
+	FILE *f = fopen(fname, "w");
+	char name[16];
+	int i, j;
+
+	if (!f) {
+		fprintf(stderr, "mtp_prof: %s: %s\n", fname, strerror(errno));
+		return;
+	}
+	for (i = 0; i < NLEG; i++)
+		for (j = 0; j < NSRC; j++)
+			write_one(f, leg_names[i], src_names[j],
+				  &st->leg[i][j]);
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < NCMP; j++) {
+			sprintf(name, "t%i", i + 1);
+			write_one(f, name, cmp_names[j], &st->cmp[i][j]);
+		}
+	fclose(f);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "%s: Use: \"%s [options] -l\" or "
+		"\"%s [options] <host>\"\n"
+		"   -f <flows>    concurrent flows (default 1, max %i)\n"
+		"   -r <rate>     exchanges per second, per flow (default 100)\n"
+		"   -n <count>    exchanges per flow (default 1000)\n"
+		"   -s <size>     size of the UDP payload (default %i)\n"
+		"   -p <port>     first UDP port (default %i)\n"
+		"   -i <iface>    enable hardware stamping on <iface>\n"
+		"   -H <file>     save the histograms to <file>\n"
+		"   -v            report each flow too\n",
+		name, name, name, MAX_FLOWS, (int)sizeof(struct mtp_packet),
+		MTP_PORT);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct flow_stats *total;
+	struct hostent *h = NULL;
+	int c, i, j, k;
+
+	while ((c = getopt(argc, argv, "lf:r:n:s:p:i:H:v")) != -1) {
+		switch (c) {
+		case 'l':
+			opt_listen = 1;
+			break;
+		case 'f':
+			opt_flows = atoi(optarg);
+			break;
+		case 'r':
+			opt_rate = atoi(optarg);
+			break;
+		case 'n':
+			opt_count = atol(optarg);
+			break;
+		case 's':
+			opt_size = atoi(optarg);
+			break;
+		case 'p':
+			opt_port = atoi(optarg);
+			break;
+		case 'i':
+			opt_iface = optarg;
+			break;
+		case 'H':
+			opt_hist = optarg;
+			break;
+		case 'v':
+			opt_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - !opt_listen || opt_flows < 1 ||
+	    opt_flows > MAX_FLOWS || opt_rate < 1 || opt_count < 1 ||
+	    opt_size < (int)sizeof(struct mtp_packet) || opt_size > MAX_SIZE)
+		usage(argv[0]);
+	if (!opt_listen) {
+		h = gethostbyname(argv[optind]);
+		if (!h) {
+			fprintf(stderr, "%s: %s: can't resolve hostname\n",
+				argv[0], argv[optind]);
+			exit(1);
+		}
+	}
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+
+	flows = calloc(opt_flows, sizeof(*flows));
+	if (!flows) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		exit(1);
+	}
+
+	/* Flow i uses port "opt_port + i" on the reflector */
+	for (i = 0; i < opt_flows; i++) {
+		struct flow *f = flows + i;
+
+		f->index = i;
+		f->sock = make_socket(argv[0], opt_listen ? opt_port + i : 0,
+				      1);
+		if (f->sock < 0)
+			exit(1);
+		if (opt_listen) {
+			f->report_sock = make_socket(argv[0], 0, 0);
+			if (f->report_sock < 0)
+				exit(1);
+		} else {
+			f->peer.sin_family = AF_INET;
+			f->peer.sin_addr.s_addr = *(uint32_t *)h->h_addr;
+			f->peer.sin_port = htons(opt_port + i);
+		}
+	}
+	for (i = 0; i < opt_flows; i++)
+		pthread_create(&flows[i].thread, NULL,
+			       opt_listen ? run_reflector : run_flow, flows + i);
+	for (i = 0; i < opt_flows; i++)
+		pthread_join(flows[i].thread, NULL);
+
+	/* Merge the flows (the reflector only reports its counters) */
+	total = calloc(1, sizeof(*total));
+	if (!total)
+		exit(1);
+	for (i = 0; i < opt_flows; i++) {
+		struct flow_stats *st = &flows[i].st;
+
+		if (opt_verbose && opt_flows > 1) {
+			printf("flow %i: ", i);
+			report(stdout, st);
+		}
+		for (j = 0; j < NLEG; j++)
+			for (k = 0; k < NSRC; k++)
+				hdr_merge(&total->leg[j][k], &st->leg[j][k]);
+		for (j = 0; j < 4; j++)
+			for (k = 0; k < NCMP; k++)
+				hdr_merge(&total->cmp[j][k], &st->cmp[j][k]);
+		total->sent += st->sent;
+		total->received += st->received;
+		total->lost += st->lost;
+		total->bad += st->bad;
+		total->no_txstamp += st->no_txstamp;
+	}
+	if (opt_flows > 1)
+		printf("%i flows: ", opt_flows);
+	report(stdout, total);
+	if (opt_hist)
+		write_hist(opt_hist, total);
+	return 0;
+}
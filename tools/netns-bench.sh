@@ -0,0 +1,286 @@
+#!/bin/bash
+#
+# Copyright (C) 2024 CERN (www.cern.ch)
+#
+# Released according to the GNU GPL, version 2 or any later version.
+#
+# Scalability benchmark of the unix daemon, with software time stamps.
+# A grandmaster, a boundary clock and its slaves run in their own network
+# namespaces, joined by veth pairs: the boundary clock has one port to
+# the grandmaster and one to each slave. For each number of ports and
+# each logSyncInterval we measure time-to-lock of the slaves, then the
+# CPU time and the wakeups (voluntary context switches) of each daemon
+# and the offset from master reported by the slaves. Output is CSV.
+#
+# All namespaces share the system clock, so no daemon adjusts it ("-t"):
+# the offset is the error of time stamping and of the software path.
+# Must be run as root.
+
+set -e
+
+ports_list="2 4 8 16"
+sync_list="1 0 -1"
+secs=30
+lock_secs=60
+lock_ns=10000
+ppsi=""
+src=$(cd "$(dirname "$0")/.." && pwd)
+work=${TMPDIR:-/tmp}/ppsi-netns-bench.$$
+pfx=pbench
+
+usage() {
+	echo "Use: \"$0 [options]\"" >&2
+	echo "  -p \"<ports>\"    ports of the boundary clock ($ports_list)" >&2
+	echo "  -s \"<logs>\"     logSyncInterval values ($sync_list)" >&2
+	echo "  -d <seconds>    measurement time of each run ($secs)" >&2
+	echo "  -l <seconds>    time allowed to lock ($lock_secs)" >&2
+	echo "  -e <ns>         offset threshold for lock ($lock_ns)" >&2
+	echo "  -b <ppsi>       use this binary (built with CONFIG_METRICS)" >&2
+	echo "  -w <dir>        work directory ($work)" >&2
+	exit 1
+}
+
+while getopts "p:s:d:l:e:b:w:" opt; do
+	case $opt in
+	p) ports_list=$OPTARG ;;
+	s) sync_list=$OPTARG ;;
+	d) secs=$OPTARG ;;
+	l) lock_secs=$OPTARG ;;
+	e) lock_ns=$OPTARG ;;
+	b) ppsi=$OPTARG ;;
+	w) work=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+[ $OPTIND -gt $# ] || usage
+for log in $sync_list; do
+	# The range accepted by the configuration (constants.h)
+	if [ "$log" -lt -1 -o "$log" -gt 1 ]; then
+		echo "$0: logSyncInterval $log: not in -1..1" >&2
+		exit 1
+	fi
+done
+
+if [ $(id -u) -ne 0 ]; then
+	echo "$0: must be run as root" >&2
+	exit 1
+fi
+mkdir -p $work
+
+# Build the unix config, with metrics, in a copy of the tree
+if [ -z "$ppsi" ]; then
+	echo "building in $work/src" >&2
+	rm -rf $work/src
+	mkdir $work/src
+	tar -C $src --exclude=.git -cf - . | tar -C $work/src -xf -
+	(
+		cd $work/src
+		make -s distclean
+		make -s unix_defconfig
+		echo CONFIG_METRICS=y >> .config
+		make -s olddefconfig
+		make -s -j$(nproc)
+	) > $work/build.log 2>&1 || {
+		echo "$0: build failed, see $work/build.log" >&2
+		exit 1
+	}
+	ppsi=$work/src/ppsi
+fi
+
+# Metrics are read from a UNIX socket: use socat if we have it
+metrics() {
+	if command -v socat > /dev/null; then
+		socat - UNIX-CONNECT:$1 2> /dev/null
+	else
+		python3 -c 'import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+while True:
+    b = s.recv(4096)
+    if not b: break
+    sys.stdout.write(b.decode())' $1 2> /dev/null
+	fi
+}
+
+# Print "<port_state> <update_count> <offset_ns> <frames rx>" of a slave
+slave_status() {
+	metrics $work/s$1.sock | awk '
+		/^ppsi_port_state/ { state = $2 }
+		/value="update_count"/ { count = $2 }
+		/value="offset_from_master"/ { ofm = $2 * 1e9 }
+		/^ppsi_ptp_rx_total/ { rx = $2 }
+		END { printf "%i %i %.0f %i\n", state, count, ofm, rx }'
+}
+
+# Print "<cpu ticks> <voluntary switches>" of a process
+proc_usage() {
+	local ticks=$(awk '{ print $14 + $15 }' /proc/$1/stat)
+	local sw=$(awk '/^voluntary_ctxt_switches/ { print $2 }' \
+		/proc/$1/status)
+	echo $ticks $sw
+}
+
+cleanup() {
+	local ns
+
+	for ns in $(ip netns list | awk '{print $1}' | grep "^$pfx-"); do
+		ip netns pids $ns | xargs -r kill 2> /dev/null || true
+		ip netns del $ns
+	done
+	rm -f $work/*.sock
+}
+trap cleanup EXIT
+
+# Write the config of an instance: $1 name, $2 logSyncInterval, $3 global
+# options, the rest are port interfaces
+write_conf() {
+	local name=$1 log=$2 glob=$3 iface
+
+	shift 3
+	{
+		echo "metrics-socket $work/$name.sock"
+		echo -e "$glob"
+		for iface in $@; do
+			echo "port $iface"
+			echo "iface $iface"
+			echo "proto raw"
+			echo "logSyncInterval $log"
+		done
+	} > $work/$name.conf
+}
+
+declare -A pid lock good first u0 u1 rx0
+
+start() {
+	ip netns exec $pfx-$1 $ppsi -t -f $work/$1.conf \
+		> $work/$1.log 2>&1 &
+	pid[$1]=$!
+}
+
+now() {
+	date +%s.%N
+}
+
+# Print "<cpu %> <wakeups/s>" of a daemon, over the measurement window
+usage_rate() {
+	awk -v a="${u0[$1]}" -v b="${u1[$1]}" -v hz=$(getconf CLK_TCK) \
+	    -v t=$2 'BEGIN {
+		split(a, x); split(b, y)
+		printf "%.2f %.1f\n", (y[1] - x[1]) * 100 / hz / t,
+			(y[2] - x[2]) / t }'
+}
+
+# One run: $1 ports of the boundary clock, $2 logSyncInterval
+run() {
+	local nports=$1 log=$2 nslaves=$(($1 - 1)) ifaces=p0
+	local i p t0 t all st count ofm rx lock_max
+	local gm_cpu gm_wk bc_cpu bc_wk
+
+	ip netns add $pfx-gm
+	ip netns add $pfx-bc
+	ip -n $pfx-gm link add p0 type veth peer name p0 netns $pfx-bc
+	for p in gm bc; do
+		ip -n $pfx-$p link set dev lo up
+		ip -n $pfx-$p link set dev p0 up
+	done
+	for i in $(seq 1 $nslaves); do
+		ip netns add $pfx-s$i
+		ip -n $pfx-bc link add p$i type veth peer name p0 \
+			netns $pfx-s$i
+		ip -n $pfx-bc link set dev p$i up
+		ip -n $pfx-s$i link set dev lo up
+		ip -n $pfx-s$i link set dev p0 up
+		ifaces="$ifaces p$i"
+		write_conf s$i $log "slaveOnly 1" p0
+	done
+	write_conf gm $log "clock-class 6" p0
+	write_conf bc $log "" $ifaces
+
+	lock=() good=() first=()
+	t0=$(now)
+	start gm
+	start bc
+	for i in $(seq 1 $nslaves); do
+		start s$i
+	done
+
+	# Locked: slave state, and 3 polls in a row within the threshold
+	while :; do
+		sleep 0.2
+		t=$(now)
+		all=1
+		for i in $(seq 1 $nslaves); do
+			[ -n "${lock[$i]}" ] && continue
+			read st count ofm rx <<< "$(slave_status $i)"
+			if [ "$st" = 9 ] && [ "$count" -gt 0 ] &&
+			   [ ${ofm#-} -le $lock_ns ]; then
+				good[$i]=$((${good[$i]:-0} + 1))
+				[ ${good[$i]} = 1 ] && first[$i]=$t
+			else
+				good[$i]=0
+			fi
+			if [ ${good[$i]} -ge 3 ]; then
+				lock[$i]=${first[$i]}
+			else
+				all=0
+			fi
+		done
+		[ $all = 1 ] && break
+		awk "BEGIN {exit !($t - $t0 > $lock_secs)}" && break
+	done
+	# The slowest slave, or -1 if any did not lock
+	lock_max=$(for i in $(seq 1 $nslaves); do
+			echo ${lock[$i]:--1}
+		done | awk -v t0=$t0 '$1 < 0 {nolock = 1}
+			$1 - t0 > m {m = $1 - t0}
+			END {printf "%.1f", nolock ? -1 : m}')
+
+	# Steady state: CPU and wakeups over the window, offset every 0.5s
+	for p in "${!pid[@]}"; do
+		u0[$p]=$(proc_usage ${pid[$p]})
+	done
+	for i in $(seq 1 $nslaves); do
+		rx0[$i]=$(slave_status $i | awk '{print $4}')
+	done
+	t0=$(now)
+	: > $work/ofm
+	while awk "BEGIN {exit !($(now) - $t0 < $secs)}"; do
+		for i in $(seq 1 $nslaves); do
+			slave_status $i >> $work/ofm
+		done
+		sleep 0.5
+	done
+	t=$(awk "BEGIN {print $(now) - $t0}")
+	for p in "${!pid[@]}"; do
+		u1[$p]=$(proc_usage ${pid[$p]})
+	done
+	# The frames received by the slaves tell the rate actually achieved
+	for i in $(seq 1 $nslaves); do
+		echo ${rx0[$i]} $(slave_status $i | awk '{print $4}')
+	done > $work/rx
+
+	read gm_cpu gm_wk <<< "$(usage_rate gm $t)"
+	read bc_cpu bc_wk <<< "$(usage_rate bc $t)"
+	echo -n "$nports,$log,$gm_cpu,$gm_wk,$bc_cpu,"
+	awk "BEGIN {printf \"%.2f,\", $bc_cpu / $nports}"
+	echo -n "$bc_wk,"
+	for i in $(seq 1 $nslaves); do
+		usage_rate s$i $t
+	done | awk '{c += $1; w += $2; n++}
+		END {printf "%.2f,%.1f,", c / n, w / n}'
+	awk -v t=$t '{r += $2 - $1; n++} END {printf "%.1f,", r / n / t}' \
+		$work/rx
+	echo -n "$lock_max,"
+	awk '{s += $3 * $3; a = $3 < 0 ? -$3 : $3; if (a > m) m = a; n++}
+		END {printf "%.0f,%.0f\n", n ? sqrt(s / n) : 0, m}' $work/ofm
+
+	cleanup
+	pid=() u0=() u1=() rx0=()
+}
+
+echo "ports,log_sync,gm_cpu_pct,gm_wakeups_s,bc_cpu_pct,bc_cpu_pct_per_port,bc_wakeups_s,slave_cpu_pct,slave_wakeups_s,slave_rx_s,lock_s,ofm_rms_ns,ofm_max_ns"
+for n in $ports_list; do
+	for log in $sync_list; do
+		run $n $log
+	done
+done
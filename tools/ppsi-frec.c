@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU GPL, version 2 or any later version.
+ */
+
+/*
+ * Decoder of the flight recorder files written by ppsi (on SIGUSR1 and
+ * when a port enters FAULTY) and by wrs_dump_shmem_ppsi (PPSI_FREC).
+ * Each dump is printed port by port, oldest event first. Events are
+ * stamped with CLOCK_MONOTONIC; the dump header has both clocks, so
+ * they are printed as the local time of day, and as the time before
+ * the dump.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <ppsi/ppsi.h>
+
+static const char * const frec_state_name[] = {
+	[PPS_INITIALIZING] = "INITIALIZING",
+	[PPS_FAULTY] = "FAULTY",
+	[PPS_DISABLED] = "DISABLED",
+	[PPS_LISTENING] = "LISTENING",
+	[PPS_PRE_MASTER] = "PRE_MASTER",
+	[PPS_MASTER] = "MASTER",
+	[PPS_PASSIVE] = "PASSIVE",
+	[PPS_UNCALIBRATED] = "UNCALIBRATED",
+	[PPS_SLAVE] = "SLAVE",
+#ifdef CONFIG_ABSCAL
+	[PPS_ABSCAL] = "ABSCAL",
+#endif
+};
+
+static const char * const frec_drop_name[PP_DROP_COUNT] = {
+	[PP_DROP_RECV] = "recv",
+	[PP_DROP_MALFORMED] = "malformed",
+	[PP_DROP_DOMAIN] = "domain",
+	[PP_DROP_ALT_MASTER] = "alternate_master",
+	[PP_DROP_LOOP] = "looping",
+	[PP_DROP_OWN_CLOCK] = "own_clock",
+	[PP_DROP_STATE] = "port_state",
+};
+
+static char *only_port; /* "-p" */
+
+static const char *state_name(int state)
+{
+	static char s[16];
+
+	if (state > 0 && state < PPS_LAST_STATE && frec_state_name[state])
+		return frec_state_name[state];
+	sprintf(s, "state-%i", state); /* of an extension */
+	return s;
+}
+
+static const char *msg_name(int type)
+{
+	static char s[16];
+
+	if (type < __PP_NR_MESSAGES_TYPES && pp_msgtype_name[type])
+		return pp_msgtype_name[type];
+	sprintf(s, "type-%x", type);
+	return s;
+}
+
+static void print_id(struct pp_frec_entry *e)
+{
+	uint8_t *id = e->id.id;
+
+	printf("%02x%02x%02x.%02x%02x.%02x%02x%02x-%i", id[0], id[1], id[2],
+	       id[3], id[4], id[5], id[6], id[7], e->port);
+}
+
+static void print_entry(struct pp_frec_file *h, struct pp_frec_entry *e)
+{
+	int64_t ago = h->mono_ns - e->mono_ns;
+	int64_t real = h->real_ns - ago;
+	time_t secs = real / 1000000000LL;
+	char tod[16];
+	int drop;
+
+	strftime(tod, sizeof(tod), "%H:%M:%S", localtime(&secs));
+	printf("  %s.%06lli (-%lli.%06lli) ", tod,
+	       (long long)(real % 1000000000LL) / 1000,
+	       (long long)ago / 1000000000LL,
+	       (long long)(ago % 1000000000LL) / 1000);
+
+	switch (e->type) {
+	case PP_FREC_RX:
+	case PP_FREC_TX:
+		printf("%s %s seq %u", e->type == PP_FREC_RX ? "rx" : "tx",
+		       msg_name(e->code), e->seq);
+		if (e->type == PP_FREC_RX) {
+			printf(" from ");
+			print_id(e);
+		} else if (e->port) {
+			printf(" to ");
+			print_id(e);
+		}
+		printf(" stamp %lli.%09lli", (long long)e->a,
+		       (long long)e->b >> 16);
+		drop = e->flags & 0xff;
+		if (e->type == PP_FREC_RX && drop)
+			printf(" dropped (%s)", drop < PP_DROP_COUNT ?
+			       frec_drop_name[drop] : "unknown");
+		if (e->flags & PP_FREC_F_NO_STAMP)
+			printf(" (no stamp)");
+		break;
+	case PP_FREC_STATE:
+		printf("state %s -> %s", state_name(e->seq),
+		       state_name(e->code));
+		break;
+	case PP_FREC_BMC:
+		printf("bmc %s (in %s), erbest ", state_name(e->code),
+		       state_name(e->seq));
+		if (e->port)
+			print_id(e);
+		else
+			printf("none");
+		printf(", ebest on port index %i", (int16_t)e->flags);
+		break;
+	case PP_FREC_SERVO:
+		printf("servo %s", pp_frec_servo_name(e->code));
+		if (e->code == PP_FREC_SERVO_INIT)
+			printf(" drift %lli ppb", (long long)e->a);
+		else
+			printf(" offset %lli ns meanDelay %lli ns",
+			       (long long)e->a, (long long)e->b);
+		break;
+	default:
+		printf("unknown event %i", e->type);
+	}
+	printf("\n");
+}
+
+static int read_one(FILE *f, void *p, size_t size, const char *name)
+{
+	if (fread(p, size, 1, f) == 1)
+		return 0;
+	fprintf(stderr, "%s: %s\n", name, ferror(f) ? strerror(errno) :
+		"truncated dump");
+	return -1;
+}
+
+/* Print all the dumps in a file; returns 0 or -1 */
+static int decode(FILE *f, const char *name)
+{
+	struct pp_frec_file h;
+	struct pp_frec_port p;
+	struct pp_frec_entry e;
+	time_t secs;
+	char tod[32];
+	uint32_t i;
+	int j, ndump = 0;
+
+	while (fread(&h, sizeof(h), 1, f) == 1) {
+		if (h.magic != PP_FREC_MAGIC || h.version != PP_FREC_VERSION ||
+		    h.entry_size != sizeof(e)) {
+			fprintf(stderr, "%s: not a flight recorder dump (or "
+				"version %i, entries of %i bytes)\n", name,
+				h.version, h.entry_size);
+			return -1;
+		}
+		secs = h.real_ns / 1000000000LL;
+		strftime(tod, sizeof(tod), "%Y-%m-%d %H:%M:%S",
+			 localtime(&secs));
+		printf("dump %i: %s", ndump++, pp_frec_reason_name(h.reason));
+		if (h.inst >= 0)
+			printf(" of instance %i", h.inst);
+		printf(", at %s.%06lli, %i port%s\n", tod,
+		       (long long)(h.real_ns % 1000000000LL) / 1000,
+		       h.nports, h.nports == 1 ? "" : "s");
+		for (j = 0; j < h.nports; j++) {
+			if (read_one(f, &p, sizeof(p), name) < 0)
+				return -1;
+			p.name[sizeof(p.name) - 1] = '\0';
+			if (!only_port || !strcmp(only_port, p.name))
+				printf("port %s: %u events, the last %u:\n",
+				       p.name, p.n, p.count);
+			for (i = 0; i < p.count; i++) {
+				if (read_one(f, &e, sizeof(e), name) < 0)
+					return -1;
+				if (!only_port || !strcmp(only_port, p.name))
+					print_entry(&h, &e);
+			}
+		}
+	}
+	if (ferror(f)) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Use: \"%s [-p <port>] <file> [...]\"\n"
+		"   <file>      flight recorder file (\"-\" is stdin)\n"
+		"   -p <port>   only print this port\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = 0;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "p:")) != -1) {
+		switch (opt) {
+		case 'p':
+			only_port = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc)
+		usage(argv[0]);
+
+	for (; optind < argc; optind++) {
+		f = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+		if (!f) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind],
+				strerror(errno));
+			ret = 1;
+			continue;
+		}
+		if (decode(f, argv[optind]) < 0)
+			ret = 1;
+		if (f != stdin)
+			fclose(f);
+	}
+	return ret;
+}
@@ -0,0 +1,918 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU GPL, version 2 or any later version.
+ */
+
+/*
+ * Offline analysis of a PTP capture (pcap or pcap-ng, like those written
+ * by "ptpdump -w"), in a single pass over the file. Messages are matched
+ * by sequenceId and portIdentity: Sync with Follow_Up, Delay_Req with
+ * Delay_Resp, Pdelay_Req with Pdelay_Resp and Pdelay_Resp_Follow_Up.
+ *
+ * The capture time stamps are used as the time of the slave: t2 for
+ * Sync, t3 for Delay_Req, t1 and t4 for the Pdelay exchange. The figures
+ * are thus those the slave computes if the capture is done on the slave
+ * (or close to it). For each master/slave pair we report the mean path
+ * delay, the offset, and the delay variation of each direction, while
+ * for each port we report the rate of every message type.
+ *
+ * Memory is bounded: ports, pairs and outstanding requests live in
+ * fixed-size tables, and frames are read one at a time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#include <ppsi/ppsi.h>
+#include "decent_types.h"
+#include "ptpdump.h"
+
+#ifndef ETH_P_1588
+#define ETH_P_1588     0x88F7
+#endif
+
+#define MAX_PORTS	256	/* masters and slaves */
+#define MAX_PAIRS	1024
+#define MAX_PENDING	16	/* requests waiting for a response, per port */
+#define MAX_SNAP	(256 * 1024)
+#define MAX_IFACES	64	/* pcap-ng interfaces per section */
+
+/* Streaming mean and variance (Welford), plus the extremes, in ns */
+struct stat_acc {
+	unsigned long n;
+	double mean, m2, min, max;
+};
+
+struct pending {
+	int valid;
+	uint16_t seq;
+	struct pp_time t;		/* capture time */
+};
+
+struct ptp_port {
+	uint8_t id[10];
+	int domain;
+	unsigned long count[16];	/* per message type */
+	unsigned long lost[16];		/* holes in the sequenceId */
+	int seq_valid[16];
+	uint16_t seq[16];
+	struct pp_time first, last;
+	struct pp_time prev_sync;
+	struct stat_acc sync_interval;
+
+	/* As a master: the Sync waiting for its Follow_Up, and the last one */
+	int fup_valid;
+	uint16_t fup_seq;
+	struct pp_time fup_t2;
+	TimeInterval fup_corr;
+	int sync_valid;
+	struct pp_time t1, t2;		/* t1 already corrected */
+
+	/* As a slave, or as a Pdelay requester */
+	struct pending req[MAX_PENDING];
+	int req_next;
+	unsigned long unanswered;
+};
+
+struct ptp_pair {
+	int master, slave;		/* index in ports[] */
+	int p2p;			/* Pdelay: "master" is the responder */
+
+	/* Pdelay_Resp waiting for its Pdelay_Resp_Follow_Up */
+	int rfup_valid;
+	uint16_t rfup_seq;
+	struct pp_time rfup_t1, rfup_t2, rfup_t4;
+	TimeInterval rfup_corr;
+
+	int delay_valid;
+	struct pp_time delay;		/* the last one */
+	int64_t base_secs[2];		/* for one-way delays and offset */
+	int base_valid[2];
+	int ms_valid, sm_valid;
+	double ms_prev, sm_prev;
+
+	struct stat_acc s_delay, s_offset;
+	struct stat_acc s_ms, s_sm;	/* one-way delays, for the PDV */
+	struct stat_acc s_ipdv_ms, s_ipdv_sm;
+};
+
+static struct ptp_port ports[MAX_PORTS];
+static struct ptp_pair pairs[MAX_PAIRS];
+static int nports, npairs;
+static unsigned long n_frames, n_ptp, n_skipped, n_full;
+static int verbose;
+static FILE *series;
+
+static const char *msg_name[16] = {
+	[PPM_SYNC] = "sync",
+	[PPM_DELAY_REQ] = "delay-req",
+	[PPM_PDELAY_REQ] = "pdelay-req",
+	[PPM_PDELAY_RESP] = "pdelay-resp",
+	[PPM_FOLLOW_UP] = "follow-up",
+	[PPM_DELAY_RESP] = "delay-resp",
+	[PPM_PDELAY_R_FUP] = "pdelay-resp-fup",
+	[PPM_ANNOUNCE] = "announce",
+	[PPM_SIGNALING] = "signaling",
+	[PPM_MANAGEMENT] = "management",
+};
+
+static void stat_add(struct stat_acc *s, double v)
+{
+	double d = v - s->mean;
+
+	if (!s->n || v < s->min)
+		s->min = v;
+	if (!s->n || v > s->max)
+		s->max = v;
+	s->n++;
+	s->mean += d / s->n;
+	s->m2 += d * (v - s->mean);
+}
+
+static double stat_std(struct stat_acc *s)
+{
+	return s->n > 1 ? sqrt(s->m2 / (s->n - 1)) : 0;
+}
+
+static void stat_print(const char *name, struct stat_acc *s)
+{
+	if (!s->n)
+		return;
+	printf("   %-10s %8lu  mean %14.3f  std %12.3f  min %14.3f  "
+	       "max %14.3f ns\n", name, s->n, s->mean, stat_std(s),
+	       s->min, s->max);
+}
+
+/* base_secs plus ns, in seconds: as a double it would lose the ns */
+static char *secs_string(char *str, int64_t base_secs, double ns)
+{
+	int64_t n = llround(ns), secs = base_secs + n / 1000000000LL;
+	int neg;
+
+	n %= 1000000000LL;
+	if (n < 0) {
+		n += 1000000000LL;
+		secs--;
+	}
+	neg = secs < 0;
+	if (neg && n) {
+		secs++;
+		n = 1000000000LL - n;
+	}
+	sprintf(str, "%s%lli.%09lli", neg ? "-" : "", llabs(secs),
+		(long long)n);
+	return str;
+}
+
+/*
+ * Samples are accumulated relative to base_secs, for precision. When
+ * it is not 0 (unrelated clocks), print the absolute values in seconds.
+ */
+static void stat_print_secs(const char *name, struct stat_acc *s,
+			    int64_t base_secs)
+{
+	char s1[32], s2[32], s3[32];
+
+	if (!base_secs) {
+		stat_print(name, s);
+		return;
+	}
+	if (!s->n)
+		return;
+	printf("   %-10s %8lu  mean %s s  std %.3f ns  min %s s  "
+	       "max %s s\n", name, s->n, secs_string(s1, base_secs, s->mean),
+	       stat_std(s), secs_string(s2, base_secs, s->min),
+	       secs_string(s3, base_secs, s->max));
+}
+
+/* Differences are small, except those between unrelated clocks */
+static double pp_time_to_ns(struct pp_time *t, int64_t base_secs)
+{
+	struct pp_time r = *t;
+
+	r.secs -= base_secs;
+	normalize_pp_time(&r);
+	return pp_time_to_picos(&r) / 1000.0;
+}
+
+static void stamp_to_pp_time(const struct stamp *s, struct pp_time *t)
+{
+	t->secs = ((int64_t)ntohs(s->sec.msb) << 32) | ntohl(s->sec.lsb);
+	t->scaled_nsecs = (int64_t)ntohl(s->nsec) << TIME_FRACBITS;
+}
+
+static char *port_name(char *s, const uint8_t *id)
+{
+	sprintf(s, "%02x%02x%02x.%02x%02x.%02x%02x%02x-%i",
+		id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7],
+		(id[8] << 8) | id[9]);
+	return s;
+}
+
+static int find_port(const uint8_t *id, int domain)
+{
+	struct ptp_port *p;
+	int i;
+
+	for (i = 0; i < nports; i++)
+		if (ports[i].domain == domain && !memcmp(ports[i].id, id, 10))
+			return i;
+	if (nports == MAX_PORTS) {
+		n_full++;
+		return -1;
+	}
+	p = ports + nports;
+	memcpy(p->id, id, 10);
+	p->domain = domain;
+	return nports++;
+}
+
+static struct ptp_pair *find_pair(int master, int slave, int p2p)
+{
+	struct ptp_pair *pp;
+	int i;
+
+	for (i = 0; i < npairs; i++)
+		if (pairs[i].master == master && pairs[i].slave == slave
+		    && pairs[i].p2p == p2p)
+			return pairs + i;
+	if (npairs == MAX_PAIRS) {
+		n_full++;
+		return NULL;
+	}
+	pp = pairs + npairs++;
+	pp->master = master;
+	pp->slave = slave;
+	pp->p2p = p2p;
+	return pp;
+}
+
+static void add_request(struct ptp_port *p, uint16_t seq, struct pp_time *t)
+{
+	struct pending *r = p->req + p->req_next;
+
+	if (r->valid)
+		p->unanswered++;
+	r->valid = 1;
+	r->seq = seq;
+	r->t = *t;
+	p->req_next = (p->req_next + 1) % MAX_PENDING;
+}
+
+static struct pending *find_request(struct ptp_port *p, uint16_t seq)
+{
+	int i;
+
+	for (i = 0; i < MAX_PENDING; i++)
+		if (p->req[i].valid && p->req[i].seq == seq)
+			return p->req + i;
+	return NULL;
+}
+
+/* One-way delays include the offset: only their variation makes sense */
+static void oneway_add(struct ptp_pair *pp, struct pp_time *d, int ms)
+{
+	double v, *prev = ms ? &pp->ms_prev : &pp->sm_prev;
+	int *valid = ms ? &pp->ms_valid : &pp->sm_valid;
+
+	if (!pp->base_valid[ms]) {
+		pp->base_secs[ms] = d->secs;
+		pp->base_valid[ms] = 1;
+	}
+	v = pp_time_to_ns(d, pp->base_secs[ms]);
+	stat_add(ms ? &pp->s_ms : &pp->s_sm, v);
+	if (*valid)
+		stat_add(ms ? &pp->s_ipdv_ms : &pp->s_ipdv_sm,
+			 fabs(v - *prev));
+	*prev = v;
+	*valid = 1;
+}
+
+static void delay_add(struct ptp_pair *pp, struct pp_time *delay)
+{
+	pp->delay = *delay;
+	pp->delay_valid = 1;
+	stat_add(&pp->s_delay, pp_time_to_ns(delay, 0));
+}
+
+/* A complete Sync from a master: a sample of offset for each of its pairs */
+static void sync_done(int m, struct pp_time *now)
+{
+	struct ptp_port *p = ports + m;
+	struct ptp_pair *pp;
+	struct pp_time ms, ofm;
+	char s1[32], s2[32];
+	int i;
+
+	for (i = 0; i < npairs; i++) {
+		pp = pairs + i;
+		if (pp->master != m)
+			continue;
+		ms = p->t2;
+		pp_time_sub(&ms, &p->t1);
+		oneway_add(pp, &ms, 1);
+		if (!pp->delay_valid)
+			continue;
+		ofm = ms;
+		pp_time_sub(&ofm, &pp->delay);
+		stat_add(&pp->s_offset, pp_time_to_ns(&ofm, pp->base_secs[1]));
+		if (!series)
+			continue;
+		/* time_to_string() has a single buffer */
+		fprintf(series, "%lli.%09i %s %s %s ", (long long)now->secs,
+			(int)(now->scaled_nsecs >> TIME_FRACBITS),
+			port_name(s1, p->id), port_name(s2, ports[pp->slave].id),
+			pp->p2p ? "p2p" : "e2e");
+		fprintf(series, "%s ", time_to_string(&pp->delay));
+		fprintf(series, "%s\n", time_to_string(&ofm));
+	}
+}
+
+static void sync_t1(int m, struct pp_time *t1, TimeInterval corr)
+{
+	struct ptp_port *p = ports + m;
+
+	p->t1 = *t1;
+	pp_time_add_interval(&p->t1, corr);
+	p->sync_valid = 1;
+}
+
+/* Delay_Resp: t3 is the capture time of our Delay_Req, t4 is in the frame */
+static void delay_resp(int m, int s, struct ptp_header *h,
+		       struct ptp_sync_etc *b)
+{
+	struct ptp_port *sp = ports + s, *mp = ports + m;
+	struct ptp_pair *pp;
+	struct pending *r;
+	struct pp_time t4, sm, delay;
+	TimeInterval corr;
+
+	r = find_request(sp, ntohs(h->sequenceId));
+	if (!r)
+		return;
+	r->valid = 0;
+	pp = find_pair(m, s, 0);
+	if (!pp)
+		return;
+	stamp_to_pp_time(&b->stamp, &t4);
+	corr = (int64_t)be64toh(h->correctionField);
+	pp_time_sub_interval(&t4, corr);
+	sm = t4;
+	pp_time_sub(&sm, &r->t);
+	oneway_add(pp, &sm, 0);
+	if (!mp->sync_valid)
+		return;
+	/* ((t2 - t1) + (t4 - t3)) / 2 */
+	delay = mp->t2;
+	pp_time_sub(&delay, &mp->t1);
+	pp_time_add(&delay, &sm);
+	pp_time_div2(&delay);
+	delay_add(pp, &delay);
+}
+
+/* ((t4 - t1) - (t3 - t2)) / 2, with t3 - t2 from the responder */
+static void pdelay_done(struct ptp_pair *pp, struct pp_time *t3)
+{
+	struct pp_time delay, turn;
+
+	pp->rfup_valid = 0;
+	delay = pp->rfup_t4;
+	pp_time_sub(&delay, &pp->rfup_t1);
+	pp_time_sub_interval(&delay, pp->rfup_corr);
+	if (t3) {
+		turn = *t3;
+		pp_time_sub(&turn, &pp->rfup_t2);
+		pp_time_sub(&delay, &turn);
+	}
+	pp_time_div2(&delay);
+	delay_add(pp, &delay);
+}
+
+static void pdelay_resp(int rsp, int req, struct ptp_header *h,
+			struct ptp_sync_etc *b, struct pp_time *now)
+{
+	struct ptp_pair *pp;
+	struct pending *r;
+
+	r = find_request(ports + req, ntohs(h->sequenceId));
+	if (!r)
+		return;
+	r->valid = 0;
+	pp = find_pair(rsp, req, 1);
+	if (!pp)
+		return;
+	pp->rfup_seq = ntohs(h->sequenceId);
+	pp->rfup_t1 = r->t;
+	pp->rfup_t4 = *now;
+	pp->rfup_corr = (int64_t)be64toh(h->correctionField);
+	stamp_to_pp_time(&b->stamp, &pp->rfup_t2);
+	if (h->flagField[0] & PP_TWO_STEP_FLAG) {
+		pp->rfup_valid = 1;
+		return;
+	}
+	/* One-step: the turnaround time is in the correction field */
+	pdelay_done(pp, NULL);
+}
+
+static void pdelay_fup(int rsp, int req, struct ptp_header *h,
+		       struct ptp_sync_etc *b)
+{
+	struct ptp_pair *pp;
+	struct pp_time t3;
+
+	pp = find_pair(rsp, req, 1);
+	if (!pp || !pp->rfup_valid || pp->rfup_seq != ntohs(h->sequenceId))
+		return;
+	stamp_to_pp_time(&b->stamp, &t3);
+	pp->rfup_corr += (int64_t)be64toh(h->correctionField);
+	pdelay_done(pp, &t3);
+}
+
+static void count_message(struct ptp_port *p, int type, uint16_t seq,
+			  struct pp_time *now)
+{
+	struct pp_time d;
+	uint16_t hole;
+
+	if (!p->first.secs && !p->first.scaled_nsecs)
+		p->first = *now;
+	p->last = *now;
+	p->count[type]++;
+	/*
+	 * Responses carry the sequenceId of the request, so their numbers
+	 * come from all the slaves being answered: holes mean nothing there.
+	 */
+	if (type == PPM_DELAY_RESP || type == PPM_PDELAY_RESP ||
+	    type == PPM_PDELAY_R_FUP)
+		return;
+	if (p->seq_valid[type]) {
+		hole = seq - p->seq[type] - 1;
+		/* A big jump is a restart, not a loss */
+		if (hole && hole < 0x8000)
+			p->lost[type] += hole;
+	}
+	p->seq[type] = seq;
+	p->seq_valid[type] = 1;
+	if (type != PPM_SYNC)
+		return;
+	if (p->count[type] > 1) {
+		d = *now;
+		pp_time_sub(&d, &p->prev_sync);
+		stat_add(&p->sync_interval, pp_time_to_ns(&d, 0));
+	}
+	p->prev_sync = *now;
+}
+
+static void analyze_ptp(void *pl, int len, struct pp_time *now)
+{
+	struct ptp_header *h = pl;
+	struct ptp_sync_etc *b = (void *)(h + 1);
+	struct ptp_port *p;
+	struct pp_time t;
+	int type, i, j;
+	uint16_t seq;
+
+	if (len < sizeof(*h) || (h->versionPTP_and_reserved & 0xf) != 2)
+		return;
+	type = h->type_and_transport_specific & 0xf;
+	seq = ntohs(h->sequenceId);
+	i = find_port(h->sourcePortIdentity, h->domainNumber);
+	if (i < 0)
+		return;
+	p = ports + i;
+	n_ptp++;
+	count_message(p, type, seq, now);
+
+	if (len < sizeof(*h) + sizeof(struct stamp))
+		return;
+	switch (type) {
+	case PPM_SYNC:
+		if (h->flagField[0] & PP_TWO_STEP_FLAG) {
+			p->fup_valid = 1;
+			p->fup_seq = seq;
+			p->fup_t2 = *now;
+			p->fup_corr = (int64_t)be64toh(h->correctionField);
+			break;
+		}
+		stamp_to_pp_time(&b->stamp, &t);
+		p->t2 = *now;
+		sync_t1(i, &t, (int64_t)be64toh(h->correctionField));
+		sync_done(i, now);
+		break;
+	case PPM_FOLLOW_UP:
+		if (!p->fup_valid || p->fup_seq != seq)
+			break;
+		p->fup_valid = 0;
+		stamp_to_pp_time(&b->stamp, &t);
+		p->t2 = p->fup_t2;
+		sync_t1(i, &t, p->fup_corr +
+			(int64_t)be64toh(h->correctionField));
+		sync_done(i, now);
+		break;
+	case PPM_DELAY_REQ:
+	case PPM_PDELAY_REQ:
+		add_request(p, seq, now);
+		break;
+	case PPM_DELAY_RESP:
+	case PPM_PDELAY_RESP:
+	case PPM_PDELAY_R_FUP:
+		if (len < sizeof(*h) + sizeof(*b))
+			break;
+		j = find_port(b->port, h->domainNumber);
+		if (j < 0)
+			break;
+		if (type == PPM_DELAY_RESP)
+			delay_resp(i, j, h, b);
+		else if (type == PPM_PDELAY_RESP)
+			pdelay_resp(i, j, h, b, now);
+		else
+			pdelay_fup(i, j, h, b);
+		break;
+	}
+}
+
+/* Find the PTP payload in a frame: Ethernet, IPv4 or IPv6 with UDP */
+static void analyze_frame(uint8_t *buf, int len, int linktype,
+			  struct pp_time *now)
+{
+	uint8_t *p = buf;
+	int proto, hlen, off;
+
+	n_frames++;
+	switch (linktype) {
+	case 1: /* Ethernet */
+		off = 12;
+		break;
+	case 113: /* Linux "cooked" */
+		off = 14;
+		break;
+	default:
+		n_skipped++;
+		return;
+	}
+	if (len < off + 2)
+		return;
+	proto = (p[off] << 8) | p[off + 1];
+	off += 2;
+	while ((proto == 0x8100 || proto == 0x88a8) && len >= off + 4) {
+		proto = (p[off + 2] << 8) | p[off + 3];
+		off += 4;
+	}
+	p += off;
+	len -= off;
+
+	switch (proto) {
+	case ETH_P_1588:
+		break;
+	case 0x0800: /* IPv4, unfragmented UDP */
+		if (len < 20 || p[9] != IPPROTO_UDP)
+			return;
+		if (((p[6] << 8) | p[7]) & 0x3fff)
+			return;
+		hlen = (p[0] & 0xf) * 4;
+		goto udp;
+	case 0x86dd: /* IPv6, UDP with no extension headers */
+		if (len < 40 || p[6] != IPPROTO_UDP)
+			return;
+		hlen = 40;
+	udp:
+		if (len < hlen + 8)
+			return;
+		p += hlen;
+		len -= hlen;
+		if (((p[2] << 8) | p[3]) != 319 && ((p[2] << 8) | p[3]) != 320)
+			return;
+		p += 8;
+		len -= 8;
+		break;
+	default:
+		return;
+	}
+	if (verbose) {
+		if (linktype == 1 && proto == ETH_P_1588)
+			dump_1588pkt("", buf, p - buf + len, now, -1);
+		else if (linktype == 1 && proto == 0x0800 && off <= 18)
+			dump_udppkt("", buf, p - buf + len, now, -1);
+		else
+			dump_payloadpkt("", p, len, now);
+		putchar('\n');
+	}
+	analyze_ptp(p, len, now);
+}
+
+/*
+ * File formats. All we need is the link type and the time stamp of each
+ * record, in a byte order that may differ from ours.
+ */
+static int swapped;
+
+static uint16_t get16(uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, 2);
+	return swapped ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t get32(uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return swapped ? __builtin_bswap32(v) : v;
+}
+
+/* Read, or skip if buf is NULL: stdin can't seek */
+static int get_bytes(FILE *f, uint8_t *buf, size_t len)
+{
+	static uint8_t junk[4096];
+	size_t n;
+
+	if (buf)
+		return fread(buf, 1, len, f) == len ? 0 : -1;
+	while (len) {
+		n = len < sizeof(junk) ? len : sizeof(junk);
+		if (fread(junk, 1, n, f) != n)
+			return -1;
+		len -= n;
+	}
+	return 0;
+}
+
+static void ticks_to_pp_time(uint64_t ticks, int tsresol, int64_t tsoffset,
+			     struct pp_time *t)
+{
+	uint64_t div, frac;
+	int i;
+
+	if (tsresol & 0x80) { /* a power of two */
+		i = tsresol & 0x7f;
+		t->secs = ticks >> i;
+		frac = ticks & ((1ULL << i) - 1);
+		t->scaled_nsecs = (int64_t)ldexp(frac * 1e9, TIME_FRACBITS - i);
+	} else {
+		for (div = 1, i = 0; i < tsresol; i++)
+			div *= 10;
+		t->secs = ticks / div;
+		frac = ticks % div;
+		for (; i < 9; i++)
+			frac *= 10;
+		for (; i > 9; i--)
+			frac /= 10;
+		t->scaled_nsecs = (int64_t)frac << TIME_FRACBITS;
+	}
+	t->secs += tsoffset;
+}
+
+static int read_pcap(FILE *f, uint8_t *hdr, uint8_t *buf)
+{
+	uint8_t rec[16];
+	uint32_t magic, caplen;
+	int linktype, tsresol;
+	struct pp_time t;
+
+	memcpy(&magic, hdr, 4);
+	swapped = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+	tsresol = (get32(hdr) == 0xa1b23c4d) ? 9 : 6;
+	if (get_bytes(f, hdr + 8, 16))
+		return -1;
+	linktype = get32(hdr + 20) & 0xffff;
+
+	while (get_bytes(f, rec, sizeof(rec)) == 0) {
+		caplen = get32(rec + 8);
+		if (caplen > MAX_SNAP) {
+			fprintf(stderr, "ptp-analyze: record too long (%u)\n",
+				caplen);
+			return -1;
+		}
+		if (get_bytes(f, buf, caplen))
+			break;
+		ticks_to_pp_time(get32(rec + 4), tsresol, 0, &t);
+		t.secs += get32(rec);
+		analyze_frame(buf, caplen, linktype, &t);
+	}
+	return 0;
+}
+
+static int read_pcapng(FILE *f, uint8_t *hdr, uint8_t *buf)
+{
+	struct {
+		int linktype, tsresol;
+		int64_t tsoffset;
+	} ifs[MAX_IFACES];
+	int nifs = 0, i, code, olen;
+	uint32_t type, blen, caplen;
+	uint64_t v64;
+	uint8_t *opt, *end;
+	struct pp_time t;
+
+	/* The first block: we have type and length, and need the BOM */
+	if (get_bytes(f, hdr + 8, 4))
+		return -1;
+	for (;;) {
+		type = get32(hdr);
+		if (type == 0x0a0d0d0a) {
+			swapped = 0;
+			if (get32(hdr + 8) != 0x1a2b3c4d)
+				swapped = 1;
+			nifs = 0;
+		}
+		blen = get32(hdr + 4);
+		if (blen < 12 || blen > MAX_SNAP || (blen & 3)) {
+			fprintf(stderr, "ptp-analyze: bad block length %u\n",
+				blen);
+			return -1;
+		}
+		memcpy(buf, hdr, 12);
+		if (get_bytes(f, buf + 12, blen - 12))
+			break;
+
+		switch (type) {
+		case 1: /* Interface Description */
+			if (nifs == MAX_IFACES || blen < 20)
+				break;
+			ifs[nifs].linktype = get16(buf + 8);
+			ifs[nifs].tsresol = 6;
+			ifs[nifs].tsoffset = 0;
+			end = buf + blen - 4;
+			for (opt = buf + 16; opt + 4 <= end; ) {
+				code = get16(opt);
+				olen = get16(opt + 2);
+				if (!code || opt + 4 + olen > end)
+					break;
+				if (code == 9 && olen == 1)
+					ifs[nifs].tsresol = opt[4];
+				if (code == 14 && olen == 8) {
+					memcpy(&v64, opt + 4, 8);
+					ifs[nifs].tsoffset = swapped ?
+						__builtin_bswap64(v64) : v64;
+				}
+				opt += 4 + ((olen + 3) & ~3);
+			}
+			nifs++;
+			break;
+		case 2: /* Packet (obsolete) */
+		case 6: /* Enhanced Packet */
+			if (blen < 32) {
+				n_skipped++;
+				break;
+			}
+			i = type == 6 ? get32(buf + 8) : get16(buf + 8);
+			caplen = get32(buf + 20);
+			if (i >= nifs || caplen > blen - 32) {
+				n_skipped++;
+				break;
+			}
+			ticks_to_pp_time(((uint64_t)get32(buf + 12) << 32) |
+					 get32(buf + 16), ifs[i].tsresol,
+					 ifs[i].tsoffset, &t);
+			analyze_frame(buf + 28, caplen, ifs[i].linktype, &t);
+			break;
+		case 3: /* Simple Packet: no time stamp, useless */
+			n_skipped++;
+			break;
+		}
+		if (get_bytes(f, hdr, 12))
+			break;
+	}
+	return 0;
+}
+
+static void report(void)
+{
+	struct ptp_port *p;
+	struct ptp_pair *pp;
+	struct pp_time d;
+	double secs;
+	char s1[32], s2[32];
+	int i, j;
+
+	printf("%lu frames, %lu PTP messages, %lu skipped\n",
+	       n_frames, n_ptp, n_skipped);
+	if (n_full)
+		printf("%lu messages ignored: more than %i ports or %i pairs\n",
+		       n_full, MAX_PORTS, MAX_PAIRS);
+
+	for (i = 0; i < nports; i++) {
+		p = ports + i;
+		d = p->last;
+		pp_time_sub(&d, &p->first);
+		secs = pp_time_to_ns(&d, 0) / 1e9;
+		printf("\nport %s domain %i: %.3f s\n", port_name(s1, p->id),
+		       p->domain, secs);
+		for (j = 0; j < 16; j++) {
+			if (!p->count[j])
+				continue;
+			printf("   %-16s %8lu  %10.3f/s",
+			       msg_name[j] ? msg_name[j] : "reserved",
+			       p->count[j], secs > 0 ? p->count[j] / secs : 0);
+			if (p->seq_valid[j])
+				printf("  %lu lost", p->lost[j]);
+			putchar('\n');
+		}
+		if (p->sync_interval.n)
+			printf("   sync interval    mean %.3f ms, std %.3f ms, "
+			       "min %.3f ms, max %.3f ms\n",
+			       p->sync_interval.mean / 1e6,
+			       stat_std(&p->sync_interval) / 1e6,
+			       p->sync_interval.min / 1e6,
+			       p->sync_interval.max / 1e6);
+		if (p->unanswered)
+			printf("   %lu requests without a response\n",
+			       p->unanswered);
+	}
+
+	for (i = 0; i < npairs; i++) {
+		pp = pairs + i;
+		printf("\n%s %s -> %s\n", pp->p2p ? "p2p" : "e2e",
+		       port_name(s1, ports[pp->master].id),
+		       port_name(s2, ports[pp->slave].id));
+		stat_print("delay", &pp->s_delay);
+		stat_print_secs("offset", &pp->s_offset, pp->base_secs[1]);
+		if (pp->s_ms.n)
+			printf("   pdv m->s    p-p %.3f ns, std %.3f ns, "
+			       "ipdv mean %.3f ns, max %.3f ns\n",
+			       pp->s_ms.max - pp->s_ms.min, stat_std(&pp->s_ms),
+			       pp->s_ipdv_ms.mean, pp->s_ipdv_ms.max);
+		if (pp->s_sm.n)
+			printf("   pdv s->m    p-p %.3f ns, std %.3f ns, "
+			       "ipdv mean %.3f ns, max %.3f ns\n",
+			       pp->s_sm.max - pp->s_sm.min, stat_std(&pp->s_sm),
+			       pp->s_ipdv_sm.mean, pp->s_ipdv_sm.max);
+	}
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Use: \"%s [-s <series-file>] [-v] <capture>\"\n"
+		"   <capture>   pcap or pcap-ng file (\"-\" is stdin)\n"
+		"   -s <file>   write each offset sample, with the delay\n"
+		"               (\"-\" is stdout)\n"
+		"   -v          print the PTP frames too\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t hdr[24], *buf;
+	uint32_t magic;
+	FILE *f;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "s:v")) != -1) {
+		switch (opt) {
+		case 's':
+			series = strcmp(optarg, "-") ? fopen(optarg, "w")
+				: stdout;
+			if (!series) {
+				fprintf(stderr, "%s: %s: %s\n", argv[0],
+					optarg, strerror(errno));
+				exit(1);
+			}
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+	f = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+	if (!f) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind],
+			strerror(errno));
+		exit(1);
+	}
+	buf = malloc(MAX_SNAP);
+	if (!buf || get_bytes(f, hdr, 8)) {
+		fprintf(stderr, "%s: %s: can't read\n", argv[0], argv[optind]);
+		exit(1);
+	}
+	memcpy(&magic, hdr, 4);
+	switch (magic) {
+	case 0xa1b2c3d4: case 0xd4c3b2a1: /* pcap, microseconds */
+	case 0xa1b23c4d: case 0x4d3cb2a1: /* pcap, nanoseconds */
+		ret = read_pcap(f, hdr, buf);
+		break;
+	case 0x0a0d0d0a:
+		ret = read_pcapng(f, hdr, buf);
+		break;
+	default:
+		fprintf(stderr, "%s: %s: not pcap or pcap-ng\n", argv[0],
+			argv[optind]);
+		exit(1);
+	}
+	if (series && series != stdout)
+		fclose(series);
+	report();
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,716 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU GPL, version 2 or any later version.
+ */
+
+/*
+ * Synthetic slave load for benchmarking a PTP master. We emulate many
+ * slaves, each with its own clockIdentity, sending Delay_Req (or
+ * Pdelay_Req) at a configurable rate over raw Ethernet or UDP, and we
+ * match the responses by requestingPortIdentity and sequenceId.
+ *
+ * Requests are packed and responses are unpacked by the protocol code
+ * of ppsi (proto-standard/msg.c and msg-p2p.c): each emulated slave is a
+ * pp_instance, and we provide the __send_and_log() they call.
+ *
+ * The response latency is the time from the request being handed to the
+ * kernel to the (kernel) reception of the response that completes the
+ * exchange: Delay_Resp, or Pdelay_Resp_Follow_Up for a two-step Pdelay.
+ * A request is "lost" if no response came before the next request of
+ * the same slave (or the end of the run); a response after the timeout
+ * counts as "late". With "-a", the rate is raised by 50% each step until
+ * more than 1% of the requests are lost or late.
+ */
+#define _GNU_SOURCE /* ppoll */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#include <ppsi/ppsi.h>
+#include "../proto-standard/common-fun.h"
+
+#define LD_ID0 0x02 /* locally administered, like a MAC address */
+#define LD_MAX_SLAVES (1 << 24)
+#define LD_MAX_STEPS 30
+#define LD_LOSS_PERMILLE 10 /* "-a" stops after 1% lost or late */
+
+struct ld_slave {
+	struct pp_instance ppi; /* first: __send_and_log() gets this */
+	portDS_t portDS;
+	unsigned char frame[PP_MAX_FRAME_LENGTH];
+	uint16_t seq;		/* of the pending request */
+	uint8_t pending;	/* 1: no response yet, 2: no follow-up yet */
+	uint8_t has_prev;
+	int64_t tx_ns;		/* time of the request (CLOCK_REALTIME) */
+	int64_t prev_tx_ns;
+	struct pp_time t2;	/* of the master: t4 for E2E, t2 for P2P */
+	struct pp_time prev_t2;
+};
+
+struct ld_stats {
+	unsigned long sent, answered, late, lost, bad, foreign;
+	int64_t *lat, *turn;	/* ns, one per answered request */
+	unsigned long nturn, size;
+};
+
+static struct ld_slave *slaves;
+static int nslaves = 1000;
+static double rate = 1.0;	/* per slave */
+static int p2p, udp, ramp, verbose;
+static int duration = 10, timeout_ms = 1000, tolerance_ms = 10;
+static int domain;
+static int fd_evt = -1, fd_gen = -1; /* only fd_evt for raw Ethernet */
+static int ifindex;
+static struct sockaddr_in dest;
+static struct ld_stats st;
+static volatile int stop;
+
+static struct pp_globals ld_ppg;
+static defaultDS_t ld_defaultDS;
+static const struct pp_ext_hooks ld_hooks;
+
+static int ld_get_time(struct pp_instance *ppi, struct pp_time *t)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	t->secs = ts.tv_sec;
+	t->scaled_nsecs = (int64_t)ts.tv_nsec << TIME_FRACBITS;
+	return 0;
+}
+
+static const struct pp_time_operations ld_time_ops = {
+	.get = ld_get_time,
+};
+
+static int64_t ld_now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000LL * 1000 * 1000 + ts.tv_nsec;
+}
+
+static int64_t ld_time_ns(struct pp_time *t)
+{
+	return t->secs * 1000LL * 1000 * 1000 +
+		(t->scaled_nsecs >> TIME_FRACBITS);
+}
+
+/* msg.c needs this for msg_from_current_master(), that we never call */
+int bmc_pidcmp(struct PortIdentity *a, struct PortIdentity *b)
+{
+	int ret = memcmp(&a->clockIdentity, &b->clockIdentity,
+			 sizeof(a->clockIdentity));
+
+	return ret ? ret : a->portNumber - b->portNumber;
+}
+
+/* Called by msg_issue_request(), through the protocol code */
+int __send_and_log(struct pp_instance *ppi, int msglen, int chtype,
+		   enum pp_msg_format msg_fmt)
+{
+	struct ld_slave *s = (struct ld_slave *)ppi;
+	int ret;
+
+	s->tx_ns = ld_now_ns(CLOCK_REALTIME);
+	if (udp)
+		ret = sendto(fd_evt, ppi->tx_ptp, msglen, 0,
+			     (struct sockaddr *)&dest, sizeof(dest));
+	else
+		ret = send(fd_evt, ppi->tx_frame, msglen + ppi->tx_offset, 0);
+	if (ret < 0) {
+		if (verbose)
+			fprintf(stderr, "ptp-load: send: %s\n", strerror(errno));
+		return PP_SEND_ERROR;
+	}
+	return PP_SEND_OK;
+}
+
+static void ld_store(int64_t **v, unsigned long n, int64_t ns)
+{
+	if (n == st.size) {
+		st.size = st.size ? st.size * 2 : 65536;
+		st.lat = realloc(st.lat, st.size * sizeof(*st.lat));
+		st.turn = realloc(st.turn, st.size * sizeof(*st.turn));
+		if (!st.lat || !st.turn) {
+			fprintf(stderr, "ptp-load: out of memory\n");
+			exit(1);
+		}
+	}
+	(*v)[n] = ns;
+}
+
+static void ld_init_slaves(unsigned char *mac)
+{
+	struct ld_slave *s;
+	int i;
+
+	ld_ppg.defaultDS = &ld_defaultDS;
+	ld_defaultDS.domainNumber = domain;
+	for (i = 0; i < nslaves; i++) {
+		s = slaves + i;
+		s->ppi.glbs = &ld_ppg;
+		s->ppi.portDS = &s->portDS;
+		s->ppi.t_ops = &ld_time_ops;
+		s->ppi.ext_hooks = &ld_hooks;
+		s->ppi.delayMechanism = p2p ? MECH_P2P : MECH_E2E;
+		s->ppi.tx_frame = s->frame;
+		s->ppi.tx_offset = udp ? 0 : sizeof(struct ethhdr);
+		s->ppi.tx_ptp = s->frame + s->ppi.tx_offset;
+		s->portDS.versionNumber = PP_VERSION_PTP;
+		s->portDS.minorVersionNumber = PP_MINOR_VERSION_PTP;
+		s->portDS.logMinDelayReqInterval = 0x7f;
+		memcpy(s->portDS.portIdentity.clockIdentity.id,
+		       (uint8_t[]){LD_ID0, 'l', 'd', 0xff, 0xfe,
+				       i >> 16, i >> 8, i}, 8);
+		s->portDS.portIdentity.portNumber = 1;
+		msg_init_header(&s->ppi, s->ppi.tx_ptp);
+		/* Random start, so a restarted run is not taken as a replay */
+		s->ppi.sent_seq[p2p ? PPM_PDELAY_REQ : PPM_DELAY_REQ] = random();
+		if (!udp) {
+			struct ethhdr *eth = (void *)s->frame;
+
+			memcpy(eth->h_dest, p2p ? PP_PDELAY_MACADDRESS
+			       : PP_MCAST_MACADDRESS, ETH_ALEN);
+			memcpy(eth->h_source, mac, ETH_ALEN);
+			eth->h_proto = htons(ETH_P_1588);
+		}
+	}
+}
+
+static struct ld_slave *ld_lookup(PortIdentity *pid)
+{
+	uint8_t *id = pid->clockIdentity.id;
+	int i;
+
+	if (id[0] != LD_ID0 || id[1] != 'l' || id[2] != 'd' ||
+	    id[3] != 0xff || id[4] != 0xfe || pid->portNumber != 1)
+		return NULL;
+	i = id[5] << 16 | id[6] << 8 | id[7];
+	return i < nslaves ? slaves + i : NULL;
+}
+
+static void ld_bad(struct ld_slave *s, const char *why)
+{
+	st.bad++;
+	if (verbose)
+		fprintf(stderr, "ptp-load: slave %li: %s\n",
+			(long)(s - slaves), why);
+}
+
+/*
+ * We can't compare the time of the master with ours: we check that it
+ * advances like ours does, from one request of a slave to the next.
+ */
+static int ld_check_time(struct ld_slave *s, struct pp_time *t)
+{
+	int64_t d, ours;
+
+	if (s->has_prev) {
+		d = ld_time_ns(t) - ld_time_ns(&s->prev_t2);
+		ours = s->tx_ns - s->prev_tx_ns;
+		if (d <= 0 || llabs(d - ours) > tolerance_ms * 1000LL * 1000) {
+			ld_bad(s, "time of the master is not consistent");
+			s->has_prev = 0;
+			return -1;
+		}
+	}
+	s->prev_t2 = *t;
+	s->prev_tx_ns = s->tx_ns;
+	s->has_prev = 1;
+	return 0;
+}
+
+static void ld_done(struct ld_slave *s, int64_t rx_ns)
+{
+	int64_t ns = rx_ns - s->tx_ns;
+
+	s->pending = 0;
+	if (ns > timeout_ms * 1000LL * 1000) {
+		st.late++;
+		return;
+	}
+	ld_store(&st.lat, st.answered++, ns);
+}
+
+static void ld_recv_frame(void *buf, int len, int64_t rx_ns)
+{
+	struct pp_instance rx_ppi = {};
+	MsgHeader *hdr = &rx_ppi.received_ptp_header;
+	MsgDelayResp resp;
+	MsgPDelayResp presp;
+	MsgPDelayRespFollowUp pfup;
+	struct pp_time t3;
+	struct ld_slave *s;
+	PortIdentity *pid;
+
+	if (len < PP_HEADER_LENGTH || msg_unpack_header(&rx_ppi, buf, len))
+		return;
+	if (hdr->domainNumber != domain)
+		return;
+	switch (hdr->messageType) {
+	case PPM_DELAY_RESP:
+		if (p2p || len < PP_DELAY_RESP_LENGTH)
+			return;
+		msg_unpack_delay_resp(buf, &resp);
+		pid = &resp.requestingPortIdentity;
+		break;
+	case PPM_PDELAY_RESP:
+		if (!p2p || len < PP_PDELAY_RESP_LENGTH)
+			return;
+		msg_unpack_pdelay_resp(buf, &presp);
+		pid = &presp.requestingPortIdentity;
+		break;
+	case PPM_PDELAY_R_FUP:
+		if (!p2p || len < PP_PDELAY_RESP_FOLLOW_UP_LENGTH)
+			return;
+		msg_unpack_pdelay_resp_follow_up(buf, &pfup);
+		pid = &pfup.requestingPortIdentity;
+		break;
+	default:
+		return;
+	}
+	s = ld_lookup(pid);
+	if (!s) {
+		st.foreign++;
+		return;
+	}
+	if (!s->pending || hdr->sequenceId != s->seq) {
+		ld_bad(s, "unexpected sequenceId");
+		return;
+	}
+
+	switch (hdr->messageType) {
+	case PPM_DELAY_RESP:
+		if (ld_check_time(s, &resp.receiveTimestamp) == 0)
+			ld_done(s, rx_ns);
+		else
+			s->pending = 0;
+		return;
+	case PPM_PDELAY_RESP:
+		if (s->pending != 1) {
+			ld_bad(s, "duplicate Pdelay_Resp");
+			return;
+		}
+		s->t2 = presp.requestReceiptTimestamp;
+		if (ld_check_time(s, &s->t2) < 0) {
+			s->pending = 0;
+			return;
+		}
+		if (!(hdr->flagField[0] & PP_TWO_STEP_FLAG)) {
+			ld_done(s, rx_ns);
+			return;
+		}
+		s->pending = 2;
+		return;
+	case PPM_PDELAY_R_FUP:
+		if (s->pending != 2) {
+			ld_bad(s, "Pdelay_Resp_Follow_Up before Pdelay_Resp");
+			return;
+		}
+		t3 = pfup.responseOriginTimestamp;
+		pp_time_sub(&t3, &s->t2);
+		if (t3.secs < 0 || t3.scaled_nsecs < 0) {
+			ld_bad(s, "Pdelay_Resp sent before Pdelay_Req arrived");
+			s->pending = 0;
+			return;
+		}
+		ld_store(&st.turn, st.nturn++, ld_time_ns(&t3));
+		ld_done(s, rx_ns);
+		return;
+	}
+}
+
+static void ld_recv(int fd)
+{
+	unsigned char buf[PP_MAX_FRAME_LENGTH + 64];
+	char ctrl[256];
+	struct sockaddr_ll from;
+	struct iovec iov = {buf, sizeof(buf)};
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct timespec *ts;
+	int64_t rx_ns;
+	int len, off = udp ? 0 : sizeof(struct ethhdr);
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &from;
+		msg.msg_namelen = sizeof(from);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+		len = recvmsg(fd, &msg, MSG_DONTWAIT);
+		if (len < 0)
+			return;
+		if (!udp && from.sll_pkttype == PACKET_OUTGOING)
+			continue;
+		rx_ns = 0;
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+			if (cm->cmsg_level == SOL_SOCKET &&
+			    cm->cmsg_type == SO_TIMESTAMPNS) {
+				ts = (void *)CMSG_DATA(cm);
+				rx_ns = ts->tv_sec * 1000LL * 1000 * 1000
+					+ ts->tv_nsec;
+			}
+		if (!rx_ns)
+			rx_ns = ld_now_ns(CLOCK_REALTIME);
+		if (len > off)
+			ld_recv_frame(buf + off, len - off, rx_ns);
+	}
+}
+
+static int ld_open_raw(char *ifname, unsigned char *mac)
+{
+	struct packet_mreq mr = {};
+	struct sockaddr_ll addr = {};
+	struct ifreq ifr = {};
+	int fd, one = 1;
+
+	fd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_1588));
+	if (fd < 0)
+		return -1;
+	strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+	if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0)
+		return -1;
+	memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(ETH_P_1588);
+	addr.sll_ifindex = ifindex;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	mr.mr_ifindex = ifindex;
+	mr.mr_type = PACKET_MR_MULTICAST;
+	mr.mr_alen = ETH_ALEN;
+	memcpy(mr.mr_address, PP_MCAST_MACADDRESS, ETH_ALEN);
+	if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+		       &mr, sizeof(mr)) < 0)
+		return -1;
+	memcpy(mr.mr_address, PP_PDELAY_MACADDRESS, ETH_ALEN);
+	if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+		       &mr, sizeof(mr)) < 0)
+		return -1;
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+		return -1;
+	return fd;
+}
+
+static int ld_open_udp(char *ifname, int port, struct in_addr *ifaddr)
+{
+	struct sockaddr_in addr = {};
+	struct ip_mreqn mr = {};
+	unsigned char zero = 0;
+	int fd, one = 1;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname,
+		       strlen(ifname)) < 0)
+		return -1;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	mr.imr_ifindex = ifindex;
+	mr.imr_address = *ifaddr;
+	inet_aton(PP_DEFAULT_DOMAIN_ADDRESS, &mr.imr_multiaddr);
+	if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr, sizeof(mr)) < 0)
+		return -1;
+	inet_aton(PP_PDELAY_DOMAIN_ADDRESS, &mr.imr_multiaddr);
+	if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr, sizeof(mr)) < 0)
+		return -1;
+	if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, ifaddr,
+		       sizeof(*ifaddr)) < 0)
+		return -1;
+	/* Our own requests would only be discarded */
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &zero, sizeof(zero));
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+		return -1;
+	return fd;
+}
+
+static int ld_cmp(const void *a, const void *b)
+{
+	int64_t x = *(int64_t *)a, y = *(int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double ld_pct(int64_t *v, unsigned long n, int permille)
+{
+	unsigned long i = (n * permille + 999) / 1000;
+
+	return v[i ? i - 1 : 0] / 1000.0;
+}
+
+static void ld_print_pct(const char *name, int64_t *v, unsigned long n)
+{
+	if (!n)
+		return;
+	qsort(v, n, sizeof(*v), ld_cmp);
+	printf("  %s (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f"
+	       "  max %.1f\n", name, ld_pct(v, n, 500), ld_pct(v, n, 900),
+	       ld_pct(v, n, 990), ld_pct(v, n, 999), v[n - 1] / 1000.0);
+}
+
+/* A slave sends a new request: the previous one, if any, is lost */
+static void ld_send(struct ld_slave *s)
+{
+	if (s->pending) {
+		st.lost++;
+		s->has_prev = 0;
+	}
+	if (msg_issue_request(&s->ppi) != PP_SEND_OK)
+		return;
+	s->seq = s->ppi.sent_seq[p2p ? PPM_PDELAY_REQ : PPM_DELAY_REQ];
+	s->pending = 1;
+	st.sent++;
+}
+
+static void ld_poll(int64_t until_ns)
+{
+	struct pollfd pfd[2] = {{fd_evt, POLLIN}, {fd_gen, POLLIN}};
+	struct timespec ts;
+	int64_t left = until_ns - ld_now_ns(CLOCK_MONOTONIC);
+
+	if (left < 0)
+		left = 0;
+	ts.tv_sec = left / 1000000000;
+	ts.tv_nsec = left % 1000000000;
+	if (ppoll(pfd, fd_gen < 0 ? 1 : 2, &ts, NULL) <= 0)
+		return;
+	if (pfd[0].revents & POLLIN)
+		ld_recv(fd_evt);
+	if (fd_gen >= 0 && pfd[1].revents & POLLIN)
+		ld_recv(fd_gen);
+}
+
+/* Run at "total" requests per second: 1 if too many are lost or late */
+static int ld_step(int step, double total)
+{
+	int64_t period = 1000LL * 1000 * 1000 / total, start, next, end;
+	unsigned long behind = 0, i, k = 0;
+	double secs;
+
+	free(st.lat);
+	free(st.turn);
+	memset(&st, 0, sizeof(st));
+	start = next = ld_now_ns(CLOCK_MONOTONIC);
+	end = start + duration * 1000LL * 1000 * 1000;
+	while (!stop && next < end) {
+		if (ld_now_ns(CLOCK_MONOTONIC) < next) {
+			ld_poll(next);
+			continue;
+		}
+		ld_send(slaves + k);
+		k = (k + 1) % nslaves;
+		next += period;
+		/* Don't burst to catch up after a stall: just count it */
+		if (ld_now_ns(CLOCK_MONOTONIC) - next > 100LL * 1000 * 1000) {
+			behind++;
+			next = ld_now_ns(CLOCK_MONOTONIC);
+		}
+	}
+	secs = (ld_now_ns(CLOCK_MONOTONIC) - start) / 1e9;
+
+	/* Wait for the responses in flight, then the rest is lost */
+	end = ld_now_ns(CLOCK_MONOTONIC) + timeout_ms * 1000LL * 1000;
+	while (!stop && ld_now_ns(CLOCK_MONOTONIC) < end)
+		ld_poll(end);
+	for (i = 0; i < nslaves; i++) {
+		if (slaves[i].pending)
+			st.lost++;
+		slaves[i].pending = 0;
+		slaves[i].has_prev = 0;
+	}
+
+	printf("step %i: %i slaves, %.1f req/s (sent %.1f/s)\n", step,
+	       nslaves, total, st.sent / secs);
+	printf("  sent %lu  answered %lu  late %lu  lost %lu (%.2f%%)"
+	       "  bad %lu\n", st.sent, st.answered, st.late, st.lost,
+	       st.sent ? 100.0 * (st.lost + st.late) / st.sent : 0.0,
+	       st.bad);
+	if (st.foreign)
+		printf("  %lu responses to other slaves\n", st.foreign);
+	if (behind)
+		printf("  %lu stalls of the sender\n", behind);
+	ld_print_pct("latency", st.lat, st.answered);
+	ld_print_pct("master turnaround", st.turn, st.nturn);
+	fflush(stdout);
+	/* If we couldn't keep the rate, the limit is ours, not the master's */
+	if (st.sent < 0.9 * total * secs) {
+		printf("  can't send faster: stopping here\n");
+		return -1;
+	}
+	return !st.sent ||
+		(st.lost + st.late) * 1000 > st.sent * LD_LOSS_PERMILLE;
+}
+
+static void ld_sig(int sig)
+{
+	stop = 1;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Use: \"%s [options] <interface>\"\n"
+		"  -n <slaves>    number of emulated slaves (default 1000)\n"
+		"  -r <rate>      requests per second of each slave (1)\n"
+		"  -p             use Pdelay_Req instead of Delay_Req\n"
+		"  -u             use UDP instead of raw Ethernet\n"
+		"  -m <address>   send UDP requests to this address\n"
+		"  -d <seconds>   duration of the run, or of each step (10)\n"
+		"  -a             raise the rate by 50%% at each step\n"
+		"  -t <ms>        response timeout (1000)\n"
+		"  -j <ms>        tolerance on the time of the master (10)\n"
+		"  -D <domain>    domainNumber (0)\n"
+		"  -v             report each bad response\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char mac[ETH_ALEN] = {};
+	struct in_addr ifaddr;
+	struct ifreq ifr = {};
+	char *ifname, *to = NULL;
+	double total, good = 0;
+	int opt, step, ret, fd;
+
+	while ((opt = getopt(argc, argv, "n:r:pum:d:at:j:D:v")) != -1) {
+		switch (opt) {
+		case 'n':
+			nslaves = atoi(optarg);
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'p':
+			p2p = 1;
+			break;
+		case 'u':
+			udp = 1;
+			break;
+		case 'm':
+			to = optarg;
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'a':
+			ramp = 1;
+			break;
+		case 't':
+			timeout_ms = atoi(optarg);
+			break;
+		case 'j':
+			tolerance_ms = atoi(optarg);
+			break;
+		case 'D':
+			domain = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || nslaves < 1 || nslaves > LD_MAX_SLAVES ||
+	    rate <= 0 || duration < 1 || timeout_ms < 1)
+		usage(argv[0]);
+	if (p2p && !CONFIG_HAS_P2P) {
+		fprintf(stderr, "%s: built without P2P support\n", argv[0]);
+		exit(1);
+	}
+	ifname = argv[optind];
+	ifindex = if_nametoindex(ifname);
+	if (!ifindex) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], ifname,
+			strerror(errno));
+		exit(1);
+	}
+
+	if (udp) {
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+		strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+		ifr.ifr_addr.sa_family = AF_INET;
+		if (fd < 0 || ioctl(fd, SIOCGIFADDR, &ifr) < 0) {
+			fprintf(stderr, "%s: %s: no IPv4 address\n", argv[0],
+				ifname);
+			exit(1);
+		}
+		close(fd);
+		ifaddr = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr;
+		dest.sin_family = AF_INET;
+		dest.sin_port = htons(PP_EVT_PORT);
+		if (!to)
+			to = p2p ? PP_PDELAY_DOMAIN_ADDRESS
+				: PP_DEFAULT_DOMAIN_ADDRESS;
+		if (!inet_aton(to, &dest.sin_addr)) {
+			fprintf(stderr, "%s: %s: not an IPv4 address\n",
+				argv[0], to);
+			exit(1);
+		}
+		fd_evt = ld_open_udp(ifname, PP_EVT_PORT, &ifaddr);
+		if (fd_evt >= 0)
+			fd_gen = ld_open_udp(ifname, PP_GEN_PORT, &ifaddr);
+		if (fd_evt < 0 || fd_gen < 0) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], ifname,
+				strerror(errno));
+			exit(1);
+		}
+	} else {
+		fd_evt = ld_open_raw(ifname, mac);
+		if (fd_evt < 0) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], ifname,
+				strerror(errno));
+			exit(1);
+		}
+	}
+
+	slaves = calloc(nslaves, sizeof(*slaves));
+	if (!slaves) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		exit(1);
+	}
+	srandom(getpid() ^ time(NULL));
+	ld_init_slaves(mac);
+	signal(SIGINT, ld_sig);
+	signal(SIGTERM, ld_sig);
+
+	total = nslaves * rate;
+	for (step = 1; step <= (ramp ? LD_MAX_STEPS : 1) && !stop; step++) {
+		ret = ld_step(step, total);
+		if (ret)
+			break;
+		good = total;
+		total *= 1.5;
+	}
+	if (ramp) {
+		if (good)
+			printf("sustainable rate: %.1f req/s\n", good);
+		else
+			printf("sustainable rate: below %.1f req/s\n",
+			       nslaves * rate);
+	}
+	return 0;
+}
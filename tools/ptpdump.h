@@ -21,4 +21,10 @@ int dump_payloadpkt(char *prefix, void *buf, int len,
 int dump_1588pkt(char *prefix, void *buf, int len, const struct pp_time *t,
 		 int vlan);
 
+/* Only in tools/ptpdump: live view of a frame, and capture mode */
+int ptpdump_frame(void *buf, int len, struct pp_time *ti, int vlan);
+int ptpdump_attach_filter(int sock);
+int ptpdump_capture(int sock, const char *ifname, const char *fname,
+		    int ring_mb, unsigned long count, int verbose);
+
 #endif /* __PTPDUMP_H__ */
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2024 CERN (www.cern.ch)
+ *
+ * Released according to the GNU LGPL, version 2.1 or any later version.
+ */
+
+/*
+ * Batch runner for the simulator (ppsi built with sim_defconfig). It runs
+ * the simulator for every combination of a parameter grid and for every
+ * seed, one process per run, as many at a time as there are CPUs. The
+ * offset of each port ("sim_print_samples") is reduced to a few figures
+ * per run, and runs are aggregated per configuration, as CSV or JSON.
+ *
+ * The grid file has one configuration keyword per line, with the values
+ * to try separated by '|'. Every combination is simulated. E.g.:
+ *
+ *	servo-pi 10,1000 | 20,2000
+ *	sim_jit_ns 0 | 500 | 2000
+ *	sim_iter_max 3000
+ *
+ * The grid is passed with "-C", after the file given with "-f", if any.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_PARAMS	32
+#define MAX_VALUES	64
+#define MAX_CFG		4096
+
+struct param {
+	char *key;
+	int nval;
+	char *val[MAX_VALUES];
+};
+
+static struct param params[MAX_PARAMS];
+static int nparams, nconfig = 1;
+static unsigned *seeds;
+static int nseeds;
+
+static char *sim_prog, *sim_file;
+static int64_t threshold_ns = 1000;
+static int64_t mtie_window_ns = 100LL * 1000 * 1000 * 1000;
+
+/* One per run, in memory shared with the workers */
+struct result {
+	int done, failed, converged, nsamples;
+	double conv_s;		/* first sample of the steady state */
+	double rms_ns;		/* in the steady state ... */
+	double max_ns;		/* ... as well as these two */
+	double mtie_ns;
+};
+
+struct port {
+	char name[64];
+	int n, max;
+	int64_t *t, *ofm;
+};
+
+static char *trim(char *s)
+{
+	char *e;
+
+	while (*s == ' ' || *s == '\t')
+		s++;
+	for (e = s + strlen(s); e > s && strchr(" \t\r\n", e[-1]); e--)
+		;
+	*e = '\0';
+	return s;
+}
+
+static int read_grid(char *fname)
+{
+	char line[MAX_CFG], *s, *v;
+	struct param *p;
+	FILE *f;
+
+	f = fopen(fname, "r");
+	if (!f) {
+		fprintf(stderr, "%s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		s = trim(line);
+		if (!*s || *s == '#')
+			continue;
+		if (nparams == MAX_PARAMS) {
+			fprintf(stderr, "%s: too many parameters\n", fname);
+			return -1;
+		}
+		p = params + nparams++;
+		p->key = strdup(strtok(s, " \t"));
+		while ((v = strtok(NULL, "|"))) {
+			if (p->nval == MAX_VALUES) {
+				fprintf(stderr, "%s: too many values\n", p->key);
+				return -1;
+			}
+			p->val[p->nval++] = strdup(trim(v));
+		}
+		if (!p->nval) {
+			fprintf(stderr, "%s: no values\n", p->key);
+			return -1;
+		}
+		nconfig *= p->nval;
+	}
+	fclose(f);
+	return 0;
+}
+
+/* "1-10,20" */
+static int parse_seeds(char *s)
+{
+	unsigned a, b;
+	char *tok;
+
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		if (sscanf(tok, "%u-%u", &a, &b) != 2) {
+			if (sscanf(tok, "%u", &a) != 1)
+				return -1;
+			b = a;
+		}
+		for (; a <= b; a++) {
+			seeds = realloc(seeds, (nseeds + 1) * sizeof(*seeds));
+			seeds[nseeds++] = a;
+		}
+	}
+	return nseeds ? 0 : -1;
+}
+
+/* The value of a parameter in a configuration: mixed radix */
+static char *param_val(int config, int i)
+{
+	int j;
+
+	for (j = 0; j < i; j++)
+		config /= params[j].nval;
+	return params[i].val[config % params[i].nval];
+}
+
+static void config_string(char *buf, int config, unsigned seed)
+{
+	int i, n = 0;
+
+	for (i = 0; i < nparams; i++) {
+		n += snprintf(buf + n, MAX_CFG - n, "%s %s;", params[i].key,
+			      param_val(config, i));
+		/* If truncated, don't let the size underflow */
+		if (n > MAX_CFG - 1)
+			n = MAX_CFG - 1;
+	}
+	snprintf(buf + n, MAX_CFG - n, "sim_seed %u; sim_print_samples 1",
+		 seed);
+}
+
+static struct port *get_port(struct port **ports, int *nports, char *name)
+{
+	int i;
+
+	for (i = 0; i < *nports; i++)
+		if (!strcmp((*ports)[i].name, name))
+			return *ports + i;
+	*ports = realloc(*ports, (*nports + 1) * sizeof(**ports));
+	memset(*ports + *nports, 0, sizeof(**ports));
+	strncpy((*ports)[*nports].name, name, sizeof((*ports)->name) - 1);
+	return *ports + (*nports)++;
+}
+
+static void add_sample(struct port *p, int64_t t, int64_t ofm)
+{
+	if (p->n == p->max) {
+		p->max = p->max ? 2 * p->max : 1024;
+		p->t = realloc(p->t, p->max * sizeof(*p->t));
+		p->ofm = realloc(p->ofm, p->max * sizeof(*p->ofm));
+	}
+	p->t[p->n] = t;
+	p->ofm[p->n++] = ofm;
+}
+
+/* Maximum peak-to-peak offset in any window of mtie_window_ns */
+static double mtie(int64_t *t, int64_t *ofm, int n)
+{
+	int64_t lo, hi, res = 0;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		lo = hi = ofm[i];
+		for (j = i + 1; j < n && t[j] - t[i] <= mtie_window_ns; j++) {
+			if (ofm[j] < lo)
+				lo = ofm[j];
+			if (ofm[j] > hi)
+				hi = ofm[j];
+		}
+		if (hi - lo > res)
+			res = hi - lo;
+		if (j == n)
+			break; /* later windows are included in this one */
+	}
+	return res;
+}
+
+/*
+ * The steady state starts after the last sample above the threshold.
+ * A run converged if all ports did: report the worst port
+ */
+static void port_figures(struct port *p, struct result *r)
+{
+	double sum2 = 0, v;
+	int i, first;
+
+	r->nsamples += p->n;
+	for (first = p->n; first > 0; first--)
+		if (llabs(p->ofm[first - 1]) > threshold_ns)
+			break;
+	if (first == p->n) {
+		r->converged = 0;
+		return;
+	}
+	if (p->t[first] / 1e9 > r->conv_s)
+		r->conv_s = p->t[first] / 1e9;
+	for (i = first; i < p->n; i++) {
+		v = llabs(p->ofm[i]);
+		sum2 += v * v;
+		if (v > r->max_ns)
+			r->max_ns = v;
+	}
+	v = sqrt(sum2 / (p->n - first));
+	if (v > r->rms_ns)
+		r->rms_ns = v;
+	v = mtie(p->t + first, p->ofm + first, p->n - first);
+	if (v > r->mtie_ns)
+		r->mtie_ns = v;
+}
+
+static void run_one(int run, struct result *r)
+{
+	char cfg[MAX_CFG], line[256], name[64];
+	char *argv[8];
+	struct port *ports = NULL;
+	int fd[2], argc = 0, nports = 0, i, status;
+	long long t, ofm;
+	FILE *f;
+	pid_t pid;
+
+	config_string(cfg, run / nseeds, seeds[run % nseeds]);
+	argv[argc++] = sim_prog;
+	if (sim_file) {
+		argv[argc++] = "-f";
+		argv[argc++] = sim_file;
+	}
+	argv[argc++] = "-C";
+	argv[argc++] = cfg;
+	argv[argc] = NULL;
+
+	if (pipe(fd) < 0 || (pid = fork()) < 0) {
+		perror("sim-batch");
+		return;
+	}
+	if (!pid) {
+		dup2(fd[1], STDOUT_FILENO);
+		close(fd[0]);
+		close(fd[1]);
+		execv(sim_prog, argv);
+		perror(sim_prog);
+		_exit(1);
+	}
+	close(fd[1]);
+	f = fdopen(fd[0], "r");
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "sim-sample %63s %lli %lli",
+			   name, &t, &ofm) == 3)
+			add_sample(get_port(&ports, &nports, name), t, ofm);
+	fclose(f);
+	r->done = 1;
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+	    || WEXITSTATUS(status)) {
+		fprintf(stderr, "sim-batch: run %i failed: \"%s\"\n", run, cfg);
+		r->failed = 1;
+		return;
+	}
+
+	r->converged = nports > 0;
+	for (i = 0; i < nports; i++)
+		port_figures(ports + i, r);
+}
+
+static void print_csv_value(char *s)
+{
+	if (strpbrk(s, ",\""))
+		printf(",\"%s\"", s); /* no quotes in values, by now */
+	else
+		printf(",%s", s);
+}
+
+static void aggregate(struct result *res, int json)
+{
+	struct result *r, sum, worst;
+	int c, s, done, failed, conv;
+
+	if (json)
+		printf("[\n");
+	else {
+		printf("config");
+		for (c = 0; c < nparams; c++)
+			print_csv_value(params[c].key);
+		printf(",runs,failed,converged,conv_s_mean,conv_s_max,"
+		       "rms_ns_mean,rms_ns_max,max_abs_ns,mtie_ns_mean,"
+		       "mtie_ns_max\n");
+	}
+	for (c = 0; c < nconfig; c++) {
+		memset(&sum, 0, sizeof(sum));
+		memset(&worst, 0, sizeof(worst));
+		for (s = done = failed = conv = 0; s < nseeds; s++) {
+			r = res + c * nseeds + s;
+			done += r->done;
+			failed += r->failed;
+			if (!r->done || r->failed || !r->converged)
+				continue;
+			conv++;
+			sum.conv_s += r->conv_s;
+			sum.rms_ns += r->rms_ns;
+			sum.mtie_ns += r->mtie_ns;
+			worst.conv_s = fmax(worst.conv_s, r->conv_s);
+			worst.rms_ns = fmax(worst.rms_ns, r->rms_ns);
+			worst.max_ns = fmax(worst.max_ns, r->max_ns);
+			worst.mtie_ns = fmax(worst.mtie_ns, r->mtie_ns);
+		}
+		if (conv) {
+			sum.conv_s /= conv;
+			sum.rms_ns /= conv;
+			sum.mtie_ns /= conv;
+		}
+		if (!json) {
+			printf("%i", c);
+			for (s = 0; s < nparams; s++)
+				print_csv_value(param_val(c, s));
+			printf(",%i,%i,%i,%.3f,%.3f,%.1f,%.1f,%.0f,%.0f,%.0f\n",
+			       done, failed, conv, sum.conv_s, worst.conv_s,
+			       sum.rms_ns, worst.rms_ns, worst.max_ns,
+			       sum.mtie_ns, worst.mtie_ns);
+			continue;
+		}
+		printf("  {\"config\": %i, \"params\": {", c);
+		for (s = 0; s < nparams; s++)
+			printf("%s\"%s\": \"%s\"", s ? ", " : "",
+			       params[s].key, param_val(c, s));
+		printf("},\n   \"runs\": %i, \"failed\": %i, "
+		       "\"converged\": %i,\n"
+		       "   \"conv_s_mean\": %.3f, \"conv_s_max\": %.3f,\n"
+		       "   \"rms_ns_mean\": %.1f, \"rms_ns_max\": %.1f, "
+		       "\"max_abs_ns\": %.0f,\n"
+		       "   \"mtie_ns_mean\": %.0f, \"mtie_ns_max\": %.0f}%s\n",
+		       done, failed, conv, sum.conv_s, worst.conv_s, sum.rms_ns,
+		       worst.rms_ns, worst.max_ns, sum.mtie_ns, worst.mtie_ns,
+		       c == nconfig - 1 ? "" : ",");
+	}
+	if (json)
+		printf("]\n");
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Use: \"%s [options] <ppsi-sim> <grid-file>\"\n"
+		"  -j <n>        parallel runs (default: number of CPUs)\n"
+		"  -s <seeds>    e.g. \"1-10,20\" (default: 1)\n"
+		"  -f <file>     simulator configuration (e.g. topology)\n"
+		"  -e <ns>       convergence threshold (default: 1000)\n"
+		"  -m <s>        MTIE observation window (default: 100)\n"
+		"  -J            JSON output, instead of CSV\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct result *res;
+	int opt, jobs, json = 0, run, nruns, running = 0;
+
+	jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, "j:s:f:e:m:J")) != -1) {
+		switch (opt) {
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 's':
+			if (parse_seeds(optarg))
+				usage(argv[0]);
+			break;
+		case 'f':
+			sim_file = optarg;
+			break;
+		case 'e':
+			threshold_ns = atoll(optarg);
+			break;
+		case 'm':
+			mtie_window_ns = atof(optarg) * 1e9;
+			break;
+		case 'J':
+			json = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 2 || jobs < 1)
+		usage(argv[0]);
+	sim_prog = argv[optind];
+	if (read_grid(argv[optind + 1]))
+		exit(1);
+	if (!nseeds)
+		parse_seeds(strdup("1"));
+
+	nruns = nconfig * nseeds;
+	res = mmap(NULL, nruns * sizeof(*res), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (res == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	fprintf(stderr, "%i configurations, %i seeds, %i at a time\n",
+		nconfig, nseeds, jobs);
+
+	/* One worker process per run: the simulator is not a library */
+	for (run = 0; run < nruns; run++) {
+		if (running == jobs) {
+			wait(NULL);
+			running--;
+		}
+		switch (fork()) {
+		case -1:
+			perror("fork");
+			exit(1);
+		case 0:
+			run_one(run, res + run);
+			_exit(0);
+		default:
+			running++;
+		}
+	}
+	while (running--)
+		wait(NULL);
+
+	aggregate(res, json);
+	return 0;
+}
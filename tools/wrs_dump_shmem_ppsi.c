@@ -1,4 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include <ppsi/ppsi.h>
 #include <ppsi-wrs.h>
 #include <time_lib.h>
@@ -231,30 +236,26 @@ struct dump_info dsfm_info [] = {
 #undef DUMP_STRUCT
 #define DUMP_STRUCT struct pp_instance
 struct dump_info ppi_info [] = {
+	/* hot data */
 	DUMP_FIELD(ppi_state, state),
 	DUMP_FIELD(ppi_state, next_state),
 	DUMP_FIELD(int, next_delay),
 	DUMP_FIELD(yes_no, is_new_state),
-	DUMP_FIELD(exstate,extState),
+	DUMP_FIELD(ppi_flag, flags),
+	DUMP_FIELD(yes_no_Boolean, link_up),
 	DUMP_FIELD(pp_pdstate,pdstate),
-	DUMP_FIELD(pointer, arch_inst_data),
-	DUMP_FIELD(pointer, ext_data),
+	DUMP_FIELD(exstate,extState),
 	DUMP_FIELD(protocol_extension, protocol_extension),
 	DUMP_FIELD(pointer, ext_hooks),
-	DUMP_FIELD(pointer, servo),		/* FIXME: follow this */
+	DUMP_FIELD(pointer, ext_data),
 	DUMP_FIELD(unsigned_long, d_flags),
-	DUMP_FIELD(ppi_flag, flags),
-	DUMP_FIELD(ppi_proto, proto),
-	DUMP_FIELD(delay_mechanism, delayMechanism),
 	DUMP_FIELD(pointer, glbs),
-	DUMP_FIELD(pointer, n_ops),
-	DUMP_FIELD(pointer, t_ops),
-	DUMP_FIELD(pointer, __tx_buffer),
-	DUMP_FIELD(pointer, __rx_buffer),
-	DUMP_FIELD(pointer, tx_frame),
-	DUMP_FIELD(pointer, rx_frame),
-	DUMP_FIELD(pointer, tx_ptp),
-	DUMP_FIELD(pointer, rx_ptp),
+	DUMP_FIELD(pointer, portDS),
+	DUMP_FIELD(pointer, servo),		/* FIXME: follow this */
+	DUMP_FIELD(int, port_idx),
+	DUMP_FIELD(UInteger16, frgn_rec_num),
+	DUMP_FIELD(Integer16,  frgn_rec_best),
+	//DUMP_FIELD(unsigned long tmo_cfg[PP_TO_COUNT]), /* dump separately */
 
 	/* This is a sub-structure */
 	DUMP_FIELD(int, ch[0].fd),
@@ -268,10 +269,23 @@ struct dump_info ppi_info [] = {
 	DUMP_FIELD_SIZE(bina, ch[1].addr, 6),
 	DUMP_FIELD(yes_no, ch[1].pkt_present),
 
-	DUMP_FIELD(ip_address, mcast_addr[0]),
-	DUMP_FIELD(ip_address, mcast_addr[1]),
+	/* per-frame data */
+	DUMP_FIELD(pointer, arch_inst_data),
+	DUMP_FIELD(ppi_proto, proto),
+	DUMP_FIELD(delay_mechanism, delayMechanism),
+	DUMP_FIELD(pointer, n_ops),
+	DUMP_FIELD(pointer, t_ops),
+	DUMP_FIELD(pointer, __tx_buffer),
+	DUMP_FIELD(pointer, __rx_buffer),
+	DUMP_FIELD(pointer, tx_frame),
+	DUMP_FIELD(pointer, rx_frame),
+	DUMP_FIELD(pointer, tx_ptp),
+	DUMP_FIELD(pointer, rx_ptp),
 	DUMP_FIELD(int, tx_offset),
 	DUMP_FIELD(int, rx_offset),
+
+	DUMP_FIELD(ip_address, mcast_addr[0]),
+	DUMP_FIELD(ip_address, mcast_addr[1]),
 	DUMP_FIELD_SIZE(bina, peer, 6),
 	DUMP_FIELD_SIZE(bina, activePeer, 6),
 	DUMP_FIELD(uint16_t, peer_vid),
@@ -285,11 +299,13 @@ struct dump_info ppi_info [] = {
 	DUMP_FIELD(uint64_t, syncCF),
 	DUMP_FIELD(time, last_rcv_time),
 	DUMP_FIELD(time, last_snt_time),
-	DUMP_FIELD(UInteger16, frgn_rec_num),
-	DUMP_FIELD(Integer16,  frgn_rec_best),
-	DUMP_FIELD(UInteger32, frgn_master_time_window_ms),
-	DUMP_FIELD(pointer,frgn_master),
-	DUMP_FIELD(pointer, portDS),
+	DUMP_FIELD(UInteger16, recv_sync_sequence_id),
+	//DUMP_FIELD(UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]),
+	DUMP_FIELD_SIZE(bina, received_ptp_header, sizeof(MsgHeader)),
+
+	DUMP_FIELD(unsigned_long, ptp_tx_count),
+	DUMP_FIELD(unsigned_long, ptp_rx_count),
+
 	DUMP_FIELD(yes_no_Boolean,asymmetryCorrectionPortDS.enable),
 	DUMP_FIELD(TimeInterval,asymmetryCorrectionPortDS.constantAsymmetry),
 	DUMP_FIELD(RelativeDifference,asymmetryCorrectionPortDS.scaledDelayCoefficient),
@@ -297,17 +313,14 @@ struct dump_info ppi_info [] = {
 	DUMP_FIELD(TimeInterval,timestampCorrectionPortDS.ingressLatency),
 	DUMP_FIELD(TimeInterval,timestampCorrectionPortDS.messageTimestampPointLatency),
 	DUMP_FIELD(TimeInterval,timestampCorrectionPortDS.semistaticLatency),
-	DUMP_FIELD(ppi_state_Enumeration8,externalPortConfigurationPortDS.desiredState),
 
-	//DUMP_FIELD(unsigned long tmo_cfg[PP_TO_COUNT]), /* dump separately */
-	DUMP_FIELD(UInteger16, recv_sync_sequence_id),
-	//DUMP_FIELD(UInteger16 sent_seq[__PP_NR_MESSAGES_TYPES]),
-	DUMP_FIELD_SIZE(bina, received_ptp_header, sizeof(MsgHeader)),
-	DUMP_FIELD(yes_no_Boolean, link_up),
+	/* cold data */
+	DUMP_FIELD(UInteger32, frgn_master_time_window_ms),
+	DUMP_FIELD(pointer,frgn_master),
+	DUMP_FIELD(ppi_state_Enumeration8,externalPortConfigurationPortDS.desiredState),
 
 	DUMP_FIELD_SIZE(pointer, iface_name,16),
 	DUMP_FIELD_SIZE(pointer, port_name,16),
-	DUMP_FIELD(int, port_idx),
 	DUMP_FIELD(int, vlans_array_len),
 	/* pass the size of a vlans array in the nvlans field */
 	DUMP_FIELD_SIZE(array_int, vlans, offsetof(DUMP_STRUCT, nvlans)),
@@ -318,9 +331,6 @@ struct dump_info ppi_info [] = {
 	DUMP_FIELD_SIZE(char, cfg.iface_name, 16),
 	DUMP_FIELD(ppi_profile, cfg.profile),
 	DUMP_FIELD(delay_mechanism, cfg.delayMechanism),
-
-	DUMP_FIELD(unsigned_long, ptp_tx_count),
-	DUMP_FIELD(unsigned_long, ptp_rx_count),
 };
 
 #undef DUMP_STRUCT
@@ -360,7 +370,18 @@ struct dump_info wr_ext_portDS_info [] = {
 struct dump_info wrs_arch_data_info [] = {
 	DUMP_FIELD(timing_mode,timingMode),
 	DUMP_FIELD(int,timingModeLockingState),
-	DUMP_FIELD(int,gmUnlockErr)
+	DUMP_FIELD(int,gmUnlockErr),
+	DUMP_FIELD(pointer,inst_seg)
+};
+
+#undef DUMP_STRUCT
+#define DUMP_STRUCT struct wrs_shm_inst
+struct dump_info wrs_shm_inst_info [] = {
+	DUMP_FIELD(UInteger32,sequence),
+	DUMP_FIELD(UInteger32,stamp),
+	DUMP_FIELD(int,index),
+	DUMP_FIELD(pointer,ppi),
+	DUMP_FIELD(UInteger32,nsamples),
 };
 #endif
 
@@ -742,6 +763,505 @@ void dump_one_field_ppsi_wrs(int type, int size, void *p, int i)
 
 extern struct dump_info shm_head [5];
 
+#if CONFIG_HAS_STABILITY
+/* Stability estimates, from the accumulators in the servo */
+static void dump_stability(struct pp_stability *s, char *prefix)
+{
+	int64_t v;
+	int j;
+
+	printf("%s.stab.samples: %u\n", prefix, s->n);
+	printf("%s.stab.tau0_ns: %lli\n", prefix,
+	       (long long)pp_stab_tau0_ns(s));
+	for (j = 0; j < PP_STAB_NWIN; j++)
+		if ((v = pp_stab_mtie_ps(s, j)) >= 0)
+			printf("%s.stab.mtie_ps[%llis]: %lli\n", prefix,
+			       (long long)s->mtie[j].win_ns / 1000000000LL,
+			       (long long)v);
+	for (j = 0; j < PP_STAB_NTAU; j++) {
+		if ((v = pp_stab_tdev_ps(s, j)) < 0)
+			continue;
+		printf("%s.stab.tdev_ps[%i]: %lli\n", prefix, 1 << j,
+		       (long long)v);
+		printf("%s.stab.adev[%i]: %.3e\n", prefix, 1 << j,
+		       pp_stab_adev(s, j));
+	}
+}
+#endif
+
+#if CONFIG_HAS_FSM_PROFILE
+/* Time accounting of the state machine: only entries with calls */
+static void dump_prof_stat(char *prefix, const char *kind, const char *name,
+			   int idx, struct pp_prof_stat *s)
+{
+	if (!s->n)
+		return;
+	if (name)
+		printf("%s.prof.%s.%s:", prefix, kind, name);
+	else
+		printf("%s.prof.%s.%i:", prefix, kind, idx);
+	printf(" calls %u min_ns %u avg_ns %u max_ns %u\n", s->n, s->min,
+	       pp_prof_avg(s), s->max);
+}
+
+static void dump_profile(struct pp_prof *p, char *prefix)
+{
+	int j;
+
+	printf("%s.prof.runs: %u\n", prefix, p->runs);
+	for (j = 0; j < PPS_LAST_STATE; j++)
+		dump_prof_stat(prefix, "state", NULL, j, &p->state[j]);
+	for (j = 0; j < __PP_NR_MESSAGES_TYPES; j++)
+		dump_prof_stat(prefix, "msg", NULL, j, &p->msg[j]);
+	dump_prof_stat(prefix, "msg", "timer", 0, &p->timer);
+	for (j = 0; j < PP_PROF_NHOOKS; j++)
+		dump_prof_stat(prefix, "hook", pp_prof_hook_name(j), j,
+			       &p->hook[j]);
+}
+#endif
+
+#if CONFIG_ARCH_IS_WRS && CONFIG_HAS_LOOP_MONITOR
+/* Main loop monitor: histogram summaries and the last stalls */
+static void dump_loopmon(struct pp_loopmon *m, struct pp_instance *ppi,
+			 int nlinks)
+{
+	struct pp_loop_stall *st;
+	struct pp_lat_hist *h;
+	uint32_t i;
+	int k;
+
+	for (k = 0; k < PP_LOOP_NKINDS; k++) {
+		h = &m->h[k];
+		printf("ppsi.loop.%s: n %u avg_ns %llu max_ns %u stalls %u\n",
+		       pp_loop_kind_name(k), h->n,
+		       h->n ? (unsigned long long)h->sum / h->n : 0ULL,
+		       h->max, m->stalls[k]);
+	}
+	i = m->nstalls > PP_LOOP_NSTALLS ? m->nstalls - PP_LOOP_NSTALLS : 0;
+	for (; i < m->nstalls; i++) {
+		st = &m->stall[i % PP_LOOP_NSTALLS];
+		printf("ppsi.loop.stall.%u: %s %u ns at %lli.%09lli", i,
+		       pp_loop_kind_name(st->kind), st->ns,
+		       (long long)st->when_ns / 1000000000LL,
+		       (long long)st->when_ns % 1000000000LL);
+		if (ppi && st->inst >= 0 && st->inst < nlinks)
+			printf(", %s state %i", ppi[st->inst].cfg.port_name,
+			       st->state);
+		printf("\n");
+	}
+}
+#endif
+
+#if CONFIG_ARCH_IS_WRS
+/*
+ * Streaming mode: attach once and poll the instances at a fixed rate.
+ * Each instance is copied under its own sequence, then compared with the
+ * previous copy: only fields that changed are printed, and the servo
+ * samples written since the last poll are taken from the ring in the
+ * instance segment, so no update is missed unless the ring overflowed.
+ */
+struct stream_inst {
+	struct wrs_shm_inst seg;
+	struct pp_instance ppi;
+	portDS_t portDS;
+	struct pp_servo servo;
+#if CONFIG_HAS_EXT_WR || CONFIG_HAS_EXT_L1SYNC
+	wrh_servo_t wrh_servo;
+#endif
+	uint32_t nsamples;		/* samples already emitted */
+	int valid;
+};
+
+/* Size of a field of the given type, for the types of the tables above */
+static int stream_type_size(int type)
+{
+#define STREAM_TYPE(t, ctype) case dump_type_ ## t: return sizeof(ctype)
+#define STREAM_TYPEDEF(t) STREAM_TYPE(t, t)
+	switch (type) {
+	STREAM_TYPE(int, int);
+	STREAM_TYPE(yes_no, int);
+	STREAM_TYPE(unsigned_long, unsigned long);
+	STREAM_TYPE(unsigned_char, unsigned char);
+	STREAM_TYPE(unsigned_short, unsigned short);
+	STREAM_TYPE(long_long, long long);
+	STREAM_TYPE(double, double);
+	STREAM_TYPE(float, float);
+	STREAM_TYPE(pointer, void *);
+	STREAM_TYPE(time, struct pp_time);
+	STREAM_TYPE(pp_time, struct pp_time);
+	STREAM_TYPE(ip_address, uint32_t);
+	STREAM_TYPEDEF(uint16_t);
+	STREAM_TYPEDEF(uint32_t);
+	STREAM_TYPEDEF(uint64_t);
+	STREAM_TYPEDEF(UInteger64);
+	STREAM_TYPEDEF(Integer64);
+	STREAM_TYPEDEF(UInteger32);
+	STREAM_TYPEDEF(Integer32);
+	STREAM_TYPEDEF(UInteger16);
+	STREAM_TYPEDEF(Integer16);
+	STREAM_TYPEDEF(UInteger8);
+	STREAM_TYPEDEF(Integer8);
+	STREAM_TYPEDEF(Enumeration8);
+	STREAM_TYPEDEF(UInteger4);
+	STREAM_TYPEDEF(Boolean);
+	STREAM_TYPEDEF(ClockIdentity);
+	STREAM_TYPEDEF(PortIdentity);
+	STREAM_TYPEDEF(ClockQuality);
+	STREAM_TYPEDEF(TimeInterval);
+	STREAM_TYPEDEF(RelativeDifference);
+	STREAM_TYPEDEF(FixedDelta);
+	STREAM_TYPEDEF(Timestamp);
+	STREAM_TYPEDEF(scaledPicoseconds);
+	STREAM_TYPEDEF(yes_no_Boolean);
+	STREAM_TYPEDEF(delay_mechanism);
+	STREAM_TYPEDEF(protocol_extension);
+	STREAM_TYPEDEF(wrpc_mode_cfg);
+	STREAM_TYPEDEF(timing_mode);
+	STREAM_TYPEDEF(ppi_state);
+	STREAM_TYPEDEF(ppi_state_Enumeration8);
+	STREAM_TYPEDEF(wr_config);
+	STREAM_TYPEDEF(wr_config_Enumeration8);
+	STREAM_TYPEDEF(wr_role);
+	STREAM_TYPEDEF(wr_role_Enumeration8);
+	STREAM_TYPEDEF(pp_pdstate);
+	STREAM_TYPEDEF(exstate);
+	STREAM_TYPEDEF(pp_servo_flag);
+	STREAM_TYPEDEF(pp_servo_state);
+#if CONFIG_HAS_EXT_WR
+	STREAM_TYPEDEF(wr_state);
+#endif
+	STREAM_TYPEDEF(ppi_profile);
+	STREAM_TYPEDEF(ppi_proto);
+	STREAM_TYPEDEF(ppi_flag);
+	}
+#undef STREAM_TYPEDEF
+#undef STREAM_TYPE
+	return -1;
+}
+
+/*
+ * The size of field j, from its entry in the dump table: strings and
+ * binary fields have their size, int arrays the offset of their count,
+ * and other types with a size are arrays of that many items. Returns
+ * -1 for unknown types: such fields are always printed.
+ */
+static int stream_field_size(struct dump_info *info, void *new, void *old)
+{
+	int n, size = stream_type_size(info->type);
+
+	switch (info->type) {
+	case dump_type_char:
+	case dump_type_bina:
+		return info->size;
+	case dump_type_array_int:
+		n = *(int *)(new + info->size);
+		if (old && *(int *)(old + info->size) > n)
+			n = *(int *)(old + info->size);
+		/* The count follows the array: don't trust it beyond */
+		if (n < 0 || n * sizeof(int) > info->size - info->offset)
+			n = (info->size - info->offset) / sizeof(int);
+		return n * sizeof(int);
+	case dump_type_pointer:
+		return size; /* the size is for the pointed-to string */
+	}
+	if (size > 0 && info->size)
+		size *= info->size;
+	return size;
+}
+
+static int stream_diff(void *new, void *old, struct dump_info *info, int n,
+		       char *prefix)
+{
+	int j, off, size, ret = 0;
+
+	for (j = 0; j < n; j++) {
+		off = info[j].offset;
+		size = stream_field_size(info + j, new, old);
+		if (old && size >= 0 && !memcmp(new + off, old + off, size))
+			continue;
+		dump_many_fields(new, info + j, 1, prefix);
+		ret++;
+	}
+	return ret;
+}
+
+static int stream_snapshot(struct wrs_shm_head *head, int i,
+			   struct stream_inst *si)
+{
+	struct wrs_shm_inst *seg = wrs_shm_inst_lookup(head, i);
+	struct pp_instance *ppi;
+	unsigned seq;
+	int tries;
+
+	if (!seg)
+		return -1;
+	ppi = wrs_shm_inst_ppi(head, seg);
+	for (tries = 0; tries < 100; tries++) {
+		seq = wrs_shm_inst_seqbegin(seg);
+		si->seg = *seg;
+		si->ppi = *ppi;
+		si->portDS = *(portDS_t *)wrs_shm_follow(head, ppi->portDS);
+		si->servo = *(struct pp_servo *)wrs_shm_follow(head, ppi->servo);
+#if CONFIG_HAS_EXT_WR
+		if (ppi->protocol_extension == PPSI_EXT_WR)
+			si->wrh_servo = ((struct wr_data *)
+				wrs_shm_follow(head, ppi->ext_data))->servo;
+#endif
+#if CONFIG_HAS_EXT_L1SYNC
+		if (ppi->protocol_extension == PPSI_EXT_L1S)
+			si->wrh_servo = ((struct l1e_data *)
+				wrs_shm_follow(head, ppi->ext_data))->servo;
+#endif
+		if (!wrs_shm_inst_seqretry(seg, seq))
+			return 0;
+	}
+	return -1; /* the writer is too busy: try at next poll */
+}
+
+/* Local helpers, so that the tool does not depend on ppsi's time-arith.c */
+static long long stream_picos(struct pp_time *t)
+{
+	return t->secs * 1000LL * 1000 * 1000 * 1000 +
+		((t->scaled_nsecs * 1000) >> TIME_FRACBITS);
+}
+
+static char *stream_time(struct pp_time *t, char *buf)
+{
+	sprintf(buf, "%lli.%09lli", (long long)t->secs,
+		(long long)(t->scaled_nsecs >> TIME_FRACBITS));
+	return buf;
+}
+
+static void stream_sample(int format, int i, struct stream_inst *si,
+			  struct wrs_shm_sample *smp, uint32_t lost,
+			  long long now_ms)
+{
+	struct wrs_shm_stream_rec rec;
+	char buf[64];
+
+	switch (format) {
+	case PPSI_STREAM_TEXT:
+		if (lost)
+			printf("ppsi.inst.%d.sample.lost: %u\n", i, lost);
+		if (!smp)
+			break;
+		printf("ppsi.inst.%d.sample.%u: %s offset_ps %lli delay_ps %lli "
+		       "state %i locked %i\n", i, smp->update_count,
+		       stream_time(&smp->update_time, buf),
+		       stream_picos(&smp->offsetFromMaster),
+		       stream_picos(&smp->meanDelay),
+		       smp->state, smp->servo_locked);
+		break;
+	case PPSI_STREAM_JSON:
+		printf("{\"time_ms\":%lli,\"inst\":%d,\"port\":\"%s\"",
+		       now_ms, i, si->ppi.cfg.port_name);
+		if (lost)
+			printf(",\"lost\":%u", lost);
+		if (smp)
+			printf(",\"update_count\":%u,\"update_time\":\"%s\","
+			       "\"offset_ps\":%lli,\"delay_ps\":%lli,"
+			       "\"state\":%i,\"locked\":%i", smp->update_count,
+			       stream_time(&smp->update_time, buf),
+			       stream_picos(&smp->offsetFromMaster),
+			       stream_picos(&smp->meanDelay),
+			       smp->state, smp->servo_locked);
+		printf("}\n");
+		break;
+	case PPSI_STREAM_BIN:
+		memset(&rec, 0, sizeof(rec));
+		rec.magic = WRS_SHM_STREAM_MAGIC;
+		rec.index = i;
+		rec.ppi_state = si->ppi.state;
+		rec.lost = lost;
+		if (smp)
+			rec.sample = *smp;
+		fwrite(&rec, sizeof(rec), 1, stdout);
+		break;
+	}
+}
+
+static void stream_inst(int format, int i, struct stream_inst *si,
+			struct stream_inst *old, long long now_ms)
+{
+	uint32_t n = si->seg.nsamples, from, lost = 0;
+	char prefix[64];
+
+	if (format == PPSI_STREAM_TEXT) {
+		sprintf(prefix, "ppsi.inst.%d.info", i);
+		stream_diff(&si->ppi, old ? &old->ppi : NULL, ppi_info,
+			    ARRAY_SIZE(ppi_info), prefix);
+		sprintf(prefix, "ppsi.inst.%d.portDS", i);
+		stream_diff(&si->portDS, old ? &old->portDS : NULL, portDS_info,
+			    ARRAY_SIZE(portDS_info), prefix);
+		sprintf(prefix, "ppsi.inst.%d.servo", i);
+		stream_diff(&si->servo, old ? &old->servo : NULL,
+			    servo_state_info, ARRAY_SIZE(servo_state_info),
+			    prefix);
+#if CONFIG_HAS_EXT_WR || CONFIG_HAS_EXT_L1SYNC
+		if (si->ppi.protocol_extension == PPSI_EXT_WR ||
+		    si->ppi.protocol_extension == PPSI_EXT_L1S) {
+			sprintf(prefix, "ppsi.inst.%d.servo.wrh", i);
+			stream_diff(&si->wrh_servo,
+				    old ? &old->wrh_servo : NULL,
+				    wrh_servo_info, ARRAY_SIZE(wrh_servo_info),
+				    prefix);
+		}
+#endif
+	} else if (format == PPSI_STREAM_JSON &&
+		   (!old || old->ppi.state != si->ppi.state)) {
+		printf("{\"time_ms\":%lli,\"inst\":%d,\"port\":\"%s\","
+		       "\"ppi_state\":%i}\n", now_ms, i,
+		       si->ppi.cfg.port_name, si->ppi.state);
+	}
+
+	/* At the first poll only new samples are emitted */
+	if (!old)
+		si->nsamples = n;
+	else
+		si->nsamples = old->nsamples;
+	from = si->nsamples;
+	if (n - from > WRS_SHM_INST_NSAMPLES) {
+		lost = n - from - WRS_SHM_INST_NSAMPLES;
+		from = n - WRS_SHM_INST_NSAMPLES;
+	}
+	if (lost)
+		stream_sample(format, i, si, NULL, lost, now_ms);
+	for (; from != n; from++)
+		stream_sample(format, i, si,
+			      si->seg.sample + from % WRS_SHM_INST_NSAMPLES,
+			      0, now_ms);
+	si->nsamples = n;
+}
+
+static long long stream_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int stream_ppsi_mem(struct wrs_shm_head *head, int format, int period_ms)
+{
+	struct stream_inst *cur, *prev, *tmp;
+	struct pp_globals *ppg = wrs_shm_ppg(head);
+	unsigned pidsequence = head->pidsequence;
+	int i, nlinks = ppg->nlinks, first = 1;
+	long long now_ms;
+
+	cur = calloc(nlinks, sizeof(*cur));
+	prev = calloc(nlinks, sizeof(*prev));
+	if (!cur || !prev) {
+		fprintf(stderr, "dump ppsi: out of memory\n");
+		return -1;
+	}
+	while (1) {
+		if (head->pidsequence != pidsequence ||
+		    head->version != WRS_PPSI_SHMEM_VERSION) {
+			fprintf(stderr, "dump ppsi: ppsi restarted\n");
+			break;
+		}
+		now_ms = stream_now_ms();
+		if (format == PPSI_STREAM_TEXT)
+			printf("ppsi.stream.time_ms: %lli\n", now_ms);
+		for (i = 0; i < nlinks; i++) {
+			cur[i].valid = !stream_snapshot(head, i, cur + i);
+			if (!cur[i].valid) {
+				/* keep the last good copy for the next diff */
+				cur[i] = prev[i];
+				continue;
+			}
+			stream_inst(format, i, cur + i,
+				    first || !prev[i].valid ? NULL : prev + i,
+				    now_ms);
+		}
+		fflush(stdout);
+		tmp = prev; prev = cur; cur = tmp;
+		first = 0;
+		usleep(period_ms * 1000);
+	}
+	free(cur);
+	free(prev);
+	return -1;
+}
+
+/* PPSI_STREAM="<text|json|bin>[,<period_ms>]" turns the dump into a stream */
+static int stream_from_env(struct wrs_shm_head *head, char *s)
+{
+	char *comma = strchr(s, ',');
+	int len = comma ? comma - s : strlen(s), format, period_ms = 100;
+
+	if (!strncmp(s, "text", len))
+		format = PPSI_STREAM_TEXT;
+	else if (!strncmp(s, "json", len))
+		format = PPSI_STREAM_JSON;
+	else if (!strncmp(s, "bin", len))
+		format = PPSI_STREAM_BIN;
+	else
+		format = -1;
+	if (comma)
+		period_ms = atoi(comma + 1);
+	if (format < 0 || !len || period_ms <= 0) {
+		fprintf(stderr, "dump ppsi: invalid PPSI_STREAM \"%s\"\n", s);
+		return -1;
+	}
+	return stream_ppsi_mem(head, format, period_ms);
+}
+#endif
+
+#if CONFIG_ARCH_IS_WRS && CONFIG_HAS_FLIGHT_RECORDER
+/*
+ * PPSI_FREC=<file> appends the flight recorders of all the instances to
+ * the file, in the format of the dumps of ppsi itself: ppsi-frec decodes
+ * it. The rings are read without locking, like the rest of the dump.
+ */
+static int frec_from_env(struct wrs_shm_head *head, char *name)
+{
+	struct pp_globals *ppg = (void *)head + head->data_off;
+	struct pp_instance *ppi = wrs_shm_follow(head, ppg->pp_instances);
+	struct pp_frec_file h;
+	struct pp_frec_port p;
+	struct timespec ts;
+	struct pp_frec *r;
+	uint32_t i;
+	FILE *f;
+	int j;
+
+	f = fopen(name, "a");
+	if (!f) {
+		fprintf(stderr, "dump ppsi: %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	memset(&h, 0, sizeof(h));
+	h.magic = PP_FREC_MAGIC;
+	h.version = PP_FREC_VERSION;
+	h.entry_size = sizeof(struct pp_frec_entry);
+	h.reason = PP_FREC_DUMP_SHMEM;
+	h.inst = -1;
+	h.nports = ppg->nlinks;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	h.mono_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	h.real_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	fwrite(&h, sizeof(h), 1, f);
+	for (j = 0; j < ppg->nlinks; j++) {
+		r = &ppi[j].frec;
+		memset(&p, 0, sizeof(p));
+		strncpy(p.name, ppi[j].cfg.port_name, sizeof(p.name) - 1);
+		p.n = r->n; /* once: ppsi keeps recording */
+		p.count = p.n < PP_FREC_LEN ? p.n : PP_FREC_LEN;
+		fwrite(&p, sizeof(p), 1, f);
+		for (i = p.n - p.count; i < p.n; i++)
+			fwrite(&r->e[i % PP_FREC_LEN], sizeof(r->e[0]), 1, f);
+	}
+	if (fclose(f) != 0) {
+		fprintf(stderr, "dump ppsi: %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+#endif
+
 int dump_ppsi_mem(struct wrs_shm_head *head)
 {
 	struct pp_globals *ppg;
@@ -758,6 +1278,14 @@ int dump_ppsi_mem(struct wrs_shm_head *head)
 			head->version, WRS_PPSI_SHMEM_VERSION);
 		return -1;
 	}
+#if CONFIG_ARCH_IS_WRS
+	if (getenv("PPSI_STREAM"))
+		return stream_from_env(head, getenv("PPSI_STREAM"));
+#endif
+#if CONFIG_ARCH_IS_WRS && CONFIG_HAS_FLIGHT_RECORDER
+	if (getenv("PPSI_FREC"))
+		return frec_from_env(head, getenv("PPSI_FREC"));
+#endif
 	/* dump shmem header*/
 	dump_many_fields(head, shm_head, ARRAY_SIZE(shm_head),"ppsi.shm");
 
@@ -780,6 +1308,11 @@ int dump_ppsi_mem(struct wrs_shm_head *head)
 	{
 		wrs_arch_data_t *arch_data=wrs_shm_follow(head, WRS_ARCH_G(ppg));
 		dump_many_fields(arch_data, wrs_arch_data_info, ARRAY_SIZE(wrs_arch_data_info),"ppsi.arch_inst_data");
+#if CONFIG_HAS_LOOP_MONITOR
+		dump_loopmon(&arch_data->loop,
+			     wrs_shm_follow(head, ppg->pp_instances),
+			     ppg->nlinks);
+#endif
 	}
 #endif
 
@@ -789,16 +1322,34 @@ int dump_ppsi_mem(struct wrs_shm_head *head)
 	for (i = 0; i < ppg->nlinks; i++) {
 		struct pp_instance * ppi= pp_instances+i;
 
+#if CONFIG_ARCH_IS_WRS
+		{
+			struct wrs_shm_inst *seg = wrs_shm_inst_lookup(head, i);
+
+			sprintf(prefix,"ppsi.inst.%d.shm",i);
+			if (seg)
+				dump_many_fields(seg, wrs_shm_inst_info,
+						 ARRAY_SIZE(wrs_shm_inst_info),prefix);
+		}
+#endif
 		sprintf(prefix,"ppsi.inst.%d.portDS",i);
 		dump_many_fields( wrs_shm_follow(head, ppi->portDS)
 				, portDS_info,
 				 ARRAY_SIZE(portDS_info),prefix);
+#if CONFIG_HAS_FSM_PROFILE
+		sprintf(prefix,"ppsi.inst.%d",i);
+		dump_profile(&ppi->prof, prefix);
+#endif
 
 		if ( ppi->state == PPS_SLAVE ) {
 			sprintf(prefix,"ppsi.inst.%d.servo",i);
 			dump_many_fields( wrs_shm_follow(head, ppi->servo)
 					, servo_state_info,
 					 ARRAY_SIZE(servo_state_info),prefix);
+#if CONFIG_HAS_STABILITY
+			dump_stability(&((struct pp_servo *)
+				wrs_shm_follow(head, ppi->servo))->stab, prefix);
+#endif
 #if CONFIG_HAS_EXT_WR == 1
 			if ( ppi->protocol_extension == PPSI_EXT_WR) {
 				struct wr_data *data;